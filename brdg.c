@@ -32,7 +32,11 @@
  * Bridge module for Solaris
  * 
  * /usr/local/bin/gcc -D_KERNEL brdg.c -c
- * ld -dn -r brdg.o -o brdg
+ * /usr/local/bin/gcc -D_KERNEL brdgcore.c -c
+ * ld -dn -r brdg.o brdgcore.o -o brdg
+ *
+ * STREAMS part of the bridge. Forwarding decisions are made by the
+ * forwarding core in brdgcore.c.
  *
  *******************************************************/
 
@@ -56,86 +60,221 @@
 #include <sys/ddi.h>
 #include <sys/sunddi.h>
 #include <sys/cmn_err.h>
-#include <stdarg.h>
+#include <sys/strsun.h>
+#include <sys/random.h>
+#include <sys/kstat.h>
 #ifdef SOL11
 #include <sys/vfs_opreg.h>
 #endif
+#include "brdgcore.h"
+#include "brdgtrace.h"
+#include "brdgio.h"
+
+/*
+ * Number of ethernet addresses which can be registered in the forwarding
+ * database. It is rounded up to a power of two number of buckets when the
+ * module is loaded, and can be changed in /etc/system, e.g.
+ *
+ *    set brdg:brdg_fdb_size = 16384
+ */
+uint32_t brdg_fdb_size = 4096;
+
+/*
+ * Aging of the forwarding database.
+ * An address which has not been seen for brdg_fdb_aging seconds is removed
+ * from the forwarding database. (0 disables aging)
+ * The sweeper runs every brdg_fdb_sweep_interval milliseconds and checks
+ * at most brdg_fdb_sweep_buckets buckets each time, so that the sweeper
+ * never holds the lock of the forwarding database for long. It also
+ * reclaims entries of closed or flushed ports, which are already treated
+ * as not registered.
+ */
+uint32_t brdg_fdb_aging = 300;
+uint32_t brdg_fdb_sweep_interval = 100;
+uint32_t brdg_fdb_sweep_buckets = 256;
+
+/*
+ * IGMP/MLD snooping.
+ * brdg_mcast_groups multicast groups in each VLAN can be learned.
+ * (0 disables snooping, and multicast frames are flooded)
+ * A port is a member of a group for brdg_mcast_timeout seconds since the
+ * last report, or brdg_mcast_leave seconds since a leave unless reported
+ * again. A port is a router port for brdg_mrouter_timeout seconds since
+ * the last query. Defaults are the group membership interval, the last
+ * member query time and the other querier present interval of RFC 3376.
+ *
+ *    set brdg:brdg_mcast_groups = 0
+ */
+uint32_t brdg_mcast_groups = 512;
+uint32_t brdg_mcast_timeout = 260;
+uint32_t brdg_mcast_leave = 2;
+uint32_t brdg_mrouter_timeout = 255;
+
+/*
+ * Storm control.
+ * Limits of broadcast, multicast and unknown unicast frames received on
+ * each port are set by brdgadm. Bursts up to brdg_storm_burst milliseconds
+ * of the limit are accepted. It must be longer than brdg_fdb_sweep_interval,
+ * which is the resolution of the clock of storm control.
+ */
+uint32_t brdg_storm_burst = 200;
+
+/*
+ * Station move.
+ * When an address is seen on another port, frames are forwarded at once
+ * and the address is moved to the port. An address is not moved again for
+ * brdg_move_holddown seconds after a move, so that a flapping address (or
+ * a loop) can not rewrite the entry constantly. Frames from the other port
+ * are dropped meanwhile. Moves are counted in "move" of the kstat of the
+ * new port. 0 disables the hold-down, e.g.
+ *
+ *    set brdg:brdg_move_holddown = 0
+ */
+uint32_t brdg_move_holddown = 1;
+
+/*
+ * Loop detection.
+ * A port is blocked when brdg_loop_flaps addresses in a second were moved
+ * to the port within brdg_move_holddown + 2 seconds of their previous
+ * move, as a host which really moved never is, or when a probe sent to
+ * each port every brdg_loop_probe seconds came back to it. The port does not
+ * receive nor send frames for brdg_loop_block seconds, which is doubled
+ * for each detection of the same port up to 16 times. Dropped frames are
+ * counted in "drop_blocked" of the kstat, and detections are shown by
+ * brdgadm -b. 0 disables each method of detection, e.g.
+ *
+ *    set brdg:brdg_loop_probe = 0
+ */
+uint32_t brdg_loop_flaps = 10;
+uint32_t brdg_loop_block = 10;
+uint32_t brdg_loop_probe = 2;
+
+/*
+ * Rapid Spanning Tree Protocol (802.1w).
+ * Set brdg_stp to 1 to run RSTP with the bridge priority brdg_stp_priority
+ * (a multiple of 4096). BPDUs are flooded as other multicast frames while
+ * RSTP is disabled. Path costs, port priorities and edge ports are set by
+ * brdgadm -P, and the state is shown by brdgadm -r, e.g.
+ *
+ *    set brdg:brdg_stp = 1
+ */
+uint32_t brdg_stp = 0;
+uint32_t brdg_stp_priority = 32768;
+
+/*
+ * If set, frames queued on the backlog of a port are linked by b_next and
+ * passed to putnext(9F) at once by brdg_wsrv(). A driver which does not
+ * handle b_next chains sends only the first frame and silently drops or
+ * leaks the rest, so this is off by default. Set it only if all NIC
+ * drivers below brdg are GLDv3 drivers, whose dld layer passes chains
+ * of raw mode streams to mac_tx(), e.g. e1000g, bge, igb, ixgbe and nge:
+ *
+ *    set brdg:brdg_xmit_chain = 1
+ */
+int brdg_xmit_chain = 0;
+
+/*
+ * Backlog of each port, in bytes.
+ * Frames which the NIC driver can not accept now are queued on the write
+ * queue of the port and sent by brdg_wsrv() when the driver back-enables
+ * the queue. Frames to the port are dropped while the backlog is above
+ * brdg_backlog_hiwat, until it is drained below brdg_backlog_lowat.
+ */
+size_t brdg_backlog_hiwat = 512 * 1024;
+size_t brdg_backlog_lowat = 128 * 1024;
 
-#define  MAXPORT 20   /* Max number of ports to be bridged. (Max number of NICs)*/
-#define  MAXHASH 1024 /* Max number of ethernet addresses to be registered. */
-#define  MAX_MSG 256  /* Max length for syslog messages */
+/*
+ * Name of the driver below the control stream.
+ * brdgadm pushes brdg on /dev/ip to send ioctls (brdgio.h). Such a stream
+ * is not added to the bridge as a port.
+ */
+#define BRDG_CTL_DRIVER "ip"
+
+/*
+ * Max number of brdg_fdb_read() or brdg_mcast_read() called by one
+ * BRDG_IOC_FDB_READ or BRDG_IOC_MCAST_READ, so that one ioctl reads at
+ * most BRDG_FDB_SCAN * BRDG_IOC_FDB_SCAN buckets.
+ */
+#define BRDG_IOC_FDB_SCAN 16
 
 static int  brdg_open (queue_t*, dev_t*, int, int, cred_t*);
 static int  brdg_close (queue_t*, int, int, cred_t*);
 static int  brdg_wput (queue_t*, mblk_t*);
+static int  brdg_wsrv (queue_t*);
 static int  brdg_rput (queue_t*, mblk_t*);
-static int  brdg_rput_data (queue_t*, mblk_t*);
-static void brdg_register_node (queue_t *, mblk_t *);
-#ifdef DEBUG
-static void debug_print (int , char *, ...);
-#endif
+static void brdg_rput_proto (queue_t*, mblk_t*);
+static void brdg_pullup (mblk_t*);
+static void brdg_sweep (void *);
+static void brdg_learn_task (void *);
+static void brdg_fini_bridge (void);
+static int  brdg_ops_canput (void *);
+static void brdg_ops_xmit (void *, void *);
+static void *brdg_ops_dup (void *);
+static void brdg_ops_free (void *);
+static int  brdg_ops_schedule (brdg_t *);
+static void *brdg_ops_retag (void *, uint32_t, uint32_t);
+static void *brdg_ops_alloc (const uint8_t *, size_t);
+static int  brdg_kstat_update (kstat_t *, int);
+static void brdg_ioctl (queue_t *, mblk_t *);
+static void brdg_ioctl_excl (queue_t *, mblk_t *);
+static void brdg_ioc_fdb_read (brdg_ioc_fdb_read_t *);
+static void brdg_ioc_fdb_info (brdg_ioc_fdb_info_t *);
+static void brdg_ioc_mcast_read (brdg_ioc_mcast_read_t *);
+static int  brdg_ioc_fdb_add (brdg_ioc_fdb_entry_t *);
+static int  brdg_ioc_fdb_del (brdg_ioc_fdb_entry_t *);
+static int  brdg_ioc_vlan_set (brdg_ioc_vlan_t *);
+static int  brdg_ioc_vlan_get (brdg_ioc_vlan_t *);
+static int  brdg_ioc_storm_set (brdg_ioc_storm_t *);
+static void brdg_ioc_port_list (brdg_ioc_port_list_t *);
+static void brdg_ioc_loop_read (brdg_ioc_loop_read_t *);
+static int  brdg_ioc_stp_set (brdg_ioc_stp_port_t *);
+static int  brdg_ioc_stp_read (brdg_ioc_stp_read_t *);
+static int  brdg_ioc_limit_set (brdg_ioc_limit_t *);
+static void brdg_ioc_limit_read (brdg_ioc_limit_read_t *);
 /*
  * Port structure.
  * One port structure corresponds to one NIC added by brdgadm command.
  * It has an address of read side queue of brdg module which was PUSH'ed by brdgadm command.
- * 'MAXPORT' port structures are allocated when brdg module is loaded into the kernel
- * as a result of allocating port_list[] array.
+ * Port structure is allocated in brdg_open(), and registered in the
+ * forwarding core as a port. The control stream also has a port structure,
+ * which is not registered. (bport is NULL)
  */
 typedef struct port_s
 {
     queue_t  *rqueue;   /* Read queue of brdg module which corresponds to this port.*/
-    char     *ifname;   /* Not used. For future implementation */
-    uint32_t muxid;     /* Not used. For future implementation */
+    char     ifname[BRDG_IOC_IFNAMSIZ]; /* Interface name set by brdgadm */
+    uint32_t muxid;     /* Mux ID of I_PLINK set by brdgadm. 0 before linked */
+    uint32_t link;      /* BRDG_IOC_LINK_XXX notified by the driver */
+    brdg_port_t *bport; /* Port of the forwarding core. NULL for the control stream */
+    uint32_t id;        /* Port number. Instance number of the kstat */
+    kstat_t  *ksp;      /* Named kstat of statistics of this port */
+    struct port_s *next; /* Next port in port_list */
 } port_t;
 
-port_t port_list[MAXPORT];
+static void brdg_kstat_create (port_t *);
+static port_t *brdg_port_find (uint32_t);
+static int  brdg_ioc_port_set (port_t *, brdg_ioc_port_entry_t *);
 
-/*
- * Node structure.
- * Node structure corresponds to one source ethernet address.
- * This structure is allocated when receiving a packet.
- * It is intended to prevent forwarding a packet to which packet was received.
- */ 
-typedef struct node_s
-{
-    struct    ether_addr ether_addr; /* Source ethenet address */
-    port_t    *port;                 /* Port where this node is connected */
-    uint16_t  state;
-} node_t;
-
-node_t node_hash_table[MAXHASH];
+brdg_t       *brdg_bridge;   /* The bridge. Created in _init() */
+kmutex_t      sweep_lock;    /* Protects sweep_id */
+timeout_id_t  sweep_id;      /* Timeout ID of the sweeper. NULL when stopped */
+ddi_taskq_t   *learn_taskq;  /* Task queue which runs brdg_learn_run() */
+uint32_t      port_id_next;  /* Port number given to the next port */
+port_t        *port_list;    /* All ports except control streams. Changed only in open/close */
 
 /*
- * Calculate a hash value from ethernet address [0-MAXHASH]
+ * Operations for the forwarding core. Frames are mblk_t.
  */
-#define ETHER_HASH(ether_addr) \
-              (\
-                   ((uint8_t)ether_addr.ether_addr_octet[0]    ) + \
-                   ((uint8_t)ether_addr.ether_addr_octet[1]<<8 ) + \
-                   ((uint8_t)ether_addr.ether_addr_octet[2]    ) + \
-                   ((uint8_t)ether_addr.ether_addr_octet[3]<<8 ) + \
-                   ((uint8_t)ether_addr.ether_addr_octet[4]    ) + \
-                   ((uint8_t)ether_addr.ether_addr_octet[5]<<8 )   \
-               ) % MAXHASH
-
-/*
- * Debug routine.
- */
-#ifdef DEBUG
-#define DEBUG_PRINT_ETHER(str, ether_addr) \
-            debug_print(CE_CONT,"%s %x:%x:%x:%x:%x:%x\n", \
-                    str,\
-                    (uint8_t)ether_addr.ether_addr_octet[0],\
-                    (uint8_t)ether_addr.ether_addr_octet[1],\
-                    (uint8_t)ether_addr.ether_addr_octet[2],\
-                    (uint8_t)ether_addr.ether_addr_octet[3],\
-                    (uint8_t)ether_addr.ether_addr_octet[4],\
-                    (uint8_t)ether_addr.ether_addr_octet[5])
-#define  DEBUG_PRINT(argsx)  debug_print args
-#else
-#define DEBUG_PRINT(args)
-#define DEBUG_PRINT_ETHER(str, ether_addr)
-#endif
+static brdg_ops_t brdg_ops = {
+    brdg_ops_canput,
+    brdg_ops_xmit,
+    brdg_ops_dup,
+    brdg_ops_free,
+    brdg_ops_schedule,
+    NULL,
+    brdg_ops_retag,
+    brdg_ops_alloc
+};
 
 static struct module_info minfo = {
     0xabbe, "brdg", 0, INFPSZ, 512, 128 
@@ -146,13 +285,18 @@ static struct qinit brdg_rinit = {
 };
 
 static struct qinit brdg_winit = { 
-    brdg_wput, NULL, NULL, NULL, NULL, &minfo, NULL 
+    brdg_wput, brdg_wsrv, NULL, NULL, NULL, &minfo, NULL 
 };
 
 struct streamtab brdg_info = {
     &brdg_rinit, &brdg_winit, NULL, NULL
 };
 
+/*
+ * Put procedures enter the outer perimeter shared, and open/close enter it
+ * exclusively (D_MTOCEXCL), so that ports are never added or removed while
+ * messages are being forwarded. Put procedures never enter it exclusively.
+ */
 static struct fmodsw brdg_fmodsw ={
     "brdg",
     &brdg_info,
@@ -175,8 +319,41 @@ int
 _init()
 {
         int err;
-        DEBUG_PRINT((CE_CONT,"Entering _init()\n"));        
-        err = mod_install(&modlinkage);
+        brdg_conf_t conf;
+
+        bzero(&conf, sizeof(conf));
+        conf.bc_fdb_size = brdg_fdb_size;
+        conf.bc_fdb_aging = brdg_fdb_aging;
+        conf.bc_sweep_buckets = brdg_fdb_sweep_buckets;
+        conf.bc_mcast_size = brdg_mcast_groups;
+        conf.bc_mcast_timeout = brdg_mcast_timeout;
+        conf.bc_mcast_leave = brdg_mcast_leave;
+        conf.bc_mrouter_timeout = brdg_mrouter_timeout;
+        conf.bc_storm_burst = brdg_storm_burst;
+        conf.bc_move_holddown = (brdg_move_holddown < 65536) ? brdg_move_holddown : 65535;
+        conf.bc_loop_flaps = brdg_loop_flaps;
+        conf.bc_loop_block = (brdg_loop_block != 0) ? brdg_loop_block : 1;
+        conf.bc_loop_probe = brdg_loop_probe;
+        conf.bc_stp = brdg_stp;
+        conf.bc_stp_priority = brdg_stp_priority;
+        (void) random_get_pseudo_bytes((uint8_t *)conf.bc_hash_key, sizeof(conf.bc_hash_key));
+        (void) random_get_pseudo_bytes((uint8_t *)&conf.bc_addr, sizeof(conf.bc_addr));
+
+        learn_taskq = ddi_taskq_create(NULL, "brdg_learn", 1, TASKQ_DEFAULTPRI, 0);
+        if (learn_taskq == NULL)
+            return(ENOMEM);
+        if ((brdg_bridge = brdg_create(&conf, &brdg_ops, NULL)) == NULL) {
+            ddi_taskq_destroy(learn_taskq);
+            return(ENOMEM);
+        }
+        brdg_tick(brdg_bridge, gethrtime() / (NANOSEC / MILLISEC));
+
+        mutex_init(&sweep_lock, NULL, MUTEX_DRIVER, NULL);
+        sweep_id = timeout(brdg_sweep, NULL,
+            drv_usectohz(brdg_fdb_sweep_interval * 1000));
+
+        if ((err = mod_install(&modlinkage)) != 0)
+            brdg_fini_bridge();
         return err;
 }
 
@@ -184,7 +361,6 @@ int
 _info(struct modinfo *modinfop)
 {
     int err;
-    DEBUG_PRINT((CE_CONT,"Entering _info()\n"));    
     err = mod_info(&modlinkage, modinfop);
     return err;
 }
@@ -193,11 +369,43 @@ int
 _fini()
 {
     int err;
-    DEBUG_PRINT((CE_CONT,"Entering _finit()\n"));    
     err =  mod_remove(&modlinkage);
+    if (err == 0)
+        brdg_fini_bridge();
     return err;
 }
 
+/*****************************************************************************
+ * brdg_fini_bridge()
+ *
+ * Stop the sweeper and the learning task, and destroy the bridge.
+ * Called from _init() or _fini().
+ *****************************************************************************/
+static void
+brdg_fini_bridge(void)
+{
+    timeout_id_t tid;
+
+    /*
+     * Clear sweep_id first so that a running sweeper does not
+     * schedule itself again.
+     */
+    mutex_enter(&sweep_lock);
+    tid = sweep_id;
+    sweep_id = NULL;
+    mutex_exit(&sweep_lock);
+    (void) untimeout(tid);
+    mutex_destroy(&sweep_lock);
+
+    /*
+     * Wait for the learning task.
+     */
+    ddi_taskq_destroy(learn_taskq);
+    learn_taskq = NULL;
+
+    brdg_destroy(brdg_bridge);
+    brdg_bridge = NULL;
+}
 
 /**********************************************************************
  * brdg_open()
@@ -208,28 +416,49 @@ static int
 brdg_open(queue_t* q, dev_t *devp, int oflag, int sflag, cred_t *cred)
 {
     port_t *port = NULL;
-    uint32_t portnum;
 
-    DEBUG_PRINT((CE_CONT,"Entering brdg_open()\n"));
     if (sflag != MODOPEN) {
         return EINVAL;
     }
-    
-    for (portnum = 0; portnum < MAXPORT; portnum++){
-        if (port_list[portnum].rqueue == NULL){
-            port_list[portnum].rqueue = q;
-            port = &port_list[portnum];            
-            break;
-        }
-    }
 
-    if (portnum >= MAXPORT)
-        return(ENXIO);    
+    port = kmem_zalloc(sizeof(port_t), KM_SLEEP);
+    port->rqueue = q;
+    if (strcmp(WR(q)->q_next->q_qinfo->qi_minfo->mi_idname,
+            BRDG_CTL_DRIVER) == 0) {
+        /*
+         * Control stream. Only ioctls are handled.
+         */
+        q->q_ptr = WR(q)->q_ptr = port;
+        qprocson(q);
+        return(0);
+    }
     /*
      * Set an address of port_s structure to q_ptr of read queue and write queue.
      */
     q->q_ptr = WR(q)->q_ptr = port;
+    /*
+     * Watermarks of the backlog of this port.
+     */
+    (void) strqset(WR(q), QHIWAT, 0, brdg_backlog_hiwat);
+    (void) strqset(WR(q), QLOWAT, 0, brdg_backlog_lowat);
+    /*
+     * Enable PUT and SERVICE routine before the port is added to the
+     * forwarding core, since BPDUs and probes of loop detection are put to
+     * the port by brdg_sweep() and the learning task as soon as it is added.
+     * Frames received meanwhile are discarded by brdg_rput() (bport is NULL),
+     * though put procedures do not run until open returns (D_MTOCEXCL).
+     */
     qprocson(q);
+    if ((port->bport = brdg_port_add(brdg_bridge, port)) == NULL) {
+        qprocsoff(q);
+        q->q_ptr = WR(q)->q_ptr = NULL;
+        kmem_free(port, sizeof(port_t));
+        return(ENOMEM);
+    }
+    port->id = port_id_next++;
+    port->next = port_list;
+    port_list = port;
+    brdg_kstat_create(port);
     return(0);    
 }
 
@@ -241,29 +470,35 @@ brdg_open(queue_t* q, dev_t *devp, int oflag, int sflag, cred_t *cred)
 static int brdg_close (queue_t *q, int flag, int sflag, cred_t *cred)
 {
     port_t *port;
-    node_t *node;
-    uint32_t nodenum;
+    port_t **pp;
     
-    DEBUG_PRINT((CE_CONT,"Entering brdg_close()\n"));    
     port = q->q_ptr;
+    if (port->ksp != NULL)
+        kstat_delete(port->ksp);
     /*
-     * Disable PUT and SERVICE routine.
-     */
-    qprocsoff(q);
-    /*
-     * Delete node structure
+     * Remove the port from the forwarding core. Node structures of
+     * this port are deleted. This is done before qprocsoff(), since
+     * BPDUs and probes of loop detection are put to the port by
+     * brdg_sweep() and the learning task until the port is removed.
      */
-    for ( nodenum =0 ; nodenum < MAXHASH ; nodenum++){
-        node = &node_hash_table[nodenum];
-        if ( node->port != NULL && node->port->rqueue == q){
-            node->port = NULL;
+    if (port->bport != NULL) {
+        brdg_port_remove(brdg_bridge, port->bport);
+        for (pp = &port_list; *pp != NULL; pp = &(*pp)->next) {
+            if (*pp == port) {
+                *pp = port->next;
+                break;
+            }
         }
     }
-    port->rqueue= NULL; 
+    /*
+     * Disable PUT and SERVICE routine.
+     */
+    qprocsoff(q);
     /*
      * Unlink port structure.
      */
     q->q_ptr = WR(q)->q_ptr = NULL;
+    kmem_free(port, sizeof(port_t));
     return(0);
 }
 
@@ -271,7 +506,11 @@ static int brdg_close (queue_t *q, int flag, int sflag, cred_t *cred)
  * brdg_wput()
  *
  * Write put procedure of brdg module.
- * No one won't call this function...
+ * Called for messages from the upper stream, and for frames forwarded
+ * from other ports by put(9F).
+ * If the NIC driver can not accept the message now, or messages are
+ * already queued, the message is queued and sent by brdg_wsrv().
+ * ioctls of brdg (brdgio.h) are handled by brdg_ioctl().
  * 
  *  Arguments:
  *           q:  queue structure
@@ -282,9 +521,69 @@ static int brdg_close (queue_t *q, int flag, int sflag, cred_t *cred)
 static int
 brdg_wput(queue_t *q, mblk_t *mp)
 {
-    DEBUG_PRINT((CE_CONT,"Entering brdg_wput()\n"));
-    
-    putnext(q, mp);
+    if (mp->b_datap->db_type == M_FLUSH) {
+        if (*mp->b_rptr & FLUSHW)
+            flushq(q, FLUSHDATA);
+        putnext(q, mp);
+        return(0);
+    }
+    if (mp->b_datap->db_type == M_IOCTL &&
+        (((struct iocblk *)mp->b_rptr)->ioc_cmd & ~0xff) == BRDG_IOC) {
+        brdg_ioctl(q, mp);
+        return(0);
+    }
+    if (mp->b_datap->db_type >= QPCTL ||
+        (q->q_first == NULL && canputnext(q))) {
+        putnext(q, mp);
+        return(0);
+    }
+    BRDG_TRACE2(flowctl, queue_t *, q, mblk_t *, mp);
+    (void) putq(q, mp);
+    return(0);
+}
+
+/*************************************************************************
+ * brdg_wsrv()
+ *
+ * Write service procedure of brdg module.
+ * Sends the queued messages to the NIC driver while it can accept them.
+ * Called when the driver back-enables the queue. Up to BRDG_BATCH queued
+ * M_DATA messages are linked by b_next and passed at once if
+ * brdg_xmit_chain is set. The chain is built here, in the context of the
+ * queue itself, since messages which STREAMS defers to the syncq of the
+ * queue are linked by b_next.
+ * 
+ *  Arguments:
+ *           q:  queue structure
+ *  Return:
+ *           None
+ *************************************************************************/
+static int
+brdg_wsrv(queue_t *q)
+{
+    mblk_t   *mp;
+    mblk_t   *tail;
+    mblk_t   *next;
+    uint32_t n;
+
+    while ((mp = getq(q)) != NULL) {
+        if (mp->b_datap->db_type < QPCTL && !canputnext(q)) {
+            BRDG_TRACE2(flowctl, queue_t *, q, mblk_t *, mp);
+            (void) putbq(q, mp);
+            break;
+        }
+        if (brdg_xmit_chain && mp->b_datap->db_type == M_DATA) {
+            for (n = 1, tail = mp; n < BRDG_BATCH && (next = getq(q)) != NULL; n++) {
+                if (next->b_datap->db_type != M_DATA) {
+                    (void) putbq(q, next);
+                    break;
+                }
+                tail->b_next = next;
+                tail = next;
+            }
+        }
+        putnext(q, mp);
+    }
     return(0);
 }
 
@@ -294,7 +593,12 @@ brdg_wput(queue_t *q, mblk_t *mp)
  * Read procedure of brdg module.
  *
  * This function is called by putnext(9F) called by NIC driver.
- * If messages type is M_DATA, brdg_rput_data() is called.
+ * If messages type is M_DATA, it is passed to the forwarding core.
+ * Frames of the control stream are discarded. M_ERROR and M_HANGUP take
+ * the link of the port down, and DLPI messages are handled by
+ * brdg_rput_proto().
+ * A chain of M_DATA messages linked by b_next is passed to the forwarding
+ * core BRDG_BATCH messages at a time.
  * 
  *  Arguments:
  *           q:  queue structure
@@ -305,10 +609,11 @@ brdg_wput(queue_t *q, mblk_t *mp)
 static int
 brdg_rput(queue_t *q, mblk_t *mp)
 {
-    struct     ether_header *ether;
-    uchar_t    *rptr;       /* Read pointer */
-    node_t     *snode;      /* node structure which is a list of senders */
-    
+    port_t       *port;
+    brdg_frame_t frames[BRDG_BATCH];
+    uint32_t     n;
+    mblk_t       *next;
+
     switch(mp->b_datap->db_type) {
         case M_FLUSH:
             if (*mp->b_rptr & FLUSHW) {
@@ -320,31 +625,37 @@ brdg_rput(queue_t *q, mblk_t *mp)
             return(0);
         case M_ERROR:
         case M_HANGUP:
+            /* The device can not send frames anymore */
+            port = q->q_ptr;
+            if (port->bport != NULL) {
+                port->link = BRDG_IOC_LINK_DOWN;
+                brdg_port_link(brdg_bridge, port->bport, 0);
+            }
             freemsg(mp);
             return(0);
+        case M_PROTO:
+        case M_PCPROTO:
+            brdg_rput_proto(q, mp);
+            return(0);
         case M_DATA:
-            rptr = mp->b_rptr; /* Read pointer of the messages */
-            ether = (struct ether_header *)&rptr[0];
-            snode = &node_hash_table[ETHER_HASH(ether->ether_shost)];
-
-            if(snode->port == NULL){
-                /*
-                 * The node is not registered yet.
-                 */
-                DEBUG_PRINT((CE_CONT,"Node not registerd. Register new node\n"));
-                qwriter(q, mp, brdg_register_node, PERIM_OUTER);
-                return(0);
-            } else if(bcmp(&ether->ether_shost, &snode->ether_addr, ETHERADDRL)){
-                /*
-                 * It seems hash valus is conflict. (likely happen..)
-                 */
-                DEBUG_PRINT((CE_CONT,"Node address is conflict!!!!\n"));
-                DEBUG_PRINT_ETHER("conflict source addr = ", ether->ether_shost);
-                DEBUG_PRINT_ETHER("conflict node  addr  = ", snode->ether_addr );
-                qwriter(q, mp, brdg_register_node, PERIM_OUTER);
+            port = q->q_ptr;
+            if (port->bport == NULL) {
+                freemsg(mp);
                 return(0);
-            }  
-            brdg_rput_data(q, mp);
+            }
+            while (mp != NULL) {
+                for (n = 0; n < BRDG_BATCH && mp != NULL; n++, mp = next) {
+                    next = mp->b_next;
+                    mp->b_next = NULL;
+                    if (mp->b_cont != NULL)
+                        brdg_pullup(mp);
+                    frames[n].bf_frame = mp;
+                    frames[n].bf_hdr = mp->b_rptr;
+                    frames[n].bf_len = MBLKL(mp);
+                    frames[n].bf_size = (mp->b_cont == NULL) ? MBLKL(mp) : msgdsize(mp);
+                }
+                brdg_input_batch(brdg_bridge, port->bport, frames, n);
+            }
             return(0);
         default:
             freemsg(mp);
@@ -353,145 +664,1087 @@ brdg_rput(queue_t *q, mblk_t *mp)
 }
 
 /**********************************************************************
- * brdg_rput_data()
+ * brdg_pullup()
+ *
+ * Make the data which the forwarding core reads contiguous in the first
+ * message block: the ethernet header with 802.1Q tag and, in IP multicast
+ * frames, the IP header and the IGMP or MLD message if the packet is one.
+ * The rest of the frame is left in b_cont, so ARP, broadcast and multicast
+ * data are not copied. If pullupmsg() fails, the frame is forwarded as it
+ * is, and is not snooped since the core reads only the first block.
  *
- * Read procedure of brdg module for M_DATA message type.
- * This is called by brdg_rput() or brdg_register_node().
- * This function putnext(9F) a messages to the other network interface's queue.
+ *  Arguments:
+ *          mp:  M_DATA message which has b_cont
+ ***********************************************************************/
+static void
+brdg_pullup(mblk_t *mp)
+{
+    size_t    size = msgdsize(mp);
+    size_t    off = sizeof(struct ether_header);
+    size_t    len;
+    uint8_t   *p;
+    uint32_t  type;
+
+    len = MIN(size, sizeof(struct ether_vlan_header));
+    if (MBLKL(mp) < len && !pullupmsg(mp, len))
+        return;
+    p = mp->b_rptr;
+    if (len < sizeof(struct ether_vlan_header) ||
+        !((p[0] == 0x01 && p[1] == 0x00 && p[2] == 0x5e) ||
+            (p[0] == 0x33 && p[1] == 0x33)))
+        return;
+    type = (p[12] << 8) | p[13];
+    if (type == ETHERTYPE_VLAN) {
+        type = (p[16] << 8) | p[17];
+        off += 4;
+    }
+
+    /* IP header */
+    if (type == ETHERTYPE_IP)
+        len = off + 20;
+    else if (type == ETHERTYPE_IPV6)
+        len = off + 40;
+    else
+        return;
+    if (size < len || (MBLKL(mp) < len && !pullupmsg(mp, len)))
+        return;
+    p = mp->b_rptr + off;
+
+    /* IGMP or MLD message, which is the whole payload of the packet */
+    if (type == ETHERTYPE_IP && p[9] == IPPROTO_IGMP)
+        len = off + ((p[2] << 8) | p[3]);
+    else if (type == ETHERTYPE_IPV6 &&
+        (p[6] == IPPROTO_HOPOPTS || p[6] == IPPROTO_ICMPV6))
+        len = off + 40 + ((p[4] << 8) | p[5]);
+    else
+        return;
+    len = MIN(size, len);
+    if (MBLKL(mp) < len)
+        (void) pullupmsg(mp, len);
+}
+
+/**********************************************************************
+ * brdg_rput_proto()
+ *
+ * Handle a DLPI message from the NIC driver.
+ * DL_NOTIFY_IND of link up or down, which brdgadm requested by
+ * DL_NOTIFY_REQ, is given to the forwarding core, which flushes the
+ * addresses of the port at once when the link goes down. Other messages
+ * are acknowledgements of requests of brdgadm, and are passed up until
+ * the stream is linked under IP.
  * 
  *  Arguments:
  *           q:  queue structure
- *          mp:  message block 
- *  Return:
- *           int
+ *          mp:  M_PROTO or M_PCPROTO message
  ***********************************************************************/
-static int
-brdg_rput_data(queue_t *q, mblk_t *mp)
-{
-    uint32_t   portnum;
-    struct     ether_header *ether;
-    uchar_t    *rptr;         /* read pointer */
-    node_t     *snode;        /* node structure */
-    node_t     *dnode;        /* node structure */
-    port_t     *port;         /* port structure */
-    mblk_t     *dp;           /* duplicate message block */
-    
-    port = q->q_ptr;          
-    rptr = mp->b_rptr;       
-    ether = (struct ether_header *)&rptr[0];
-    snode = &node_hash_table[ETHER_HASH(ether->ether_shost)];
+static void
+brdg_rput_proto(queue_t *q, mblk_t *mp)
+{
+    port_t          *port = q->q_ptr;
+    dl_notify_ind_t *ind = (dl_notify_ind_t *)mp->b_rptr;
 
-    if(snode->port == NULL){
-        DEBUG_PRINT((CE_CONT,"Node not registered yet. Something wrong!!!!!\n"));
+    if (port->bport == NULL) {
         freemsg(mp);
-        return(0);
-    } 
+        return;
+    }
+    if (MBLKL(mp) >= sizeof(dl_notify_ind_t) && ind->dl_primitive == DL_NOTIFY_IND) {
+        switch (ind->dl_notification) {
+            case DL_NOTE_LINK_DOWN:
+                port->link = BRDG_IOC_LINK_DOWN;
+                brdg_port_link(brdg_bridge, port->bport, 0);
+                break;
+            case DL_NOTE_LINK_UP:
+                port->link = BRDG_IOC_LINK_UP;
+                brdg_port_link(brdg_bridge, port->bport, 1);
+                break;
+            default:
+                break;
+        }
+        freemsg(mp);
+        return;
+    }
+    if (port->muxid == 0)
+        putnext(q, mp);
+    else
+        freemsg(mp);
+}
 
-    if( snode->port->rqueue == q){
-        dnode = &node_hash_table[ETHER_HASH(ether->ether_dhost)];
+/*****************************************************************************
+ * brdg_ioctl()
+ *
+ * Handle ioctls of brdg sent by I_STR. The result is returned in the
+ * argument of the ioctl.
+ *
+ *  Arguments:
+ *           q  :  write queue
+ *           mp :  M_IOCTL message
+ *****************************************************************************/
+static void
+brdg_ioctl(queue_t *q, mblk_t *mp)
+{
+    struct iocblk *iocp = (struct iocblk *)mp->b_rptr;
+    port_t        *port;
+    int           err;
 
-        if( dnode->port != NULL ){
+    switch (iocp->ioc_cmd) {
+        case BRDG_IOC_FDB_READ:
+            if ((err = miocpullup(mp, sizeof(brdg_ioc_fdb_read_t))) != 0)
+                break;
+            brdg_ioc_fdb_read((brdg_ioc_fdb_read_t *)mp->b_cont->b_rptr);
+            miocack(q, mp, sizeof(brdg_ioc_fdb_read_t), 0);
+            return;
+        case BRDG_IOC_FDB_INFO:
+            if ((err = miocpullup(mp, sizeof(brdg_ioc_fdb_info_t))) != 0)
+                break;
+            brdg_ioc_fdb_info((brdg_ioc_fdb_info_t *)mp->b_cont->b_rptr);
+            miocack(q, mp, sizeof(brdg_ioc_fdb_info_t), 0);
+            return;
+        case BRDG_IOC_MCAST_READ:
+            if ((err = miocpullup(mp, sizeof(brdg_ioc_mcast_read_t))) != 0)
+                break;
+            brdg_ioc_mcast_read((brdg_ioc_mcast_read_t *)mp->b_cont->b_rptr);
+            miocack(q, mp, sizeof(brdg_ioc_mcast_read_t), 0);
+            return;
+        case BRDG_IOC_LOOP_READ:
+            if ((err = miocpullup(mp, sizeof(brdg_ioc_loop_read_t))) != 0)
+                break;
+            brdg_ioc_loop_read((brdg_ioc_loop_read_t *)mp->b_cont->b_rptr);
+            miocack(q, mp, sizeof(brdg_ioc_loop_read_t), 0);
+            return;
+        case BRDG_IOC_STP_READ:
+            if ((err = miocpullup(mp, sizeof(brdg_ioc_stp_read_t))) != 0)
+                break;
+            if ((err = brdg_ioc_stp_read((brdg_ioc_stp_read_t *)mp->b_cont->b_rptr)) != 0)
+                break;
+            miocack(q, mp, sizeof(brdg_ioc_stp_read_t), 0);
+            return;
+        case BRDG_IOC_STP_SET:
+            if ((err = secpolicy_net_config(iocp->ioc_cr, B_FALSE)) != 0)
+                break;
+            if ((err = miocpullup(mp, sizeof(brdg_ioc_stp_port_t))) != 0)
+                break;
+            /* RSTP is serialized by the lock of the forwarding database */
+            if ((err = brdg_ioc_stp_set((brdg_ioc_stp_port_t *)mp->b_cont->b_rptr)) != 0)
+                break;
+            miocack(q, mp, 0, 0);
+            return;
+        case BRDG_IOC_LIMIT_SET:
+            if ((err = secpolicy_net_config(iocp->ioc_cr, B_FALSE)) != 0)
+                break;
+            if ((err = miocpullup(mp, sizeof(brdg_ioc_limit_t))) != 0)
+                break;
+            /*
+             * The token bucket of the learn rate is updated by put
+             * procedures of the port without any lock.
+             */
+            qwriter(q, mp, brdg_ioctl_excl, PERIM_OUTER);
+            return;
+        case BRDG_IOC_LIMIT_READ:
+            if ((err = miocpullup(mp, sizeof(brdg_ioc_limit_read_t))) != 0)
+                break;
+            brdg_ioc_limit_read((brdg_ioc_limit_read_t *)mp->b_cont->b_rptr);
+            miocack(q, mp, sizeof(brdg_ioc_limit_read_t), 0);
+            return;
+        case BRDG_IOC_FDB_ADD:
+        case BRDG_IOC_FDB_DEL:
+            if ((err = secpolicy_net_config(iocp->ioc_cr, B_FALSE)) != 0)
+                break;
+            if ((err = miocpullup(mp, sizeof(brdg_ioc_fdb_entry_t))) != 0)
+                break;
+            if (iocp->ioc_cmd == BRDG_IOC_FDB_ADD)
+                err = brdg_ioc_fdb_add((brdg_ioc_fdb_entry_t *)mp->b_cont->b_rptr);
+            else
+                err = brdg_ioc_fdb_del((brdg_ioc_fdb_entry_t *)mp->b_cont->b_rptr);
+            if (err != 0)
+                break;
+            miocack(q, mp, 0, 0);
+            return;
+        case BRDG_IOC_VLAN_SET:
+            if ((err = secpolicy_net_config(iocp->ioc_cr, B_FALSE)) != 0)
+                break;
+            if ((err = miocpullup(mp, sizeof(brdg_ioc_vlan_t))) != 0)
+                break;
+            /*
+             * The data path reads VLAN configuration of ports without
+             * any lock. Change it while no put procedure is running.
+             */
+            qwriter(q, mp, brdg_ioctl_excl, PERIM_OUTER);
+            return;
+        case BRDG_IOC_STORM_SET:
+            if ((err = secpolicy_net_config(iocp->ioc_cr, B_FALSE)) != 0)
+                break;
+            if ((err = miocpullup(mp, sizeof(brdg_ioc_storm_t))) != 0)
+                break;
+            /*
+             * Token buckets are updated by put procedures of the port
+             * without any lock. Change them while none is running.
+             */
+            qwriter(q, mp, brdg_ioctl_excl, PERIM_OUTER);
+            return;
+        case BRDG_IOC_PORT_SET:
+            if ((err = secpolicy_net_config(iocp->ioc_cr, B_FALSE)) != 0)
+                break;
+            if ((err = miocpullup(mp, sizeof(brdg_ioc_port_entry_t))) != 0)
+                break;
+            /*
+             * Names of ports are read by BRDG_IOC_PORT_LIST of other
+             * streams, and checked for duplicates. Change them exclusively.
+             */
+            qwriter(q, mp, brdg_ioctl_excl, PERIM_OUTER);
+            return;
+        case BRDG_IOC_PORT_LIST:
+            if ((err = miocpullup(mp, sizeof(brdg_ioc_port_list_t))) != 0)
+                break;
+            brdg_ioc_port_list((brdg_ioc_port_list_t *)mp->b_cont->b_rptr);
+            miocack(q, mp, sizeof(brdg_ioc_port_list_t), 0);
+            return;
+        case BRDG_IOC_VLAN_GET:
+            if ((err = miocpullup(mp, sizeof(brdg_ioc_vlan_t))) != 0)
+                break;
+            if ((err = brdg_ioc_vlan_get((brdg_ioc_vlan_t *)mp->b_cont->b_rptr)) != 0)
+                break;
+            miocack(q, mp, sizeof(brdg_ioc_vlan_t), 0);
+            return;
+        case BRDG_IOC_PORT_ID:
+            if ((err = miocpullup(mp, sizeof(uint32_t))) != 0)
+                break;
+            port = q->q_ptr;
+            if (port->bport == NULL) {
+                err = EINVAL;
+                break;
+            }
+            *(uint32_t *)mp->b_cont->b_rptr = port->id;
+            miocack(q, mp, sizeof(uint32_t), 0);
+            return;
+        default:
+            err = EINVAL;
+            break;
+    }
+    miocnak(q, mp, 0, err);
+}
 
-            if (dnode->port->rqueue == q){
+/*****************************************************************************
+ * brdg_ioctl_excl()
+ *
+ * Handle ioctls which change configuration read by the data path.
+ * Called by qwriter(9F) with the outer perimeter held exclusively.
+ *
+ *  Arguments:
+ *           q  :  write queue
+ *           mp :  M_IOCTL message, already checked by brdg_ioctl()
+ *****************************************************************************/
+static void
+brdg_ioctl_excl(queue_t *q, mblk_t *mp)
+{
+    struct iocblk *iocp = (struct iocblk *)mp->b_rptr;
+    int           err;
 
-                DEBUG_PRINT((CE_CONT,"Dest addr is registerd. But not need to forward.\n"));
-                freemsg(mp);
-                return(0);
-            }
-            if ( dnode->port->rqueue == NULL) {
-                DEBUG_PRINT((CE_CONT,"Dest addr is registered. But queue does not exist\n"));
-            } else {
-                if ( canputnext(WR(dnode->port->rqueue))){
-                    DEBUG_PRINT((CE_CONT,"Dest addr is registered. Put the msg to appropriate queue\n"));
-
-                    putnext(WR(dnode->port->rqueue), mp);
-                    return(0);
-                } else {
-                    DEBUG_PRINT((CE_CONT,"Dest addr is registerd. But can not put message.\n"));
-                    freemsg(mp);
-                    return(0);
-                }
+    switch (iocp->ioc_cmd) {
+        case BRDG_IOC_VLAN_SET:
+            err = brdg_ioc_vlan_set((brdg_ioc_vlan_t *)mp->b_cont->b_rptr);
+            break;
+        case BRDG_IOC_STORM_SET:
+            err = brdg_ioc_storm_set((brdg_ioc_storm_t *)mp->b_cont->b_rptr);
+            break;
+        case BRDG_IOC_LIMIT_SET:
+            err = brdg_ioc_limit_set((brdg_ioc_limit_t *)mp->b_cont->b_rptr);
+            break;
+        case BRDG_IOC_PORT_SET:
+            err = brdg_ioc_port_set(q->q_ptr,
+                (brdg_ioc_port_entry_t *)mp->b_cont->b_rptr);
+            if (err == 0) {
+                miocack(q, mp, sizeof(brdg_ioc_port_entry_t), 0);
+                return;
             }
-        } else {
-            DEBUG_PRINT_ETHER("dnode not found for this address: Ether = ", ether->ether_dhost);
-            DEBUG_PRINT((CE_CONT, "dnodes's ETHER_HASH = %d\n", ETHER_HASH(ether->ether_dhost)));
-            /*
-             * Destination ethernet address is not registered yet.
-             * Round ports and put message to all ports.
-             */
-            for ( portnum = 0 ; portnum < MAXPORT ; portnum++){
-                if((port_list[portnum].rqueue != NULL) && (port_list[portnum].rqueue != q)){
-                    if (canputnext(WR(port_list[portnum].rqueue))){
-                        dp = dupmsg(mp);
-                        DEBUG_PRINT((CE_CONT,"put message to port_list[%d] \n",portnum));
-                        putnext(WR(port_list[portnum].rqueue), dp);
-                    }
-                }
-            } 
-            freemsg(mp);
-            return(0);
-        } 
-    } else { /* rqueue == q ? */
-        freemsg(mp);
-        return(0);
+            break;
+        default:
+            err = EINVAL;
+            break;
+    }
+    if (err != 0)
+        miocnak(q, mp, 0, err);
+    else
+        miocack(q, mp, 0, 0);
+}
+
+/*****************************************************************************
+ * brdg_ioc_fdb_read()
+ *
+ * BRDG_IOC_FDB_READ. Fill a page of entries which match the filter,
+ * starting from fr_cursor.
+ * The page is filled by reading the forwarding database in small pieces
+ * by brdg_fdb_read(), so the lock of the forwarding database is never
+ * held for the whole walk. If filters are given, the page may be returned
+ * with fewer entries before the end.
+ *
+ *  Arguments:
+ *           fr :  argument of the ioctl
+ *****************************************************************************/
+static void
+brdg_ioc_fdb_read(brdg_ioc_fdb_read_t *fr)
+{
+    brdg_fdb_entry_t     ent[BRDG_FDB_WAYS * 4];
+    brdg_ioc_fdb_entry_t *fe;
+    port_t               *port;
+    uint32_t             cursor = fr->fr_cursor;
+    uint32_t             count = 0;
+    uint32_t             room;
+    uint32_t             n;
+    uint32_t             i;
+    int                  call;
+
+    if (fr->fr_prefixlen > ETHERADDRL)
+        fr->fr_prefixlen = ETHERADDRL;
+
+    for (call = 0; call < BRDG_IOC_FDB_SCAN && cursor != BRDG_FDB_END; call++) {
+        room = BRDG_IOC_FDB_PAGE - count;
+        if (room > sizeof(ent) / sizeof(ent[0]))
+            room = sizeof(ent) / sizeof(ent[0]);
+        if (room < BRDG_FDB_WAYS)
+            break;
+        cursor = brdg_fdb_read(brdg_bridge, cursor, ent, room, &n);
+        for (i = 0; i < n; i++) {
+            port = ent[i].be_cookie;
+            if ((fr->fr_filter & BRDG_IOC_FDB_PORT) && port->id != fr->fr_port)
+                continue;
+            if ((fr->fr_filter & BRDG_IOC_FDB_PREFIX) &&
+                bcmp(&ent[i].be_addr, fr->fr_prefix, fr->fr_prefixlen) != 0)
+                continue;
+            if ((fr->fr_filter & BRDG_IOC_FDB_VLAN) && ent[i].be_vid != fr->fr_vid)
+                continue;
+            fe = &fr->fr_entry[count++];
+            bcopy(&ent[i].be_addr, fe->fe_addr, ETHERADDRL);
+            fe->fe_flags = (ent[i].be_flags & BRDG_FDB_STATIC) ? BRDG_IOC_FDB_STATIC : 0;
+            fe->fe_port = port->id;
+            fe->fe_age = ent[i].be_age;
+            fe->fe_vid = ent[i].be_vid;
+        }
+    }
+    fr->fr_cursor = cursor;
+    fr->fr_count = count;
+}
+
+/*****************************************************************************
+ * brdg_ioc_fdb_info()
+ *
+ * BRDG_IOC_FDB_INFO. Occupancy of the forwarding database.
+ *
+ *  Arguments:
+ *           fi :  argument of the ioctl
+ *****************************************************************************/
+static void
+brdg_ioc_fdb_info(brdg_ioc_fdb_info_t *fi)
+{
+    brdg_fdb_info_t info;
+    int             i;
+
+    brdg_fdb_info(brdg_bridge, &info);
+    bzero(fi, sizeof(brdg_ioc_fdb_info_t));
+    fi->fi_nbucket = info.bi_nbucket;
+    fi->fi_ways = BRDG_FDB_WAYS;
+    fi->fi_entries = info.bi_entries;
+    fi->fi_aging = brdg_fdb_aging;
+    for (i = 0; i <= BRDG_FDB_WAYS && i <= BRDG_IOC_MAXWAYS; i++)
+        fi->fi_load[i] = info.bi_load[i];
+    fi->fi_evict = info.bi_evict;
+}
+
+/*****************************************************************************
+ * brdg_ioc_mcast_read()
+ *
+ * BRDG_IOC_MCAST_READ. Fill a page of memberships of multicast groups,
+ * starting from mr_cursor.
+ *
+ *  Arguments:
+ *           mr :  argument of the ioctl
+ *****************************************************************************/
+static void
+brdg_ioc_mcast_read(brdg_ioc_mcast_read_t *mr)
+{
+    brdg_mcast_entry_t     ent[BRDG_IOC_MCAST_PAGE / 4];
+    brdg_ioc_mcast_entry_t *me;
+    port_t                 *port;
+    uint32_t               cursor = mr->mr_cursor;
+    uint32_t               count = 0;
+    uint32_t               room;
+    uint32_t               n;
+    uint32_t               i;
+    int                    call;
+
+    for (call = 0; call < BRDG_IOC_FDB_SCAN && cursor != BRDG_FDB_END &&
+             count < BRDG_IOC_MCAST_PAGE; call++) {
+        room = BRDG_IOC_MCAST_PAGE - count;
+        if (room > sizeof(ent) / sizeof(ent[0]))
+            room = sizeof(ent) / sizeof(ent[0]);
+        cursor = brdg_mcast_read(brdg_bridge, cursor, ent, room, &n);
+        for (i = 0; i < n; i++) {
+            port = ent[i].bm_cookie;
+            me = &mr->mr_entry[count++];
+            bcopy(&ent[i].bm_addr, me->me_addr, ETHERADDRL);
+            me->me_flags = (ent[i].bm_flags & BRDG_MCAST_ROUTER) ? BRDG_IOC_MCAST_ROUTER : 0;
+            me->me_port = port->id;
+            me->me_expire = ent[i].bm_expire;
+            me->me_vid = ent[i].bm_vid;
+            me->me_pad = 0;
+        }
+    }
+    mr->mr_cursor = cursor;
+    mr->mr_count = count;
+}
+
+/*****************************************************************************
+ * brdg_ioc_loop_read()
+ *
+ * BRDG_IOC_LOOP_READ. Fill recent detections of loops.
+ *
+ *  Arguments:
+ *           lr :  argument of the ioctl
+ *****************************************************************************/
+static void
+brdg_ioc_loop_read(brdg_ioc_loop_read_t *lr)
+{
+    brdg_loop_event_t     ev[BRDG_LOOP_EVENTS];
+    brdg_ioc_loop_entry_t *le;
+    port_t                *port;
+    uint32_t              n;
+    uint32_t              i;
+
+    /* BRDG_IOC_LOOP_EVENTS is the same as BRDG_LOOP_EVENTS */
+    n = brdg_loop_read(brdg_bridge, ev, BRDG_LOOP_EVENTS);
+    for (i = 0; i < n; i++) {
+        port = ev[i].bl_cookie;
+        le = &lr->lr_entry[i];
+        le->le_port = port->id;
+        le->le_peer = (ev[i].bl_peer != NULL) ?
+            ((port_t *)ev[i].bl_peer)->id : BRDG_IOC_PORT_NONE;
+        bcopy(&ev[i].bl_addr, le->le_addr, ETHERADDRL);
+        le->le_reason = (ev[i].bl_reason == BRDG_LOOP_FLAP) ?
+            BRDG_IOC_LOOP_FLAP : BRDG_IOC_LOOP_PROBE;
+        le->le_flaps = ev[i].bl_flaps;
+        le->le_age = ev[i].bl_age;
+        le->le_block = ev[i].bl_block;
+        le->le_remain = ev[i].bl_remain;
     }
+    lr->lr_count = n;
+}
+
+/*****************************************************************************
+ * brdg_ioc_stp_set()
+ *
+ * BRDG_IOC_STP_SET. Set RSTP of a port.
+ *
+ *  Arguments:
+ *           sp :  argument of the ioctl
+ *  Return:
+ *           0 on success, or errno
+ *****************************************************************************/
+static int
+brdg_ioc_stp_set(brdg_ioc_stp_port_t *sp)
+{
+    port_t          *port;
+    brdg_stp_port_t bp;
+
+    if (!brdg_stp)
+        return(ENOTSUP);
+    if ((port = brdg_port_find(sp->sp_port)) == NULL)
+        return(ENXIO);
+    bzero(&bp, sizeof(bp));
+    bp.bp_cost = sp->sp_cost;
+    bp.bp_priority = sp->sp_priority;
+    bp.bp_edge = sp->sp_edge;
+    if (brdg_port_stp(brdg_bridge, port->bport, &bp) != 0)
+        return(EINVAL);
     return(0);
 }
 
 /*****************************************************************************
- * brdg_register_node()
+ * brdg_ioc_stp_read()
  *
- * Register source ethernet address in node structure.
- * This function must be called through qwriter(9F)
+ * BRDG_IOC_STP_READ. Fill the root bridge and a page of ports, starting
+ * from the port number sr_cursor.
  *
  *  Arguments:
- *           q:  queue structure
- *          mp:  message block 
- *  Return: 
- *           none
+ *           sr :  argument of the ioctl
+ *  Return:
+ *           0 on success, or errno
  *****************************************************************************/
-static void 
-brdg_register_node(queue_t *q, mblk_t *mp)
+static int
+brdg_ioc_stp_read(brdg_ioc_stp_read_t *sr)
 {
-    struct ether_header  *ether;
-    uchar_t              *rptr;     /* read pointer */
-    node_t               *node;     /* node structure */
-    port_t               *port;     /* port structure */
-    
-    port  = q->q_ptr;   
-    rptr  = mp->b_rptr; 
-    ether = (struct ether_header *)&rptr[0];
-    node  = &node_hash_table[ETHER_HASH(ether->ether_shost)];
+    brdg_stp_info_t     info;
+    brdg_stp_port_t     bp;
+    brdg_ioc_stp_port_t *sp;
+    port_t              *port;
+    port_t              *next;
+    uint32_t            cursor = sr->sr_cursor;
+    uint32_t            n;
+    int                 i;
 
-    DEBUG_PRINT((CE_CONT,"register: ETHER_HASH = %d\n",ETHER_HASH(ether->ether_shost)));
-    DEBUG_PRINT_ETHER("register : Ether = ", ether->ether_shost);
-    
-    bcopy(ether->ether_shost.ether_addr_octet, node->ether_addr.ether_addr_octet, ETHERADDRL);
-    node->port = port;
+    if (brdg_stp_info(brdg_bridge, &info) != 0)
+        return(ENOTSUP);
+    for (i = 0; i < 8; i++) {
+        sr->sr_bridge[i] = (uint8_t)(info.bs_bridge >> (56 - 8 * i));
+        sr->sr_root[i] = (uint8_t)(info.bs_root >> (56 - 8 * i));
+    }
+    sr->sr_cost = info.bs_cost;
+    sr->sr_root_port = (info.bs_root_port != NULL) ?
+        ((port_t *)info.bs_root_port)->id : BRDG_IOC_PORT_NONE;
+    sr->sr_tc_count = info.bs_tc_count;
+    sr->sr_tc_age = info.bs_tc_age;
 
-    brdg_rput_data(q, mp);
-    return;
+    for (n = 0; n < BRDG_IOC_STP_PAGE; n++) {
+        next = NULL;
+        for (port = port_list; port != NULL; port = port->next) {
+            if (port->id >= cursor && (next == NULL || port->id < next->id))
+                next = port;
+        }
+        if (next == NULL)
+            break;
+        (void) brdg_port_stp_get(brdg_bridge, next->bport, &bp);
+        sp = &sr->sr_entry[n];
+        bzero(sp, sizeof(brdg_ioc_stp_port_t));
+        sp->sp_port = next->id;
+        sp->sp_cost = bp.bp_cost;
+        sp->sp_priority = bp.bp_priority;
+        sp->sp_edge = bp.bp_edge;
+        sp->sp_id = bp.bp_id;
+        /* BRDG_IOC_STP_XXX are the same as BRDG_STP_XXX */
+        sp->sp_role = bp.bp_role;
+        sp->sp_state = bp.bp_state;
+        sp->sp_oper_edge = bp.bp_oper_edge;
+        for (i = 0; i < 8; i++)
+            sp->sp_dbridge[i] = (uint8_t)(bp.bp_dbridge >> (56 - 8 * i));
+        sp->sp_dport = bp.bp_dport;
+        cursor = next->id + 1;
+    }
+    sr->sr_count = n;
+    sr->sr_cursor = (n == BRDG_IOC_STP_PAGE) ? cursor : BRDG_IOC_FDB_END;
+    return(0);
 }
+
 /*****************************************************************************
- * debug_print()
+ * brdg_ioc_fdb_add()
  *
- * For debug output
+ * BRDG_IOC_FDB_ADD. Register a static entry.
  *
  *  Arguments:
- *           level  :  
- *           format :  
- * Return:
- *           None
+ *           fe :  argument of the ioctl
+ *  Return:
+ *           0 on success, or errno
+ *****************************************************************************/
+static int
+brdg_ioc_fdb_add(brdg_ioc_fdb_entry_t *fe)
+{
+    port_t      *port;
+    brdg_vlan_t vlan;
+
+    if (fe->fe_addr[0] & 0x01)
+        return(EINVAL);     /* Multicast address */
+    if (fe->fe_vid >= BRDG_VLAN_MAX)
+        return(EINVAL);
+    if ((port = brdg_port_find(fe->fe_port)) == NULL)
+        return(ENXIO);
+    if (fe->fe_vid == 0) {
+        brdg_port_vlan_get(port->bport, &vlan);
+        fe->fe_vid = vlan.bv_pvid;
+    }
+    if (brdg_fdb_add_static(brdg_bridge, (struct ether_addr *)fe->fe_addr,
+            fe->fe_vid, port->bport) != 0)
+        return(ENOSPC);
+    return(0);
+}
+
+/*****************************************************************************
+ * brdg_ioc_fdb_del()
+ *
+ * BRDG_IOC_FDB_DEL. Delete an entry.
+ *
+ *  Arguments:
+ *           fe :  argument of the ioctl
+ *  Return:
+ *           0 on success, or errno
+ *****************************************************************************/
+static int
+brdg_ioc_fdb_del(brdg_ioc_fdb_entry_t *fe)
+{
+    if (brdg_fdb_delete(brdg_bridge, (struct ether_addr *)fe->fe_addr,
+            fe->fe_vid) != 0)
+        return(ENOENT);
+    return(0);
+}
+
+/*****************************************************************************
+ * brdg_ioc_vlan_set()
+ *
+ * BRDG_IOC_VLAN_SET. Set VLAN configuration of a port.
+ * Called with the outer perimeter held exclusively.
+ *
+ *  Arguments:
+ *           iv :  argument of the ioctl
+ *  Return:
+ *           0 on success, or errno
+ *****************************************************************************/
+static int
+brdg_ioc_vlan_set(brdg_ioc_vlan_t *iv)
+{
+    port_t      *port;
+    brdg_vlan_t vlan;
+
+    if ((port = brdg_port_find(iv->iv_port)) == NULL)
+        return(ENXIO);
+    vlan.bv_mode = (iv->iv_mode == BRDG_IOC_VLAN_ACCESS) ?
+        BRDG_VLAN_ACCESS : BRDG_VLAN_TRUNK;
+    vlan.bv_pvid = iv->iv_pvid;
+    bcopy(iv->iv_member, vlan.bv_member, sizeof(vlan.bv_member));
+    if (brdg_port_vlan(brdg_bridge, port->bport, &vlan) != 0)
+        return(EINVAL);
+    return(0);
+}
+
+/*****************************************************************************
+ * brdg_ioc_vlan_get()
+ *
+ * BRDG_IOC_VLAN_GET. Get VLAN configuration of a port.
+ *
+ *  Arguments:
+ *           iv :  argument of the ioctl
+ *  Return:
+ *           0 on success, or errno
+ *****************************************************************************/
+static int
+brdg_ioc_vlan_get(brdg_ioc_vlan_t *iv)
+{
+    port_t      *port;
+    brdg_vlan_t vlan;
+
+    if ((port = brdg_port_find(iv->iv_port)) == NULL)
+        return(ENXIO);
+    brdg_port_vlan_get(port->bport, &vlan);
+    iv->iv_mode = (vlan.bv_mode == BRDG_VLAN_ACCESS) ?
+        BRDG_IOC_VLAN_ACCESS : BRDG_IOC_VLAN_TRUNK;
+    iv->iv_pvid = vlan.bv_pvid;
+    bcopy(vlan.bv_member, iv->iv_member, sizeof(iv->iv_member));
+    return(0);
+}
+
+/*****************************************************************************
+ * brdg_ioc_storm_set()
+ *
+ * BRDG_IOC_STORM_SET. Set storm control of a port.
+ * Called with the outer perimeter held exclusively.
+ *
+ *  Arguments:
+ *           is :  argument of the ioctl
+ *  Return:
+ *           0 on success, or errno
+ *****************************************************************************/
+static int
+brdg_ioc_storm_set(brdg_ioc_storm_t *is)
+{
+    port_t       *port;
+    brdg_storm_t storm;
+    uint32_t     class;
+
+    switch (is->is_class) {
+        case BRDG_IOC_STORM_BCAST:
+            class = BRDG_STORM_BCAST;
+            break;
+        case BRDG_IOC_STORM_MCAST:
+            class = BRDG_STORM_MCAST;
+            break;
+        case BRDG_IOC_STORM_UNKNOWN:
+            class = BRDG_STORM_UNKNOWN;
+            break;
+        default:
+            return(EINVAL);
+    }
+    if ((port = brdg_port_find(is->is_port)) == NULL)
+        return(ENXIO);
+    storm.bs_pps = is->is_pps;
+    storm.bs_bps = is->is_bps;
+    if (brdg_port_storm(brdg_bridge, port->bport, class, &storm) != 0)
+        return(EINVAL);
+    return(0);
+}
+
+/*****************************************************************************
+ * brdg_ioc_limit_set()
+ *
+ * BRDG_IOC_LIMIT_SET. Set MAC limit of a port.
+ * Called with the outer perimeter held exclusively.
+ *
+ *  Arguments:
+ *           lm :  argument of the ioctl
+ *  Return:
+ *           0 on success, or errno
+ *****************************************************************************/
+static int
+brdg_ioc_limit_set(brdg_ioc_limit_t *lm)
+{
+    port_t       *port;
+    brdg_limit_t limit;
+
+    if ((port = brdg_port_find(lm->lm_port)) == NULL)
+        return(ENXIO);
+    bzero(&limit, sizeof(limit));
+    limit.bm_max = lm->lm_max;
+    limit.bm_rate = lm->lm_rate;
+    /* BRDG_IOC_LIMIT_XXX are the same as BRDG_LIMIT_XXX */
+    limit.bm_action = lm->lm_action;
+    if (brdg_port_limit(brdg_bridge, port->bport, &limit) != 0)
+        return(EINVAL);
+    return(0);
+}
+
+/*****************************************************************************
+ * brdg_ioc_limit_read()
+ *
+ * BRDG_IOC_LIMIT_READ. Fill a page of MAC limits of ports, starting from
+ * the port number ll_cursor.
+ *
+ *  Arguments:
+ *           ll :  argument of the ioctl
+ *****************************************************************************/
+static void
+brdg_ioc_limit_read(brdg_ioc_limit_read_t *ll)
+{
+    brdg_limit_t     limit;
+    brdg_ioc_limit_t *lm;
+    port_t           *port;
+    port_t           *next;
+    uint64_t         stats[BRDG_STAT_MAX];
+    uint32_t         cursor = ll->ll_cursor;
+    uint32_t         n;
+
+    for (n = 0; n < BRDG_IOC_LIMIT_PAGE; n++) {
+        next = NULL;
+        for (port = port_list; port != NULL; port = port->next) {
+            if (port->id >= cursor && (next == NULL || port->id < next->id))
+                next = port;
+        }
+        if (next == NULL)
+            break;
+        brdg_port_limit_get(brdg_bridge, next->bport, &limit);
+        brdg_port_stats(next->bport, stats);
+        lm = &ll->ll_entry[n];
+        bzero(lm, sizeof(brdg_ioc_limit_t));
+        lm->lm_port = next->id;
+        lm->lm_max = limit.bm_max;
+        lm->lm_rate = limit.bm_rate;
+        lm->lm_action = limit.bm_action;
+        lm->lm_learned = limit.bm_learned;
+        lm->lm_shutdown = limit.bm_shutdown;
+        lm->lm_over = stats[BRDG_STAT_LIMIT];
+        cursor = next->id + 1;
+    }
+    ll->ll_count = n;
+    ll->ll_cursor = (n == BRDG_IOC_LIMIT_PAGE) ? cursor : BRDG_IOC_FDB_END;
+}
+
+/*****************************************************************************
+ * brdg_ioc_port_set()
+ *
+ * BRDG_IOC_PORT_SET. Set the interface name and the mux ID of the port.
+ * Sent to the stream of a port, the port of the stream is changed.
+ * Sent to the control stream, the port is looked up by pe_port.
+ * Called with the outer perimeter held exclusively.
+ *
+ *  Arguments:
+ *           sport :  port structure of the stream the ioctl is sent to
+ *           pe    :  argument of the ioctl
+ *  Return:
+ *           0 on success, or errno
  *****************************************************************************/
-void
-debug_print(int level, char *format, ...)
-{
-    va_list     ap;
-    char        buf[MAX_MSG];
-
-    va_start(ap, format);
-    vsprintf(buf, format, ap);    
-    va_end(ap);
-    cmn_err(level, "%s", buf);
-    return;
-}    
+static int
+brdg_ioc_port_set(port_t *sport, brdg_ioc_port_entry_t *pe)
+{
+    port_t *port;
+    port_t *other;
+
+    if (sport->bport != NULL)
+        port = sport;
+    else if ((port = brdg_port_find(pe->pe_port)) == NULL)
+        return(ENOENT);
+
+    pe->pe_ifname[BRDG_IOC_IFNAMSIZ - 1] = '\0';
+    if (pe->pe_ifname[0] != '\0') {
+        for (other = port_list; other != NULL; other = other->next) {
+            if (other != port && strcmp(other->ifname, pe->pe_ifname) == 0)
+                return(EEXIST);
+        }
+    }
+    (void) strlcpy(port->ifname, pe->pe_ifname, BRDG_IOC_IFNAMSIZ);
+    port->muxid = pe->pe_muxid;
+    pe->pe_port = port->id;
+    return(0);
+}
+
+/*****************************************************************************
+ * brdg_ioc_port_list()
+ *
+ * BRDG_IOC_PORT_LIST. Fill a page of ports whose port number is
+ * pl_cursor or larger, in order of the port number.
+ * port_list is short and in order of addition, so the port with the
+ * smallest number is picked up for each entry.
+ *
+ *  Arguments:
+ *           pl :  argument of the ioctl
+ *****************************************************************************/
+static void
+brdg_ioc_port_list(brdg_ioc_port_list_t *pl)
+{
+    brdg_ioc_port_entry_t *pe;
+    port_t                *port;
+    port_t                *next;
+    uint32_t              cursor = pl->pl_cursor;
+    uint32_t              n;
+
+    for (n = 0; n < BRDG_IOC_PORT_PAGE; n++) {
+        next = NULL;
+        for (port = port_list; port != NULL; port = port->next) {
+            if (port->id >= cursor && (next == NULL || port->id < next->id))
+                next = port;
+        }
+        if (next == NULL)
+            break;
+        pe = &pl->pl_entry[n];
+        pe->pe_port = next->id;
+        pe->pe_muxid = next->muxid;
+        pe->pe_link = next->link;
+        (void) strlcpy(pe->pe_ifname, next->ifname, BRDG_IOC_IFNAMSIZ);
+        cursor = next->id + 1;
+    }
+    pl->pl_count = n;
+    pl->pl_cursor = (n == BRDG_IOC_PORT_PAGE) ? cursor : BRDG_IOC_FDB_END;
+}
+
+/*****************************************************************************
+ * brdg_port_find()
+ *
+ * Find the port by the port number.
+ * port_list is changed only in open and close, which are exclusive with
+ * put procedures.
+ *
+ *  Arguments:
+ *           id :  port number
+ *  Return:
+ *           port structure, or NULL if not found
+ *****************************************************************************/
+static port_t *
+brdg_port_find(uint32_t id)
+{
+    port_t *port;
+
+    for (port = port_list; port != NULL; port = port->next) {
+        if (port->id == id)
+            return(port);
+    }
+    return(NULL);
+}
+
+/*****************************************************************************
+ * brdg_sweep()
+ *
+ * Sweeper of the forwarding database. Called by timeout(9F).
+ * Advances the clock of the bridge and ages out old addresses.
+ *
+ *  Arguments:
+ *           arg :  not used
+ *****************************************************************************/
+static void
+brdg_sweep(void *arg)
+{
+    brdg_tick(brdg_bridge, gethrtime() / (NANOSEC / MILLISEC));
+
+    mutex_enter(&sweep_lock);
+    if (sweep_id != NULL)
+        sweep_id = timeout(brdg_sweep, NULL,
+            drv_usectohz(brdg_fdb_sweep_interval * 1000));
+    mutex_exit(&sweep_lock);
+}
+
+/*****************************************************************************
+ * brdg_learn_task()
+ *
+ * Register source addresses queued by the forwarding core.
+ * Called by the learning task queue.
+ *
+ *  Arguments:
+ *           arg :  bridge
+ *****************************************************************************/
+static void
+brdg_learn_task(void *arg)
+{
+    brdg_learn_run((brdg_t *)arg);
+}
+
+/*****************************************************************************
+ * brdg_kstat_create()
+ *
+ * Create the named kstat brdg:<port number>:port<port number> which shows
+ * statistics of the port. e.g. kstat -m brdg
+ * Statistics are not available if the kstat can not be created.
+ *
+ *  Arguments:
+ *           port :  port structure
+ *****************************************************************************/
+static void
+brdg_kstat_create(port_t *port)
+{
+    kstat_t        *ksp;
+    kstat_named_t  *kn;
+    char           name[KSTAT_STRLEN];
+    int            i;
+
+    (void) snprintf(name, sizeof(name), "port%u", port->id);
+    ksp = kstat_create("brdg", port->id, name, "net", KSTAT_TYPE_NAMED,
+        BRDG_STAT_MAX, 0);
+    if (ksp == NULL) {
+        cmn_err(CE_WARN, "brdg: can't create kstat of %s", name);
+        return;
+    }
+    kn = ksp->ks_data;
+    for (i = 0; i < BRDG_STAT_MAX; i++)
+        kstat_named_init(&kn[i], brdg_stat_name[i], KSTAT_DATA_UINT64);
+    ksp->ks_update = brdg_kstat_update;
+    ksp->ks_private = port;
+    kstat_install(ksp);
+    port->ksp = ksp;
+}
+
+/*****************************************************************************
+ * brdg_kstat_update()
+ *
+ * Update routine of the kstat. Sums up per-CPU statistics of the port.
+ *
+ *  Arguments:
+ *           ksp :  kstat
+ *           rw  :  KSTAT_READ or KSTAT_WRITE
+ *  Return:
+ *           0 on success, EACCES for KSTAT_WRITE
+ *****************************************************************************/
+static int
+brdg_kstat_update(kstat_t *ksp, int rw)
+{
+    port_t         *port = ksp->ks_private;
+    kstat_named_t  *kn = ksp->ks_data;
+    uint64_t       stats[BRDG_STAT_MAX];
+    int            i;
+
+    if (rw == KSTAT_WRITE)
+        return(EACCES);
+    brdg_port_stats(port->bport, stats);
+    for (i = 0; i < BRDG_STAT_MAX; i++)
+        kn[i].value.ui64 = stats[i];
+    return(0);
+}
+
+/*****************************************************************************
+ * Operations for the forwarding core.
+ *
+ * cookie is port_t, and frame is mblk_t.
+ *****************************************************************************/
+static int
+brdg_ops_canput(void *cookie)
+{
+    port_t *port = cookie;
+
+    /* Backlog of the port is not full */
+    return(canput(WR(port->rqueue)));
+}
+
+static void
+brdg_ops_xmit(void *cookie, void *frame)
+{
+    port_t *port = cookie;
+
+    put(WR(port->rqueue), (mblk_t *)frame);
+}
+
+static void *
+brdg_ops_dup(void *frame)
+{
+    return(dupmsg((mblk_t *)frame));
+}
+
+static void
+brdg_ops_free(void *frame)
+{
+    freemsg((mblk_t *)frame);
+}
+
+static int
+brdg_ops_schedule(brdg_t *br)
+{
+    if (ddi_taskq_dispatch(learn_taskq, brdg_learn_task, br,
+            DDI_NOSLEEP) != DDI_SUCCESS)
+        return(-1);
+    return(0);
+}
+
+static void *
+brdg_ops_retag(void *frame, uint32_t from, uint32_t to)
+{
+    mblk_t   *mp = frame;
+    mblk_t   *hmp;
+    uint8_t  *tag;
+
+    /*
+     * Change the header in place if the data is not shared with
+     * duplicates sent to other ports.
+     */
+    if (DB_REF(mp) == 1) {
+        if ((from & BRDG_TAG_PRESENT) && (to & BRDG_TAG_PRESENT)) {
+            mp->b_rptr[14] = (to >> 8) & 0xff;
+            mp->b_rptr[15] = to & 0xff;
+            return(mp);
+        }
+        if (from & BRDG_TAG_PRESENT) {
+            ovbcopy(mp->b_rptr, mp->b_rptr + 4, 2 * ETHERADDRL);
+            mp->b_rptr += 4;
+            return(mp);
+        }
+        if (MBLKHEAD(mp) >= 4) {
+            ovbcopy(mp->b_rptr, mp->b_rptr - 4, 2 * ETHERADDRL);
+            mp->b_rptr -= 4;
+            tag = mp->b_rptr + 2 * ETHERADDRL;
+            tag[0] = BRDG_VLAN_TPID >> 8;
+            tag[1] = BRDG_VLAN_TPID & 0xff;
+            tag[2] = (to >> 8) & 0xff;
+            tag[3] = to & 0xff;
+            return(mp);
+        }
+    }
+
+    /*
+     * Prepend a new header, and skip the old header of the frame.
+     */
+    if ((hmp = allocb(2 * ETHERADDRL + 4, BPRI_MED)) == NULL) {
+        freemsg(mp);
+        return(NULL);
+    }
+    bcopy(mp->b_rptr, hmp->b_wptr, 2 * ETHERADDRL);
+    hmp->b_wptr += 2 * ETHERADDRL;
+    if (to & BRDG_TAG_PRESENT) {
+        hmp->b_wptr[0] = BRDG_VLAN_TPID >> 8;
+        hmp->b_wptr[1] = BRDG_VLAN_TPID & 0xff;
+        hmp->b_wptr[2] = (to >> 8) & 0xff;
+        hmp->b_wptr[3] = to & 0xff;
+        hmp->b_wptr += 4;
+    }
+    mp->b_rptr += (from & BRDG_TAG_PRESENT) ? 2 * ETHERADDRL + 4 : 2 * ETHERADDRL;
+    hmp->b_cont = mp;
+    return(hmp);
+}
+
+static void *
+brdg_ops_alloc(const uint8_t *data, size_t len)
+{
+    mblk_t   *mp;
+
+    if ((mp = allocb(len, BPRI_MED)) == NULL)
+        return(NULL);
+    bcopy(data, mp->b_wptr, len);
+    mp->b_wptr += len;
+    return(mp);
+}
@@ -31,12 +31,21 @@
  * Command which configures brdg module
  *
  * Usage: 
- *   brdgadm -a interface    # Add interface as switch port
- *   brdgadm -d interface    # Delete interface
+ *   brdgadm -a interface[,interface]...  # Add interfaces as switch ports
+ *   brdgadm -d interface[,interface]...  # Delete interfaces
+ *   brdgadm -f file         # Add interfaces listed in file
+ *   brdgadm -s interval     # Show statistics of ports every interval seconds
+ *   brdgadm -t [-p port] [-m prefix] [-v vlan] # Show forwarding database
+ *   brdgadm -S mac,interface[,vlan] # Add static entry of mac on interface
+ *   brdgadm -R mac[,vlan]     # Remove static entry
+ *   brdgadm -V interface,access,vlan           # Set access port of vlan
+ *   brdgadm -V interface,trunk,pvid[,vlans]    # Set trunk port of vlans
  *
  *********************************************************************/
 #include <netinet/in.h>
 #include <sys/types.h>
+#include <sys/param.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <sys/socket.h>
 #include <sys/stropts.h>
@@ -56,26 +65,113 @@
 #include <sys/varargs.h>
 #include <strings.h>
 #include <ctype.h>
+#include <kstat.h>
+#include <stddef.h>
+#include "brdgio.h"
+#include "dlpiutil.h"
 
-#define MAXDLBUF        32768
-#define MUXIDFILE        "/tmp/brdg.muxid" /* File that stores mux_id*/
+#define STATICFILE       "/etc/brdg.static" /* File that stores static entries */
+#define VLANFILE         "/etc/brdg.vlan"   /* File that stores VLAN configuration */
+#define STORMFILE        "/etc/brdg.storm"  /* File that stores storm control */
+#define STPFILE          "/etc/brdg.stp"    /* File that stores RSTP of ports */
+#define LIMITFILE        "/etc/brdg.limit"  /* File that stores MAC limits of ports */
 
-int add_interface(char *);
-int delete_interface(char *);
+/*
+ * Static entries of an ethernet address to be matched in
+ * /etc/brdg.static by match_static().
+ */
+typedef struct static_match {
+    uint8_t *sm_addr;     /* ethernet address */
+    int      sm_vid;      /* VLAN ID. -1 for all VLANs */
+    int      sm_fd;       /* stream to delete the entries from, or -1 */
+} static_match_t;
+
+int add_interface(int, int, char *, dlbringup_t *);
+int delete_interface(int, char *);
+int open_interface(char *, t_uscalar_t *);
+int plumb_interface(int, char *, uint32_t *);
+int config_interfaces(char *, int);
+int read_config(char *);
 int list_interface();
+int show_stats(int);
+int show_fdb(int, char *, int);
+int show_mcast();
+int show_loop();
+int show_stp();
+int show_limit();
+int open_control();
+int add_static(char *);
+int remove_static(char *);
+int apply_static(int, char *, uint32_t);
+int read_ports();
+brdg_ioc_port_entry_t *find_entry(char *);
+int find_port(char *);
+char *find_interface(uint32_t, char *, size_t);
+int parse_mac(char *, uint8_t *);
+int remove_static_entry(uint8_t *, int, int);
+int match_static(char *, void *);
+int match_key(char *, void *);
+int rewrite_config(char *, int (*)(char *, void *), void *, char *);
+int replace_config_line(char *, char *, char *);
+int apply_config(int, char *, uint32_t);
+int set_vlan(char *);
+int parse_vlan(char *, void *);
+int set_storm(char *);
+int parse_storm(char *, void *);
+int set_stp(char *);
+int parse_stp(char *, void *);
+int set_limit(char *);
+int parse_limit(char *, void *);
 int print_usage(char *);
 
-extern int dlattachreq(int, t_uscalar_t, caddr_t );
-extern int dlpromisconreq(int, t_uscalar_t, caddr_t);
-extern int dlbindreq(int, t_uscalar_t, t_uscalar_t, uint16_t, uint16_t, t_uscalar_t, caddr_t);
-extern int dldetachreq(int , caddr_t);
-extern int dlpromiscoffreq(int, t_uscalar_t, caddr_t);
-extern int strioctl(int , int , int , int , char *);
+/*
+ * Columns shown by show_stats(), and statistics of the brdg kstat
+ * summed up for each column.
+ */
+#define NSTATCOL 11
+static struct {
+    char  *title;
+    char  *stats[6];
+} stat_columns[NSTATCOL] = {
+    { "rx",      { "rx", NULL } },
+    { "tx",      { "tx", NULL } },
+    { "forward", { "forward", NULL } },
+    { "flood",   { "flood", NULL } },
+    { "mcast",   { "mcast", NULL } },
+    { "drop",    { "drop_src", "drop_runt", "drop_vlan", "drop_full", "drop_nomem", NULL } },
+    { "storm",   { "drop_bcast", "drop_mcast", "drop_unknown", NULL } },
+    { "learn",   { "learn", NULL } },
+    { "move",    { "move", NULL } },
+    { "blocked", { "drop_blocked", NULL } },
+    { "limit",   { "limit", NULL } }
+};
+
+/*
+ * Snapshot of statistics of a port
+ */
+typedef struct portstat_s
+{
+    int        instance;                /* Instance of the kstat */
+    char       name[KSTAT_STRLEN];      /* Name of the kstat */
+    hrtime_t   snaptime;                /* Time of the snapshot */
+    uint64_t   val[NSTATCOL];
+} portstat_t;
+
+/*
+ * Ports registered in brdg module. Read by read_ports()
+ */
+static brdg_ioc_port_entry_t *port_table = NULL;
+static uint32_t port_count = 0;
+
 
 int
 main(int argc, char *argv[])
 {
     int     i;
+    int     fdb = 0;        /* -t is given */
+    int     port = -1;      /* port number given by -p */
+    int     vlan = -1;      /* VLAN ID given by -v */
+    char    *prefix = NULL; /* address prefix given by -m */
     extern char *optarg;
 
     if( argc == 1 )
@@ -86,22 +182,77 @@ main(int argc, char *argv[])
         exit(1);
     }
     
-    while ((i = getopt (argc, argv, "d:a:l")) != EOF) {
+    while ((i = getopt (argc, argv, "d:a:f:ls:tgbrnp:m:v:S:R:V:L:P:M:")) != EOF) {
         switch (i){
             case 'd':
-                delete_interface(optarg);                
+                config_interfaces(optarg, 0);
                 break;
             case 'a':
-                add_interface(optarg);
+                config_interfaces(optarg, 1);
+                break;
+            case 'f':
+                read_config(optarg);
                 break;
             case 'l':
                 list_interface();
                 break;                
+            case 's':
+                show_stats(atoi(optarg));
+                break;
+            case 't':
+                fdb = 1;
+                break;
+            case 'g':
+                show_mcast();
+                break;
+            case 'b':
+                show_loop();
+                break;
+            case 'r':
+                show_stp();
+                break;
+            case 'n':
+                show_limit();
+                break;
+            case 'p':
+                if (strncmp(optarg, "port", 4) == 0)
+                    port = atoi(optarg + 4);
+                else if ((port = find_port(optarg)) < 0) {
+                    fprintf(stderr, "Interface %s is not registerd\n", optarg);
+                    exit(1);
+                }
+                break;
+            case 'm':
+                prefix = optarg;
+                break;
+            case 'v':
+                vlan = atoi(optarg);
+                break;
+            case 'S':
+                add_static(optarg);
+                break;
+            case 'R':
+                remove_static(optarg);
+                break;
+            case 'V':
+                set_vlan(optarg);
+                break;
+            case 'L':
+                set_storm(optarg);
+                break;
+            case 'P':
+                set_stp(optarg);
+                break;
+            case 'M':
+                set_limit(optarg);
+                break;
             default:
                 print_usage(argv[0]);
                 break;
         }
     }
+    if (fdb)
+        show_fdb(port, prefix, vlan);
     exit(0);
 }
 
@@ -110,9 +261,51 @@ print_usage(char *argv)
 {
     printf("Usage: %s [ -a interface | -d interface] \n",argv);
     printf("Options:\n");
-    printf(" -a interface\t: Add interface as port\n");
-    printf(" -d interface\t: Delete interface from port list\n");
+    printf(" -a interface[,interface]...\n");
+    printf("            \t: Add interfaces as ports\n");
+    printf(" -d interface[,interface]...\n");
+    printf("            \t: Delete interfaces from port list\n");
+    printf(" -f file\t: Add interfaces listed in file. Interfaces are separated\n");
+    printf("        \t  by spaces, ',' or newlines. '#' begins a comment\n");
     printf(" -l \t\t: List all interfaces in port list\n");    
+    printf(" -s interval\t: Show statistics of ports every interval seconds.\n");
+    printf("            \t  Totals since the ports were added are shown first.\n");
+    printf("            \t  If interval is 0, only the totals are shown.\n");
+    printf(" -t \t\t: Show forwarding database and its occupancy\n");
+    printf(" -p port\t: With -t, show addresses on the port (e.g. port0 or hme0) only\n");
+    printf(" -m prefix\t: With -t, show addresses which begin with prefix\n");
+    printf("          \t  (e.g. 0:14:4f) only\n");
+    printf(" -v vlan\t: With -t, show addresses in vlan only\n");
+    printf(" -g \t\t: Show multicast groups and router ports learned by\n");
+    printf("    \t\t  IGMP/MLD snooping\n");
+    printf(" -b \t\t: Show recent loops and ports blocked by loop detection\n");
+    printf(" -r \t\t: Show spanning tree and roles and states of ports\n");
+    printf(" -n \t\t: Show MAC limits and learned addresses of ports\n");
+    printf(" -S mac,interface[,vlan]: Add static entry of mac in vlan (default 1)\n");
+    printf("            \t  on interface. It is never aged or replaced, and\n");
+    printf("            \t  is added again when the interface is added.\n");
+    printf(" -R mac[,vlan]\t: Remove static entry of mac\n");
+    printf(" -V interface,access,vlan\n");
+    printf("            \t: Interface is a member of vlan. Frames are untagged\n");
+    printf(" -V interface,trunk,pvid[,vlan[-vlan]]...\n");
+    printf("            \t: Interface is a member of the vlans (all if omitted).\n");
+    printf("            \t  Frames are tagged except frames of pvid.\n");
+    printf("            \t  Interfaces are trunk of all vlans with pvid 1 by default.\n");
+    printf(" -L interface,class,pps[,bps]\n");
+    printf("            \t: Limit frames of class (bcast, mcast or unknown) received\n");
+    printf("            \t  on interface to pps frames/s and bps bytes/s.\n");
+    printf("            \t  0 means no limit. Drops are shown in storm of -s.\n");
+    printf(" -P interface,cost[,priority[,edge]]\n");
+    printf("            \t: Set path cost (0 for default) and port priority\n");
+    printf("            \t  (multiple of 16, default 128) of RSTP of interface.\n");
+    printf("            \t  edge is 1 if only hosts are connected to interface.\n");
+    printf(" -M interface,max[,rate[,action]]\n");
+    printf("            \t: Learn up to max addresses, and rate new addresses/s\n");
+    printf("            \t  on interface. 0 means no limit. Frames from other\n");
+    printf("            \t  addresses are forwarded without learning (stop), are\n");
+    printf("            \t  dropped (drop), or shut down interface (shutdown)\n");
+    printf("            \t  until -M is given again. Default is stop. Frames over\n");
+    printf("            \t  the limit are shown in limit of -s.\n");
     exit(1);
 }
 
@@ -120,119 +313,71 @@ print_usage(char *argv)
  * delete_interface()
  *
  * Delete interface from port list.
- * Delete entry from /tmp/brdg.muxid file.
- * 
+ * The mux ID of the interface is read from brdg module, and the
+ * stream of the interface is unlinked from IP. The port disappears
+ * from brdg module when the stream is closed.
+ *
  *  Arguments:
+ *          ip_fd     : stream of /dev/ip
  *          interface : network interface name
  *  Return:
- *           int
+ *           0 on success, -1 on failure
  ******************************************************/
 int
-delete_interface(char *interface)
+delete_interface(int ip_fd, char *interface)
 {
-    int     ip_fd;
-    int     muxid = 0; 
-    FILE    *fp;
-    char    entry[128];
-    char    *p;
-    char    backup[1024];
-    
-    bzero(entry, 128);
-    bzero(backup, 1024);
-    
-    if ((fp = fopen(MUXIDFILE, "r")) == NULL) {
-        fprintf(stderr,"Can't open %s\n", MUXIDFILE);
-        fclose(fp);        
-        exit(1);
-    } 
-    /*
-     * Search interface entry within /tmp/brdg.muxid file.
-     */
-    while (fgets(entry, sizeof(entry), fp) != NULL){
-        if (strncmp(entry, interface, strlen(interface)) == 0){
-            p = strpbrk(entry, ":");                
-            muxid = atoi(p+1);
-        } else {
-            strcat(backup, entry);
-        }
-    }        
-    if (muxid == 0){
-        fprintf(stderr,"Interface %s is not registerd\n",interface );
-        fclose(fp);
-        exit(1);
-    }
-    fclose(fp);
+    brdg_ioc_port_entry_t *pe;
 
-    if ((fp = fopen(MUXIDFILE, "w")) == NULL) {
-        fprintf(stderr,"Can't open %s\n", MUXIDFILE);
-        fclose(fp);        
-        exit(1);
+    if ((pe = find_entry(interface)) == NULL || pe->pe_muxid == 0){
+        fprintf(stderr,"Interface %s is not registerd\n",interface );
+        return(-1);
     }
-    fputs(backup,fp);
-    fclose(fp);
-    
-    if ((ip_fd = open("/dev/ip", O_RDWR)) < 0){
-        perror("/dev/ip");
-        exit(0);
-    }    
 
-    if (ioctl(ip_fd, I_PUNLINK, muxid) < 0) {
-        printf("failed to unlink\n");
-        exit(1);
+    if (ioctl(ip_fd, I_PUNLINK, pe->pe_muxid) < 0) {
+        fprintf(stderr, "Can't unlink %s: %s\n", interface, strerror(errno));
+        return(-1);
     }
+    pe->pe_ifname[0] = '\0';
     printf("%s successfully deleted.\n", interface);
-    exit(0);
+    return(0);
 }
 
 /*******************************************************
- * add_interface()
+ * open_interface()
+ *
+ * Open the device of the network interface.
  *
- * Add network interface as a port.
- * Store network interface name and MUX ID in /tmp/brdg.muxid
- * file for later deletion.
- * 
  *  Arguments:
- *          interface : network interface name 
+ *          interface : network interface name
+ *          ppap      : set to PPA (instance number) of the interface
  *  Return:
- *           int
+ *           file descriptor of the stream, or -1 on failure
  ******************************************************/
-int add_interface(interface)
-char        *interface;     /* interface name */
-{
-    int       i;    
-    char      buf[MAXDLBUF];    
-    uint32_t  ppa = 0;      /* PPA(Physical Point of address). */
-    uint32_t  if_fd, ip_fd; /* FD# for IP driver. And FD# for interface driver */
-    uint32_t  muxid;        /* Multiplexer ID */
+int
+open_interface(char *interface, t_uscalar_t *ppap)
+{
+    int       i;
+    t_uscalar_t ppa = 0;    /* PPA(Physical Point of address). */
+    int       if_fd;        /* FD# for interface driver */
     char      devname[30];  /* interface name without instance number (hme)*/
     char      devpath[30];  /* Path to the device (/dev/hme)*/
-    FILE      *fp;          /* File pointer of /tmp/brdg.muxid */
-    char      entry[30];
     uint32_t  ifnamelen;    /* Length of interface name */
     char      *tempchar;
-    
-    /*
-     * Check /tmp/brdg.muxid 
-     */
-    if ((fp = fopen(MUXIDFILE, "r")) != NULL) {
-        while (fgets(entry, sizeof(entry), fp) != NULL){
-            if (strncmp(entry, interface, strlen(interface)) == 0){
-                fprintf(stderr, "Interface %s is already registerd. Please remove first\n", interface);
-                exit(1);
-            }
-        }
-        fclose(fp);
-    }
 
     ifnamelen = strlen(interface);
     tempchar = interface;
-    
+
+    if (ifnamelen == 0 || ifnamelen >= BRDG_IOC_IFNAMSIZ ||
+        ifnamelen + 6 > sizeof(devpath)) {
+        fprintf(stderr, "Invalid interface name %s\n", interface);
+        return(-1);
+    }
     if ( isdigit ((int) tempchar[ifnamelen - 1]) == 0 ){
         /* interface doesn't have instance number */
         fprintf(stderr, "Please specify instance number (e.g. hme0, eri2)\n");
-        exit(1);
+        return(-1);
     }
-    
+
     for ( i = ifnamelen - 2 ; i >= 0 ; i--){
         if ( isdigit ((int) tempchar[i]) == 0 ){
             ppa = atoi(&(tempchar[i + 1]));
@@ -240,93 +385,297 @@ char        *interface;     /* interface name */
         }
         if (i == 0) {
             /* looks all char are digit.. can't handle */
-            fprintf(stderr, "Invalid interface name\n");
-            exit(1);
+            fprintf(stderr, "Invalid interface name %s\n", interface);
+            return(-1);
         }
         continue;
     }
     strlcpy(devname, interface, i + 2);
 
     sprintf(devpath, "/dev/%s",devname);
-    //printf("devname = %s, ppa = %d devpath = %s \n",devname, ppa, devpath);
+
+    if((if_fd = open (devpath , O_RDWR)) < 0 ){
+        perror(devpath);
+        return(-1);
+    }
+    *ppap = ppa;
+    return(if_fd);
+}
+
+/*******************************************************
+ * plumb_interface()
+ *
+ * Make the stream of the network interface a port of brdg module.
+ * The stream has been attached, bound, and set to promiscuous mode
+ * and raw mode by dlbringup().
+ * The interface name is registered in brdg module, and VLAN
+ * configuration, storm control, RSTP and static entries of the interface
+ * are set from /etc/brdg.vlan, /etc/brdg.storm, /etc/brdg.stp and
+ * /etc/brdg.static. Then the driver is asked to notify brdg module of
+ * link up and down.
+ *
+ *  Arguments:
+ *          if_fd     : stream of the interface
+ *          interface : network interface name
+ *          portp     : set to the port number of the interface
+ *  Return:
+ *           0 on success, -1 on failure
+ ******************************************************/
+int
+plumb_interface(int if_fd, char *interface, uint32_t *portp)
+{
+    brdg_ioc_port_entry_t pe;
+    char                  buf[MAXDLBUFSIZE];
 
     /*
-     * Open /dev/ip and network interface
+     * Flush Queue
      */
-    if ((ip_fd = open("/dev/ip", O_RDWR)) < 0){
-        perror("/dev/ip");
-        exit(1);
+    if (ioctl(if_fd, I_FLUSH, FLUSHR) < 0){
+        perror("I_FLUSH");
+        return(-1);
     }
 
-    if((if_fd = open (devpath , O_RDWR)) < 0 ){
-        perror(devpath);
-        exit(1);
+    /*
+     * Push brdg module into interface's stream.
+     */
+    if (ioctl(if_fd, I_PUSH, "brdg") < 0){
+        perror("I_PUSH");
+        return(-1);
     }
 
     /*
-     * Attach request.
+     * Register the name of the interface. brdg module refuses the
+     * name if another port has it.
      */
-    if( dlattachreq(if_fd, ppa, buf) < 0)
-        exit(1);
-        
+    bzero(&pe, sizeof(pe));
+    strlcpy(pe.pe_ifname, interface, sizeof(pe.pe_ifname));
+    if (strioctl(if_fd, BRDG_IOC_PORT_SET, -1, sizeof(pe), (char *)&pe) < 0){
+        if (errno == EEXIST)
+            fprintf(stderr, "Interface %s is already registerd. Please remove first\n", interface);
+        else
+            perror("BRDG_IOC_PORT_SET");
+        return(-1);
+    }
+
     /*
-     * Bind request. 
+     * Set VLAN configuration, storm control, RSTP, MAC limit and static
+     * entries of the interface.
      */
-    if( dlbindreq (if_fd, 0, 0, DL_CLDLS, 0, 0, buf) < 0)
-        exit(1);
-             
+    apply_config(if_fd, interface, pe.pe_port);
+    apply_static(if_fd, interface, pe.pe_port);
+
     /*
-     * Set PROMISCOUS mode.
+     * DL_NOTIFY_IND of link state is handled by brdg module. A driver which
+     * does not support DL_NOTIFY_REQ is regarded as always up.
      */
-    if(dlpromisconreq(if_fd, DL_PROMISC_SAP, buf) < 0)
-        exit(1);
-    if(dlpromisconreq(if_fd, DL_PROMISC_PHYS, buf) < 0)
-        exit(1);
+    if (dlnotifyreq(if_fd, DL_NOTE_LINK_UP | DL_NOTE_LINK_DOWN, buf) < 0)
+        fprintf(stderr, "Link state of %s is not notified by the driver\n", interface);
 
-    if (strioctl(if_fd, DLIOCRAW, -1, 0, NULL) < 0){
-        perror("DLIOCRAW");
-        exit(1);
+    *portp = pe.pe_port;
+    return(0);
+}
+
+/*******************************************************
+ * add_interface()
+ *
+ * Add network interface as a port.
+ * The stream of the interface is linked under IP, and the mux ID is
+ * stored in brdg module for later deletion. The stream is closed.
+ *
+ *  Arguments:
+ *          ip_fd     : stream of /dev/ip
+ *          ctl_fd    : control stream of brdg module
+ *          interface : network interface name
+ *          db        : the stream brought up by dlbringup()
+ *  Return:
+ *           0 on success, -1 on failure
+ ******************************************************/
+int
+add_interface(int ip_fd, int ctl_fd, char *interface, dlbringup_t *db)
+{
+    int       muxid;        /* Multiplexer ID */
+    uint32_t  port;         /* Port number of the interface */
+    int       i;
+    brdg_ioc_port_entry_t pe;
+
+    if (plumb_interface(db->db_fd, interface, &port) < 0) {
+        close(db->db_fd);
+        return(-1);
     }
 
     /*
-     * Flush Queue
+     * Link inteface's stream to ip's stream.
+     * (PLINK = persist link)
+     * If it fails, the port is removed when the stream is closed.
      */
-    if (ioctl(if_fd, I_FLUSH, FLUSHR) < 0){
-        perror("I_FLUSH");
-        exit(1);
+    muxid = ioctl(ip_fd, I_PLINK, db->db_fd);
+    close(db->db_fd);
+    if( muxid < 0){
+        fprintf(stderr, "Can't link %s: %s\n", interface, strerror(errno));
+        return(-1);
     }
 
     /*
-     * Push brdg module into interface's stream.
+     * The stream of the port can't be reached after it is linked.
+     * Store the mux ID through the control stream.
      */
-    if (ioctl(if_fd, I_PUSH, "brdg") < 0){
-        perror("I_PUSH");
-        exit(1);
+    bzero(&pe, sizeof(pe));
+    pe.pe_port = port;
+    pe.pe_muxid = muxid;
+    strlcpy(pe.pe_ifname, interface, sizeof(pe.pe_ifname));
+    if (strioctl(ctl_fd, BRDG_IOC_PORT_SET, -1, sizeof(pe), (char *)&pe) < 0){
+        perror("BRDG_IOC_PORT_SET");
+        (void) ioctl(ip_fd, I_PUNLINK, muxid);
+        return(-1);
     }
 
+    printf("%s successfully added. (", interface);
+    for (i = 0; i < DL_STEP_MAX; i++)
+        printf("%s%s %.1fms", i ? ", " : "", dlstepname(i), db->db_time[i] / 1000000.0);
+    printf(")\n");
+    return(0);
+}
+
+/***************************************************************
+ * config_interfaces()
+ *
+ * Add or delete network interfaces in one invocation.
+ * Interfaces are separated by ',' (e.g. hme0,hme1,eri0).
+ * All interfaces are tried even if some of them fail.
+ * Interfaces to add are brought up by dlbringup() concurrently, so
+ * adding many interfaces takes as long as the slowest one.
+ *
+ *  Arguments:
+ *          list : list of network interface names
+ *          add  : 1 to add, 0 to delete
+ *  Return:
+ *           exits with 1 if any of the interfaces failed
+ ***************************************************************/
+int
+config_interfaces(char *list, int add)
+{
+    int         ip_fd;
+    int         ctl_fd;
+    int         failed = 0;
+    char        *interface;
+    char        *next;
+    char        **names = NULL;
+    dlbringup_t *db;
+    int         n = 0;
+    int         i;
+
     /*
-     * Link inteface's stream to ip's stream.
-     * (PLINK = persist link)
+     * strtok() can't be used here. It is used while adding the interface.
      */
-    muxid = ioctl(ip_fd, I_PLINK, if_fd);
-    if( muxid < 0){
-        perror("I_PLINK ioctl failed");
+    for (interface = list; *interface != '\0'; interface = next) {
+        next = interface + strcspn(interface, ", \t\n");
+        if (*next != '\0')
+            *next++ = '\0';
+        if (*interface == '\0')
+            continue;
+        if ((names = realloc(names, (n + 1) * sizeof(char *))) == NULL) {
+            perror("realloc");
+            exit(1);
+        }
+        names[n++] = interface;
+    }
+
+    if ((ip_fd = open("/dev/ip", O_RDWR)) < 0){
+        perror("/dev/ip");
         exit(1);
     }
-    
-    if ((fp = fopen(MUXIDFILE, "a")) == NULL) {
-        fprintf(stderr,"Can't open %s\n", MUXIDFILE);
-        exit(1);	
+
+    if (!add) {
+        for (i = 0; i < n; i++) {
+            if (delete_interface(ip_fd, names[i]) < 0)
+                failed++;
+        }
+        close(ip_fd);
+        exit(failed ? 1 : 0);
     }
 
-    sprintf(entry, "%s:%d\n", interface, muxid);
-    fputs(entry,fp);
-    fclose(fp);
-    
-    printf("%s successfully added.\n", interface);
+    ctl_fd = open_control();
+    if ((db = calloc(n + 1, sizeof(dlbringup_t))) == NULL) {
+        perror("calloc");
+        exit(1);
+    }
+    for (i = 0; i < n; i++) {
+        db[i].db_fd = -1;
+        if (find_entry(names[i]) != NULL) {
+            fprintf(stderr, "Interface %s is already registerd. Please remove first\n", names[i]);
+            failed++;
+            continue;
+        }
+        if ((db[i].db_fd = open_interface(names[i], &db[i].db_ppa)) < 0)
+            failed++;
+    }
+
+    /*
+     * Attach, bind, and set PROMISCOUS mode and raw mode.
+     */
+    (void) dlbringup(db, n);
+
+    for (i = 0; i < n; i++) {
+        if (db[i].db_fd < 0)
+            continue;
+        if (db[i].db_errno != 0) {
+            fprintf(stderr, "Can't add %s: %s failed: %s\n", names[i],
+                dlstepname(db[i].db_step), strerror(db[i].db_errno));
+            close(db[i].db_fd);
+            failed++;
+            continue;
+        }
+        if (add_interface(ip_fd, ctl_fd, names[i], &db[i]) < 0)
+            failed++;
+    }
+
+    free(db);
+    free(names);
+    close(ctl_fd);
     close(ip_fd);
-    close(if_fd);
-    exit(0);
+    exit(failed ? 1 : 0);
+}
+
+/***************************************************************
+ * read_config()
+ *
+ * Read network interfaces to add from the file, and add them all
+ * in one invocation. Interfaces are separated by spaces, ',' or
+ * newlines. Lines which begin with '#' are comments.
+ *
+ *  Arguments:
+ *          file : path of the file
+ *  Return:
+ *           exits with 1 if any of the interfaces failed
+ ***************************************************************/
+int
+read_config(char *file)
+{
+    FILE    *fp;
+    char    entry[256];
+    char    *list = NULL;
+    size_t  len = 0;
+
+    if ((fp = fopen(file, "r")) == NULL) {
+        fprintf(stderr,"Can't open %s\n", file);
+        exit(1);
+    }
+    while (fgets(entry, sizeof(entry), fp) != NULL){
+        entry[strcspn(entry, "#\n")] = '\0';
+        if ((list = realloc(list, len + strlen(entry) + 2)) == NULL) {
+            perror("realloc");
+            exit(1);
+        }
+        strcpy(list + len, entry);
+        len += strlen(entry);
+        list[len++] = ',';
+        list[len] = '\0';
+    }
+    fclose(fp);
+    if (list == NULL)
+        exit(0);
+    config_interfaces(list, 1);
+    return(0);
 }
 
 /***************************************************************
@@ -336,20 +685,1363 @@ char        *interface;     /* interface name */
  ***************************************************************/
 int list_interface()
 {
-    FILE    *fp;
-    char    entry[128];
-    
-    if ((fp = fopen(MUXIDFILE, "r")) == NULL) {
-        if (errno == ENOENT)
-            exit(0);
-        fprintf(stderr,"Can't open %s\n", MUXIDFILE);
-        fclose(fp);        
-        exit(1);
-    } 
+    uint32_t i;
+
+    read_ports();
     printf("List of the interfaces\n");
-    printf("----------\n");        
-    while (fgets(entry, sizeof(entry), fp) != NULL){
-        printf("%s\n", strtok(entry, ":"));
+    printf("----------\n");
+    for (i = 0; i < port_count; i++) {
+        if (port_table[i].pe_ifname[0] == '\0')
+            continue;
+        printf("%-16s port%-6u muxid %-6u link %s\n", port_table[i].pe_ifname,
+            port_table[i].pe_port, port_table[i].pe_muxid,
+            port_table[i].pe_link == BRDG_IOC_LINK_UP ? "up" :
+            port_table[i].pe_link == BRDG_IOC_LINK_DOWN ? "down" : "-");
+    }
+    exit(0);
+}
+
+/***************************************************************
+ * show_stats()
+ *
+ * Show statistics of ports from kstats of brdg module.
+ * Totals since each port was added are shown first, and then
+ * rates (per second) of every interval seconds.
+ * 
+ *  Arguments:
+ *          interval : interval in seconds. 0 shows totals only.
+ *  Return:
+ *           int
+ ***************************************************************/
+int
+show_stats(int interval)
+{
+    kstat_ctl_t    *kc;
+    kstat_t        *ksp;
+    kstat_named_t  *kn;
+    portstat_t     *prev = NULL, *cur, *ps, *pp;
+    int            nprev = 0, ncur;
+    int            i, j;
+    double         elapsed;
+
+    if ((kc = kstat_open()) == NULL) {
+        perror("kstat_open");
+        exit(1);
+    }
+
+    for (;;) {
+        (void) kstat_chain_update(kc);
+        cur = NULL;
+        ncur = 0;
+
+        printf("%-10s", "port");
+        for (i = 0; i < NSTATCOL; i++)
+            printf(" %12s", stat_columns[i].title);
+        printf("\n");
+
+        for (ksp = kc->kc_chain; ksp != NULL; ksp = ksp->ks_next) {
+            if (strcmp(ksp->ks_module, "brdg") != 0 ||
+                ksp->ks_type != KSTAT_TYPE_NAMED)
+                continue;
+            if (kstat_read(kc, ksp, NULL) < 0)
+                continue;
+            if ((cur = realloc(cur, sizeof(portstat_t) * (ncur + 1))) == NULL) {
+                perror("realloc");
+                exit(1);
+            }
+            ps = &cur[ncur++];
+            bzero(ps, sizeof(portstat_t));
+            ps->instance = ksp->ks_instance;
+            strlcpy(ps->name, ksp->ks_name, sizeof(ps->name));
+            ps->snaptime = ksp->ks_snaptime;
+            for (i = 0; i < NSTATCOL; i++) {
+                for (j = 0; stat_columns[i].stats[j] != NULL; j++) {
+                    kn = kstat_data_lookup(ksp, stat_columns[i].stats[j]);
+                    if (kn != NULL)
+                        ps->val[i] += kn->value.ui64;
+                }
+            }
+
+            /*
+             * Rate since the last snapshot of the same port,
+             * or totals if this port was not seen last time.
+             */
+            pp = NULL;
+            for (j = 0; j < nprev; j++) {
+                if (prev[j].instance == ps->instance) {
+                    pp = &prev[j];
+                    break;
+                }
+            }
+            printf("%-10s", ps->name);
+            if (pp == NULL || ps->snaptime == pp->snaptime) {
+                for (i = 0; i < NSTATCOL; i++)
+                    printf(" %12llu", (unsigned long long)ps->val[i]);
+            } else {
+                elapsed = (double)(ps->snaptime - pp->snaptime) / NANOSEC;
+                for (i = 0; i < NSTATCOL; i++)
+                    printf(" %10.0f/s", (ps->val[i] - pp->val[i]) / elapsed);
+            }
+            printf("\n");
+        }
+        if (ncur == 0)
+            printf("No port\n");
+        printf("\n");
+        fflush(stdout);
+
+        free(prev);
+        prev = cur;
+        nprev = ncur;
+        if (interval <= 0)
+            break;
+        sleep(interval);
     }
+    free(prev);
+    (void) kstat_close(kc);
     exit(0);
 }
+
+/***************************************************************
+ * open_control()
+ *
+ * Open the control stream of brdg module, which is brdg module
+ * pushed on /dev/ip. ioctls in brdgio.h are sent to it.
+ *
+ *  Return:
+ *           file descriptor of the control stream
+ ***************************************************************/
+int
+open_control()
+{
+    int fd;
+
+    if ((fd = open("/dev/ip", O_RDWR)) < 0) {
+        perror("/dev/ip");
+        exit(1);
+    }
+    if (ioctl(fd, I_PUSH, "brdg") < 0) {
+        perror("I_PUSH");
+        exit(1);
+    }
+    return(fd);
+}
+
+/***************************************************************
+ * show_fdb()
+ *
+ * Show entries of the forwarding database, and its occupancy.
+ * Entries are read in pages by BRDG_IOC_FDB_READ, so that large
+ * table is read without blocking brdg module for long.
+ * 
+ *  Arguments:
+ *          port   : show entries of this port number only. -1 for all
+ *          prefix : show entries which begin with this address prefix
+ *                   only. NULL for all
+ *          vlan   : show entries in this VLAN only. -1 for all
+ *  Return:
+ *           int
+ ***************************************************************/
+int
+show_fdb(int port, char *prefix, int vlan)
+{
+    int                  fd;
+    brdg_ioc_fdb_info_t  fi;
+    brdg_ioc_fdb_read_t  fr;
+    brdg_ioc_fdb_entry_t *fe;
+    uint32_t             total = 0;
+    uint32_t             i;
+    unsigned int         octet;
+    char                 *p;
+    char                 ifname[IFNAMSIZ];
+
+    bzero(&fr, sizeof(fr));
+    if (port >= 0) {
+        fr.fr_filter |= BRDG_IOC_FDB_PORT;
+        fr.fr_port = port;
+    }
+    if (vlan >= 0) {
+        fr.fr_filter |= BRDG_IOC_FDB_VLAN;
+        fr.fr_vid = vlan;
+    }
+    if (prefix != NULL) {
+        fr.fr_filter |= BRDG_IOC_FDB_PREFIX;
+        for (p = strtok(prefix, ":"); p != NULL; p = strtok(NULL, ":")) {
+            if (fr.fr_prefixlen == sizeof(fr.fr_prefix) || sscanf(p, "%x", &octet) != 1 ||
+                octet > 0xff) {
+                fprintf(stderr, "Invalid address prefix\n");
+                exit(1);
+            }
+            fr.fr_prefix[fr.fr_prefixlen++] = octet;
+        }
+    }
+
+    fd = open_control();
+
+    bzero(&fi, sizeof(fi));
+    if (strioctl(fd, BRDG_IOC_FDB_INFO, -1, sizeof(fi), (char *)&fi) < 0) {
+        perror("BRDG_IOC_FDB_INFO");
+        exit(1);
+    }
+
+    printf("%-17s %4s %-10s %8s %s\n", "address", "vlan", "port", "age(s)", "flags");
+    do {
+        if (strioctl(fd, BRDG_IOC_FDB_READ, -1, sizeof(fr), (char *)&fr) < 0) {
+            perror("BRDG_IOC_FDB_READ");
+            exit(1);
+        }
+        for (i = 0; i < fr.fr_count && i < BRDG_IOC_FDB_PAGE; i++) {
+            fe = &fr.fr_entry[i];
+            printf("%02x:%02x:%02x:%02x:%02x:%02x %4u %-10s %8u %s\n",
+                fe->fe_addr[0], fe->fe_addr[1], fe->fe_addr[2],
+                fe->fe_addr[3], fe->fe_addr[4], fe->fe_addr[5], fe->fe_vid,
+                find_interface(fe->fe_port, ifname, sizeof(ifname)),
+                fe->fe_age, (fe->fe_flags & BRDG_IOC_FDB_STATIC) ? "static" : "");
+        }
+        total += fr.fr_count;
+    } while (fr.fr_cursor != BRDG_IOC_FDB_END);
+    printf("%u entries shown\n\n", total);
+
+    printf("Forwarding database: %u entries in %u buckets of %u ways (%.1f%% used)\n",
+        fi.fi_entries, fi.fi_nbucket, fi.fi_ways,
+        fi.fi_nbucket ? 100.0 * fi.fi_entries / (fi.fi_nbucket * fi.fi_ways) : 0.0);
+    printf("Aging time: %u seconds\n", fi.fi_aging);
+    printf("Buckets by number of entries:");
+    for (i = 0; i <= fi.fi_ways && i <= BRDG_IOC_MAXWAYS; i++)
+        printf(" %u:%u", i, fi.fi_load[i]);
+    printf("\n");
+    printf("Collisions: %u full buckets, %llu entries evicted\n",
+        (fi.fi_ways <= BRDG_IOC_MAXWAYS) ? fi.fi_load[fi.fi_ways] : 0,
+        (unsigned long long)fi.fi_evict);
+
+    close(fd);
+    exit(0);
+}
+
+/***************************************************************
+ * show_mcast()
+ *
+ * Show router ports and member ports of multicast groups learned
+ * by IGMP/MLD snooping. Read in pages by BRDG_IOC_MCAST_READ.
+ * 
+ *  Return:
+ *           int
+ ***************************************************************/
+int
+show_mcast()
+{
+    int                    fd;
+    brdg_ioc_mcast_read_t  mr;
+    brdg_ioc_mcast_entry_t *me;
+    uint32_t               total = 0;
+    uint32_t               i;
+    char                   ifname[IFNAMSIZ];
+
+    fd = open_control();
+
+    bzero(&mr, sizeof(mr));
+    printf("%-17s %4s %-10s %9s\n", "group", "vlan", "port", "expire(s)");
+    do {
+        if (strioctl(fd, BRDG_IOC_MCAST_READ, -1, sizeof(mr), (char *)&mr) < 0) {
+            perror("BRDG_IOC_MCAST_READ");
+            exit(1);
+        }
+        for (i = 0; i < mr.mr_count && i < BRDG_IOC_MCAST_PAGE; i++) {
+            me = &mr.mr_entry[i];
+            if (me->me_flags & BRDG_IOC_MCAST_ROUTER) {
+                printf("%-17s %4s %-10s %9u\n", "router", "-",
+                    find_interface(me->me_port, ifname, sizeof(ifname)),
+                    me->me_expire);
+                continue;
+            }
+            printf("%02x:%02x:%02x:%02x:%02x:%02x %4u %-10s %9u\n",
+                me->me_addr[0], me->me_addr[1], me->me_addr[2],
+                me->me_addr[3], me->me_addr[4], me->me_addr[5], me->me_vid,
+                find_interface(me->me_port, ifname, sizeof(ifname)),
+                me->me_expire);
+            total++;
+        }
+    } while (mr.mr_cursor != BRDG_IOC_FDB_END);
+    printf("%u memberships shown\n", total);
+
+    close(fd);
+    exit(0);
+}
+
+/***************************************************************
+ * show_loop()
+ *
+ * Show recent detections of loops, from the newest, and the time
+ * until the blocked ports are unblocked.
+ * 
+ *  Return:
+ *           int
+ ***************************************************************/
+int
+show_loop()
+{
+    int                    fd;
+    brdg_ioc_loop_read_t   lr;
+    brdg_ioc_loop_entry_t  *le;
+    uint32_t               i;
+    char                   ifname[IFNAMSIZ];
+    char                   peername[IFNAMSIZ];
+    char                   addr[18];
+
+    fd = open_control();
+
+    bzero(&lr, sizeof(lr));
+    if (strioctl(fd, BRDG_IOC_LOOP_READ, -1, sizeof(lr), (char *)&lr) < 0) {
+        perror("BRDG_IOC_LOOP_READ");
+        exit(1);
+    }
+    printf("%-10s %-6s %-10s %-17s %8s %7s %8s %9s\n", "port", "reason", "peer",
+        "address", "flaps/s", "age(s)", "block(s)", "remain(s)");
+    for (i = 0; i < lr.lr_count && i < BRDG_IOC_LOOP_EVENTS; i++) {
+        le = &lr.lr_entry[i];
+        if (le->le_reason == BRDG_IOC_LOOP_FLAP)
+            snprintf(addr, sizeof(addr), "%02x:%02x:%02x:%02x:%02x:%02x",
+                le->le_addr[0], le->le_addr[1], le->le_addr[2],
+                le->le_addr[3], le->le_addr[4], le->le_addr[5]);
+        else
+            strlcpy(addr, "-", sizeof(addr));
+        if (le->le_peer != BRDG_IOC_PORT_NONE)
+            find_interface(le->le_peer, peername, sizeof(peername));
+        else
+            strlcpy(peername, "-", sizeof(peername));
+        printf("%-10s %-6s %-10s %-17s %8u %7u %8u ",
+            find_interface(le->le_port, ifname, sizeof(ifname)),
+            le->le_reason == BRDG_IOC_LOOP_FLAP ? "flap" : "probe",
+            peername, addr, le->le_flaps, le->le_age, le->le_block);
+        if (le->le_remain != 0)
+            printf("%9u\n", le->le_remain);
+        else
+            printf("%9s\n", "-");
+    }
+    printf("%u loops shown\n", lr.lr_count);
+
+    close(fd);
+    exit(0);
+}
+
+/***************************************************************
+ * show_stp()
+ *
+ * Show the spanning tree seen by this bridge, and the roles and
+ * states given to ports by RSTP.
+ * 
+ *  Return:
+ *           int
+ ***************************************************************/
+int
+show_stp()
+{
+    int                  fd;
+    brdg_ioc_stp_read_t  sr;
+    brdg_ioc_stp_port_t  *sp;
+    uint32_t             i;
+    uint32_t             total = 0;
+    char                 ifname[IFNAMSIZ];
+    static char          *roles[] = { "disabled", "root", "designated",
+                                      "alternate", "backup" };
+    static char          *states[] = { "discarding", "learning", "forwarding" };
+
+    fd = open_control();
+
+    bzero(&sr, sizeof(sr));
+    do {
+        if (strioctl(fd, BRDG_IOC_STP_READ, -1, sizeof(sr), (char *)&sr) < 0) {
+            if (errno == ENOTSUP)
+                fprintf(stderr, "RSTP is not enabled (set brdg:brdg_stp = 1)\n");
+            else
+                perror("BRDG_IOC_STP_READ");
+            exit(1);
+        }
+        if (total == 0) {
+            printf("bridge  %02x%02x.%02x:%02x:%02x:%02x:%02x:%02x\n",
+                sr.sr_bridge[0], sr.sr_bridge[1], sr.sr_bridge[2], sr.sr_bridge[3],
+                sr.sr_bridge[4], sr.sr_bridge[5], sr.sr_bridge[6], sr.sr_bridge[7]);
+            printf("root    %02x%02x.%02x:%02x:%02x:%02x:%02x:%02x cost %u port %s\n",
+                sr.sr_root[0], sr.sr_root[1], sr.sr_root[2], sr.sr_root[3],
+                sr.sr_root[4], sr.sr_root[5], sr.sr_root[6], sr.sr_root[7],
+                sr.sr_cost, sr.sr_root_port == BRDG_IOC_PORT_NONE ? "-" :
+                find_interface(sr.sr_root_port, ifname, sizeof(ifname)));
+            printf("topology changes %u, last %u seconds ago\n\n",
+                sr.sr_tc_count, sr.sr_tc_age);
+            printf("%-10s %-10s %-10s %8s %4s %4s %-22s %5s\n", "port", "role",
+                "state", "cost", "prio", "edge", "designated bridge", "dport");
+        }
+        for (i = 0; i < sr.sr_count && i < BRDG_IOC_STP_PAGE; i++) {
+            sp = &sr.sr_entry[i];
+            printf("%-10s %-10s %-10s %8u %4u %4s "
+                "%02x%02x.%02x:%02x:%02x:%02x:%02x:%02x %04x\n",
+                find_interface(sp->sp_port, ifname, sizeof(ifname)),
+                sp->sp_role <= BRDG_IOC_STP_BACKUP ? roles[sp->sp_role] : "?",
+                sp->sp_state <= BRDG_IOC_STP_FORWARDING ? states[sp->sp_state] : "?",
+                sp->sp_cost, sp->sp_priority,
+                sp->sp_oper_edge ? (sp->sp_edge ? "yes" : "auto") : "no",
+                sp->sp_dbridge[0], sp->sp_dbridge[1], sp->sp_dbridge[2],
+                sp->sp_dbridge[3], sp->sp_dbridge[4], sp->sp_dbridge[5],
+                sp->sp_dbridge[6], sp->sp_dbridge[7], sp->sp_dport);
+        }
+        total += sr.sr_count;
+    } while (sr.sr_cursor != BRDG_IOC_FDB_END);
+    printf("%u ports shown\n", total);
+
+    close(fd);
+    exit(0);
+}
+
+/***************************************************************
+ * show_limit()
+ *
+ * Show MAC limits of ports, the number of addresses learned on
+ * them, frames over the limit, and ports shut down by the limit.
+ * 
+ *  Return:
+ *           int
+ ***************************************************************/
+int
+show_limit()
+{
+    int                    fd;
+    brdg_ioc_limit_read_t  ll;
+    brdg_ioc_limit_t       *lm;
+    uint32_t               i;
+    uint32_t               total = 0;
+    char                   ifname[IFNAMSIZ];
+    static char            *actions[] = { "stop", "drop", "shutdown" };
+
+    fd = open_control();
+
+    bzero(&ll, sizeof(ll));
+    printf("%-10s %8s %8s %-8s %8s %12s %s\n", "port", "max", "rate/s", "action",
+        "learned", "over", "state");
+    do {
+        if (strioctl(fd, BRDG_IOC_LIMIT_READ, -1, sizeof(ll), (char *)&ll) < 0) {
+            perror("BRDG_IOC_LIMIT_READ");
+            exit(1);
+        }
+        for (i = 0; i < ll.ll_count && i < BRDG_IOC_LIMIT_PAGE; i++) {
+            lm = &ll.ll_entry[i];
+            printf("%-10s ", find_interface(lm->lm_port, ifname, sizeof(ifname)));
+            if (lm->lm_max != 0)
+                printf("%8u ", lm->lm_max);
+            else
+                printf("%8s ", "-");
+            if (lm->lm_rate != 0)
+                printf("%8u ", lm->lm_rate);
+            else
+                printf("%8s ", "-");
+            printf("%-8s %8u %12llu %s\n",
+                lm->lm_action <= BRDG_IOC_LIMIT_SHUTDOWN ? actions[lm->lm_action] : "?",
+                lm->lm_learned, (unsigned long long)lm->lm_over,
+                lm->lm_shutdown ? "shutdown" : "up");
+        }
+        total += ll.ll_count;
+    } while (ll.ll_cursor != BRDG_IOC_FDB_END);
+    printf("%u ports shown\n", total);
+
+    close(fd);
+    exit(0);
+}
+
+/***************************************************************
+ * parse_mac()
+ *
+ * Convert string of ethernet address (e.g. 0:14:4f:1:2:3) to
+ * octets.
+ *
+ *  Arguments:
+ *          str  : string of ethernet address
+ *          addr : 6 octets to be set
+ *  Return:
+ *           0 on success, -1 if str is not an ethernet address
+ ***************************************************************/
+int
+parse_mac(char *str, uint8_t *addr)
+{
+    unsigned int octet[6];
+    char         c;
+    int          i;
+
+    if (sscanf(str, "%x:%x:%x:%x:%x:%x%c", &octet[0], &octet[1], &octet[2],
+            &octet[3], &octet[4], &octet[5], &c) != 6)
+        return(-1);
+    for (i = 0; i < 6; i++) {
+        if (octet[i] > 0xff)
+            return(-1);
+        addr[i] = octet[i];
+    }
+    return(0);
+}
+
+/***************************************************************
+ * read_ports()
+ *
+ * Read ports registered in brdg module by BRDG_IOC_PORT_LIST into
+ * port_table. Ports are read once in a invocation.
+ *
+ *  Return:
+ *           number of ports
+ ***************************************************************/
+int
+read_ports()
+{
+    int                  fd;
+    brdg_ioc_port_list_t pl;
+    uint32_t             i;
+
+    if (port_table != NULL)
+        return(port_count);
+
+    fd = open_control();
+    bzero(&pl, sizeof(pl));
+    do {
+        if (strioctl(fd, BRDG_IOC_PORT_LIST, -1, sizeof(pl), (char *)&pl) < 0) {
+            perror("BRDG_IOC_PORT_LIST");
+            exit(1);
+        }
+        if ((port_table = realloc(port_table,
+                 (port_count + pl.pl_count + 1) * sizeof(*port_table))) == NULL) {
+            perror("realloc");
+            exit(1);
+        }
+        for (i = 0; i < pl.pl_count && i < BRDG_IOC_PORT_PAGE; i++)
+            port_table[port_count++] = pl.pl_entry[i];
+    } while (pl.pl_cursor != BRDG_IOC_FDB_END);
+    close(fd);
+    return(port_count);
+}
+
+/***************************************************************
+ * find_entry()
+ *
+ * Get the port registered in brdg module by the interface name.
+ *
+ *  Arguments:
+ *          interface : network interface name
+ *  Return:
+ *           entry in port_table, or NULL if the interface is not added
+ ***************************************************************/
+brdg_ioc_port_entry_t *
+find_entry(char *interface)
+{
+    uint32_t i;
+
+    read_ports();
+    for (i = 0; i < port_count; i++) {
+        if (strcmp(port_table[i].pe_ifname, interface) == 0)
+            return(&port_table[i]);
+    }
+    return(NULL);
+}
+
+/***************************************************************
+ * find_port()
+ *
+ * Get port number of the interface from brdg module.
+ *
+ *  Arguments:
+ *          interface : network interface name
+ *  Return:
+ *           port number, or -1 if the interface is not added
+ ***************************************************************/
+int
+find_port(char *interface)
+{
+    brdg_ioc_port_entry_t *pe;
+
+    if ((pe = find_entry(interface)) == NULL)
+        return(-1);
+    return(pe->pe_port);
+}
+
+/***************************************************************
+ * find_interface()
+ *
+ * Get name of the interface of the port number from brdg module.
+ *
+ *  Arguments:
+ *          port : port number
+ *          buf  : buffer for the name
+ *          len  : length of buf
+ *  Return:
+ *           buf. "port<port number>" if the interface is not found
+ ***************************************************************/
+char *
+find_interface(uint32_t port, char *buf, size_t len)
+{
+    uint32_t i;
+
+    snprintf(buf, len, "port%u", port);
+    read_ports();
+    for (i = 0; i < port_count; i++) {
+        if (port_table[i].pe_port == port && port_table[i].pe_ifname[0] != '\0') {
+            strlcpy(buf, port_table[i].pe_ifname, len);
+            break;
+        }
+    }
+    return(buf);
+}
+
+/***************************************************************
+ * apply_static()
+ *
+ * Add static entries of the interface in /etc/brdg.static to
+ * brdg module. Called when the interface is added.
+ *
+ *  Arguments:
+ *          fd        : stream of brdg module
+ *          interface : network interface name
+ *          port      : port number of the interface
+ *  Return:
+ *           number of entries added
+ ***************************************************************/
+int
+apply_static(int fd, char *interface, uint32_t port)
+{
+    FILE                 *fp;
+    char                 entry[128];
+    char                 *name, *mac, *vid;
+    brdg_ioc_fdb_entry_t fe;
+    int                  count = 0;
+
+    if ((fp = fopen(STATICFILE, "r")) == NULL)
+        return(0);
+    while (fgets(entry, sizeof(entry), fp) != NULL){
+        if ((name = strtok(entry, " \t\n")) == NULL ||
+            (mac = strtok(NULL, " \t\n")) == NULL)
+            continue;
+        if (strcmp(name, interface) != 0)
+            continue;
+        bzero(&fe, sizeof(fe));
+        if (parse_mac(mac, fe.fe_addr) < 0) {
+            fprintf(stderr, "Invalid address %s in %s\n", mac, STATICFILE);
+            continue;
+        }
+        fe.fe_port = port;
+        fe.fe_vid = ((vid = strtok(NULL, " \t\n")) != NULL) ? atoi(vid) : 1;
+        if (strioctl(fd, BRDG_IOC_FDB_ADD, -1, sizeof(fe), (char *)&fe) < 0) {
+            fprintf(stderr, "Can't add static entry %s: %s\n", mac, strerror(errno));
+            continue;
+        }
+        count++;
+    }
+    fclose(fp);
+    return(count);
+}
+
+/***************************************************************
+ * add_static()
+ *
+ * Add static entry of the ethernet address on the interface.
+ * The entry is stored in /etc/brdg.static, and is added to brdg
+ * module now if the interface has been added.
+ * 
+ *  Arguments:
+ *          arg : "mac,interface[,vlan]". vlan is 1 if omitted
+ *  Return:
+ *           int
+ ***************************************************************/
+int
+add_static(char *arg)
+{
+    char                 line[256];
+    static_match_t       sm;
+    char                 *interface;
+    char                 *vid;
+    brdg_ioc_fdb_entry_t fe;
+    int                  port;
+    int                  fd;
+
+    bzero(&fe, sizeof(fe));
+    if ((interface = strchr(arg, ',')) == NULL) {
+        fprintf(stderr, "Please specify mac,interface (e.g. 0:14:4f:1:2:3,hme0)\n");
+        exit(1);
+    }
+    *interface++ = '\0';
+    if (parse_mac(arg, fe.fe_addr) < 0 || (fe.fe_addr[0] & 0x01)) {
+        fprintf(stderr, "Invalid unicast address %s\n", arg);
+        exit(1);
+    }
+    fe.fe_vid = 1;
+    if ((vid = strchr(interface, ',')) != NULL) {
+        *vid++ = '\0';
+        fe.fe_vid = atoi(vid);
+        if (fe.fe_vid < 1 || fe.fe_vid > 4094) {
+            fprintf(stderr, "Invalid VLAN ID %s\n", vid);
+            exit(1);
+        }
+    }
+
+    if ((port = find_port(interface)) >= 0) {
+        fd = open_control();
+        fe.fe_port = port;
+        if (strioctl(fd, BRDG_IOC_FDB_ADD, -1, sizeof(fe), (char *)&fe) < 0) {
+            perror("BRDG_IOC_FDB_ADD");
+            exit(1);
+        }
+        close(fd);
+    }
+
+    /*
+     * Replace the entry of the same address in /etc/brdg.static.
+     */
+    sm.sm_addr = fe.fe_addr;
+    sm.sm_vid = fe.fe_vid;
+    sm.sm_fd = -1;
+    snprintf(line, sizeof(line), "%s %x:%x:%x:%x:%x:%x %u", interface,
+        fe.fe_addr[0], fe.fe_addr[1], fe.fe_addr[2], fe.fe_addr[3],
+        fe.fe_addr[4], fe.fe_addr[5], fe.fe_vid);
+    rewrite_config(STATICFILE, match_static, &sm, line);
+    printf("static entry %s successfully added.\n", arg);
+    exit(0);
+}
+
+/***************************************************************
+ * match_static()
+ *
+ * Check if a line of /etc/brdg.static is an entry of the ethernet
+ * address. The entry is deleted from brdg module as well if
+ * sm_fd is not -1.
+ *
+ *  Arguments:
+ *          entry : line of /etc/brdg.static
+ *          arg   : static_match_t of the address
+ *  Return:
+ *           1 if the line is the entry, 0 if not
+ ***************************************************************/
+int
+match_static(char *entry, void *arg)
+{
+    static_match_t       *sm = arg;
+    char                 line[256];
+    char                 *mac, *v;
+    brdg_ioc_fdb_entry_t fe;
+    int                  evid;
+
+    strlcpy(line, entry, sizeof(line));
+    bzero(&fe, sizeof(fe));
+    if (strtok(line, " \t\n") == NULL ||
+        (mac = strtok(NULL, " \t\n")) == NULL ||
+        parse_mac(mac, fe.fe_addr) < 0 || bcmp(fe.fe_addr, sm->sm_addr, 6) != 0)
+        return(0);
+    evid = ((v = strtok(NULL, " \t\n")) != NULL) ? atoi(v) : 1;
+    if (sm->sm_vid >= 0 && sm->sm_vid != evid)
+        return(0);
+    fe.fe_vid = evid;
+    if (sm->sm_fd >= 0 &&
+        strioctl(sm->sm_fd, BRDG_IOC_FDB_DEL, -1, sizeof(fe), (char *)&fe) < 0 &&
+        errno != ENOENT) {
+        perror("BRDG_IOC_FDB_DEL");
+        exit(1);
+    }
+    return(1);
+}
+
+/***************************************************************
+ * remove_static_entry()
+ *
+ * Remove entries of the ethernet address from /etc/brdg.static.
+ *
+ *  Arguments:
+ *          addr : ethernet address
+ *          vid  : VLAN ID. -1 for all VLANs
+ *          fd   : if not -1, the entries are deleted from brdg
+ *                 module through this stream as well
+ *  Return:
+ *           number of entries removed
+ ***************************************************************/
+int
+remove_static_entry(uint8_t *addr, int vid, int fd)
+{
+    static_match_t sm;
+
+    sm.sm_addr = addr;
+    sm.sm_vid = vid;
+    sm.sm_fd = fd;
+    return(rewrite_config(STATICFILE, match_static, &sm, NULL));
+}
+
+/***************************************************************
+ * rewrite_config()
+ *
+ * Rewrite a configuration file without the lines that match and
+ * with a line appended. The file is written to <file>.tmp which is
+ * renamed over the file, so that a crash or a full disk never
+ * leaves the file truncated. The file is left untouched if no line
+ * matches and nothing is appended.
+ *
+ *  Arguments:
+ *          file  : configuration file
+ *          match : returns non-zero for a line to be removed
+ *          arg   : argument of match
+ *          line  : line to be appended without newline, or NULL
+ *  Return:
+ *           number of lines removed
+ ***************************************************************/
+int
+rewrite_config(char *file, int (*match)(char *, void *), void *arg, char *line)
+{
+    FILE        *fp, *tfp;
+    char        entry[256];
+    char        tmp[MAXPATHLEN];
+    struct stat st;
+    int         found = 0;
+    int         err;
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", file);
+    if ((tfp = fopen(tmp, "w")) == NULL) {
+        fprintf(stderr,"Can't open %s\n", tmp);
+        exit(1);
+    }
+    if ((fp = fopen(file, "r")) != NULL) {
+        if (fstat(fileno(fp), &st) == 0)
+            fchmod(fileno(tfp), st.st_mode & 07777);
+        while (fgets(entry, sizeof(entry), fp) != NULL){
+            if (match(entry, arg)) {
+                found++;
+                continue;
+            }
+            fputs(entry, tfp);
+        }
+        fclose(fp);
+    }
+    if (found == 0 && line == NULL) {
+        fclose(tfp);
+        unlink(tmp);
+        return(0);
+    }
+    if (line != NULL)
+        fprintf(tfp, "%s\n", line);
+
+    err = (fflush(tfp) != 0 || fsync(fileno(tfp)) < 0);
+    if (fclose(tfp) != 0 || err || rename(tmp, file) < 0) {
+        fprintf(stderr, "Can't write %s: %s\n", file, strerror(errno));
+        unlink(tmp);
+        exit(1);
+    }
+    return(found);
+}
+
+/***************************************************************
+ * match_key()
+ *
+ * Check if a line of a configuration file begins with the key.
+ *
+ *  Arguments:
+ *          entry : line of the configuration file
+ *          arg   : key string
+ *  Return:
+ *           1 if the line begins with the key, 0 if not
+ ***************************************************************/
+int
+match_key(char *entry, void *arg)
+{
+    char *key = arg;
+
+    return(strncmp(entry, key, strlen(key)) == 0);
+}
+
+/***************************************************************
+ * replace_config_line()
+ *
+ * Replace the lines which begin with the key in a configuration
+ * file with the line.
+ *
+ *  Arguments:
+ *          file : configuration file
+ *          key  : beginning of the lines to be replaced,
+ *                 e.g. "interface,"
+ *          line : new line without newline
+ *  Return:
+ *           number of lines replaced
+ ***************************************************************/
+int
+replace_config_line(char *file, char *key, char *line)
+{
+    return(rewrite_config(file, match_key, key, line));
+}
+
+/***************************************************************
+ * remove_static()
+ *
+ * Remove static entries of the ethernet address from brdg module
+ * and /etc/brdg.static.
+ * 
+ *  Arguments:
+ *          arg : "mac[,vlan]". Entries in all VLANs if vlan is omitted
+ *  Return:
+ *           int
+ ***************************************************************/
+int
+remove_static(char *arg)
+{
+    uint8_t  addr[6];
+    char     *vid;
+    int      fd;
+
+    if ((vid = strchr(arg, ',')) != NULL)
+        *vid++ = '\0';
+    if (parse_mac(arg, addr) < 0) {
+        fprintf(stderr, "Invalid address %s\n", arg);
+        exit(1);
+    }
+
+    fd = open_control();
+    if (remove_static_entry(addr, vid ? atoi(vid) : -1, fd) == 0) {
+        fprintf(stderr, "Static entry %s is not registerd\n", arg);
+        exit(1);
+    }
+    close(fd);
+    printf("static entry %s successfully removed.\n", arg);
+    exit(0);
+}
+
+/***************************************************************
+ * parse_vlan()
+ *
+ * Convert VLAN configuration string to the argument of
+ * BRDG_IOC_VLAN_SET.
+ *
+ *  Arguments:
+ *          str : "access,vid" or "trunk,pvid[,vid[-vid]]..."
+ *                All VLANs are allowed if no vid follows pvid of
+ *                trunk.
+ *          arg : brdg_ioc_vlan_t of BRDG_IOC_VLAN_SET to be set
+ *  Return:
+ *           0 on success, -1 if str is invalid
+ ***************************************************************/
+int
+parse_vlan(char *str, void *arg)
+{
+    brdg_ioc_vlan_t *iv = arg;
+    char    buf[256];
+    char    *p;
+    int     first, last;
+    int     vid;
+
+    strlcpy(buf, str, sizeof(buf));
+    bzero(iv->iv_member, sizeof(iv->iv_member));
+    if ((p = strtok(buf, ",")) == NULL)
+        return(-1);
+    if (strcmp(p, "access") == 0)
+        iv->iv_mode = BRDG_IOC_VLAN_ACCESS;
+    else if (strcmp(p, "trunk") == 0)
+        iv->iv_mode = BRDG_IOC_VLAN_TRUNK;
+    else
+        return(-1);
+    if ((p = strtok(NULL, ",")) == NULL)
+        return(-1);
+    iv->iv_pvid = atoi(p);
+    if (iv->iv_pvid < 1 || iv->iv_pvid > 4094)
+        return(-1);
+    if (iv->iv_mode == BRDG_IOC_VLAN_ACCESS)
+        return(strtok(NULL, ",") == NULL ? 0 : -1);
+
+    if ((p = strtok(NULL, ",")) == NULL) {
+        memset(iv->iv_member, 0xff, sizeof(iv->iv_member));
+        return(0);
+    }
+    for (; p != NULL; p = strtok(NULL, ",")) {
+        if (sscanf(p, "%d-%d", &first, &last) != 2)
+            first = last = atoi(p);
+        if (first < 1 || last > 4094 || first > last)
+            return(-1);
+        for (vid = first; vid <= last; vid++)
+            iv->iv_member[vid >> 3] |= 1 << (vid & 7);
+    }
+    return(0);
+}
+
+/***************************************************************
+ * set_vlan()
+ *
+ * Set VLAN configuration of the interface.
+ * The configuration is stored in /etc/brdg.vlan, and is set to
+ * brdg module now if the interface has been added.
+ * 
+ *  Arguments:
+ *          arg : "interface,access,vid" or
+ *                "interface,trunk,pvid[,vid[-vid]]..."
+ *  Return:
+ *           int
+ ***************************************************************/
+int
+set_vlan(char *arg)
+{
+    char            key[256];
+    char            line[256];
+    char            *conf;
+    brdg_ioc_vlan_t iv;
+    int             port;
+    int             fd;
+
+    bzero(&iv, sizeof(iv));
+    if ((conf = strchr(arg, ',')) == NULL || parse_vlan(conf + 1, &iv) < 0) {
+        fprintf(stderr, "Invalid VLAN configuration %s\n", arg);
+        exit(1);
+    }
+    *conf = '\0';
+
+    if ((port = find_port(arg)) >= 0) {
+        fd = open_control();
+        iv.iv_port = port;
+        if (strioctl(fd, BRDG_IOC_VLAN_SET, -1, sizeof(iv), (char *)&iv) < 0) {
+            perror("BRDG_IOC_VLAN_SET");
+            exit(1);
+        }
+        close(fd);
+    }
+
+    /*
+     * Replace the line of the interface in /etc/brdg.vlan.
+     */
+    snprintf(key, sizeof(key), "%s,", arg);
+    snprintf(line, sizeof(line), "%s,%s", arg, conf + 1);
+    replace_config_line(VLANFILE, key, line);
+    printf("VLAN of %s successfully set.\n", arg);
+    exit(0);
+}
+
+/***************************************************************
+ * parse_storm()
+ *
+ * Parse storm control "class,pps[,bps]".
+ *
+ *  Arguments:
+ *          str : string of storm control
+ *          arg : brdg_ioc_storm_t of BRDG_IOC_STORM_SET to be set
+ *  Return:
+ *           0 on success, -1 if str is invalid
+ ***************************************************************/
+int
+parse_storm(char *str, void *arg)
+{
+    brdg_ioc_storm_t *is = arg;
+    char    buf[256];
+    char    *p;
+
+    strlcpy(buf, str, sizeof(buf));
+    if ((p = strtok(buf, ",")) == NULL)
+        return(-1);
+    if (strcmp(p, "bcast") == 0)
+        is->is_class = BRDG_IOC_STORM_BCAST;
+    else if (strcmp(p, "mcast") == 0)
+        is->is_class = BRDG_IOC_STORM_MCAST;
+    else if (strcmp(p, "unknown") == 0)
+        is->is_class = BRDG_IOC_STORM_UNKNOWN;
+    else
+        return(-1);
+    if ((p = strtok(NULL, ",")) == NULL)
+        return(-1);
+    is->is_pps = strtoul(p, NULL, 10);
+    if ((p = strtok(NULL, ",")) != NULL)
+        is->is_bps = strtoul(p, NULL, 10);
+    return(strtok(NULL, ",") == NULL ? 0 : -1);
+}
+
+/***************************************************************
+ * set_storm()
+ *
+ * Set storm control of the interface for a class of frames.
+ * The configuration is stored in /etc/brdg.storm, and is set to
+ * brdg module now if the interface has been added.
+ * 
+ *  Arguments:
+ *          arg : "interface,class,pps[,bps]"
+ *  Return:
+ *           int
+ ***************************************************************/
+int
+set_storm(char *arg)
+{
+    char             key[256];
+    char             line[256];
+    char             *conf;
+    brdg_ioc_storm_t is;
+    int              port;
+    int              fd;
+
+    bzero(&is, sizeof(is));
+    if ((conf = strchr(arg, ',')) == NULL || parse_storm(conf + 1, &is) < 0) {
+        fprintf(stderr, "Invalid storm control %s\n", arg);
+        exit(1);
+    }
+    *conf = '\0';
+
+    if ((port = find_port(arg)) >= 0) {
+        fd = open_control();
+        is.is_port = port;
+        if (strioctl(fd, BRDG_IOC_STORM_SET, -1, sizeof(is), (char *)&is) < 0) {
+            perror("BRDG_IOC_STORM_SET");
+            exit(1);
+        }
+        close(fd);
+    }
+
+    /*
+     * Replace the configuration of the class of the interface in
+     * /etc/brdg.storm. Lines begin with "interface,class,".
+     */
+    snprintf(key, sizeof(key), "%s,%.*s,", arg,
+        (int)strcspn(conf + 1, ","), conf + 1);
+    snprintf(line, sizeof(line), "%s,%s", arg, conf + 1);
+    replace_config_line(STORMFILE, key, line);
+    printf("Storm control of %s successfully set.\n", arg);
+    exit(0);
+}
+
+/***************************************************************
+ * parse_stp()
+ *
+ * Parse RSTP of a port "cost[,priority[,edge]]".
+ *
+ *  Arguments:
+ *          str : string of RSTP of a port
+ *          arg : brdg_ioc_stp_port_t of BRDG_IOC_STP_SET to be set
+ *  Return:
+ *           0 on success, -1 if str is invalid
+ ***************************************************************/
+int
+parse_stp(char *str, void *arg)
+{
+    brdg_ioc_stp_port_t *sp = arg;
+    char    buf[256];
+    char    *p;
+
+    strlcpy(buf, str, sizeof(buf));
+    sp->sp_priority = 128;
+    if ((p = strtok(buf, ",")) == NULL)
+        return(-1);
+    sp->sp_cost = strtoul(p, NULL, 10);
+    if ((p = strtok(NULL, ",")) != NULL) {
+        sp->sp_priority = strtoul(p, NULL, 10);
+        if ((p = strtok(NULL, ",")) != NULL)
+            sp->sp_edge = (atoi(p) != 0);
+    }
+    if (sp->sp_priority > 240 || sp->sp_priority % 16 != 0)
+        return(-1);
+    return(strtok(NULL, ",") == NULL ? 0 : -1);
+}
+
+/***************************************************************
+ * set_stp()
+ *
+ * Set path cost, port priority and edge of RSTP of the interface.
+ * The configuration is stored in /etc/brdg.stp, and is set to
+ * brdg module now if the interface has been added.
+ * 
+ *  Arguments:
+ *          arg : "interface,cost[,priority[,edge]]"
+ *  Return:
+ *           int
+ ***************************************************************/
+int
+set_stp(char *arg)
+{
+    char                key[256];
+    char                line[256];
+    char                *conf;
+    brdg_ioc_stp_port_t sp;
+    int                 port;
+    int                 fd;
+
+    bzero(&sp, sizeof(sp));
+    if ((conf = strchr(arg, ',')) == NULL || parse_stp(conf + 1, &sp) < 0) {
+        fprintf(stderr, "Invalid RSTP %s\n", arg);
+        exit(1);
+    }
+    *conf = '\0';
+
+    if ((port = find_port(arg)) >= 0) {
+        fd = open_control();
+        sp.sp_port = port;
+        if (strioctl(fd, BRDG_IOC_STP_SET, -1, sizeof(sp), (char *)&sp) < 0) {
+            if (errno == ENOTSUP)
+                fprintf(stderr, "RSTP is not enabled (set brdg:brdg_stp = 1)\n");
+            else
+                perror("BRDG_IOC_STP_SET");
+            exit(1);
+        }
+        close(fd);
+    }
+
+    /*
+     * Replace the line of the interface in /etc/brdg.stp.
+     */
+    snprintf(key, sizeof(key), "%s,", arg);
+    snprintf(line, sizeof(line), "%s,%s", arg, conf + 1);
+    replace_config_line(STPFILE, key, line);
+    printf("RSTP of %s successfully set.\n", arg);
+    exit(0);
+}
+
+/***************************************************************
+ * parse_limit()
+ *
+ * Convert MAC limit string to the argument of BRDG_IOC_LIMIT_SET.
+ *
+ *  Arguments:
+ *          str : "max[,rate[,action]]". action is stop, drop or
+ *                shutdown, and is stop if omitted
+ *          arg : brdg_ioc_limit_t of BRDG_IOC_LIMIT_SET to be set
+ *  Return:
+ *           0 on success, -1 if str is invalid
+ ***************************************************************/
+int
+parse_limit(char *str, void *arg)
+{
+    brdg_ioc_limit_t *lm = arg;
+    char    buf[256];
+    char    *p;
+
+    strlcpy(buf, str, sizeof(buf));
+    lm->lm_action = BRDG_IOC_LIMIT_STOP;
+    if ((p = strtok(buf, ",")) == NULL)
+        return(-1);
+    lm->lm_max = strtoul(p, NULL, 10);
+    if ((p = strtok(NULL, ",")) != NULL) {
+        lm->lm_rate = strtoul(p, NULL, 10);
+        if ((p = strtok(NULL, ",")) != NULL) {
+            if (strcmp(p, "stop") == 0)
+                lm->lm_action = BRDG_IOC_LIMIT_STOP;
+            else if (strcmp(p, "drop") == 0)
+                lm->lm_action = BRDG_IOC_LIMIT_DROP;
+            else if (strcmp(p, "shutdown") == 0)
+                lm->lm_action = BRDG_IOC_LIMIT_SHUTDOWN;
+            else
+                return(-1);
+        }
+    }
+    return(strtok(NULL, ",") == NULL ? 0 : -1);
+}
+
+/***************************************************************
+ * set_limit()
+ *
+ * Set MAC limit, learn rate and the action on violation of the
+ * interface. The configuration is stored in /etc/brdg.limit, and
+ * is set to brdg module now if the interface has been added, which
+ * brings back the interface if it was shut down by the limit.
+ * 
+ *  Arguments:
+ *          arg : "interface,max[,rate[,action]]"
+ *  Return:
+ *           int
+ ***************************************************************/
+int
+set_limit(char *arg)
+{
+    char             key[256];
+    char             line[256];
+    char             *conf;
+    brdg_ioc_limit_t lm;
+    int              port;
+    int              fd;
+
+    bzero(&lm, sizeof(lm));
+    if ((conf = strchr(arg, ',')) == NULL || parse_limit(conf + 1, &lm) < 0) {
+        fprintf(stderr, "Invalid MAC limit %s\n", arg);
+        exit(1);
+    }
+    *conf = '\0';
+
+    if ((port = find_port(arg)) >= 0) {
+        fd = open_control();
+        lm.lm_port = port;
+        if (strioctl(fd, BRDG_IOC_LIMIT_SET, -1, sizeof(lm), (char *)&lm) < 0) {
+            perror("BRDG_IOC_LIMIT_SET");
+            exit(1);
+        }
+        close(fd);
+    }
+
+    /*
+     * Replace the line of the interface in /etc/brdg.limit.
+     */
+    snprintf(key, sizeof(key), "%s,", arg);
+    snprintf(line, sizeof(line), "%s,%s", arg, conf + 1);
+    replace_config_line(LIMITFILE, key, line);
+    printf("MAC limit of %s successfully set.\n", arg);
+    exit(0);
+}
+
+/*
+ * Per-port configuration files, which have lines of
+ * "interface,configuration" set to brdg module by apply_config().
+ */
+#define NCONFIG 4
+static struct {
+    char    *file;                    /* configuration file */
+    char    *name;                    /* shown in error messages */
+    int     (*parse)(char *, void *); /* converts configuration to arg */
+    int     cmd;                      /* ioctl command */
+    size_t  size;                     /* size of arg of the ioctl */
+    size_t  port;                     /* offset of port number in arg */
+} config_files[NCONFIG] = {
+    { VLANFILE,  "VLAN configuration", parse_vlan, BRDG_IOC_VLAN_SET,
+      sizeof(brdg_ioc_vlan_t), offsetof(brdg_ioc_vlan_t, iv_port) },
+    { STORMFILE, "storm control", parse_storm, BRDG_IOC_STORM_SET,
+      sizeof(brdg_ioc_storm_t), offsetof(brdg_ioc_storm_t, is_port) },
+    { STPFILE,   "RSTP", parse_stp, BRDG_IOC_STP_SET,
+      sizeof(brdg_ioc_stp_port_t), offsetof(brdg_ioc_stp_port_t, sp_port) },
+    { LIMITFILE, "MAC limit", parse_limit, BRDG_IOC_LIMIT_SET,
+      sizeof(brdg_ioc_limit_t), offsetof(brdg_ioc_limit_t, lm_port) },
+};
+
+/***************************************************************
+ * apply_config()
+ *
+ * Set VLAN configuration, storm control, RSTP and MAC limit of the
+ * interface in the configuration files to brdg module. Called when
+ * the interface is added. Invalid lines are reported and skipped.
+ *
+ *  Arguments:
+ *          fd        : stream of brdg module
+ *          interface : network interface name
+ *          port      : port number of the interface
+ *  Return:
+ *           int
+ ***************************************************************/
+int
+apply_config(int fd, char *interface, uint32_t port)
+{
+    FILE    *fp;
+    char    entry[256];
+    char    *conf;
+    int     i;
+    union {
+        brdg_ioc_vlan_t     iv;
+        brdg_ioc_storm_t    is;
+        brdg_ioc_stp_port_t sp;
+        brdg_ioc_limit_t    lm;
+    } arg;
+
+    for (i = 0; i < NCONFIG; i++) {
+        if ((fp = fopen(config_files[i].file, "r")) == NULL)
+            continue;
+        while (fgets(entry, sizeof(entry), fp) != NULL){
+            entry[strcspn(entry, "\n")] = '\0';
+            if ((conf = strchr(entry, ',')) == NULL)
+                continue;
+            *conf++ = '\0';
+            if (strcmp(entry, interface) != 0)
+                continue;
+            bzero(&arg, sizeof(arg));
+            if (config_files[i].parse(conf, &arg) < 0) {
+                fprintf(stderr, "Invalid %s %s in %s\n", config_files[i].name,
+                    conf, config_files[i].file);
+                continue;
+            }
+            *(uint32_t *)((char *)&arg + config_files[i].port) = port;
+            /* ENOTSUP: the function is disabled in brdg module (e.g. RSTP) */
+            if (strioctl(fd, config_files[i].cmd, -1, config_files[i].size,
+                    (char *)&arg) < 0 && errno != ENOTSUP)
+                fprintf(stderr, "Can't set %s of %s: %s\n", config_files[i].name,
+                    interface, strerror(errno));
+        }
+        fclose(fp);
+    }
+    return(0);
+}
@@ -0,0 +1,244 @@
+/*
+ * Copyright (C) 2010 Kazuyoshi Aizawa. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/********************************************************************
+ * brdgbench
+ *
+ * Benchmark of the hash function for ethernet addresses.
+ *
+ * Compares brdg_mac_hash() with the old ETHER_HASH macro (sum of
+ * octets) on sequential, same-OUI and random address sets, and prints
+ * bucket distribution and time per hash for each of them.
+ *
+ * Usage:
+ *   brdgbench [-n addresses] [-b buckets] [-l loops]
+ *
+ *********************************************************************/
+#include <sys/types.h>
+#include <sys/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "brdghash.h"
+
+#define FDB_WAYS      4          /* Same as brdg.c */
+#define ETHERADDRL    6
+
+typedef uint32_t (*hash_func_t)(const uint8_t *, const uint64_t *);
+
+int print_usage(char *);
+
+static uint64_t hash_key[2];
+
+/*
+ * The ETHER_HASH macro which was used by brdg before brdg_mac_hash().
+ */
+static uint32_t
+legacy_hash(const uint8_t *mac, const uint64_t *key)
+{
+    (void) key;
+    return(mac[0] + (mac[1] << 8) + mac[2] + (mac[3] << 8) +
+           mac[4] + (mac[5] << 8));
+}
+
+static uint32_t
+keyed_hash(const uint8_t *mac, const uint64_t *key)
+{
+    return(brdg_mac_hash(mac, 1, key));
+}
+
+/*
+ * Address sets
+ */
+static void
+gen_sequential(uint8_t *mac, uint32_t i)
+{
+    /* 00:00:00:00:00:01, 00:00:00:00:00:02, ... */
+    mac[0] = 0; mac[1] = 0;
+    mac[2] = (i + 1) >> 24; mac[3] = (i + 1) >> 16;
+    mac[4] = (i + 1) >> 8;  mac[5] = (i + 1);
+}
+
+static void
+gen_same_oui(uint8_t *mac, uint32_t i)
+{
+    /* Virtual NICs of one vendor: fixed OUI, random lower 24 bits */
+    uint32_t r = (uint32_t)random();
+
+    (void) i;
+    mac[0] = 0x00; mac[1] = 0x14; mac[2] = 0x4f;
+    mac[3] = r >> 16; mac[4] = r >> 8; mac[5] = r;
+}
+
+static void
+gen_random(uint8_t *mac, uint32_t i)
+{
+    uint32_t r1 = (uint32_t)random(), r2 = (uint32_t)random();
+
+    (void) i;
+    /* Unicast, globally administered */
+    mac[0] = (r1 >> 24) & 0xfc; mac[1] = r1 >> 16; mac[2] = r1 >> 8;
+    mac[3] = r1;                mac[4] = r2 >> 8;  mac[5] = r2;
+}
+
+static struct {
+    char  *name;
+    void  (*gen)(uint8_t *, uint32_t);
+} addr_sets[] = {
+    { "sequential", gen_sequential },
+    { "same-oui",   gen_same_oui },
+    { "random",     gen_random },
+    { NULL, NULL }
+};
+
+static struct {
+    char        *name;
+    hash_func_t func;
+} hash_funcs[] = {
+    { "ETHER_HASH",    legacy_hash },
+    { "brdg_mac_hash", keyed_hash },
+    { NULL, NULL }
+};
+
+static double
+now_usec(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return((double)tv.tv_sec * 1000000.0 + tv.tv_usec);
+}
+
+/*****************************************************************************
+ * run_bench()
+ *
+ * Hash all addresses into the buckets and print the result.
+ *
+ *  overflow : addresses which do not fit in FDB_WAYS entries of the bucket,
+ *             that is, addresses which would evict another address.
+ *  chi2/df  : chi-square of bucket loads divided by degree of freedom.
+ *             Close to 1.0 for a uniform hash.
+ *****************************************************************************/
+static void
+run_bench(char *setname, char *hashname, hash_func_t func, uint8_t *macs,
+    uint32_t naddr, uint32_t nbucket, uint32_t loops)
+{
+    uint32_t   *load;
+    uint32_t   i, l, maxload = 0, used = 0, overflow = 0;
+    double     expect, chi2 = 0, start, elapsed;
+    volatile uint32_t sink = 0;
+
+    if ((load = calloc(nbucket, sizeof(uint32_t))) == NULL) {
+        perror("calloc");
+        exit(1);
+    }
+
+    for (i = 0; i < naddr; i++)
+        load[func(&macs[i * ETHERADDRL], hash_key) & (nbucket - 1)]++;
+
+    expect = (double)naddr / nbucket;
+    for (i = 0; i < nbucket; i++) {
+        if (load[i] > maxload)
+            maxload = load[i];
+        if (load[i] > 0)
+            used++;
+        if (load[i] > FDB_WAYS)
+            overflow += load[i] - FDB_WAYS;
+        chi2 += (load[i] - expect) * (load[i] - expect) / expect;
+    }
+
+    start = now_usec();
+    for (l = 0; l < loops; l++)
+        for (i = 0; i < naddr; i++)
+            sink += func(&macs[i * ETHERADDRL], hash_key);
+    elapsed = now_usec() - start;
+
+    printf("%-12s %-14s %8u %8u %8u %10.2f %8.2f\n", setname, hashname,
+        used, maxload, overflow, chi2 / (nbucket - 1),
+        elapsed * 1000.0 / ((double)naddr * loops));
+    free(load);
+}
+
+int
+main(int argc, char *argv[])
+{
+    int       c, s, h;
+    uint32_t  naddr = 4096, nbucket = 1024, loops = 1000, i;
+    uint8_t   *macs;
+
+    while ((c = getopt(argc, argv, "n:b:l:")) != EOF) {
+        switch (c) {
+            case 'n':
+                naddr = atoi(optarg);
+                break;
+            case 'b':
+                nbucket = atoi(optarg);
+                break;
+            case 'l':
+                loops = atoi(optarg);
+                break;
+            default:
+                print_usage(argv[0]);
+                break;
+        }
+    }
+    if (naddr == 0 || loops == 0 || nbucket < 2 || (nbucket & (nbucket - 1)))
+        print_usage(argv[0]);
+
+    if ((macs = malloc((size_t)naddr * ETHERADDRL)) == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+
+    srandom(getpid() ^ (uint32_t)now_usec());
+    hash_key[0] = ((uint64_t)random() << 32) ^ random();
+    hash_key[1] = ((uint64_t)random() << 32) ^ random();
+
+    printf("%u addresses, %u buckets x %d ways\n\n", naddr, nbucket, FDB_WAYS);
+    printf("%-12s %-14s %8s %8s %8s %10s %8s\n", "set", "hash",
+        "used", "maxload", "overflow", "chi2/df", "ns/hash");
+
+    for (s = 0; addr_sets[s].name != NULL; s++) {
+        for (i = 0; i < naddr; i++)
+            addr_sets[s].gen(&macs[i * ETHERADDRL], i);
+        for (h = 0; hash_funcs[h].name != NULL; h++)
+            run_bench(addr_sets[s].name, hash_funcs[h].name,
+                hash_funcs[h].func, macs, naddr, nbucket, loops);
+    }
+    free(macs);
+    exit(0);
+}
+
+int
+print_usage(char *argv)
+{
+    printf("Usage: %s [-n addresses] [-b buckets] [-l loops]\n", argv);
+    printf("Options:\n");
+    printf(" -n addresses\t: Number of addresses in each set (default 4096)\n");
+    printf(" -b buckets\t: Number of buckets, power of two (default 1024)\n");
+    printf(" -l loops\t: Number of loops for time measurement (default 1000)\n");
+    exit(1);
+}
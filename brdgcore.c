@@ -0,0 +1,3544 @@
+/*
+ * Copyright (C) 2010 Kazuyoshi Aizawa. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/*******************************************************
+ * brdgcore.c
+ *
+ * Forwarding core of the bridge.
+ * Learning, lookup, forwarding and flooding of ethernet frames.
+ *
+ * Locking:
+ *   The data path (brdg_input()) takes no lock. Updates of the
+ *   forwarding database and the multicast group table are serialized
+ *   by fdb_lock, and readers detect concurrent updates by the sequence
+ *   counter of the bucket.
+ *   brdg_port_add() and brdg_port_remove() must not run at the same
+ *   time as brdg_input(). The caller is responsible for it.
+ *   brdg_input() for the same port must not run concurrently, so that
+ *   storm control of the port is done without any lock. (The inner
+ *   perimeter of the queue pair serializes it in the STREAMS module.)
+ *   RSTP (brdgstp.c) runs under fdb_lock, off the data path: BPDUs are
+ *   queued by the data path and processed by brdg_learn_run(), and timers
+ *   are advanced by brdg_tick(). The data path reads only the state of
+ *   ports, in 'blocked'.
+ *
+ *******************************************************/
+
+#include "brdgcore.h"
+#include "brdgstp.h"
+#include "brdghash.h"
+#include "brdgtrace.h"
+
+/*
+ * Token bucket of storm control.
+ * Tokens are added by the time since 'last' at the rate of the limit, up to
+ * bc_storm_burst milliseconds of the limit, and taken by each frame. Frames
+ * are dropped while tokens are not positive. Tokens are in 1/1000 frames or
+ * bytes, so that they are added by milliseconds without rounding.
+ * Only the data path of the port updates it.
+ */
+typedef struct storm_s
+{
+    uint32_t  pps;      /* Frames per second. 0 for no limit */
+    uint32_t  bps;      /* Bytes per second. 0 for no limit */
+    int64_t   ptokens;  /* Tokens of frames */
+    int64_t   btokens;  /* Tokens of bytes */
+    uint32_t  last;     /* msclock when tokens were added */
+} storm_t;
+
+/*
+ * Port structure of the core.
+ */
+struct brdg_port_s
+{
+    void      *cookie;  /* Handle of the port given by the caller */
+    uint32_t  index;    /* Index in the active port set */
+    uint32_t  slot;     /* Slot in the slot table. (See fdb_slot_t) */
+    uint8_t   *stats;   /* Statistics. STAT_ROW bytes for each CPU */
+    void      *stats_buf; /* Allocated buffer of stats */
+    uint32_t  vlan_mode; /* BRDG_VLAN_TRUNK or BRDG_VLAN_ACCESS */
+    uint16_t  pvid;     /* VLAN of untagged frames */
+    uint8_t   vlan_member[BRDG_VLAN_MAX / 8]; /* Bitmap of member VLANs */
+    uint32_t  storm_on; /* Bitmap of BRDG_STORM_XXX which have limits */
+    storm_t   storm[BRDG_STORM_MAX]; /* Storm control */
+    /*
+     * MAC limit. (See brdg_port_limit())
+     * 'learned' is updated under fdb_lock, and read by the data path without
+     * any lock. limit_tokens and limit_last are updated, and limit_shut is
+     * set, only by the data path of the port.
+     */
+    uint32_t  limit_max;        /* Max dynamic addresses. 0 for no limit */
+    uint32_t  limit_rate;       /* New addresses per second. 0 for no limit */
+    uint32_t  limit_action;     /* BRDG_LIMIT_XXX */
+    int64_t   limit_tokens;     /* Tokens of limit_rate. 1/1000 addresses */
+    uint32_t  limit_last;       /* msclock when tokens were added */
+    volatile uint32_t limit_shut; /* Shut down by brdg_tick() if set */
+    volatile uint32_t learned;  /* Dynamic addresses registered on the port */
+    /*
+     * Loop detection. (See brdg_loop_check())
+     * loop_probe is written by the data path of the port, and the others
+     * under fdb_lock.
+     */
+    volatile uint32_t blocked;  /* Bitmap of BLOCK_XXX. Not received nor sent to */
+    volatile uint32_t loop_probe; /* Index + 1 of the port whose probe came back */
+    uint32_t  loop_flaps;       /* Flaps of addresses moved to the port */
+    uint32_t  loop_peer;        /* Index of the port where the address was */
+    struct ether_addr loop_addr; /* Address of the last flap */
+    uint32_t  loop_flaps_last;  /* loop_flaps at the last check */
+    uint32_t  loop_until;       /* Clock when the port is unblocked */
+    uint32_t  loop_count;       /* Detections without a quiet period */
+    stp_port_t stp;             /* RSTP. Protected by fdb_lock */
+    uint32_t  hold;             /* Queued frames of the bridge. (See xmit_t) fdb_lock */
+};
+
+#define BLOCK_LOOP    0x0001    /* Blocked by loop detection */
+#define BLOCK_STP     0x0002    /* Discarding by RSTP */
+#define BLOCK_LEARN   0x0004    /* Learning by RSTP. Source addresses are learned */
+#define BLOCK_LINK    0x0008    /* Link is down. (See brdg_port_link()) */
+#define BLOCK_LIMIT   0x0010    /* Shut down by the MAC limit. (See brdg_port_limit()) */
+
+/*
+ * The port does not even receive nor send BPDUs.
+ */
+#define BLOCK_DOWN    (BLOCK_LOOP | BLOCK_LINK | BLOCK_LIMIT)
+
+/*
+ * The port must not receive nor send frames. A port whose probe came back
+ * is blocked at once by the data path, before brdg_tick() blocks it.
+ */
+#define PORT_BLOCKED(port) ((port)->blocked | (port)->loop_probe)
+
+/*
+ * VLAN membership of a port
+ */
+#define VLAN_MEMBER(port, vid) \
+    ((port)->vlan_member[(vid) >> 3] & (1 << ((vid) & 7)))
+
+/*
+ * Tag of the frame of VLAN 'vid' sent to the port. 'tag' is the tag of the
+ * received frame, of which priority is kept.
+ */
+#define VLAN_EGRESS_TAG(port, vid, tag) \
+    (((port)->vlan_mode == BRDG_VLAN_TRUNK && (vid) != (port)->pvid) ? \
+        (BRDG_TAG_PRESENT | ((tag) & 0xf000) | (vid)) : 0)
+
+/*
+ * Statistics of a port are counted in the row of the current CPU, and
+ * summed up by brdg_port_stats(). Rows are aligned to cache lines, so the
+ * data path never writes a cache line shared with other CPUs.
+ * Counters are not updated atomically. A count may be lost rarely if the
+ * thread is preempted in the middle of an increment.
+ */
+#define STAT_ROW \
+    ((BRDG_STAT_MAX * sizeof(uint64_t) + BRDG_CACHELINE - 1) & ~(BRDG_CACHELINE - 1))
+#define STAT_BUFSIZE   (STAT_ROW * BRDG_NCPU() + BRDG_CACHELINE)
+#define STAT_ADD(port, stat, n) \
+    (((uint64_t *)((port)->stats + STAT_ROW * BRDG_CPUID()))[(stat)] += (n))
+#define STAT_INC(port, stat)   STAT_ADD((port), (stat), 1)
+
+const char *brdg_stat_name[BRDG_STAT_MAX] = {
+    "rx",
+    "forward",
+    "flood",
+    "mcast",
+    "snoop",
+    "bpdu",
+    "filter",
+    "drop_src",
+    "drop_runt",
+    "drop_vlan",
+    "drop_bcast",
+    "drop_mcast",
+    "drop_unknown",
+    "drop_blocked",
+    "tx",
+    "drop_full",
+    "drop_nomem",
+    "learn",
+    "move",
+    "evict",
+    "aged",
+    "link_down",
+    "limit"
+};
+
+static const uint8_t brdg_broadcast[ETHERADDRL] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+};
+
+/*
+ * Set of active ports.
+ * Ports are packed at the beginning of ps_port[] so that the data path
+ * visits only live ports. The set is never modified after it is published;
+ * brdg_port_add() and brdg_port_remove() build a new set and replace it.
+ */
+typedef struct brdg_portset_s
+{
+    uint32_t     ps_count;      /* Number of ports */
+    uint32_t     ps_size;       /* Allocated size of this structure */
+    brdg_port_t  *ps_port[1];   /* Ports. ps_count entries */
+} brdg_portset_t;
+
+/*
+ * Node structure.
+ * Node structure corresponds to one source ethernet address in a VLAN.
+ * It is intended to prevent forwarding a packet to which packet was received.
+ */
+typedef struct node_s
+{
+    struct    ether_addr ether_addr; /* Source ethenet address */
+    uint16_t  state;                 /* Flags of this entry. NODE_XXX */
+    uint16_t  vid;                   /* VLAN ID */
+    uint16_t  moved;                 /* Low 16 bits of clock when moved. NODE_MOVED */
+    uint32_t  last_seen;             /* clock when the address was seen */
+    uint32_t  gen;                   /* Generation of the slot when registered */
+    uint16_t  slot;                  /* Slot of the port where this node is connected */
+} node_t;
+
+/*
+ * Flags of node_t.state
+ */
+#define NODE_VALID    0x0001         /* Entry is in use */
+#define NODE_STATIC   0x0002         /* Configured by brdg_fdb_add_static(). Never aged,
+                                        replaced or moved by learning */
+#define NODE_MOVED    0x0004         /* Moved from another port. 'moved' is valid */
+
+/*
+ * Slot of a port.
+ * Node structures refer to the port by the index of its slot and the
+ * generation of the slot, instead of a pointer. A node is stale, and is
+ * treated as not registered, if the generation does not match: 'gen' for
+ * dynamic entries and 'sgen' for static entries. So the entries of a port
+ * are deleted at once by bumping the generation, without scanning the
+ * forwarding database. brdg_tick() reclaims stale nodes later.
+ * Removing a port bumps both and clears 'port', and the slot is reused by
+ * another port with the new generation.
+ */
+typedef struct fdb_slot_s
+{
+    brdg_port_t * volatile port;     /* Port, or NULL if the slot is free */
+    volatile uint32_t gen;           /* Generation of dynamic entries */
+    volatile uint32_t sgen;          /* Generation of static entries */
+} fdb_slot_t;
+
+#define FDB_SLOT_INIT 16             /* Initial number of slots */
+#define FDB_SLOT_MAX  65536          /* Max number of slots. node_t.slot is 16 bits */
+#define FDB_READ_RETRY 64            /* Lock-free reads of a bucket before taking fdb_lock */
+
+/*
+ * Bucket of the forwarding database.
+ * Ethernet addresses which have the same hash value are stored in the same
+ * bucket, up to BRDG_FDB_WAYS addresses. When the bucket is full, the dynamic
+ * entry which has not been seen for the longest time is replaced by the new
+ * one.
+ * 'seq' is odd while the bucket is being updated. (See brdg_fdb_lookup())
+ */
+typedef struct fdb_bucket_s
+{
+    volatile uint32_t seq;           /* Sequence counter of updates */
+    node_t    node[BRDG_FDB_WAYS];
+} fdb_bucket_t;
+
+/*
+ * Update of a bucket. fdb_lock must be held.
+ */
+#define FDB_WRITE_BEGIN(bucket) \
+              { (bucket)->seq++; BRDG_MEMBAR_PRODUCER(); }
+#define FDB_WRITE_END(bucket) \
+              { BRDG_MEMBAR_PRODUCER(); (bucket)->seq++; }
+
+/*
+ * Request to register a source address. (See brdg_fdb_learn())
+ */
+typedef struct learn_s
+{
+    struct    ether_addr ether_addr;
+    uint16_t  vid;
+    brdg_port_t *port;
+} learn_t;
+
+/*
+ * Multicast group.
+ * Group address in a VLAN learned by IGMP/MLD snooping, and the ports
+ * which have listeners of the group. Ports are bits of 'members' by their
+ * index in the active port set, so the data path sends a frame of the
+ * group to the member ports without scanning all ports. Ports whose index
+ * is BRDG_MCAST_PORTS or more are not tracked, and receive all multicast
+ * frames.
+ */
+typedef struct mcast_group_s
+{
+    struct    ether_addr addr;       /* Group address */
+    uint16_t  vid;                   /* VLAN ID */
+    uint16_t  state;                 /* GROUP_XXX */
+    uint64_t  members;               /* Bitmap of member ports */
+} mcast_group_t;
+
+#define GROUP_VALID   0x0001         /* Entry is in use */
+
+#define MCAST_WAYS    4              /* Number of groups in one hash bucket */
+#define MCAST_ALL     (~(uint64_t)0) /* Bitmap of all ports */
+
+/*
+ * Bucket of the multicast group table. Same as fdb_bucket_t.
+ */
+typedef struct mcast_bucket_s
+{
+    volatile uint32_t seq;           /* Sequence counter of updates */
+    mcast_group_t group[MCAST_WAYS];
+} mcast_bucket_t;
+
+/*
+ * Request from IGMP/MLD snooping. (See brdg_snoop_queue())
+ */
+typedef struct snoop_s
+{
+    uint32_t  type;                  /* SNOOP_XXX */
+    struct    ether_addr addr;       /* Group address. JOIN and LEAVE only */
+    uint16_t  vid;
+    brdg_port_t *port;
+} snoop_t;
+
+#define SNOOP_NONE    0              /* Not an IGMP/MLD message */
+#define SNOOP_QUERY   1              /* Query. The port is a router port */
+#define SNOOP_JOIN    2              /* Report. The port is a member of the group */
+#define SNOOP_LEAVE   3              /* Leave. The port may have no member */
+#define SNOOP_REPORT  4              /* Return of brdg_snoop_parse(). Report or leave */
+
+#define SNOOP_PROTO_HOPOPTS 0        /* IPv6 hop-by-hop options header */
+#define SNOOP_PROTO_IGMP    2        /* IPv4 protocol of IGMP */
+#define SNOOP_PROTO_ICMPV6  58       /* IPv6 next header of ICMPv6 */
+
+#define IGMP_QUERY      0x11         /* Membership query */
+#define IGMP_V1_REPORT  0x12         /* IGMPv1 membership report */
+#define IGMP_V2_REPORT  0x16         /* IGMPv2 membership report */
+#define IGMP_V2_LEAVE   0x17         /* IGMPv2 leave group */
+#define IGMP_V3_REPORT  0x22         /* IGMPv3 membership report */
+#define MLD_QUERY       130          /* Multicast listener query */
+#define MLD_V1_REPORT   131          /* MLDv1 report */
+#define MLD_V1_DONE     132          /* MLDv1 done */
+#define MLD_V2_REPORT   143          /* MLDv2 report */
+
+/*
+ * Request for a group record of IGMPv3/MLDv2 report of the record type
+ * with nsrc sources. MODE_IS_INCLUDE (1) and CHANGE_TO_INCLUDE_MODE (3)
+ * with no source mean the host left the group. BLOCK_OLD_SOURCES (6)
+ * does not change the membership.
+ */
+#define SNOOP_RECORD(rtype, nsrc) \
+              (((rtype) == 1 || (rtype) == 3) && (nsrc) == 0 ? SNOOP_LEAVE : \
+                   ((rtype) >= 1 && (rtype) <= 5) ? SNOOP_JOIN : SNOOP_NONE)
+
+/*
+ * Loop detected on a port. (See brdg_loop_block())
+ * Entries of a removed port have NULL port.
+ */
+typedef struct loop_event_s
+{
+    brdg_port_t *port;               /* Blocked port */
+    brdg_port_t *peer;               /* Other port of the loop, or NULL */
+    struct    ether_addr addr;       /* Address which flapped */
+    uint16_t  reason;                /* BRDG_LOOP_XXX */
+    uint32_t  flaps;                 /* Flaps in the second */
+    uint32_t  time;                  /* Clock of the detection */
+    uint32_t  block;                 /* Seconds the port was blocked for */
+} loop_event_t;
+
+/*
+ * Probe of loop detection. A broadcast frame of the loopback protocol
+ * (Configuration Testing Protocol) is sent to each port with the source
+ * address of the bridge, and a port which receives it back is in a loop.
+ * The index of the sending port is in the receipt number of the reply
+ * message.
+ */
+#define LOOP_ETHERTYPE   0x9000      /* Loopback (Configuration Testing Protocol) */
+#define LOOP_PROBE_LEN   60          /* Minimum frame length without FCS */
+#define LOOP_PROBE_INDEX 18          /* Offset of the receipt number */
+#define LOOP_BACKOFF     4           /* Max doublings of the block time */
+
+/*
+ * A move of an address is a flap if the address was moved within
+ * bc_move_holddown + LOOP_FLAP_WINDOW seconds. (See brdg_loop_check())
+ */
+#define LOOP_FLAP_WINDOW 2
+
+/*
+ * BPDU of RSTP. Sent to the group address of bridges in an 802.3 frame
+ * with the LLC header of the spanning tree protocol (42 42 03).
+ */
+#define BPDU_OFFSET      17          /* Offset of the BPDU in the frame */
+#define BPDU_FRAME_LEN   60          /* Minimum frame length without FCS */
+#define BPDU_MATCH(hdr, len) \
+              ((len) >= BPDU_OFFSET + 4 && (hdr)[0] == 0x01 && (hdr)[1] == 0x80 && \
+                   (hdr)[2] == 0xc2 && (hdr)[3] == 0 && (hdr)[4] == 0 && (hdr)[5] == 0 && \
+                   (hdr)[14] == 0x42 && (hdr)[15] == 0x42 && (hdr)[16] == 0x03)
+
+/*
+ * BPDU received on a port, to be processed by brdg_learn_run()
+ */
+typedef struct bpdu_s
+{
+    brdg_port_t *port;
+    uint32_t  len;                   /* Length of data */
+    uint8_t   data[STP_BPDU_LEN];    /* BPDU after the LLC header */
+} bpdu_t;
+
+/*
+ * Frame of the bridge itself, a BPDU or a probe, to be sent to the port.
+ * Frames are queued under fdb_lock, and sent by brdg_unlock_xmit() after
+ * fdb_lock is released, since the caller may pass the frame to the driver
+ * below (e.g. put(9F)), which must not be done holding a lock of the
+ * bridge. Each queued frame holds the port, and brdg_port_remove() waits
+ * until the port has no hold.
+ */
+typedef struct xmit_s
+{
+    brdg_port_t *port;
+    void      *frame;
+} xmit_t;
+
+static const uint8_t brdg_stp_group[ETHERADDRL] = {
+    0x01, 0x80, 0xc2, 0x00, 0x00, 0x00
+};
+
+/*
+ * Bridge structure.
+ */
+struct brdg_s
+{
+    brdg_ops_t    ops;           /* Operations of the caller */
+    void          *arg;          /* Argument of the caller */
+    brdg_conf_t   conf;          /* Configuration */
+    brdg_portset_t * volatile ports; /* Active ports */
+    brdg_lock_t   port_lock;     /* Serializes updates of ports */
+
+    fdb_bucket_t  *fdb_table;    /* Forwarding database (hash table of buckets) */
+    uint32_t      fdb_nbucket;   /* Number of buckets. Power of two */
+    brdg_lock_t   fdb_lock;      /* Serializes updates of the forwarding database */
+    uint32_t      sweep_next;    /* Bucket to be checked next by brdg_tick() */
+    fdb_slot_t    *slots;        /* Slots of ports. Updated under fdb_lock */
+    uint32_t      nslot;         /* Number of slots */
+    /*
+     * Clock of the forwarding database, in seconds.
+     * Updated by brdg_tick() so that the data path can record when
+     * an address was seen with just a load and a compare.
+     */
+    volatile uint32_t clock;
+    volatile uint32_t msclock;   /* Same as clock, in milliseconds. May wrap */
+
+    learn_t       learn_queue[BRDG_LEARN_MAX]; /* Addresses to be registered */
+    learn_t       learn_batch[BRDG_LEARN_MAX]; /* Used by brdg_learn_run() */
+    uint32_t      learn_count;   /* Number of requests in learn_queue */
+    int           learn_scheduled; /* brdg_learn_run() is scheduled */
+    brdg_lock_t   learn_lock;    /* Protects learn_queue, snoop_queue and bpdu_queue */
+
+    /*
+     * Multicast group table. NULL if snooping is disabled.
+     * Expiry times are not read by the data path, and are kept apart from
+     * the table: mcast_expire has BRDG_MCAST_PORTS entries for each group,
+     * indexed by (bucket * MCAST_WAYS + way).
+     */
+    mcast_bucket_t *mcast_table;
+    uint32_t      mcast_nbucket; /* Number of buckets. Power of two */
+    uint32_t      *mcast_expire; /* Clock when the membership of the port expires */
+    uint32_t      *mcast_gexpire; /* Clock when the group expires */
+    volatile uint64_t mrouter;   /* Bitmap of router ports */
+    uint32_t      mrouter_expire[BRDG_MCAST_PORTS]; /* Clock when the router port expires */
+    snoop_t       snoop_queue[BRDG_SNOOP_MAX]; /* Requests from snooping */
+    snoop_t       snoop_batch[BRDG_SNOOP_MAX]; /* Used by brdg_learn_run() */
+    uint32_t      snoop_count;   /* Number of requests in snoop_queue */
+
+    /*
+     * Address of the bridge. Source address of probes and BPDUs, and
+     * the address part of the bridge ID of RSTP.
+     */
+    struct ether_addr addr;
+
+    /*
+     * Loop detection. Protected by fdb_lock.
+     */
+    uint32_t      probe_next;    /* Clock when probes are sent next */
+    loop_event_t  loop_event[BRDG_LOOP_EVENTS]; /* Ring of recent detections */
+    uint32_t      loop_nevent;   /* Number of detections. Next slot of loop_event */
+
+    /*
+     * RSTP. Protected by fdb_lock. Disabled if stp_on is 0.
+     */
+    int           stp_on;
+    stp_t         stp;
+    bpdu_t        bpdu_queue[BRDG_BPDU_MAX]; /* BPDUs to be processed */
+    bpdu_t        bpdu_batch[BRDG_BPDU_MAX]; /* Used by brdg_learn_run() */
+    uint32_t      bpdu_count;    /* Number of BPDUs in bpdu_queue */
+
+    /*
+     * Frames of the bridge to be sent. Protected by fdb_lock.
+     */
+    xmit_t        xmit_queue[BRDG_XMIT_MAX];
+    xmit_t        xmit_batch[BRDG_XMIT_MAX]; /* Used by brdg_unlock_xmit() */
+    uint32_t      xmit_count;    /* Number of frames in xmit_queue */
+    int           xmit_busy;     /* brdg_unlock_xmit() is sending frames */
+    brdg_cv_t     hold_cv;       /* Signaled when 'hold' of a port drops to 0 */
+};
+
+/*
+ * Get the bucket which the ethernet address in the VLAN belongs to
+ */
+#define FDB_BUCKET(br, addr, vid) \
+              (&(br)->fdb_table[brdg_mac_hash((addr)->ether_addr_octet, (vid), \
+                   (br)->conf.bc_hash_key) & ((br)->fdb_nbucket - 1)])
+
+/*
+ * Get the bucket of the multicast group table
+ */
+#define MCAST_BUCKET(br, addr, vid) \
+              (&(br)->mcast_table[brdg_mac_hash((addr)->ether_addr_octet, (vid), \
+                   (br)->conf.bc_hash_key) & ((br)->mcast_nbucket - 1)])
+
+/*
+ * Index of the group in mcast_expire and mcast_gexpire
+ */
+#define MCAST_SLOT(br, bucket, way) \
+              ((uint32_t)((bucket) - (br)->mcast_table) * MCAST_WAYS + (way))
+
+/*
+ * Group addresses of IPv4 (01:00:5e) and IPv6 (33:33) multicast.
+ * Groups of link local scope (224.0.0.x, ff02::x) are always flooded.
+ */
+#define MCAST_IP(a) \
+              (((a)[0] == 0x01 && (a)[1] == 0x00 && (a)[2] == 0x5e) || \
+                   ((a)[0] == 0x33 && (a)[1] == 0x33))
+#define MCAST_LINKLOCAL(a) \
+              ((a)[0] == 0x01 ? ((a)[3] == 0 && (a)[4] == 0) : \
+                   ((a)[2] == 0 && (a)[3] == 0 && (a)[4] == 0))
+
+/*
+ * Group structure matches the group address in the VLAN
+ */
+#define GROUP_MATCH(group, a, v) \
+              (((group)->state & GROUP_VALID) && (group)->vid == (v) && \
+                   bcmp((a), &(group)->addr, ETHERADDRL) == 0)
+
+/*
+ * The node was moved to another port within bc_move_holddown seconds, and
+ * must not be moved again yet.
+ */
+#define NODE_HELD(br, node) \
+              (((node)->state & NODE_MOVED) && \
+                   (uint16_t)((br)->clock - (node)->moved) < (br)->conf.bc_move_holddown)
+
+/*
+ * Node structure matches the ethernet address in the VLAN
+ */
+#define NODE_MATCH(node, addr, v) \
+              (((node)->state & NODE_VALID) && (node)->vid == (v) && \
+                   bcmp((addr), &(node)->ether_addr, ETHERADDRL) == 0)
+
+static brdg_port_t *brdg_fdb_lookup(brdg_t *, fdb_bucket_t *, const struct ether_addr *,
+    uint16_t, node_t **);
+static brdg_port_t *brdg_node_port(brdg_t *, const node_t *);
+static int  brdg_fdb_learn(brdg_t *, const struct ether_addr *, uint16_t, brdg_port_t *);
+static void brdg_fdb_insert(brdg_t *, const struct ether_addr *, uint16_t, brdg_port_t *);
+static node_t *brdg_fdb_find(brdg_t *, fdb_bucket_t *, const struct ether_addr *, uint16_t);
+static node_t *brdg_fdb_victim(brdg_t *, fdb_bucket_t *, uint32_t);
+static int  brdg_slot_alloc(brdg_t *, brdg_port_t *);
+static void brdg_flood(brdg_t *, brdg_port_t *, void *, uint16_t, uint32_t, uint64_t);
+static void brdg_xmit_pending(brdg_t *, brdg_port_t **, void **, uint32_t *, uint16_t *, uint32_t);
+static void *brdg_retag(brdg_t *, brdg_port_t *, void *, uint16_t, uint32_t);
+static brdg_portset_t *brdg_portset_alloc(uint32_t);
+static void brdg_portset_publish(brdg_t *, brdg_portset_t *);
+static void brdg_mcast_free(brdg_t *);
+static void brdg_mcast_input(brdg_t *, brdg_port_t *, brdg_frame_t *, uint16_t, uint32_t);
+static int  brdg_mcast_lookup(brdg_t *, mcast_bucket_t *, const struct ether_addr *, uint16_t,
+    uint64_t *);
+static void brdg_mcast_update(brdg_t *, const snoop_t *);
+static void brdg_mcast_age(brdg_t *, uint32_t);
+static void brdg_mcast_port_remove(brdg_t *, brdg_port_t *);
+static int  brdg_snoop_parse(brdg_t *, brdg_port_t *, const uint8_t *, size_t, uint16_t);
+static int  brdg_snoop_igmp(brdg_t *, brdg_port_t *, const uint8_t *, size_t, uint16_t);
+static int  brdg_snoop_mld(brdg_t *, brdg_port_t *, const uint8_t *, size_t, uint16_t);
+static void brdg_snoop_queue(brdg_t *, uint32_t, const uint8_t *, uint16_t, brdg_port_t *);
+static uint32_t brdg_ctz64(uint64_t);
+static int  brdg_storm_police(brdg_t *, brdg_port_t *, uint32_t, size_t);
+static int  brdg_limit_police(brdg_t *, brdg_port_t *);
+static void brdg_limit_shutdown(brdg_t *, brdg_port_t *);
+static void brdg_loop_check(brdg_t *, uint32_t);
+static void brdg_xmit_queue(brdg_t *, brdg_port_t *, void *);
+static void brdg_unlock_xmit(brdg_t *);
+static void brdg_loop_block(brdg_t *, brdg_port_t *, brdg_port_t *, uint32_t, uint32_t, uint32_t);
+static void brdg_loop_probe(brdg_t *);
+static void brdg_fdb_flush(brdg_t *, brdg_port_t *, int);
+static void brdg_input_blocked(brdg_t *, brdg_port_t *, brdg_frame_t *, uint32_t);
+static void brdg_bpdu_queue(brdg_t *, brdg_port_t *, const uint8_t *, size_t);
+static void brdg_stp_cb_state(stp_t *, stp_port_t *, uint32_t);
+static void brdg_stp_cb_flush(stp_t *, stp_port_t *, int);
+static void brdg_stp_cb_xmit(stp_t *, stp_port_t *, const uint8_t *, size_t);
+
+/*
+ * Operations for RSTP
+ */
+static const stp_ops_t brdg_stp_ops = {
+    brdg_stp_cb_state,
+    brdg_stp_cb_flush,
+    brdg_stp_cb_xmit
+};
+
+/*****************************************************************************
+ * brdg_create()
+ *
+ * Create a bridge.
+ *
+ *  Arguments:
+ *           conf :  configuration
+ *           ops  :  operations of the caller
+ *           arg  :  argument of the caller. Can be got by brdg_arg()
+ *  Return:
+ *           bridge, or NULL if memory is not available
+ *****************************************************************************/
+brdg_t *
+brdg_create(const brdg_conf_t *conf, const brdg_ops_t *ops, void *arg)
+{
+    brdg_t    *br;
+    uint32_t  nbucket = 1;
+    uint64_t  id;
+    uint32_t  i;
+
+    while (nbucket * BRDG_FDB_WAYS < conf->bc_fdb_size && nbucket < (1U << 24))
+        nbucket <<= 1;
+
+    if ((br = BRDG_ALLOC(sizeof(brdg_t))) == NULL)
+        return(NULL);
+    if ((br->fdb_table = BRDG_ALLOC(sizeof(fdb_bucket_t) * nbucket)) == NULL) {
+        BRDG_FREE(br, sizeof(brdg_t));
+        return(NULL);
+    }
+    if ((br->ports = brdg_portset_alloc(0)) == NULL) {
+        BRDG_FREE(br->fdb_table, sizeof(fdb_bucket_t) * nbucket);
+        BRDG_FREE(br, sizeof(brdg_t));
+        return(NULL);
+    }
+    if ((br->slots = BRDG_ALLOC(sizeof(fdb_slot_t) * FDB_SLOT_INIT)) == NULL) {
+        BRDG_FREE(br->ports, br->ports->ps_size);
+        BRDG_FREE(br->fdb_table, sizeof(fdb_bucket_t) * nbucket);
+        BRDG_FREE(br, sizeof(brdg_t));
+        return(NULL);
+    }
+    br->nslot = FDB_SLOT_INIT;
+    br->fdb_nbucket = nbucket;
+
+    /*
+     * Multicast group table. Snooping is disabled if memory is not available.
+     */
+    if (conf->bc_mcast_size != 0) {
+        for (nbucket = 1; nbucket * MCAST_WAYS < conf->bc_mcast_size &&
+                 nbucket < (1U << 16); nbucket <<= 1)
+            ;
+        br->mcast_table = BRDG_ALLOC(sizeof(mcast_bucket_t) * nbucket);
+        br->mcast_expire = BRDG_ALLOC(sizeof(uint32_t) * nbucket * MCAST_WAYS *
+            BRDG_MCAST_PORTS);
+        br->mcast_gexpire = BRDG_ALLOC(sizeof(uint32_t) * nbucket * MCAST_WAYS);
+        br->mcast_nbucket = nbucket;
+        if (br->mcast_table == NULL || br->mcast_expire == NULL ||
+            br->mcast_gexpire == NULL)
+            brdg_mcast_free(br);
+    }
+    br->ops = *ops;
+    br->arg = arg;
+    br->conf = *conf;
+    /*
+     * Locally administered unicast address of the bridge, which is
+     * different on each bridge of the network. It is sent in probes and
+     * BPDUs, so it is not made of the hash key, which must be secret.
+     */
+    br->addr = conf->bc_addr;
+    br->addr.ether_addr_octet[0] = (br->addr.ether_addr_octet[0] & 0xfc) | 0x02;
+    if (conf->bc_stp != 0 && ops->bo_alloc != NULL) {
+        id = conf->bc_stp_priority & 0xf000;
+        for (i = 0; i < ETHERADDRL; i++)
+            id = (id << 8) | br->addr.ether_addr_octet[i];
+        brdg_stp_init(&br->stp, id, &brdg_stp_ops, br);
+        br->stp_on = 1;
+    }
+    BRDG_LOCK_INIT(&br->fdb_lock);
+    BRDG_LOCK_INIT(&br->learn_lock);
+    BRDG_LOCK_INIT(&br->port_lock);
+    BRDG_CV_INIT(&br->hold_cv);
+    return(br);
+}
+
+/*****************************************************************************
+ * brdg_destroy()
+ *
+ * Destroy the bridge. All ports must have been removed, and
+ * brdg_learn_run() must not be running.
+ *****************************************************************************/
+void
+brdg_destroy(brdg_t *br)
+{
+    BRDG_CV_DESTROY(&br->hold_cv);
+    BRDG_LOCK_DESTROY(&br->port_lock);
+    BRDG_LOCK_DESTROY(&br->learn_lock);
+    BRDG_LOCK_DESTROY(&br->fdb_lock);
+    BRDG_FREE(br->ports, br->ports->ps_size);
+    BRDG_FREE(br->slots, sizeof(fdb_slot_t) * br->nslot);
+    BRDG_FREE(br->fdb_table, sizeof(fdb_bucket_t) * br->fdb_nbucket);
+    brdg_mcast_free(br);
+    BRDG_FREE(br, sizeof(brdg_t));
+}
+
+/*****************************************************************************
+ * brdg_mcast_free()
+ *
+ * Free the multicast group table, which disables snooping.
+ *****************************************************************************/
+static void
+brdg_mcast_free(brdg_t *br)
+{
+    if (br->mcast_table != NULL)
+        BRDG_FREE(br->mcast_table, sizeof(mcast_bucket_t) * br->mcast_nbucket);
+    if (br->mcast_expire != NULL)
+        BRDG_FREE(br->mcast_expire, sizeof(uint32_t) * br->mcast_nbucket *
+            MCAST_WAYS * BRDG_MCAST_PORTS);
+    if (br->mcast_gexpire != NULL)
+        BRDG_FREE(br->mcast_gexpire, sizeof(uint32_t) * br->mcast_nbucket * MCAST_WAYS);
+    br->mcast_table = NULL;
+    br->mcast_expire = NULL;
+    br->mcast_gexpire = NULL;
+    br->mcast_nbucket = 0;
+}
+
+/*****************************************************************************
+ * brdg_arg()
+ *
+ * Return the argument given to brdg_create().
+ *****************************************************************************/
+void *
+brdg_arg(brdg_t *br)
+{
+    return(br->arg);
+}
+
+/*****************************************************************************
+ * brdg_portset_alloc()
+ *
+ * Allocate a port set which can hold count ports.
+ *****************************************************************************/
+static brdg_portset_t *
+brdg_portset_alloc(uint32_t count)
+{
+    brdg_portset_t *ps;
+    uint32_t       size;
+
+    size = sizeof(brdg_portset_t) + sizeof(brdg_port_t *) * (count ? count - 1 : 0);
+    if ((ps = BRDG_ALLOC(size)) == NULL)
+        return(NULL);
+    ps->ps_count = count;
+    ps->ps_size = size;
+    return(ps);
+}
+
+/*****************************************************************************
+ * brdg_portset_publish()
+ *
+ * Replace the active port set with the new one, and free the old one.
+ * The new set is made visible only after it is filled.
+ *
+ * The old set is freed at once. The caller guarantees that brdg_input()
+ * is not running while ports are added or removed (open and close of the
+ * STREAMS module are exclusive with put procedures by D_MTOCEXCL).
+ * port_lock must be held by the caller.
+ *****************************************************************************/
+static void
+brdg_portset_publish(brdg_t *br, brdg_portset_t *ps)
+{
+    brdg_portset_t *old = br->ports;
+
+    BRDG_MEMBAR_PRODUCER();
+    br->ports = ps;
+    BRDG_FREE(old, old->ps_size);
+}
+
+/*****************************************************************************
+ * brdg_slot_alloc()
+ *
+ * Assign a free slot to the port. The slot table is doubled if all slots
+ * are in use, and the old table is freed at once, for the same reason as
+ * brdg_portset_publish(). fdb_lock must be held by the caller.
+ *
+ *  Return:
+ *           0 on success, -1 if memory is not available or FDB_SLOT_MAX
+ *           ports are in use
+ *****************************************************************************/
+static int
+brdg_slot_alloc(brdg_t *br, brdg_port_t *port)
+{
+    fdb_slot_t *slots;
+    fdb_slot_t *old = br->slots;
+    uint32_t   i;
+
+    for (i = 0; i < br->nslot; i++) {
+        if (old[i].port == NULL)
+            break;
+    }
+    if (i == br->nslot) {
+        if (br->nslot >= FDB_SLOT_MAX)
+            return(-1);
+        if ((slots = BRDG_ALLOC(sizeof(fdb_slot_t) * br->nslot * 2)) == NULL)
+            return(-1);
+        bcopy(old, slots, sizeof(fdb_slot_t) * br->nslot);
+        BRDG_MEMBAR_PRODUCER();
+        br->slots = slots;
+        BRDG_FREE(old, sizeof(fdb_slot_t) * br->nslot);
+        br->nslot *= 2;
+    }
+    port->slot = i;
+    br->slots[i].port = port;
+    return(0);
+}
+
+/*****************************************************************************
+ * brdg_port_add()
+ *
+ * Add a port to the bridge. Up to FDB_SLOT_MAX ports can be added.
+ *
+ *  Arguments:
+ *           br     :  bridge
+ *           cookie :  handle of the port, passed to operations
+ *  Return:
+ *           port, or NULL if memory is not available
+ *****************************************************************************/
+brdg_port_t *
+brdg_port_add(brdg_t *br, void *cookie)
+{
+    brdg_port_t    *port;
+    brdg_portset_t *ps;
+    uint32_t       count;
+
+    if ((port = BRDG_ALLOC(sizeof(brdg_port_t))) == NULL)
+        return(NULL);
+    if ((port->stats_buf = BRDG_ALLOC(STAT_BUFSIZE)) == NULL) {
+        BRDG_FREE(port, sizeof(brdg_port_t));
+        return(NULL);
+    }
+    port->stats = (uint8_t *)(((uintptr_t)port->stats_buf + BRDG_CACHELINE - 1) &
+        ~(uintptr_t)(BRDG_CACHELINE - 1));
+    port->cookie = cookie;
+    /* Trunk of all VLANs. Same as a VLAN unaware bridge */
+    port->vlan_mode = BRDG_VLAN_TRUNK;
+    port->pvid = BRDG_VLAN_DEFAULT;
+    memset(port->vlan_member, 0xff, sizeof(port->vlan_member));
+    port->vlan_member[0] &= ~0x01;
+    port->vlan_member[(BRDG_VLAN_MAX - 1) >> 3] &= ~0x80;
+    /* Discarding until RSTP selects the role */
+    if (br->stp_on)
+        port->blocked = BLOCK_STP;
+
+    BRDG_LOCK(&br->fdb_lock);
+    if (brdg_slot_alloc(br, port) < 0) {
+        BRDG_UNLOCK(&br->fdb_lock);
+        BRDG_FREE(port->stats_buf, STAT_BUFSIZE);
+        BRDG_FREE(port, sizeof(brdg_port_t));
+        return(NULL);
+    }
+    BRDG_LOCK(&br->port_lock);
+    count = br->ports->ps_count;
+    if ((ps = brdg_portset_alloc(count + 1)) == NULL) {
+        BRDG_UNLOCK(&br->port_lock);
+        br->slots[port->slot].port = NULL;
+        BRDG_UNLOCK(&br->fdb_lock);
+        BRDG_FREE(port->stats_buf, STAT_BUFSIZE);
+        BRDG_FREE(port, sizeof(brdg_port_t));
+        return(NULL);
+    }
+    bcopy(br->ports->ps_port, ps->ps_port, sizeof(brdg_port_t *) * count);
+    port->index = count;
+    ps->ps_port[count] = port;
+    brdg_portset_publish(br, ps);
+    BRDG_UNLOCK(&br->port_lock);
+
+    if (br->stp_on)
+        brdg_stp_port_add(&br->stp, &port->stp, port);
+    brdg_unlock_xmit(br);
+    return(port);
+}
+
+/*****************************************************************************
+ * brdg_port_remove()
+ *
+ * Remove the port from the bridge, with requests to register addresses
+ * on the port. Node structures of the port are not scanned; they become
+ * stale by the bump of the generations of the slot, and are reclaimed by
+ * brdg_tick(). So it takes the same time however large the forwarding
+ * database is.
+ * fdb_lock is held until the last port is moved to the slot of the removed
+ * port, so that bitmaps of ports in the multicast group table are never
+ * updated by the index before the move.
+ * Then it waits until frames of the bridge being sent to the port are
+ * sent. (See xmit_t)
+ *****************************************************************************/
+void
+brdg_port_remove(brdg_t *br, brdg_port_t *port)
+{
+    fdb_slot_t   *slot;
+    uint32_t     i, j;
+    uint32_t     count;
+    brdg_portset_t *ps;
+    brdg_port_t  *last;
+
+    BRDG_LOCK(&br->fdb_lock);
+    BRDG_LOCK(&br->learn_lock);
+    for (i = 0, j = 0; i < br->learn_count; i++) {
+        if (br->learn_queue[i].port != port)
+            br->learn_queue[j++] = br->learn_queue[i];
+    }
+    br->learn_count = j;
+    for (i = 0, j = 0; i < br->snoop_count; i++) {
+        if (br->snoop_queue[i].port != port)
+            br->snoop_queue[j++] = br->snoop_queue[i];
+    }
+    br->snoop_count = j;
+    for (i = 0, j = 0; i < br->bpdu_count; i++) {
+        if (br->bpdu_queue[i].port != port)
+            br->bpdu_queue[j++] = br->bpdu_queue[i];
+    }
+    br->bpdu_count = j;
+    BRDG_UNLOCK(&br->learn_lock);
+
+    slot = &br->slots[port->slot];
+    slot->gen++;
+    slot->sgen++;
+    BRDG_MEMBAR_PRODUCER();
+    slot->port = NULL;
+    brdg_mcast_port_remove(br, port);
+    for (i = 0; i < BRDG_LOOP_EVENTS; i++) {
+        if (br->loop_event[i].port == port)
+            br->loop_event[i].port = NULL;
+        if (br->loop_event[i].peer == port)
+            br->loop_event[i].peer = NULL;
+    }
+    if (br->stp_on)
+        brdg_stp_port_remove(&br->stp, &port->stp);
+
+    /*
+     * Move the last port to the slot of the removed port.
+     * If memory is not available the current set is shrunk in place.
+     */
+    BRDG_LOCK(&br->port_lock);
+    count = br->ports->ps_count;
+    last = br->ports->ps_port[count - 1];
+    if ((ps = brdg_portset_alloc(count - 1)) != NULL) {
+        bcopy(br->ports->ps_port, ps->ps_port, sizeof(brdg_port_t *) * (count - 1));
+        if (port != last)
+            ps->ps_port[port->index] = last;
+        last->index = port->index;
+        brdg_portset_publish(br, ps);
+    } else {
+        br->ports->ps_port[port->index] = last;
+        last->index = port->index;
+        BRDG_MEMBAR_PRODUCER();
+        br->ports->ps_count = count - 1;
+    }
+    BRDG_UNLOCK(&br->port_lock);
+
+    /*
+     * Drop frames queued to the port, and wait for brdg_unlock_xmit()
+     * sending frames to the port.
+     */
+    for (i = 0, j = 0; i < br->xmit_count; i++) {
+        if (br->xmit_queue[i].port != port) {
+            br->xmit_queue[j++] = br->xmit_queue[i];
+        } else {
+            br->ops.bo_free(br->xmit_queue[i].frame);
+            port->hold--;
+        }
+    }
+    br->xmit_count = j;
+    while (port->hold != 0)
+        BRDG_CV_WAIT(&br->hold_cv, &br->fdb_lock);
+    brdg_unlock_xmit(br);
+    BRDG_FREE(port->stats_buf, STAT_BUFSIZE);
+    BRDG_FREE(port, sizeof(brdg_port_t));
+}
+
+/*****************************************************************************
+ * brdg_port_link()
+ *
+ * Link of the port went down or up. While the link is down, the port is
+ * blocked and is disabled for RSTP, so that an alternate port takes over
+ * at once. Dynamic addresses of the port are deleted when the link goes
+ * down, so that frames to them are flooded to the other ports instead of
+ * being sent to the dead link until they age out.
+ *
+ *  Arguments:
+ *           br   :  bridge
+ *           port :  port
+ *           up   :  non-zero if the link is up
+ *****************************************************************************/
+void
+brdg_port_link(brdg_t *br, brdg_port_t *port, int up)
+{
+    BRDG_LOCK(&br->fdb_lock);
+    if (((port->blocked & BLOCK_LINK) == 0) == (up != 0)) {
+        BRDG_UNLOCK(&br->fdb_lock);
+        return;
+    }
+    BRDG_TRACE2(link, brdg_port_t *, port, int, up);
+    if (up) {
+        port->blocked &= ~BLOCK_LINK;
+    } else {
+        STAT_INC(port, BRDG_STAT_LINK_DOWN);
+        port->blocked |= BLOCK_LINK;
+        brdg_fdb_flush(br, port, 0);
+    }
+    if (br->stp_on && (port->blocked & BLOCK_LIMIT) == 0)
+        brdg_stp_port_enable(&br->stp, &port->stp, up);
+    brdg_unlock_xmit(br);
+}
+
+/*****************************************************************************
+ * brdg_port_stats()
+ *
+ * Sum up statistics of the port of all CPUs.
+ *
+ *  Arguments:
+ *           port  :  port
+ *           stats :  array of BRDG_STAT_MAX counters to be set
+ *****************************************************************************/
+void
+brdg_port_stats(brdg_port_t *port, uint64_t *stats)
+{
+    uint64_t  *row;
+    int       cpu;
+    int       i;
+
+    bzero(stats, sizeof(uint64_t) * BRDG_STAT_MAX);
+    for (cpu = 0; cpu < BRDG_NCPU(); cpu++) {
+        row = (uint64_t *)(port->stats + STAT_ROW * cpu);
+        for (i = 0; i < BRDG_STAT_MAX; i++)
+            stats[i] += row[i];
+    }
+}
+
+/*****************************************************************************
+ * brdg_port_vlan()
+ *
+ * Set VLAN configuration of the port, and delete addresses of the port in
+ * VLANs which the port is no longer a member of.
+ * An access port is a member of the PVID only. A trunk port is a member
+ * of VLANs in bv_member, and frames of the PVID are sent untagged.
+ * Must not be called at the same time as brdg_input(). The caller is
+ * responsible for it.
+ *
+ *  Arguments:
+ *           br   :  bridge
+ *           port :  port
+ *           vlan :  VLAN configuration
+ *  Return:
+ *           0 on success, -1 if the configuration is invalid
+ *****************************************************************************/
+int
+brdg_port_vlan(brdg_t *br, brdg_port_t *port, const brdg_vlan_t *vlan)
+{
+    fdb_bucket_t *bucket;
+    node_t       *node;
+    uint32_t     bucketnum;
+    uint32_t     way;
+
+    if (vlan->bv_pvid == 0 || vlan->bv_pvid >= BRDG_VLAN_MAX - 1)
+        return(-1);
+    switch (vlan->bv_mode) {
+        case BRDG_VLAN_ACCESS:
+            bzero(port->vlan_member, sizeof(port->vlan_member));
+            port->vlan_member[vlan->bv_pvid >> 3] |= 1 << (vlan->bv_pvid & 7);
+            break;
+        case BRDG_VLAN_TRUNK:
+            bcopy(vlan->bv_member, port->vlan_member, sizeof(port->vlan_member));
+            port->vlan_member[0] &= ~0x01;
+            port->vlan_member[(BRDG_VLAN_MAX - 1) >> 3] &= ~0x80;
+            break;
+        default:
+            return(-1);
+    }
+    port->vlan_mode = vlan->bv_mode;
+    port->pvid = vlan->bv_pvid;
+
+    BRDG_LOCK(&br->fdb_lock);
+    for (bucketnum = 0; bucketnum < br->fdb_nbucket; bucketnum++) {
+        bucket = &br->fdb_table[bucketnum];
+        for (way = 0; way < BRDG_FDB_WAYS; way++) {
+            node = &bucket->node[way];
+            if ((node->state & NODE_VALID) && brdg_node_port(br, node) == port &&
+                !VLAN_MEMBER(port, node->vid)) {
+                if ((node->state & NODE_STATIC) == 0)
+                    port->learned--;
+                FDB_WRITE_BEGIN(bucket);
+                node->state = 0;
+                FDB_WRITE_END(bucket);
+            }
+        }
+    }
+    BRDG_UNLOCK(&br->fdb_lock);
+    return(0);
+}
+
+/*****************************************************************************
+ * brdg_port_vlan_get()
+ *
+ * Get VLAN configuration of the port.
+ *
+ *  Arguments:
+ *           port :  port
+ *           vlan :  VLAN configuration to be set
+ *****************************************************************************/
+void
+brdg_port_vlan_get(brdg_port_t *port, brdg_vlan_t *vlan)
+{
+    vlan->bv_mode = port->vlan_mode;
+    vlan->bv_pvid = port->pvid;
+    bcopy(port->vlan_member, vlan->bv_member, sizeof(vlan->bv_member));
+}
+
+/*****************************************************************************
+ * brdg_port_storm()
+ *
+ * Set the limit of storm control of the port for the class of frames.
+ * Frames of the class received on the port over the limit of frames per
+ * second or bytes per second are dropped, and counted in
+ * BRDG_STAT_DROP_BCAST, BRDG_STAT_DROP_MCAST or BRDG_STAT_DROP_UNKNOWN.
+ * Bursts up to bc_storm_burst milliseconds of the limit are accepted.
+ * Must not be called at the same time as brdg_input() of the port. The
+ * caller is responsible for it.
+ *
+ *  Arguments:
+ *           br    :  bridge
+ *           port  :  port
+ *           class :  BRDG_STORM_XXX
+ *           storm :  limits. Zero for no limit
+ *  Return:
+ *           0 on success, -1 if the class is invalid
+ *****************************************************************************/
+int
+brdg_port_storm(brdg_t *br, brdg_port_t *port, uint32_t class,
+    const brdg_storm_t *storm)
+{
+    storm_t  *st;
+
+    if (class >= BRDG_STORM_MAX)
+        return(-1);
+    st = &port->storm[class];
+    st->pps = storm->bs_pps;
+    st->bps = storm->bs_bps;
+    st->ptokens = (int64_t)st->pps * br->conf.bc_storm_burst;
+    st->btokens = (int64_t)st->bps * br->conf.bc_storm_burst;
+    st->last = br->msclock;
+    if (st->pps != 0 || st->bps != 0)
+        port->storm_on |= 1 << class;
+    else
+        port->storm_on &= ~(1 << class);
+    return(0);
+}
+
+/*****************************************************************************
+ * brdg_port_limit()
+ *
+ * Set the MAC limit of the port. A frame from a source address which is
+ * not registered on the port is over the limit if bm_max dynamic addresses
+ * are already registered on the port, or if more than bm_rate addresses
+ * were learned in the last second. It is counted in BRDG_STAT_LIMIT and
+ * handled by bm_action before a request to learn the address is queued,
+ * so that a flood of random source addresses never reaches
+ * brdg_learn_run(). A port shut down by BRDG_LIMIT_SHUTDOWN is brought
+ * back by this function.
+ * Must not be called at the same time as brdg_input() of the port. The
+ * caller is responsible for it.
+ *
+ *  Arguments:
+ *           br    :  bridge
+ *           port  :  port
+ *           limit :  bm_max, bm_rate and bm_action are used
+ *  Return:
+ *           0 on success, -1 if the action is invalid
+ *****************************************************************************/
+int
+brdg_port_limit(brdg_t *br, brdg_port_t *port, const brdg_limit_t *limit)
+{
+    if (limit->bm_action > BRDG_LIMIT_SHUTDOWN)
+        return(-1);
+    BRDG_LOCK(&br->fdb_lock);
+    port->limit_max = limit->bm_max;
+    port->limit_rate = limit->bm_rate;
+    port->limit_action = limit->bm_action;
+    port->limit_tokens = (int64_t)port->limit_rate * 1000;
+    port->limit_last = br->msclock;
+    port->limit_shut = 0;
+    if (port->blocked & BLOCK_LIMIT) {
+        BRDG_TRACE2(limit, brdg_port_t *, port, int, 0);
+        port->blocked &= ~BLOCK_LIMIT;
+        if (br->stp_on && (port->blocked & BLOCK_LINK) == 0)
+            brdg_stp_port_enable(&br->stp, &port->stp, 1);
+    }
+    brdg_unlock_xmit(br);
+    return(0);
+}
+
+/*****************************************************************************
+ * brdg_port_limit_get()
+ *
+ * Get the MAC limit of the port, the number of dynamic addresses on the
+ * port, and whether the port is shut down.
+ *****************************************************************************/
+void
+brdg_port_limit_get(brdg_t *br, brdg_port_t *port, brdg_limit_t *limit)
+{
+    BRDG_LOCK(&br->fdb_lock);
+    limit->bm_max = port->limit_max;
+    limit->bm_rate = port->limit_rate;
+    limit->bm_action = port->limit_action;
+    limit->bm_learned = port->learned;
+    limit->bm_shutdown = ((port->blocked & BLOCK_LIMIT) || port->limit_shut);
+    BRDG_UNLOCK(&br->fdb_lock);
+}
+
+/**********************************************************************
+ * brdg_input()
+ *
+ * Forward a frame received on the port.
+ * Same as brdg_input_batch() with one frame.
+ *
+ *  Arguments:
+ *           br    :  bridge
+ *           port  :  port where the frame was received
+ *           frame :  frame handle. Consumed by this function
+ *           hdr   :  ethernet header of the frame
+ *           len   :  length of contiguous data at hdr
+ ***********************************************************************/
+void
+brdg_input(brdg_t *br, brdg_port_t *port, void *frame, const uint8_t *hdr,
+    size_t len)
+{
+    brdg_frame_t bf;
+
+    bf.bf_frame = frame;
+    bf.bf_hdr = hdr;
+    bf.bf_len = len;
+    bf.bf_size = len;
+    brdg_input_batch(br, port, &bf, 1);
+}
+
+/**********************************************************************
+ * brdg_input_batch()
+ *
+ * Forward frames received on the port.
+ *
+ * Frames are processed BRDG_BATCH frames at a time. The VLAN of each frame
+ * is decided from its 802.1Q tag or the PVID of the port, and buckets of
+ * the source and destination addresses in the VLAN of all frames are
+ * computed and prefetched first, so that cache misses of the forwarding
+ * database overlap. Then forwarding is decided for each frame. Frames
+ * forwarded to the same port are sent together by brdg_xmit_pending().
+ *
+ * The forwarding database is read without any lock. If the source address
+ * is not registered yet, it is queued to be registered by brdg_learn_run()
+ * and the frame is forwarded without waiting for it.
+ * Broadcast, multicast and unicast frames to unknown destinations are
+ * limited by storm control of the port before they are flooded.
+ * Frames received on a port blocked by loop detection, not forwarding
+ * by RSTP or whose link is down are dropped, and frames are never sent
+ * to it. BPDUs are queued for RSTP instead of being flooded.
+ *
+ *  Arguments:
+ *           br     :  bridge
+ *           port   :  port where the frames were received
+ *           frames :  frames. All frames are consumed by this function
+ *           count  :  number of frames
+ ***********************************************************************/
+void
+brdg_input_batch(brdg_t *br, brdg_port_t *port, brdg_frame_t *frames,
+    uint32_t count)
+{
+    const struct ether_addr *dhost;   /* destination address */
+    const struct ether_addr *shost;   /* source address */
+    node_t       *snode;              /* node structure of the source */
+    brdg_port_t  *sport;              /* port where source is registered */
+    brdg_port_t  *dport;              /* port where destination is registered */
+    fdb_bucket_t *sbucket[BRDG_BATCH]; /* bucket of the source */
+    fdb_bucket_t *dbucket[BRDG_BATCH]; /* bucket of the destination */
+    uint32_t     tag[BRDG_BATCH];     /* 802.1Q tag of the frame. BRDG_TAG_XXX */
+    uint16_t     vid[BRDG_BATCH];     /* VLAN of the frame */
+    int          drop[BRDG_BATCH];    /* Reason if the frame is dropped. 0 if not */
+    brdg_port_t  *pport[BRDG_BATCH];  /* egress port of pending frames */
+    void         *pframe[BRDG_BATCH]; /* pending frames */
+    uint32_t     ptag[BRDG_BATCH];    /* tag of pending frames */
+    uint16_t     pvid[BRDG_BATCH];    /* VLAN of pending frames */
+    brdg_frame_t *bf;
+    const uint8_t *hdr;
+    uint32_t     storm;               /* BRDG_STORM_XXX of the frame */
+    uint16_t     probe;               /* Index of the port which sent the probe */
+    uint32_t     npending;
+    uint32_t     n;
+    uint32_t     i;
+
+    for (; count > 0; count -= n, frames += n) {
+        n = (count < BRDG_BATCH) ? count : BRDG_BATCH;
+        STAT_ADD(port, BRDG_STAT_RX, n);
+
+        if (PORT_BLOCKED(port)) {
+            brdg_input_blocked(br, port, frames, n);
+            continue;
+        }
+
+        for (i = 0; i < n; i++) {
+            bf = &frames[i];
+            hdr = bf->bf_hdr;
+            drop[i] = 0;
+            if (bf->bf_len < 2 * ETHERADDRL + 2) {
+                drop[i] = BRDG_STAT_DROP_RUNT;
+                continue;
+            }
+            if (br->stp_on && BPDU_MATCH(hdr, bf->bf_len)) {
+                brdg_bpdu_queue(br, port, hdr, bf->bf_len);
+                drop[i] = BRDG_STAT_BPDU;
+                continue;
+            }
+            if (hdr[12] == (LOOP_ETHERTYPE >> 8) && hdr[13] == (LOOP_ETHERTYPE & 0xff) &&
+                bcmp(&hdr[ETHERADDRL], &br->addr, ETHERADDRL) == 0) {
+                /*
+                 * Our probe came back. Of the two ports of a loop, only the
+                 * one of the larger index is blocked, so that both ports are
+                 * not blocked by probes of each other.
+                 */
+                if (bf->bf_len >= LOOP_PROBE_INDEX + 2) {
+                    probe = (uint16_t)((hdr[LOOP_PROBE_INDEX] << 8) |
+                        hdr[LOOP_PROBE_INDEX + 1]);
+                    if (probe <= port->index)
+                        port->loop_probe = probe + 1;
+                }
+                drop[i] = BRDG_STAT_DROP_BLOCKED;
+                continue;
+            }
+            if (hdr[12] == (BRDG_VLAN_TPID >> 8) && hdr[13] == (BRDG_VLAN_TPID & 0xff)) {
+                if (bf->bf_len < 2 * ETHERADDRL + 4) {
+                    drop[i] = BRDG_STAT_DROP_RUNT;
+                    continue;
+                }
+                tag[i] = BRDG_TAG_PRESENT | (hdr[14] << 8) | hdr[15];
+                vid[i] = BRDG_VLAN_VID(tag[i]);
+                if (vid[i] == 0)
+                    vid[i] = port->pvid;    /* Priority tagged */
+            } else {
+                tag[i] = 0;
+                vid[i] = port->pvid;
+            }
+            if (!VLAN_MEMBER(port, vid[i])) {
+                drop[i] = BRDG_STAT_DROP_VLAN;
+                continue;
+            }
+            dbucket[i] = FDB_BUCKET(br, (const struct ether_addr *)&hdr[0], vid[i]);
+            sbucket[i] = FDB_BUCKET(br, (const struct ether_addr *)&hdr[ETHERADDRL], vid[i]);
+            BRDG_PREFETCH(dbucket[i]);
+            BRDG_PREFETCH(&dbucket[i]->node[BRDG_FDB_WAYS - 1]);
+            BRDG_PREFETCH(sbucket[i]);
+            BRDG_PREFETCH(&sbucket[i]->node[BRDG_FDB_WAYS - 1]);
+        }
+
+        npending = 0;
+        for (i = 0; i < n; i++) {
+            bf = &frames[i];
+            if (drop[i] != 0) {
+                STAT_INC(port, drop[i]);
+                BRDG_TRACE3(drop, brdg_port_t *, port, void *, bf->bf_frame,
+                    int, drop[i]);
+                br->ops.bo_free(bf->bf_frame);
+                continue;
+            }
+            dhost = (const struct ether_addr *)&bf->bf_hdr[0];
+            shost = (const struct ether_addr *)&bf->bf_hdr[ETHERADDRL];
+
+            sport = brdg_fdb_lookup(br, sbucket[i], shost, vid[i], &snode);
+            if (sport == NULL) {
+                /*
+                 * The node is not registered yet.
+                 */
+                if (brdg_fdb_learn(br, shost, vid[i], port) != 0 &&
+                    port->limit_action != BRDG_LIMIT_STOP) {
+                    BRDG_TRACE3(drop, brdg_port_t *, port, void *, bf->bf_frame,
+                        int, BRDG_STAT_LIMIT);
+                    br->ops.bo_free(bf->bf_frame);
+                    continue;
+                }
+            } else if (sport != port) {
+                /*
+                 * Station move. The frame is forwarded now, and the entry
+                 * is moved to this port by brdg_learn_run(), which checks
+                 * the hold-down again under fdb_lock. Static entries and
+                 * entries moved within the hold-down are not moved, and
+                 * the frame is dropped. snode is read without the sequence
+                 * counter, which is fine for this hint.
+                 */
+                if ((snode->state & NODE_STATIC) || NODE_HELD(br, snode)) {
+                    STAT_INC(port, BRDG_STAT_DROP_SRC);
+                    BRDG_TRACE3(drop, brdg_port_t *, port, void *, bf->bf_frame,
+                        int, BRDG_STAT_DROP_SRC);
+                    br->ops.bo_free(bf->bf_frame);
+                    continue;
+                }
+                if (brdg_fdb_learn(br, shost, vid[i], port) != 0 &&
+                    port->limit_action != BRDG_LIMIT_STOP) {
+                    BRDG_TRACE3(drop, brdg_port_t *, port, void *, bf->bf_frame,
+                        int, BRDG_STAT_LIMIT);
+                    br->ops.bo_free(bf->bf_frame);
+                    continue;
+                }
+            } else if (snode->last_seen != br->clock) {
+                /*
+                 * Refresh the entry. The entry is written at most once a second.
+                 */
+                snode->last_seen = br->clock;
+            }
+
+            if (dhost->ether_addr_octet[0] & 0x01) {
+                storm = (bcmp(dhost, brdg_broadcast, ETHERADDRL) == 0) ?
+                    BRDG_STORM_BCAST : BRDG_STORM_MCAST;
+                if ((port->storm_on & (1 << storm)) &&
+                    brdg_storm_police(br, port, storm, bf->bf_size)) {
+                    STAT_INC(port, BRDG_STAT_DROP_BCAST + storm);
+                    BRDG_TRACE3(drop, brdg_port_t *, port, void *, bf->bf_frame,
+                        int, BRDG_STAT_DROP_BCAST + storm);
+                    br->ops.bo_free(bf->bf_frame);
+                    continue;
+                }
+                if (br->mcast_table != NULL) {
+                    /*
+                     * Sent to members of the group by IGMP/MLD snooping.
+                     */
+                    brdg_xmit_pending(br, pport, pframe, ptag, pvid, npending);
+                    npending = 0;
+                    brdg_mcast_input(br, port, bf, vid[i], tag[i]);
+                    continue;
+                }
+            }
+
+            dport = brdg_fdb_lookup(br, dbucket[i], dhost, vid[i], NULL);
+            if (dport == NULL) {
+                /*
+                 * Destination ethernet address is not registered yet.
+                 * Pending frames are sent first to keep the order of frames.
+                 */
+                if ((port->storm_on & (1 << BRDG_STORM_UNKNOWN)) &&
+                    (dhost->ether_addr_octet[0] & 0x01) == 0 &&
+                    brdg_storm_police(br, port, BRDG_STORM_UNKNOWN, bf->bf_size)) {
+                    STAT_INC(port, BRDG_STAT_DROP_UNKNOWN);
+                    BRDG_TRACE3(drop, brdg_port_t *, port, void *, bf->bf_frame,
+                        int, BRDG_STAT_DROP_UNKNOWN);
+                    br->ops.bo_free(bf->bf_frame);
+                    continue;
+                }
+                brdg_xmit_pending(br, pport, pframe, ptag, pvid, npending);
+                npending = 0;
+                STAT_INC(port, BRDG_STAT_FLOOD);
+                BRDG_TRACE2(flood, brdg_port_t *, port, void *, bf->bf_frame);
+                brdg_flood(br, port, bf->bf_frame, vid[i], tag[i], MCAST_ALL);
+            } else if (PORT_BLOCKED(dport)) {
+                STAT_INC(port, BRDG_STAT_DROP_BLOCKED);
+                BRDG_TRACE3(drop, brdg_port_t *, port, void *, bf->bf_frame,
+                    int, BRDG_STAT_DROP_BLOCKED);
+                br->ops.bo_free(bf->bf_frame);
+            } else if (dport == port) {
+                /* Not need to forward */
+                STAT_INC(port, BRDG_STAT_FILTER);
+                BRDG_TRACE3(drop, brdg_port_t *, port, void *, bf->bf_frame,
+                    int, BRDG_STAT_FILTER);
+                br->ops.bo_free(bf->bf_frame);
+            } else {
+                STAT_INC(port, BRDG_STAT_FORWARD);
+                BRDG_TRACE3(forward, brdg_port_t *, port, brdg_port_t *, dport,
+                    void *, bf->bf_frame);
+                pport[npending] = dport;
+                ptag[npending] = tag[i];
+                pvid[npending] = vid[i];
+                pframe[npending++] = bf->bf_frame;
+            }
+        }
+        brdg_xmit_pending(br, pport, pframe, ptag, pvid, npending);
+    }
+}
+
+/**********************************************************************
+ * brdg_input_blocked()
+ *
+ * Receive frames on a port which is blocked. Frames are dropped and
+ * counted in BRDG_STAT_DROP_BLOCKED, except BPDUs which are queued for
+ * RSTP unless the port is blocked by loop detection, its link is down or
+ * it is shut down by the MAC limit. (BLOCK_DOWN) Source addresses of
+ * frames are learned within the MAC limit if the port is learning by RSTP.
+ *
+ *  Arguments:
+ *           br     :  bridge
+ *           port   :  port where the frames were received
+ *           frames :  frames. All frames are consumed by this function
+ *           count  :  number of frames. Up to BRDG_BATCH
+ ***********************************************************************/
+static void
+brdg_input_blocked(brdg_t *br, brdg_port_t *port, brdg_frame_t *frames,
+    uint32_t count)
+{
+    const struct ether_addr *shost;
+    const uint8_t *hdr;
+    uint32_t     blocked = port->blocked;
+    uint32_t     reason;
+    uint16_t     vid;
+    uint32_t     i;
+
+    for (i = 0; i < count; i++) {
+        hdr = frames[i].bf_hdr;
+        reason = BRDG_STAT_DROP_BLOCKED;
+        if ((blocked & BLOCK_DOWN) || port->loop_probe) {
+            /* Nothing is learned nor forwarded while the port is in a loop */
+        } else if (br->stp_on && BPDU_MATCH(hdr, frames[i].bf_len)) {
+            brdg_bpdu_queue(br, port, hdr, frames[i].bf_len);
+            reason = BRDG_STAT_BPDU;
+        } else if (blocked == BLOCK_LEARN && frames[i].bf_len >= 2 * ETHERADDRL + 4 &&
+            (hdr[ETHERADDRL] & 0x01) == 0) {
+            if (hdr[12] == (BRDG_VLAN_TPID >> 8) && hdr[13] == (BRDG_VLAN_TPID & 0xff) &&
+                BRDG_VLAN_VID((hdr[14] << 8) | hdr[15]) != 0)
+                vid = BRDG_VLAN_VID((hdr[14] << 8) | hdr[15]);
+            else
+                vid = port->pvid;
+            shost = (const struct ether_addr *)&hdr[ETHERADDRL];
+            if (VLAN_MEMBER(port, vid) &&
+                brdg_fdb_lookup(br, FDB_BUCKET(br, shost, vid), shost, vid, NULL) != port)
+                (void) brdg_fdb_learn(br, shost, vid, port);
+        }
+        STAT_INC(port, reason);
+        BRDG_TRACE3(drop, brdg_port_t *, port, void *, frames[i].bf_frame, int, reason);
+        br->ops.bo_free(frames[i].bf_frame);
+    }
+}
+
+/**********************************************************************
+ * brdg_xmit_pending()
+ *
+ * Send pending frames of brdg_input_batch(), grouping frames to the
+ * same port so that they are passed to bo_xmit_chain() at once.
+ * The order of frames to each port is kept.
+ *
+ *  Arguments:
+ *           br     :  bridge
+ *           pport  :  egress port of each frame. Cleared by this function
+ *           pframe :  frames
+ *           ptag   :  802.1Q tag of each frame as received
+ *           pvid   :  VLAN of each frame
+ *           count  :  number of frames
+ ***********************************************************************/
+static void
+brdg_xmit_pending(brdg_t *br, brdg_port_t **pport, void **pframe,
+    uint32_t *ptag, uint16_t *pvid, uint32_t count)
+{
+    brdg_port_t *port;
+    void        *chain[BRDG_BATCH];
+    void        *frame;
+    uint32_t    n;
+    uint32_t    i, j;
+
+    for (i = 0; i < count; i++) {
+        if ((port = pport[i]) == NULL)
+            continue;
+        if (!br->ops.bo_canput(port->cookie)) {
+            for (j = i; j < count; j++) {
+                if (pport[j] != port)
+                    continue;
+                pport[j] = NULL;
+                STAT_INC(port, BRDG_STAT_DROP_FULL);
+                BRDG_TRACE3(drop, brdg_port_t *, port, void *, pframe[j],
+                    int, BRDG_STAT_DROP_FULL);
+                br->ops.bo_free(pframe[j]);
+            }
+            continue;
+        }
+        n = 0;
+        for (j = i; j < count; j++) {
+            if (pport[j] != port)
+                continue;
+            pport[j] = NULL;
+            if ((frame = brdg_retag(br, port, pframe[j], pvid[j], ptag[j])) != NULL)
+                chain[n++] = frame;
+        }
+        if (n == 0)
+            continue;
+        STAT_ADD(port, BRDG_STAT_TX, n);
+        if (br->ops.bo_xmit_chain != NULL) {
+            br->ops.bo_xmit_chain(port->cookie, chain, n);
+        } else {
+            for (j = 0; j < n; j++)
+                br->ops.bo_xmit(port->cookie, chain[j]);
+        }
+    }
+}
+
+/**********************************************************************
+ * brdg_retag()
+ *
+ * Change the 802.1Q tag of the frame for the egress port, if the tag
+ * of the received frame is not the one of the port. If the tag can not
+ * be changed, the frame is dropped and counted in BRDG_STAT_DROP_NOMEM.
+ *
+ *  Arguments:
+ *           br    :  bridge
+ *           port  :  egress port
+ *           frame :  frame. Consumed if the tag is changed or dropped
+ *           vid   :  VLAN of the frame
+ *           tag   :  802.1Q tag of the frame as received
+ *  Return:
+ *           frame to be sent to the port, or NULL if dropped
+ ***********************************************************************/
+static void *
+brdg_retag(brdg_t *br, brdg_port_t *port, void *frame, uint16_t vid, uint32_t tag)
+{
+    uint32_t etag = VLAN_EGRESS_TAG(port, vid, tag);
+    void     *nframe;
+
+    if (etag == tag)
+        return(frame);
+    if (br->ops.bo_retag != NULL) {
+        if ((nframe = br->ops.bo_retag(frame, tag, etag)) != NULL)
+            return(nframe);
+    } else
+        br->ops.bo_free(frame);
+    STAT_INC(port, BRDG_STAT_DROP_NOMEM);
+    BRDG_TRACE3(drop, brdg_port_t *, port, void *, frame,
+        int, BRDG_STAT_DROP_NOMEM);
+    return(NULL);
+}
+
+/**********************************************************************
+ * brdg_flood()
+ *
+ * Put the frame to active ports in the bitmap which are members of the
+ * VLAN, except the ingress port. Ports which are not tracked by the
+ * bitmap (index BRDG_MCAST_PORTS or more) are always included. Only the
+ * ports in the bitmap are visited, unless it is MCAST_ALL.
+ *
+ * A port is sent a duplicate only when a next port which can accept the
+ * frame is found, so the frame is duplicated only for the ports it is
+ * really sent to, and the original frame is handed to the last one of
+ * them instead of being duplicated and freed. If a duplicate can not be
+ * allocated the port is skipped and counted in BRDG_STAT_DROP_NOMEM.
+ *
+ *  Arguments:
+ *           br     :  bridge
+ *           inport :  ingress port
+ *           frame  :  frame. Consumed by this function
+ *           vid    :  VLAN of the frame
+ *           tag    :  802.1Q tag of the frame as received
+ *           mask   :  bitmap of ports by index, or MCAST_ALL
+ ***********************************************************************/
+static void
+brdg_flood(brdg_t *br, brdg_port_t *inport, void *frame, uint16_t vid,
+    uint32_t tag, uint64_t mask)
+{
+    brdg_portset_t *ps;
+    brdg_port_t *port;
+    brdg_port_t *pending = NULL; /* port to be sent to, waiting for next one */
+    uint32_t    count;
+    uint32_t    i;
+    void        *dp;             /* duplicate frame */
+
+    ps = br->ports;
+    BRDG_MEMBAR_CONSUMER();
+    count = ps->ps_count;
+    for (i = 0; i < count; i++) {
+        if (mask != MCAST_ALL && i < BRDG_MCAST_PORTS) {
+            /* Skip to the next port in the bitmap */
+            if ((mask >> i) == 0) {
+                i = BRDG_MCAST_PORTS - 1;
+                continue;
+            }
+            i += brdg_ctz64(mask >> i);
+            if (i >= count)
+                break;
+        }
+        port = ps->ps_port[i];
+        if (port == inport || !VLAN_MEMBER(port, vid) || PORT_BLOCKED(port))
+            continue;
+        if (!br->ops.bo_canput(port->cookie)) {
+            STAT_INC(port, BRDG_STAT_DROP_FULL);
+            BRDG_TRACE3(drop, brdg_port_t *, port, void *, frame,
+                int, BRDG_STAT_DROP_FULL);
+            continue;
+        }
+        if (pending != NULL) {
+            if ((dp = br->ops.bo_dup(frame)) == NULL) {
+                STAT_INC(pending, BRDG_STAT_DROP_NOMEM);
+                BRDG_TRACE3(drop, brdg_port_t *, pending, void *, frame,
+                    int, BRDG_STAT_DROP_NOMEM);
+            } else if ((dp = brdg_retag(br, pending, dp, vid, tag)) != NULL) {
+                STAT_INC(pending, BRDG_STAT_TX);
+                br->ops.bo_xmit(pending->cookie, dp);
+            }
+        }
+        pending = port;
+    }
+    if (pending == NULL)
+        br->ops.bo_free(frame);
+    else if ((frame = brdg_retag(br, pending, frame, vid, tag)) != NULL) {
+        STAT_INC(pending, BRDG_STAT_TX);
+        br->ops.bo_xmit(pending->cookie, frame);
+    }
+}
+
+/*****************************************************************************
+ * brdg_fdb_lookup()
+ *
+ * Search the forwarding database for the ethernet address in the VLAN.
+ *
+ * This is called from the data path without any lock. Writers of the
+ * bucket make 'seq' odd while they are updating it, so the reader
+ * retries if 'seq' was odd or changed while it was reading the bucket.
+ * After FDB_READ_RETRY retries the bucket is read holding fdb_lock, since
+ * the writer may have been preempted by this thread, e.g. by an interrupt
+ * on its CPU, and would never finish the update while this thread spins.
+ * Stale nodes (see fdb_slot_t) are not registered.
+ *
+ *  Arguments:
+ *             br :  bridge
+ *         bucket :  bucket of the ethernet address. (FDB_BUCKET())
+ *           addr :  ethernet address
+ *            vid :  VLAN ID
+ *          nodep :  if not NULL, node structure of the address is set.
+ *                   Only last_seen of the node may be written by the caller.
+ *  Return:
+ *           port where the address is registered, or NULL if not registered
+ *****************************************************************************/
+static brdg_port_t *
+brdg_fdb_lookup(brdg_t *br, fdb_bucket_t *bucket, const struct ether_addr *addr,
+    uint16_t vid, node_t **nodep)
+{
+    node_t        *node;
+    node_t        *found;
+    brdg_port_t   *port;
+    uint32_t      seq;
+    uint32_t      way;
+    uint32_t      retry;
+
+    for (retry = 0; ; retry++) {
+        if (retry == FDB_READ_RETRY) {
+            BRDG_LOCK(&br->fdb_lock);
+            found = brdg_fdb_find(br, bucket, addr, vid);
+            port = (found != NULL) ? brdg_node_port(br, found) : NULL;
+            BRDG_UNLOCK(&br->fdb_lock);
+            break;
+        }
+        if ((seq = bucket->seq) & 1) {
+            BRDG_PAUSE();
+            continue;
+        }
+        BRDG_MEMBAR_CONSUMER();
+        found = NULL;
+        port = NULL;
+        for (way = 0; way < BRDG_FDB_WAYS; way++) {
+            node = &bucket->node[way];
+            if (NODE_MATCH(node, addr, vid) &&
+                (port = brdg_node_port(br, node)) != NULL) {
+                found = node;
+                break;
+            }
+        }
+        BRDG_MEMBAR_CONSUMER();
+        if (seq == bucket->seq)
+            break;
+    }
+
+    if (nodep != NULL)
+        *nodep = found;
+    return(port);
+}
+
+/*****************************************************************************
+ * brdg_node_port()
+ *
+ * Return the port of the valid node structure, or NULL if the node is
+ * stale. (See fdb_slot_t) The port is read before the generation, so
+ * the port of a reused slot is never returned for a node of the previous
+ * port of the slot.
+ *****************************************************************************/
+static brdg_port_t *
+brdg_node_port(brdg_t *br, const node_t *node)
+{
+    fdb_slot_t    *slot = &br->slots[node->slot];
+    brdg_port_t   *port;
+
+    port = slot->port;
+    BRDG_MEMBAR_CONSUMER();
+    if (node->gen != ((node->state & NODE_STATIC) ? slot->sgen : slot->gen))
+        return(NULL);
+    return(port);
+}
+
+/*****************************************************************************
+ * brdg_fdb_learn()
+ *
+ * Queue the source address to be registered by brdg_learn_run().
+ * Requests for the same address are coalesced. If the queue is full the
+ * request is dropped, and it will be requested again by the next frame
+ * from the address.
+ * The MAC limit of the port is checked only when a request for the address
+ * on the port is newly queued, so that a burst of frames from one new
+ * address takes one token of the learn rate.
+ *
+ *  Return:
+ *           1 if the address is over the MAC limit, otherwise 0
+ *****************************************************************************/
+static int
+brdg_fdb_learn(brdg_t *br, const struct ether_addr *addr, uint16_t vid,
+    brdg_port_t *port)
+{
+    uint32_t  i;
+
+    BRDG_LOCK(&br->learn_lock);
+    for (i = 0; i < br->learn_count; i++) {
+        if (br->learn_queue[i].vid == vid &&
+            bcmp(addr, &br->learn_queue[i].ether_addr, ETHERADDRL) == 0)
+            break;
+    }
+    if (i < br->learn_count && br->learn_queue[i].port == port) {
+        /* Already queued */
+    } else if (i == BRDG_LEARN_MAX) {
+        /* The queue is full */
+    } else if (brdg_limit_police(br, port) != 0) {
+        BRDG_UNLOCK(&br->learn_lock);
+        return(1);
+    } else if (i < br->learn_count) {
+        br->learn_queue[i].port = port;
+    } else {
+        bcopy(addr, &br->learn_queue[i].ether_addr, ETHERADDRL);
+        br->learn_queue[i].vid = vid;
+        br->learn_queue[i].port = port;
+        br->learn_count++;
+    }
+    if (!br->learn_scheduled) {
+        if (br->ops.bo_schedule(br) == 0)
+            br->learn_scheduled = 1;
+    }
+    BRDG_UNLOCK(&br->learn_lock);
+    return(0);
+}
+
+/*****************************************************************************
+ * brdg_bpdu_queue()
+ *
+ * Queue the BPDU received on the port to be processed by brdg_learn_run().
+ * If the queue is full the BPDU is dropped. The sender sends it again
+ * within a hello time.
+ *
+ *  Arguments:
+ *           br   :  bridge
+ *           port :  port where the BPDU was received
+ *           hdr  :  frame. BPDU_MATCH() is true
+ *           len  :  length of contiguous data at hdr
+ *****************************************************************************/
+static void
+brdg_bpdu_queue(brdg_t *br, brdg_port_t *port, const uint8_t *hdr, size_t len)
+{
+    bpdu_t    *bp;
+
+    len -= BPDU_OFFSET;
+    BRDG_LOCK(&br->learn_lock);
+    if (br->bpdu_count < BRDG_BPDU_MAX) {
+        bp = &br->bpdu_queue[br->bpdu_count++];
+        bp->port = port;
+        bp->len = (len < STP_BPDU_LEN) ? (uint32_t)len : STP_BPDU_LEN;
+        bcopy(&hdr[BPDU_OFFSET], bp->data, bp->len);
+    }
+    if (!br->learn_scheduled) {
+        if (br->ops.bo_schedule(br) == 0)
+            br->learn_scheduled = 1;
+    }
+    BRDG_UNLOCK(&br->learn_lock);
+}
+
+/*****************************************************************************
+ * brdg_learn_run()
+ *
+ * Register all addresses queued by brdg_fdb_learn() at once, update the
+ * multicast group table by requests queued by brdg_snoop_queue(), and
+ * process BPDUs queued by brdg_bpdu_queue().
+ * Called by the caller after bo_schedule() was requested. Must not be
+ * called concurrently.
+ * The queue is taken while holding fdb_lock, so that brdg_port_remove()
+ * can remove requests for the removed port before they are registered.
+ *****************************************************************************/
+void
+brdg_learn_run(brdg_t *br)
+{
+    uint32_t  count;
+    uint32_t  scount;
+    uint32_t  bcount;
+    uint32_t  i;
+
+    BRDG_LOCK(&br->fdb_lock);
+    BRDG_LOCK(&br->learn_lock);
+    count = br->learn_count;
+    bcopy(br->learn_queue, br->learn_batch, sizeof(learn_t) * count);
+    br->learn_count = 0;
+    scount = br->snoop_count;
+    bcopy(br->snoop_queue, br->snoop_batch, sizeof(snoop_t) * scount);
+    br->snoop_count = 0;
+    bcount = br->bpdu_count;
+    bcopy(br->bpdu_queue, br->bpdu_batch, sizeof(bpdu_t) * bcount);
+    br->bpdu_count = 0;
+    br->learn_scheduled = 0;
+    BRDG_UNLOCK(&br->learn_lock);
+
+    for (i = 0; i < count; i++) {
+        /* The port was blocked, and its addresses deleted, since queued */
+        if ((br->learn_batch[i].port->blocked & ~BLOCK_LEARN) != 0)
+            continue;
+        brdg_fdb_insert(br, &br->learn_batch[i].ether_addr,
+            br->learn_batch[i].vid, br->learn_batch[i].port);
+    }
+    for (i = 0; i < scount; i++)
+        brdg_mcast_update(br, &br->snoop_batch[i]);
+    for (i = 0; i < bcount; i++)
+        brdg_stp_input(&br->stp, &br->bpdu_batch[i].port->stp,
+            br->bpdu_batch[i].data, br->bpdu_batch[i].len);
+    brdg_unlock_xmit(br);
+}
+
+/*****************************************************************************
+ * brdg_fdb_insert()
+ *
+ * Register the ethernet address in the VLAN in the forwarding database.
+ * Static entries are never changed. If all entries of the bucket are
+ * static, the address is not registered.
+ * If the address is registered on another port, the entry is moved to
+ * this port unless it was moved within bc_move_holddown seconds.
+ * The MAC limit of the port is checked again, since requests queued
+ * before the limit was reached may exceed it.
+ * fdb_lock must be held by the caller.
+ *****************************************************************************/
+static void
+brdg_fdb_insert(brdg_t *br, const struct ether_addr *addr, uint16_t vid,
+    brdg_port_t *port)
+{
+    fdb_bucket_t  *bucket;   /* bucket of the forwarding database */
+    node_t        *node;     /* node structure */
+    brdg_port_t   *oldport;  /* port where the address is registered */
+    uint32_t      now = br->clock;
+
+    bucket = FDB_BUCKET(br, addr, vid);
+    /*
+     * Use the entry of the address if it is already registered, or an
+     * empty entry of the bucket if any. Otherwise replace the dynamic
+     * entry which has not been seen for the longest time.
+     */
+    node = brdg_fdb_find(br, bucket, addr, vid);
+    if (node != NULL && (node->state & NODE_STATIC))
+        return;
+    oldport = (node != NULL) ? brdg_node_port(br, node) : NULL;
+    if (oldport == port) {
+        node->last_seen = now;
+        return;
+    }
+    if (port->limit_max != 0 && port->learned >= port->limit_max)
+        return;
+    if (node != NULL) {
+        /*
+         * Station move
+         */
+        if (NODE_HELD(br, node))
+            return;
+        STAT_INC(port, BRDG_STAT_MOVE);
+        BRDG_TRACE3(move, brdg_port_t *, port, const struct ether_addr *, addr,
+            brdg_port_t *, oldport);
+        if ((node->state & NODE_MOVED) && (uint16_t)(now - node->moved) <
+            br->conf.bc_move_holddown + LOOP_FLAP_WINDOW) {
+            /* Counted by brdg_loop_check() */
+            port->loop_flaps++;
+            port->loop_peer = oldport->index;
+            bcopy(addr, &port->loop_addr, ETHERADDRL);
+        }
+        FDB_WRITE_BEGIN(bucket);
+        node->slot = port->slot;
+        node->gen = br->slots[port->slot].gen;
+        node->last_seen = now;
+        node->moved = (uint16_t)now;
+        node->state |= NODE_MOVED;
+        FDB_WRITE_END(bucket);
+        oldport->learned--;
+        port->learned++;
+        return;
+    }
+
+    if ((node = brdg_fdb_victim(br, bucket, now)) == NULL)
+        return;    /* All entries are static */
+    if ((node->state & NODE_VALID) && (oldport = brdg_node_port(br, node)) != NULL) {
+        STAT_INC(oldport, BRDG_STAT_EVICT);
+        BRDG_TRACE3(evict, brdg_port_t *, oldport,
+            struct ether_addr *, &node->ether_addr,
+            const struct ether_addr *, addr);
+        oldport->learned--;
+    }
+    STAT_INC(port, BRDG_STAT_LEARN);
+    BRDG_TRACE2(learn, brdg_port_t *, port, const struct ether_addr *, addr);
+    FDB_WRITE_BEGIN(bucket);
+    bcopy(addr, &node->ether_addr, ETHERADDRL);
+    node->vid = vid;
+    node->slot = port->slot;
+    node->gen = br->slots[port->slot].gen;
+    node->last_seen = now;
+    node->state = NODE_VALID;
+    FDB_WRITE_END(bucket);
+    port->learned++;
+}
+
+/*****************************************************************************
+ * brdg_fdb_find()
+ *
+ * Return the node structure of the address in the VLAN in the bucket,
+ * or NULL. Stale nodes are ignored. fdb_lock must be held by the caller.
+ *****************************************************************************/
+static node_t *
+brdg_fdb_find(brdg_t *br, fdb_bucket_t *bucket, const struct ether_addr *addr,
+    uint16_t vid)
+{
+    uint32_t  way;
+
+    for (way = 0; way < BRDG_FDB_WAYS; way++) {
+        if (NODE_MATCH(&bucket->node[way], addr, vid) &&
+            brdg_node_port(br, &bucket->node[way]) != NULL)
+            return(&bucket->node[way]);
+    }
+    return(NULL);
+}
+
+/*****************************************************************************
+ * brdg_fdb_victim()
+ *
+ * Return an empty or stale node structure of the bucket if any. Otherwise
+ * return the dynamic entry which has not been seen for the longest time,
+ * or NULL if all entries are static.
+ * fdb_lock must be held by the caller.
+ *****************************************************************************/
+static node_t *
+brdg_fdb_victim(brdg_t *br, fdb_bucket_t *bucket, uint32_t now)
+{
+    node_t    *node = NULL;
+    uint32_t  way;
+
+    for (way = 0; way < BRDG_FDB_WAYS; way++) {
+        if ((bucket->node[way].state & NODE_VALID) == 0 ||
+            brdg_node_port(br, &bucket->node[way]) == NULL)
+            return(&bucket->node[way]);
+        if (bucket->node[way].state & NODE_STATIC)
+            continue;
+        if (node == NULL || now - bucket->node[way].last_seen > now - node->last_seen)
+            node = &bucket->node[way];
+    }
+    return(node);
+}
+
+/*****************************************************************************
+ * brdg_fdb_add_static()
+ *
+ * Register the ethernet address in the VLAN on the port as a static entry.
+ * A static entry is never aged out, replaced by other addresses or moved to
+ * another port by learning, so frames to the address are always forwarded
+ * without flooding. It is deleted by brdg_fdb_delete() or when the port is
+ * removed. If the address is already registered, the entry is changed to
+ * a static entry on the port.
+ *
+ *  Arguments:
+ *           br   :  bridge
+ *           addr :  ethernet address. Must not be a multicast address
+ *           vid  :  VLAN ID
+ *           port :  port
+ *  Return:
+ *           0 on success, -1 if all entries of the bucket are static
+ *****************************************************************************/
+int
+brdg_fdb_add_static(brdg_t *br, const struct ether_addr *addr, uint16_t vid,
+    brdg_port_t *port)
+{
+    fdb_bucket_t  *bucket;
+    node_t        *node;
+    brdg_port_t   *oldport;
+    uint32_t      now = br->clock;
+
+    BRDG_LOCK(&br->fdb_lock);
+    bucket = FDB_BUCKET(br, addr, vid);
+    if ((node = brdg_fdb_find(br, bucket, addr, vid)) == NULL) {
+        if ((node = brdg_fdb_victim(br, bucket, now)) == NULL) {
+            BRDG_UNLOCK(&br->fdb_lock);
+            return(-1);
+        }
+        if ((node->state & NODE_VALID) && (oldport = brdg_node_port(br, node)) != NULL) {
+            STAT_INC(oldport, BRDG_STAT_EVICT);
+            BRDG_TRACE3(evict, brdg_port_t *, oldport,
+                struct ether_addr *, &node->ether_addr,
+                const struct ether_addr *, addr);
+            oldport->learned--;
+        }
+    } else if ((node->state & NODE_STATIC) == 0) {
+        brdg_node_port(br, node)->learned--;
+    }
+    FDB_WRITE_BEGIN(bucket);
+    bcopy(addr, &node->ether_addr, ETHERADDRL);
+    node->vid = vid;
+    node->slot = port->slot;
+    node->gen = br->slots[port->slot].sgen;
+    node->last_seen = now;
+    node->state = NODE_VALID | NODE_STATIC;
+    FDB_WRITE_END(bucket);
+    BRDG_UNLOCK(&br->fdb_lock);
+    return(0);
+}
+
+/*****************************************************************************
+ * brdg_fdb_delete()
+ *
+ * Delete the ethernet address in the VLAN from the forwarding database.
+ * Static entries are deleted as well as dynamic entries.
+ *
+ *  Arguments:
+ *           br   :  bridge
+ *           addr :  ethernet address
+ *           vid  :  VLAN ID
+ *  Return:
+ *           0 on success, -1 if the address is not registered
+ *****************************************************************************/
+int
+brdg_fdb_delete(brdg_t *br, const struct ether_addr *addr, uint16_t vid)
+{
+    fdb_bucket_t  *bucket;
+    node_t        *node;
+
+    BRDG_LOCK(&br->fdb_lock);
+    bucket = FDB_BUCKET(br, addr, vid);
+    if ((node = brdg_fdb_find(br, bucket, addr, vid)) == NULL) {
+        BRDG_UNLOCK(&br->fdb_lock);
+        return(-1);
+    }
+    if ((node->state & NODE_STATIC) == 0)
+        brdg_node_port(br, node)->learned--;
+    FDB_WRITE_BEGIN(bucket);
+    node->state = 0;
+    FDB_WRITE_END(bucket);
+    BRDG_UNLOCK(&br->fdb_lock);
+    return(0);
+}
+
+/*****************************************************************************
+ * brdg_fdb_flush()
+ *
+ * Delete dynamic entries of the port, or of all ports but the port and
+ * edge ports of RSTP if 'others'. The entries are deleted by bumping the
+ * generation of dynamic entries of the slots. (See fdb_slot_t)
+ * fdb_lock must be held by the caller.
+ *****************************************************************************/
+static void
+brdg_fdb_flush(brdg_t *br, brdg_port_t *port, int others)
+{
+    brdg_portset_t *ps = br->ports;
+    brdg_port_t  *p;
+    uint32_t     i;
+
+    BRDG_TRACE2(flush, brdg_port_t *, port, int, others);
+    if (!others) {
+        br->slots[port->slot].gen++;
+        port->learned = 0;
+        return;
+    }
+    for (i = 0; i < ps->ps_count; i++) {
+        p = ps->ps_port[i];
+        if (p != port && !p->stp.oper_edge) {
+            br->slots[p->slot].gen++;
+            p->learned = 0;
+        }
+    }
+}
+
+/*****************************************************************************
+ * brdg_tick()
+ *
+ * Advance the clock of the bridge, and remove stale nodes (see fdb_slot_t)
+ * and the addresses which have not been seen for bc_fdb_aging seconds from
+ * next bc_sweep_buckets buckets. Ports which went over the MAC limit with
+ * BRDG_LIMIT_SHUTDOWN are shut down.
+ * Memberships of multicast groups and router ports are expired, loops
+ * are checked (brdg_loop_check()) and timers of RSTP are advanced once a
+ * second. Called periodically by the caller.
+ *
+ * The clock in milliseconds is used by storm control, and the interval of
+ * calls should be shorter than bc_storm_burst.
+ *
+ *  Arguments:
+ *           br   :  bridge
+ *           msec :  current time in milliseconds
+ *****************************************************************************/
+void
+brdg_tick(brdg_t *br, uint64_t msec)
+{
+    fdb_bucket_t *bucket;
+    node_t       *node;
+    brdg_port_t  *port;
+    brdg_portset_t *ps;
+    uint32_t     now = (uint32_t)(msec / 1000);
+    uint32_t     count;
+    uint32_t     way;
+    uint32_t     i;
+    int          second;
+
+    br->msclock = (uint32_t)msec;
+    BRDG_LOCK(&br->fdb_lock);
+    second = (now != br->clock);
+    if (br->mcast_table != NULL && second)
+        brdg_mcast_age(br, now);
+    br->clock = now;
+    if (second)
+        brdg_loop_check(br, now);
+    if (second && br->stp_on)
+        brdg_stp_tick(&br->stp);
+    ps = br->ports;
+    for (i = 0; i < ps->ps_count; i++) {
+        port = ps->ps_port[i];
+        if (port->limit_shut && (port->blocked & BLOCK_LIMIT) == 0)
+            brdg_limit_shutdown(br, port);
+    }
+
+    for (count = 0; count < br->conf.bc_sweep_buckets &&
+             count < br->fdb_nbucket; count++) {
+        bucket = &br->fdb_table[br->sweep_next];
+        for (way = 0; way < BRDG_FDB_WAYS; way++) {
+            node = &bucket->node[way];
+            if ((node->state & NODE_VALID) == 0)
+                continue;
+            if ((port = brdg_node_port(br, node)) == NULL) {
+                /* The port was removed or flushed */
+                FDB_WRITE_BEGIN(bucket);
+                node->state &= ~NODE_VALID;
+                FDB_WRITE_END(bucket);
+            } else if ((node->state & NODE_STATIC) == 0 &&
+                br->conf.bc_fdb_aging != 0 &&
+                now - node->last_seen >= br->conf.bc_fdb_aging) {
+                STAT_INC(port, BRDG_STAT_AGED);
+                BRDG_TRACE2(age, brdg_port_t *, port,
+                    struct ether_addr *, &node->ether_addr);
+                FDB_WRITE_BEGIN(bucket);
+                node->state &= ~NODE_VALID;
+                FDB_WRITE_END(bucket);
+                port->learned--;
+            }
+        }
+        br->sweep_next = (br->sweep_next + 1) & (br->fdb_nbucket - 1);
+    }
+    brdg_unlock_xmit(br);
+}
+
+/*****************************************************************************
+ * brdg_loop_check()
+ *
+ * Detect loops and block the ports in them. Called by brdg_tick() once a
+ * second.
+ *
+ * A move of an address which was moved shortly before is a flap. (See
+ * LOOP_FLAP_WINDOW) In a loop, frames of every host come back on ports
+ * other than the one the host is on, and addresses are moved back and
+ * forth every time their hold-down expires, while a host which really
+ * moved, e.g. a migrated virtual machine, is moved only once however many
+ * frames it sent before brdg_learn_run() moved it. The port which had the
+ * most flaps in the last second, and at least bc_loop_flaps, is blocked.
+ * Only one port is blocked at a time, since the flaps on the other ports
+ * of the loop stop when the loop is broken.
+ * A port whose probe came back (see brdg_loop_probe()) is blocked as well.
+ *
+ * A blocked port is unblocked after bc_loop_block seconds, which is
+ * doubled for each detection of the port up to LOOP_BACKOFF times, until
+ * the port has no detection for the longest block time.
+ * fdb_lock must be held by the caller.
+ *
+ *  Arguments:
+ *           br   :  bridge
+ *           now  :  clock
+ *****************************************************************************/
+static void
+brdg_loop_check(brdg_t *br, uint32_t now)
+{
+    brdg_portset_t *ps = br->ports;
+    brdg_port_t  *port;
+    brdg_port_t  *worst = NULL;  /* port of the most flaps */
+    uint32_t     wflaps = 0;
+    uint32_t     flaps;
+    uint32_t     probe;
+    uint32_t     i;
+
+    for (i = 0; i < ps->ps_count; i++) {
+        port = ps->ps_port[i];
+        flaps = port->loop_flaps - port->loop_flaps_last;
+        port->loop_flaps_last = port->loop_flaps;
+        if ((probe = port->loop_probe) != 0) {
+            brdg_loop_block(br, port, (probe - 1 < ps->ps_count) ?
+                ps->ps_port[probe - 1] : NULL, BRDG_LOOP_PROBE, flaps, now);
+            port->loop_probe = 0;
+            continue;
+        }
+        if (port->blocked & BLOCK_LOOP) {
+            if ((int32_t)(now - port->loop_until) >= 0) {
+                BRDG_TRACE2(unblock, brdg_port_t *, port, int, BLOCK_LOOP);
+                port->blocked &= ~BLOCK_LOOP;
+            }
+            continue;
+        }
+        if (port->loop_count != 0 &&
+            now - port->loop_until >= (br->conf.bc_loop_block << LOOP_BACKOFF))
+            port->loop_count = 0;
+        if (br->conf.bc_loop_flaps != 0 && flaps >= br->conf.bc_loop_flaps &&
+            flaps > wflaps) {
+            worst = port;
+            wflaps = flaps;
+        }
+    }
+    if (worst != NULL) {
+        brdg_loop_block(br, worst, (worst->loop_peer < ps->ps_count) ?
+            ps->ps_port[worst->loop_peer] : NULL, BRDG_LOOP_FLAP, wflaps, now);
+    }
+
+    if (br->conf.bc_loop_probe != 0 && br->ops.bo_alloc != NULL &&
+        (int32_t)(now - br->probe_next) >= 0) {
+        brdg_loop_probe(br);
+        br->probe_next = now + br->conf.bc_loop_probe;
+    }
+}
+
+/*****************************************************************************
+ * brdg_loop_block()
+ *
+ * Block the port in a loop, and record the detection. Dynamic addresses
+ * of the port are deleted, so that frames to them are flooded to the
+ * other path instead of being dropped.
+ * fdb_lock must be held by the caller.
+ *
+ *  Arguments:
+ *           br     :  bridge
+ *           port   :  port to be blocked
+ *           peer   :  other port of the loop, or NULL if unknown
+ *           reason :  BRDG_LOOP_XXX
+ *           flaps  :  flaps in the last second
+ *           now    :  clock
+ *****************************************************************************/
+static void
+brdg_loop_block(brdg_t *br, brdg_port_t *port, brdg_port_t *peer,
+    uint32_t reason, uint32_t flaps, uint32_t now)
+{
+    loop_event_t *ev;
+    uint32_t     block;
+
+    block = br->conf.bc_loop_block <<
+        ((port->loop_count < LOOP_BACKOFF) ? port->loop_count : LOOP_BACKOFF);
+    port->loop_count++;
+    port->loop_until = now + block;
+    port->blocked |= BLOCK_LOOP;
+    BRDG_TRACE3(loop, brdg_port_t *, port, brdg_port_t *, peer, int, reason);
+
+    ev = &br->loop_event[br->loop_nevent++ % BRDG_LOOP_EVENTS];
+    ev->port = port;
+    ev->peer = peer;
+    if (reason == BRDG_LOOP_FLAP)
+        bcopy(&port->loop_addr, &ev->addr, ETHERADDRL);
+    else
+        bzero(&ev->addr, ETHERADDRL);
+    ev->reason = reason;
+    ev->flaps = flaps;
+    ev->time = now;
+    ev->block = block;
+    brdg_fdb_flush(br, port, 0);
+}
+
+/*****************************************************************************
+ * brdg_loop_probe()
+ *
+ * Send a probe to each port which is not blocked. (See LOOP_ETHERTYPE)
+ * Probes are queued by brdg_xmit_queue(), and sent by brdg_unlock_xmit()
+ * when brdg_tick() releases fdb_lock. fdb_lock must be held by the caller.
+ *****************************************************************************/
+static void
+brdg_loop_probe(brdg_t *br)
+{
+    brdg_portset_t *ps = br->ports;
+    brdg_port_t  *port;
+    uint8_t      probe[LOOP_PROBE_LEN];
+    void         *frame;
+    uint32_t     i;
+
+    bzero(probe, sizeof(probe));
+    bcopy(brdg_broadcast, &probe[0], ETHERADDRL);
+    bcopy(&br->addr, &probe[ETHERADDRL], ETHERADDRL);
+    probe[12] = LOOP_ETHERTYPE >> 8;
+    probe[13] = LOOP_ETHERTYPE & 0xff;
+    probe[16] = 1;      /* Function: reply, little endian */
+
+    for (i = 0; i < ps->ps_count; i++) {
+        port = ps->ps_port[i];
+        if (PORT_BLOCKED(port) || !br->ops.bo_canput(port->cookie))
+            continue;
+        probe[LOOP_PROBE_INDEX] = (uint8_t)(i >> 8);
+        probe[LOOP_PROBE_INDEX + 1] = (uint8_t)i;
+        if ((frame = br->ops.bo_alloc(probe, sizeof(probe))) == NULL)
+            break;
+        brdg_xmit_queue(br, port, frame);
+    }
+}
+
+/*****************************************************************************
+ * brdg_loop_read()
+ *
+ * Copy recent detections of loops, from the newest one.
+ *
+ *  Arguments:
+ *           br     :  bridge
+ *           events :  array of detections to be set
+ *           max    :  size of events
+ *  Return:
+ *           number of detections set to events
+ *****************************************************************************/
+uint32_t
+brdg_loop_read(brdg_t *br, brdg_loop_event_t *events, uint32_t max)
+{
+    loop_event_t *ev;
+    brdg_loop_event_t *bl;
+    uint32_t     count = 0;
+    uint32_t     i;
+
+    BRDG_LOCK(&br->fdb_lock);
+    for (i = 1; i <= BRDG_LOOP_EVENTS && i <= br->loop_nevent && count < max; i++) {
+        ev = &br->loop_event[(br->loop_nevent - i) % BRDG_LOOP_EVENTS];
+        if (ev->port == NULL)
+            continue;
+        bl = &events[count++];
+        bl->bl_cookie = ev->port->cookie;
+        bl->bl_peer = (ev->peer != NULL) ? ev->peer->cookie : NULL;
+        bcopy(&ev->addr, &bl->bl_addr, ETHERADDRL);
+        bl->bl_reason = ev->reason;
+        bl->bl_flaps = ev->flaps;
+        bl->bl_age = br->clock - ev->time;
+        bl->bl_block = ev->block;
+        bl->bl_remain = 0;
+        if ((ev->port->blocked & BLOCK_LOOP) &&
+            ev->port->loop_until == ev->time + ev->block)
+            bl->bl_remain = ev->port->loop_until - br->clock;
+    }
+    BRDG_UNLOCK(&br->fdb_lock);
+    return(count);
+}
+
+/*****************************************************************************
+ * brdg_stp_cb_state()
+ *
+ * so_state of RSTP. The state is cached in 'blocked' of the port, which is
+ * the only thing the data path reads.
+ *****************************************************************************/
+static void
+brdg_stp_cb_state(stp_t *stp, stp_port_t *sp, uint32_t state)
+{
+    brdg_port_t *port = sp->arg;
+    uint32_t    blocked = port->blocked & ~(BLOCK_STP | BLOCK_LEARN);
+
+    (void) stp;
+    if (state == BRDG_STP_DISCARDING)
+        blocked |= BLOCK_STP;
+    else if (state == BRDG_STP_LEARNING)
+        blocked |= BLOCK_LEARN;
+    port->blocked = blocked;
+    BRDG_TRACE2(stp, brdg_port_t *, port, int, state);
+}
+
+/*****************************************************************************
+ * brdg_stp_cb_flush()
+ *
+ * so_flush of RSTP.
+ *****************************************************************************/
+static void
+brdg_stp_cb_flush(stp_t *stp, stp_port_t *sp, int others)
+{
+    brdg_fdb_flush(stp->arg, sp->arg, others);
+}
+
+/*****************************************************************************
+ * brdg_xmit_queue()
+ *
+ * Queue the frame of the bridge to be sent to the port by
+ * brdg_unlock_xmit(), and hold the port. If the queue is full the frame is
+ * dropped; BPDUs are sent again within a hello time, and probes at the
+ * next interval.
+ * fdb_lock must be held by the caller.
+ *****************************************************************************/
+static void
+brdg_xmit_queue(brdg_t *br, brdg_port_t *port, void *frame)
+{
+    if (br->xmit_count == BRDG_XMIT_MAX) {
+        br->ops.bo_free(frame);
+        return;
+    }
+    br->xmit_queue[br->xmit_count].port = port;
+    br->xmit_queue[br->xmit_count].frame = frame;
+    br->xmit_count++;
+    port->hold++;
+}
+
+/*****************************************************************************
+ * brdg_unlock_xmit()
+ *
+ * Release fdb_lock, and send the frames queued by brdg_xmit_queue().
+ * Called instead of BRDG_UNLOCK(&br->fdb_lock) by the functions which may
+ * queue frames. Frames are sent without fdb_lock, and holds of the ports
+ * are released under fdb_lock after they are sent. Only one thread sends
+ * frames at a time, which also sends frames queued meanwhile by others,
+ * so that the order of frames to a port is kept.
+ * fdb_lock must be held by the caller.
+ *****************************************************************************/
+static void
+brdg_unlock_xmit(brdg_t *br)
+{
+    brdg_port_t *port;
+    uint32_t    count;
+    uint32_t    i;
+
+    if (br->xmit_busy) {
+        BRDG_UNLOCK(&br->fdb_lock);
+        return;
+    }
+    br->xmit_busy = 1;
+    while ((count = br->xmit_count) != 0) {
+        bcopy(br->xmit_queue, br->xmit_batch, sizeof(xmit_t) * count);
+        br->xmit_count = 0;
+        BRDG_UNLOCK(&br->fdb_lock);
+        for (i = 0; i < count; i++) {
+            port = br->xmit_batch[i].port;
+            STAT_INC(port, BRDG_STAT_TX);
+            br->ops.bo_xmit(port->cookie, br->xmit_batch[i].frame);
+        }
+        BRDG_LOCK(&br->fdb_lock);
+        for (i = 0; i < count; i++) {
+            if (--br->xmit_batch[i].port->hold == 0)
+                BRDG_CV_BROADCAST(&br->hold_cv);
+        }
+    }
+    br->xmit_busy = 0;
+    BRDG_UNLOCK(&br->fdb_lock);
+}
+
+/*****************************************************************************
+ * brdg_stp_cb_xmit()
+ *
+ * so_xmit of RSTP. Queue the BPDU to the port in an 802.3 frame, unless the
+ * port is blocked by BLOCK_DOWN. It is sent by brdg_unlock_xmit().
+ *****************************************************************************/
+static void
+brdg_stp_cb_xmit(stp_t *stp, stp_port_t *sp, const uint8_t *bpdu, size_t len)
+{
+    brdg_t      *br = stp->arg;
+    brdg_port_t *port = sp->arg;
+    uint8_t     buf[BPDU_FRAME_LEN];
+    void        *frame;
+
+    if ((port->blocked & BLOCK_DOWN) || port->loop_probe ||
+        !br->ops.bo_canput(port->cookie))
+        return;
+    bzero(buf, sizeof(buf));
+    bcopy(brdg_stp_group, &buf[0], ETHERADDRL);
+    bcopy(&br->addr, &buf[ETHERADDRL], ETHERADDRL);
+    buf[12] = (uint8_t)((len + 3) >> 8);      /* Length of 802.3 */
+    buf[13] = (uint8_t)(len + 3);
+    buf[14] = 0x42;
+    buf[15] = 0x42;
+    buf[16] = 0x03;
+    bcopy(bpdu, &buf[BPDU_OFFSET], len);
+    if ((frame = br->ops.bo_alloc(buf, sizeof(buf))) == NULL)
+        return;
+    brdg_xmit_queue(br, port, frame);
+}
+
+/*****************************************************************************
+ * brdg_stp_info()
+ *
+ * Get the root bridge and topology changes of RSTP.
+ *
+ *  Arguments:
+ *           br   :  bridge
+ *           info :  set by this function
+ *  Return:
+ *           0 on success, -1 if RSTP is disabled
+ *****************************************************************************/
+int
+brdg_stp_info(brdg_t *br, brdg_stp_info_t *info)
+{
+    if (!br->stp_on)
+        return(-1);
+    BRDG_LOCK(&br->fdb_lock);
+    info->bs_bridge = br->stp.bridge;
+    info->bs_root = br->stp.root.root;
+    info->bs_cost = br->stp.root.cost;
+    info->bs_root_port = (br->stp.root_port != NULL) ?
+        ((brdg_port_t *)br->stp.root_port->arg)->cookie : NULL;
+    info->bs_tc_count = br->stp.tc_count;
+    info->bs_tc_age = br->stp.clock - br->stp.tc_time;
+    BRDG_UNLOCK(&br->fdb_lock);
+    return(0);
+}
+
+/*****************************************************************************
+ * brdg_port_stp()
+ *
+ * Set the path cost, the port priority and the edge port of RSTP of the
+ * port. Only bp_cost, bp_priority and bp_edge are used.
+ *
+ *  Arguments:
+ *           br   :  bridge
+ *           port :  port
+ *           bp   :  configuration
+ *  Return:
+ *           0 on success, -1 if RSTP is disabled or the priority is invalid
+ *****************************************************************************/
+int
+brdg_port_stp(brdg_t *br, brdg_port_t *port, const brdg_stp_port_t *bp)
+{
+    if (!br->stp_on || (bp->bp_priority & ~0xf0) != 0)
+        return(-1);
+    BRDG_LOCK(&br->fdb_lock);
+    brdg_stp_port_config(&br->stp, &port->stp, bp->bp_cost, bp->bp_priority,
+        bp->bp_edge);
+    brdg_unlock_xmit(br);
+    return(0);
+}
+
+/*****************************************************************************
+ * brdg_port_stp_get()
+ *
+ * Get RSTP of the port.
+ *
+ *  Arguments:
+ *           br   :  bridge
+ *           port :  port
+ *           bp   :  set by this function
+ *  Return:
+ *           0 on success, -1 if RSTP is disabled
+ *****************************************************************************/
+int
+brdg_port_stp_get(brdg_t *br, brdg_port_t *port, brdg_stp_port_t *bp)
+{
+    stp_port_t *sp = &port->stp;
+
+    if (!br->stp_on)
+        return(-1);
+    BRDG_LOCK(&br->fdb_lock);
+    bp->bp_cost = sp->cost;
+    bp->bp_priority = (sp->id >> 8) & 0xf0;
+    bp->bp_edge = sp->admin_edge;
+    bp->bp_id = sp->id;
+    bp->bp_role = sp->role;
+    bp->bp_state = sp->state;
+    bp->bp_oper_edge = sp->oper_edge;
+    bp->bp_dbridge = sp->vec.bridge;
+    bp->bp_dport = sp->vec.port;
+    BRDG_UNLOCK(&br->fdb_lock);
+    return(0);
+}
+
+/*****************************************************************************
+ * brdg_fdb_read()
+ *
+ * Copy entries of the forwarding database, starting from the bucket
+ * 'cursor', for dumping the table in pages. Whole buckets are copied while
+ * there is room for BRDG_FDB_WAYS entries, and at most BRDG_FDB_SCAN buckets
+ * are read by one call, so fdb_lock is held only for a short time. The
+ * data path does not take fdb_lock and is never blocked by this.
+ *
+ *  Arguments:
+ *           br     :  bridge
+ *           cursor :  bucket to start from. 0 for the first call
+ *           ent    :  array of entries to be set
+ *           max    :  size of ent. Must be BRDG_FDB_WAYS or more
+ *           countp :  number of entries set to ent
+ *  Return:
+ *           cursor for the next call, or BRDG_FDB_END if all buckets
+ *           have been read
+ *****************************************************************************/
+uint32_t
+brdg_fdb_read(brdg_t *br, uint32_t cursor, brdg_fdb_entry_t *ent,
+    uint32_t max, uint32_t *countp)
+{
+    fdb_bucket_t *bucket;
+    node_t       *node;
+    brdg_port_t  *port;
+    uint32_t     count = 0;
+    uint32_t     scan;
+    uint32_t     way;
+
+    BRDG_LOCK(&br->fdb_lock);
+    for (scan = 0; scan < BRDG_FDB_SCAN && cursor < br->fdb_nbucket &&
+             count + BRDG_FDB_WAYS <= max; scan++, cursor++) {
+        bucket = &br->fdb_table[cursor];
+        for (way = 0; way < BRDG_FDB_WAYS; way++) {
+            node = &bucket->node[way];
+            if ((node->state & NODE_VALID) == 0 ||
+                (port = brdg_node_port(br, node)) == NULL)
+                continue;
+            bcopy(&node->ether_addr, &ent[count].be_addr, ETHERADDRL);
+            ent[count].be_vid = node->vid;
+            ent[count].be_flags = (node->state & NODE_STATIC) ? BRDG_FDB_STATIC : 0;
+            ent[count].be_cookie = port->cookie;
+            ent[count].be_age = br->clock - node->last_seen;
+            count++;
+        }
+    }
+    BRDG_UNLOCK(&br->fdb_lock);
+
+    *countp = count;
+    return((cursor < br->fdb_nbucket) ? cursor : BRDG_FDB_END);
+}
+
+/*****************************************************************************
+ * brdg_fdb_info()
+ *
+ * Count entries in use and buckets for each number of entries in them.
+ * Buckets are read without any lock, so counts are approximate if the
+ * forwarding database is being updated.
+ * Stale entries (see fdb_slot_t) are counted until brdg_tick() reclaims
+ * them.
+ *
+ *  Arguments:
+ *           br   :  bridge
+ *           info :  occupancy to be set
+ *****************************************************************************/
+void
+brdg_fdb_info(brdg_t *br, brdg_fdb_info_t *info)
+{
+    fdb_bucket_t   *bucket;
+    brdg_portset_t *ps;
+    uint64_t       stats[BRDG_STAT_MAX];
+    uint32_t       bucketnum;
+    uint32_t       way;
+    uint32_t       n;
+    uint32_t       i;
+
+    bzero(info, sizeof(brdg_fdb_info_t));
+    info->bi_nbucket = br->fdb_nbucket;
+    for (bucketnum = 0; bucketnum < br->fdb_nbucket; bucketnum++) {
+        bucket = &br->fdb_table[bucketnum];
+        for (way = 0, n = 0; way < BRDG_FDB_WAYS; way++) {
+            if (bucket->node[way].state & NODE_VALID)
+                n++;
+        }
+        info->bi_load[n]++;
+        info->bi_entries += n;
+    }
+
+    BRDG_LOCK(&br->port_lock);
+    ps = br->ports;
+    for (i = 0; i < ps->ps_count; i++) {
+        brdg_port_stats(ps->ps_port[i], stats);
+        info->bi_evict += stats[BRDG_STAT_EVICT];
+    }
+    BRDG_UNLOCK(&br->port_lock);
+}
+
+/**********************************************************************
+ * brdg_mcast_input()
+ *
+ * Forward a multicast frame received on the port.
+ *
+ * IGMP/MLD messages are snooped by brdg_snoop_parse(). Queries are
+ * flooded, and reports are sent to router ports only, so that hosts on
+ * other ports do not suppress their own reports (RFC 4541). Frames of a
+ * group in the multicast group table are sent to the member ports of the
+ * group and router ports. Other multicast frames, i.e. broadcast, groups
+ * of link local scope and groups nobody reported, are flooded.
+ *
+ *  Arguments:
+ *           br    :  bridge
+ *           port  :  port where the frame was received
+ *           bf    :  frame. Consumed by this function
+ *           vid   :  VLAN of the frame
+ *           tag   :  802.1Q tag of the frame as received
+ ***********************************************************************/
+static void
+brdg_mcast_input(brdg_t *br, brdg_port_t *port, brdg_frame_t *bf,
+    uint16_t vid, uint32_t tag)
+{
+    const struct ether_addr *dhost = (const struct ether_addr *)bf->bf_hdr;
+    uint64_t  mask = MCAST_ALL;
+    uint64_t  members;
+
+    if (MCAST_IP(bf->bf_hdr)) {
+        switch (brdg_snoop_parse(br, port, bf->bf_hdr, bf->bf_len, vid)) {
+            case SNOOP_QUERY:
+                break;
+            case SNOOP_REPORT:
+                /* Flooded if no querier is known */
+                if (br->mrouter != 0)
+                    mask = br->mrouter;
+                break;
+            default:
+                if (!MCAST_LINKLOCAL(bf->bf_hdr) &&
+                    brdg_mcast_lookup(br, MCAST_BUCKET(br, dhost, vid), dhost, vid,
+                        &members))
+                    mask = members | br->mrouter;
+                break;
+        }
+    }
+    if (mask == MCAST_ALL) {
+        STAT_INC(port, BRDG_STAT_FLOOD);
+        BRDG_TRACE2(flood, brdg_port_t *, port, void *, bf->bf_frame);
+    } else
+        STAT_INC(port, BRDG_STAT_MCAST);
+    brdg_flood(br, port, bf->bf_frame, vid, tag, mask);
+}
+
+/*****************************************************************************
+ * brdg_mcast_lookup()
+ *
+ * Search the multicast group table for the group address in the VLAN.
+ * Called from the data path without any lock, in the same way as
+ * brdg_fdb_lookup(), and the bucket is read holding fdb_lock after
+ * FDB_READ_RETRY retries.
+ *
+ *  Arguments:
+ *             br :  bridge
+ *         bucket :  bucket of the group address. (MCAST_BUCKET())
+ *           addr :  group address
+ *            vid :  VLAN ID
+ *        members :  bitmap of member ports to be set
+ *  Return:
+ *           1 if the group is registered, otherwise 0
+ *****************************************************************************/
+static int
+brdg_mcast_lookup(brdg_t *br, mcast_bucket_t *bucket, const struct ether_addr *addr,
+    uint16_t vid, uint64_t *members)
+{
+    mcast_group_t *group;
+    uint32_t      seq;
+    uint32_t      way;
+    uint32_t      retry;
+    int           found;
+
+    for (retry = 0; ; retry++) {
+        if (retry == FDB_READ_RETRY) {
+            BRDG_LOCK(&br->fdb_lock);
+        } else if ((seq = bucket->seq) & 1) {
+            BRDG_PAUSE();
+            continue;
+        }
+        BRDG_MEMBAR_CONSUMER();
+        found = 0;
+        for (way = 0; way < MCAST_WAYS; way++) {
+            group = &bucket->group[way];
+            if (GROUP_MATCH(group, addr, vid)) {
+                *members = group->members;
+                found = 1;
+                break;
+            }
+        }
+        if (retry == FDB_READ_RETRY) {
+            BRDG_UNLOCK(&br->fdb_lock);
+            break;
+        }
+        BRDG_MEMBAR_CONSUMER();
+        if (seq == bucket->seq)
+            break;
+    }
+
+    return(found);
+}
+
+/*****************************************************************************
+ * brdg_snoop_parse()
+ *
+ * If the frame is an IGMP or MLD message, queue requests to update the
+ * multicast group table by brdg_snoop_queue(). Only the contiguous data at
+ * hdr is read.
+ *
+ *  Arguments:
+ *           br   :  bridge
+ *           port :  port where the frame was received
+ *           hdr  :  ethernet header of the frame
+ *           len  :  length of contiguous data at hdr
+ *           vid  :  VLAN of the frame
+ *  Return:
+ *           SNOOP_QUERY, SNOOP_REPORT, or SNOOP_NONE if the frame is not
+ *           an IGMP/MLD message
+ *****************************************************************************/
+static int
+brdg_snoop_parse(brdg_t *br, brdg_port_t *port, const uint8_t *hdr,
+    size_t len, uint16_t vid)
+{
+    size_t    off = 2 * ETHERADDRL;
+    uint32_t  type;
+    int       ret;
+
+    if (hdr[off] == (BRDG_VLAN_TPID >> 8) && hdr[off + 1] == (BRDG_VLAN_TPID & 0xff))
+        off += 4;
+    if (len < off + 2)
+        return(SNOOP_NONE);
+    type = (hdr[off] << 8) | hdr[off + 1];
+    off += 2;
+
+    if (type == ETHERTYPE_IP)
+        ret = brdg_snoop_igmp(br, port, hdr + off, len - off, vid);
+    else if (type == ETHERTYPE_IPV6)
+        ret = brdg_snoop_mld(br, port, hdr + off, len - off, vid);
+    else
+        ret = SNOOP_NONE;
+    if (ret != SNOOP_NONE)
+        STAT_INC(port, BRDG_STAT_SNOOP);
+    return(ret);
+}
+
+/*****************************************************************************
+ * brdg_snoop_igmp()
+ *
+ * Snoop IGMPv1/v2/v3 message in the IPv4 packet. Sources of IGMPv3 group
+ * records are ignored; a port is a member of the group if a host on it
+ * wants any source of the group.
+ *
+ *  Arguments:
+ *           br   :  bridge
+ *           port :  port where the packet was received
+ *           p    :  IPv4 header
+ *           len  :  length of contiguous data at p
+ *           vid  :  VLAN of the packet
+ *  Return:
+ *           SNOOP_XXX of brdg_snoop_parse()
+ *****************************************************************************/
+static int
+brdg_snoop_igmp(brdg_t *br, brdg_port_t *port, const uint8_t *p, size_t len,
+    uint16_t vid)
+{
+    uint8_t   addr[ETHERADDRL];
+    size_t    hlen;
+    size_t    rlen;
+    uint32_t  nrec;
+    uint32_t  nsrc;
+    uint32_t  type;
+
+    if (len < 20 || (p[0] >> 4) != 4 || p[9] != SNOOP_PROTO_IGMP)
+        return(SNOOP_NONE);
+    hlen = (p[0] & 0x0f) * 4;
+    if (hlen < 20 || len < hlen + 8)
+        return(SNOOP_NONE);
+    p += hlen;
+    len -= hlen;
+
+    addr[0] = 0x01;
+    addr[1] = 0x00;
+    addr[2] = 0x5e;
+    switch (p[0]) {
+        case IGMP_QUERY:
+            brdg_snoop_queue(br, SNOOP_QUERY, NULL, vid, port);
+            return(SNOOP_QUERY);
+        case IGMP_V1_REPORT:
+        case IGMP_V2_REPORT:
+        case IGMP_V2_LEAVE:
+            if ((p[4] & 0xf0) == 0xe0) {
+                addr[3] = p[5] & 0x7f;
+                addr[4] = p[6];
+                addr[5] = p[7];
+                brdg_snoop_queue(br, (p[0] == IGMP_V2_LEAVE) ? SNOOP_LEAVE : SNOOP_JOIN,
+                    addr, vid, port);
+            }
+            return(SNOOP_REPORT);
+        case IGMP_V3_REPORT:
+            nrec = (p[6] << 8) | p[7];
+            p += 8;
+            len -= 8;
+            for (; nrec > 0 && len >= 8; nrec--, p += rlen, len -= rlen) {
+                nsrc = (p[2] << 8) | p[3];
+                rlen = 8 + 4 * nsrc + 4 * p[1];
+                if (len < rlen)
+                    break;
+                type = SNOOP_RECORD(p[0], nsrc);
+                if (type != SNOOP_NONE && (p[4] & 0xf0) == 0xe0) {
+                    addr[3] = p[5] & 0x7f;
+                    addr[4] = p[6];
+                    addr[5] = p[7];
+                    brdg_snoop_queue(br, type, addr, vid, port);
+                }
+            }
+            return(SNOOP_REPORT);
+        default:
+            return(SNOOP_NONE);
+    }
+}
+
+/*****************************************************************************
+ * brdg_snoop_mld()
+ *
+ * Snoop MLDv1/v2 message in the IPv6 packet, same as brdg_snoop_igmp().
+ * MLD messages follow the hop-by-hop options header with router alert
+ * option.
+ *
+ *  Arguments:
+ *           br   :  bridge
+ *           port :  port where the packet was received
+ *           p    :  IPv6 header
+ *           len  :  length of contiguous data at p
+ *           vid  :  VLAN of the packet
+ *  Return:
+ *           SNOOP_XXX of brdg_snoop_parse()
+ *****************************************************************************/
+static int
+brdg_snoop_mld(brdg_t *br, brdg_port_t *port, const uint8_t *p, size_t len,
+    uint16_t vid)
+{
+    uint8_t   addr[ETHERADDRL];
+    size_t    off = 40;
+    size_t    rlen;
+    uint32_t  nh;
+    uint32_t  nrec;
+    uint32_t  nsrc;
+    uint32_t  type;
+
+    if (len < off || (p[0] >> 4) != 6)
+        return(SNOOP_NONE);
+    nh = p[6];
+    if (nh == SNOOP_PROTO_HOPOPTS) {
+        if (len < off + 8)
+            return(SNOOP_NONE);
+        nh = p[off];
+        off += (p[off + 1] + 1) * 8;
+    }
+    if (nh != SNOOP_PROTO_ICMPV6 || len < off + 8)
+        return(SNOOP_NONE);
+    p += off;
+    len -= off;
+
+    addr[0] = 0x33;
+    addr[1] = 0x33;
+    switch (p[0]) {
+        case MLD_QUERY:
+            brdg_snoop_queue(br, SNOOP_QUERY, NULL, vid, port);
+            return(SNOOP_QUERY);
+        case MLD_V1_REPORT:
+        case MLD_V1_DONE:
+            if (len >= 24 && p[8] == 0xff) {
+                bcopy(&p[20], &addr[2], 4);
+                brdg_snoop_queue(br, (p[0] == MLD_V1_DONE) ? SNOOP_LEAVE : SNOOP_JOIN,
+                    addr, vid, port);
+            }
+            return(SNOOP_REPORT);
+        case MLD_V2_REPORT:
+            nrec = (p[6] << 8) | p[7];
+            p += 8;
+            len -= 8;
+            for (; nrec > 0 && len >= 20; nrec--, p += rlen, len -= rlen) {
+                nsrc = (p[2] << 8) | p[3];
+                rlen = 20 + 16 * nsrc + 4 * p[1];
+                if (len < rlen)
+                    break;
+                type = SNOOP_RECORD(p[0], nsrc);
+                if (type != SNOOP_NONE && p[4] == 0xff) {
+                    bcopy(&p[16], &addr[2], 4);
+                    brdg_snoop_queue(br, type, addr, vid, port);
+                }
+            }
+            return(SNOOP_REPORT);
+        default:
+            return(SNOOP_NONE);
+    }
+}
+
+/*****************************************************************************
+ * brdg_snoop_queue()
+ *
+ * Queue the request to update the multicast group table by brdg_learn_run().
+ * A request same as the last request for the group on the port is
+ * coalesced. If the queue is full the request is dropped, and it will be
+ * requested again by the next report or query.
+ *
+ *  Arguments:
+ *           br   :  bridge
+ *           type :  SNOOP_QUERY, SNOOP_JOIN or SNOOP_LEAVE
+ *           addr :  group address. NULL for SNOOP_QUERY
+ *           vid  :  VLAN ID
+ *           port :  port where the message was received
+ *****************************************************************************/
+static void
+brdg_snoop_queue(brdg_t *br, uint32_t type, const uint8_t *addr, uint16_t vid,
+    brdg_port_t *port)
+{
+    snoop_t   *sn;
+    uint32_t  i;
+
+    if (addr != NULL && MCAST_LINKLOCAL(addr))
+        return;
+
+    BRDG_LOCK(&br->learn_lock);
+    for (i = br->snoop_count; i > 0; i--) {
+        sn = &br->snoop_queue[i - 1];
+        if (sn->port != port || sn->vid != vid)
+            continue;
+        if (addr == NULL ? sn->type != SNOOP_QUERY :
+            (sn->type == SNOOP_QUERY || bcmp(addr, &sn->addr, ETHERADDRL) != 0))
+            continue;
+        if (sn->type == type) {
+            BRDG_UNLOCK(&br->learn_lock);
+            return;
+        }
+        break;
+    }
+    if (br->snoop_count < BRDG_SNOOP_MAX) {
+        sn = &br->snoop_queue[br->snoop_count++];
+        sn->type = type;
+        if (addr != NULL)
+            bcopy(addr, &sn->addr, ETHERADDRL);
+        else
+            bzero(&sn->addr, ETHERADDRL);
+        sn->vid = vid;
+        sn->port = port;
+    }
+    if (!br->learn_scheduled) {
+        if (br->ops.bo_schedule(br) == 0)
+            br->learn_scheduled = 1;
+    }
+    BRDG_UNLOCK(&br->learn_lock);
+}
+
+/*****************************************************************************
+ * brdg_mcast_update()
+ *
+ * Update the multicast group table by the request from snooping.
+ *
+ *   SNOOP_QUERY : the port is a router port for bc_mrouter_timeout seconds.
+ *   SNOOP_JOIN  : the port is a member of the group for bc_mcast_timeout
+ *                 seconds. The group is registered if it is not yet.
+ *   SNOOP_LEAVE : the membership of the port expires in bc_mcast_leave
+ *                 seconds, unless another host on the port answers to
+ *                 the group specific query of the querier.
+ *
+ * A group with no member port is kept until the group expires, so that
+ * frames of the group are sent to router ports only instead of flooded.
+ * If the bucket is full, the group is not registered and its frames are
+ * flooded. fdb_lock must be held by the caller.
+ *****************************************************************************/
+static void
+brdg_mcast_update(brdg_t *br, const snoop_t *sn)
+{
+    mcast_bucket_t *bucket;
+    mcast_group_t  *group;
+    uint32_t       idx = sn->port->index;
+    uint32_t       now = br->clock;
+    uint32_t       *expire;
+    uint32_t       slot;
+    uint32_t       way;
+    uint64_t       bit;
+
+    if (br->mcast_table == NULL || idx >= BRDG_MCAST_PORTS)
+        return;     /* The port receives all multicast frames */
+    bit = (uint64_t)1 << idx;
+
+    if (sn->type == SNOOP_QUERY) {
+        br->mrouter_expire[idx] = now + br->conf.bc_mrouter_timeout;
+        br->mrouter |= bit;
+        return;
+    }
+
+    bucket = MCAST_BUCKET(br, &sn->addr, sn->vid);
+    for (way = 0; way < MCAST_WAYS; way++) {
+        if (GROUP_MATCH(&bucket->group[way], &sn->addr, sn->vid))
+            break;
+    }
+    if (way == MCAST_WAYS) {
+        if (sn->type != SNOOP_JOIN)
+            return;
+        for (way = 0; way < MCAST_WAYS; way++) {
+            if ((bucket->group[way].state & GROUP_VALID) == 0)
+                break;
+        }
+        if (way == MCAST_WAYS)
+            return;
+        group = &bucket->group[way];
+        FDB_WRITE_BEGIN(bucket);
+        bcopy(&sn->addr, &group->addr, ETHERADDRL);
+        group->vid = sn->vid;
+        group->members = 0;
+        group->state = GROUP_VALID;
+        FDB_WRITE_END(bucket);
+    }
+    group = &bucket->group[way];
+    slot = MCAST_SLOT(br, bucket, way);
+    expire = &br->mcast_expire[slot * BRDG_MCAST_PORTS + idx];
+
+    if (sn->type == SNOOP_JOIN) {
+        *expire = now + br->conf.bc_mcast_timeout;
+        br->mcast_gexpire[slot] = now + br->conf.bc_mcast_timeout;
+        if ((group->members & bit) == 0) {
+            BRDG_TRACE2(join, brdg_port_t *, sn->port, struct ether_addr *, &group->addr);
+            FDB_WRITE_BEGIN(bucket);
+            group->members |= bit;
+            FDB_WRITE_END(bucket);
+        }
+    } else if ((group->members & bit) &&
+        (int32_t)(*expire - now) > (int32_t)br->conf.bc_mcast_leave) {
+        *expire = now + br->conf.bc_mcast_leave;
+    }
+}
+
+/*****************************************************************************
+ * brdg_mcast_age()
+ *
+ * Remove memberships, groups and router ports which have expired.
+ * fdb_lock must be held by the caller.
+ *
+ *  Arguments:
+ *           br  :  bridge
+ *           now :  current time in seconds
+ *****************************************************************************/
+static void
+brdg_mcast_age(brdg_t *br, uint32_t now)
+{
+    mcast_bucket_t *bucket;
+    mcast_group_t  *group;
+    uint32_t       bucketnum;
+    uint32_t       way;
+    uint32_t       slot;
+    uint32_t       idx;
+    uint64_t       members;
+    uint64_t       m;
+
+    for (bucketnum = 0; bucketnum < br->mcast_nbucket; bucketnum++) {
+        bucket = &br->mcast_table[bucketnum];
+        for (way = 0; way < MCAST_WAYS; way++) {
+            group = &bucket->group[way];
+            if ((group->state & GROUP_VALID) == 0)
+                continue;
+            slot = MCAST_SLOT(br, bucket, way);
+            if ((int32_t)(br->mcast_gexpire[slot] - now) <= 0) {
+                FDB_WRITE_BEGIN(bucket);
+                group->state = 0;
+                group->members = 0;
+                FDB_WRITE_END(bucket);
+                continue;
+            }
+            members = group->members;
+            for (m = members; m != 0; m &= m - 1) {
+                idx = brdg_ctz64(m);
+                if ((int32_t)(br->mcast_expire[slot * BRDG_MCAST_PORTS + idx] - now) <= 0) {
+                    members &= ~((uint64_t)1 << idx);
+                    BRDG_TRACE2(leave, brdg_port_t *, br->ports->ps_port[idx],
+                        struct ether_addr *, &group->addr);
+                }
+            }
+            if (members != group->members) {
+                FDB_WRITE_BEGIN(bucket);
+                group->members = members;
+                FDB_WRITE_END(bucket);
+            }
+        }
+    }
+
+    members = br->mrouter;
+    for (m = members; m != 0; m &= m - 1) {
+        idx = brdg_ctz64(m);
+        if ((int32_t)(br->mrouter_expire[idx] - now) <= 0)
+            members &= ~((uint64_t)1 << idx);
+    }
+    br->mrouter = members;
+}
+
+/*****************************************************************************
+ * brdg_mcast_port_remove()
+ *
+ * Remove the port from bitmaps of the multicast group table, and move the
+ * bit of the last port to the index of the removed port, as
+ * brdg_port_remove() moves the last port to the slot.
+ * If the last port was not tracked by bitmaps, it received all multicast
+ * frames; it stays a member of all groups and a router port until the
+ * memberships expire.
+ * fdb_lock must be held by the caller.
+ *****************************************************************************/
+static void
+brdg_mcast_port_remove(brdg_t *br, brdg_port_t *port)
+{
+    mcast_bucket_t *bucket;
+    mcast_group_t  *group;
+    uint32_t       idx = port->index;
+    uint32_t       last = br->ports->ps_count - 1;
+    uint32_t       *expire;
+    uint32_t       bucketnum;
+    uint32_t       way;
+    uint64_t       bit;
+    uint64_t       lbit;
+    uint64_t       members;
+
+    if (br->mcast_table == NULL || idx >= BRDG_MCAST_PORTS)
+        return;
+    bit = (uint64_t)1 << idx;
+    lbit = (last < BRDG_MCAST_PORTS) ? (uint64_t)1 << last : 0;
+
+    for (bucketnum = 0; bucketnum < br->mcast_nbucket; bucketnum++) {
+        bucket = &br->mcast_table[bucketnum];
+        for (way = 0; way < MCAST_WAYS; way++) {
+            group = &bucket->group[way];
+            if ((group->state & GROUP_VALID) == 0)
+                continue;
+            expire = &br->mcast_expire[MCAST_SLOT(br, bucket, way) * BRDG_MCAST_PORTS];
+            members = group->members & ~bit;
+            if (last != idx && lbit == 0) {
+                members |= bit;
+                expire[idx] = br->mcast_gexpire[MCAST_SLOT(br, bucket, way)];
+            } else if (last != idx && (members & lbit)) {
+                members = (members & ~lbit) | bit;
+                expire[idx] = expire[last];
+            }
+            if (members != group->members) {
+                FDB_WRITE_BEGIN(bucket);
+                group->members = members;
+                FDB_WRITE_END(bucket);
+            }
+        }
+    }
+
+    members = br->mrouter & ~bit;
+    if (last != idx && lbit == 0) {
+        members |= bit;
+        br->mrouter_expire[idx] = br->clock + br->conf.bc_mrouter_timeout;
+    } else if (last != idx && (members & lbit)) {
+        members = (members & ~lbit) | bit;
+        br->mrouter_expire[idx] = br->mrouter_expire[last];
+    }
+    br->mrouter = members;
+}
+
+/*****************************************************************************
+ * brdg_mcast_read()
+ *
+ * Copy memberships of the multicast group table, starting from 'cursor',
+ * for dumping the table in pages, in the same way as brdg_fdb_read().
+ * Router ports are copied first, followed by member ports of groups. The
+ * cursor holds the position (0 for router ports, slot + 1 for a group)
+ * times BRDG_MCAST_PORTS plus the first port index to be copied, so that
+ * the members of a group which do not fit in ent are continued in the
+ * next call.
+ *
+ *  Arguments:
+ *           br     :  bridge
+ *           cursor :  0 for the first call
+ *           ent    :  array of entries to be set
+ *           max    :  size of ent
+ *           countp :  number of entries set to ent
+ *  Return:
+ *           cursor for the next call, or BRDG_FDB_END if all groups
+ *           have been read
+ *****************************************************************************/
+uint32_t
+brdg_mcast_read(brdg_t *br, uint32_t cursor, brdg_mcast_entry_t *ent,
+    uint32_t max, uint32_t *countp)
+{
+    brdg_portset_t *ps;
+    mcast_bucket_t *bucket;
+    mcast_group_t  *group;
+    uint32_t       nslot = br->mcast_nbucket * MCAST_WAYS;
+    uint32_t       pos = cursor / BRDG_MCAST_PORTS;
+    uint32_t       first = cursor % BRDG_MCAST_PORTS;
+    uint32_t       count = 0;
+    uint32_t       scan;
+    uint32_t       slot;
+    uint32_t       idx;
+    uint64_t       m = 0;
+
+    BRDG_LOCK(&br->fdb_lock);
+    BRDG_LOCK(&br->port_lock);
+    ps = br->ports;
+    if (pos == 0) {
+        for (m = br->mrouter & ~(((uint64_t)1 << first) - 1); m != 0 && count < max;
+             m &= m - 1) {
+            idx = brdg_ctz64(m);
+            bzero(&ent[count], sizeof(brdg_mcast_entry_t));
+            ent[count].bm_flags = BRDG_MCAST_ROUTER;
+            ent[count].bm_cookie = ps->ps_port[idx]->cookie;
+            ent[count].bm_expire = br->mrouter_expire[idx] - br->clock;
+            count++;
+        }
+        if (m == 0) {
+            pos = 1;
+            first = 0;
+        }
+    }
+    for (scan = 0; m == 0 && scan < BRDG_FDB_SCAN && pos - 1 < nslot;
+         scan++, pos++, first = 0) {
+        slot = pos - 1;
+        bucket = &br->mcast_table[slot / MCAST_WAYS];
+        group = &bucket->group[slot % MCAST_WAYS];
+        if ((group->state & GROUP_VALID) == 0)
+            continue;
+        for (m = group->members & ~(((uint64_t)1 << first) - 1); m != 0 && count < max;
+             m &= m - 1) {
+            idx = brdg_ctz64(m);
+            bcopy(&group->addr, &ent[count].bm_addr, ETHERADDRL);
+            ent[count].bm_vid = group->vid;
+            ent[count].bm_flags = 0;
+            ent[count].bm_cookie = ps->ps_port[idx]->cookie;
+            ent[count].bm_expire =
+                br->mcast_expire[slot * BRDG_MCAST_PORTS + idx] - br->clock;
+            count++;
+        }
+        if (m != 0)
+            break;    /* The rest of the group is read by the next call */
+    }
+    BRDG_UNLOCK(&br->port_lock);
+    BRDG_UNLOCK(&br->fdb_lock);
+
+    *countp = count;
+    if (m != 0)
+        return(pos * BRDG_MCAST_PORTS + brdg_ctz64(m));
+    return((pos - 1 < nslot) ? pos * BRDG_MCAST_PORTS : BRDG_FDB_END);
+}
+
+/*****************************************************************************
+ * brdg_ctz64()
+ *
+ * Return the number of trailing zero bits of x, which must not be 0.
+ *****************************************************************************/
+static uint32_t
+brdg_ctz64(uint64_t x)
+{
+    static const uint8_t debruijn[64] = {
+         0,  1, 48,  2, 57, 49, 28,  3, 61, 58, 50, 42, 38, 29, 17,  4,
+        62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12,  5,
+        63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11,
+        46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19,  9, 13,  8,  7,  6
+    };
+
+    return(debruijn[((x & (~x + 1)) * 0x03f79d71b4ca8b09ULL) >> 58]);
+}
+
+/*****************************************************************************
+ * brdg_storm_police()
+ *
+ * Take tokens of storm control of the port for a frame of the class.
+ * Tokens are added first by the time since they were added last time.
+ * Called only from the data path of the port, without any lock.
+ *
+ *  Arguments:
+ *           br    :  bridge
+ *           port  :  port where the frame was received
+ *           class :  BRDG_STORM_XXX
+ *           size  :  length of the frame
+ *  Return:
+ *           1 if the frame is over the limit and should be dropped,
+ *           otherwise 0
+ *****************************************************************************/
+static int
+brdg_storm_police(brdg_t *br, brdg_port_t *port, uint32_t class, size_t size)
+{
+    storm_t   *st = &port->storm[class];
+    uint32_t  now = br->msclock;
+    uint32_t  burst = br->conf.bc_storm_burst;
+    uint32_t  elapsed;
+
+    if (now != st->last) {
+        elapsed = now - st->last;
+        if (elapsed > burst)
+            elapsed = burst;
+        st->ptokens += (int64_t)st->pps * elapsed;
+        if (st->ptokens > (int64_t)st->pps * burst)
+            st->ptokens = (int64_t)st->pps * burst;
+        st->btokens += (int64_t)st->bps * elapsed;
+        if (st->btokens > (int64_t)st->bps * burst)
+            st->btokens = (int64_t)st->bps * burst;
+        st->last = now;
+    }
+    if ((st->pps != 0 && st->ptokens <= 0) || (st->bps != 0 && st->btokens <= 0))
+        return(1);
+    st->ptokens -= 1000;
+    st->btokens -= (int64_t)size * 1000;
+    return(0);
+}
+
+/*****************************************************************************
+ * brdg_limit_police()
+ *
+ * Check the MAC limit of the port for a source address which is to be
+ * queued to be learned on the port, and take a token of the learn rate.
+ * Tokens are added in the same way as brdg_storm_police(), up to a second
+ * of the rate. If the frame is over the limit, it is counted in
+ * BRDG_STAT_LIMIT, and the port is marked to be shut down by brdg_tick()
+ * for BRDG_LIMIT_SHUTDOWN.
+ * Called only by brdg_fdb_learn() from the data path of the port.
+ *
+ *  Arguments:
+ *           br    :  bridge
+ *           port  :  port where the frame was received
+ *  Return:
+ *           1 if the address must not be learned, otherwise 0
+ *****************************************************************************/
+static int
+brdg_limit_police(brdg_t *br, brdg_port_t *port)
+{
+    uint32_t  now = br->msclock;
+    uint32_t  elapsed;
+    int       over = 0;
+
+    if (port->limit_max == 0 && port->limit_rate == 0)
+        return(0);
+    if (port->limit_max != 0 && port->learned >= port->limit_max) {
+        over = 1;
+    } else if (port->limit_rate != 0) {
+        if (now != port->limit_last) {
+            elapsed = now - port->limit_last;
+            if (elapsed > 1000)
+                elapsed = 1000;
+            port->limit_tokens += (int64_t)port->limit_rate * elapsed;
+            if (port->limit_tokens > (int64_t)port->limit_rate * 1000)
+                port->limit_tokens = (int64_t)port->limit_rate * 1000;
+            port->limit_last = now;
+        }
+        if (port->limit_tokens <= 0)
+            over = 1;
+        else
+            port->limit_tokens -= 1000;
+    }
+    if (over) {
+        STAT_INC(port, BRDG_STAT_LIMIT);
+        if (port->limit_action == BRDG_LIMIT_SHUTDOWN)
+            port->limit_shut = 1;
+    }
+    return(over);
+}
+
+/*****************************************************************************
+ * brdg_limit_shutdown()
+ *
+ * Shut down the port which went over the MAC limit. The port is blocked
+ * and disabled for RSTP, and its dynamic addresses are deleted, until the
+ * limit is set again by brdg_port_limit().
+ * fdb_lock must be held by the caller.
+ *****************************************************************************/
+static void
+brdg_limit_shutdown(brdg_t *br, brdg_port_t *port)
+{
+    BRDG_TRACE2(limit, brdg_port_t *, port, int, 1);
+    port->blocked |= BLOCK_LIMIT;
+    brdg_fdb_flush(br, port, 0);
+    if (br->stp_on && (port->blocked & BLOCK_LINK) == 0)
+        brdg_stp_port_enable(&br->stp, &port->stp, 0);
+}
@@ -0,0 +1,447 @@
+/*
+ * Copyright (C) 2010 Kazuyoshi Aizawa. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/****************************************************************
+ * brdgcore.h
+ *
+ * Forwarding core of the bridge.
+ *
+ * The core does learning, lookup, forwarding and flooding of frames,
+ * and knows nothing about STREAMS. Frames and ports are opaque handles
+ * of the caller (the STREAMS module, or a userspace program), which
+ * moves frames through the operations in brdg_ops_t.
+ *
+ * The same source is compiled into the kernel module (_KERNEL) and
+ * into userspace programs.
+ ***************************************************************/
+
+#ifndef __BRDGCORE_H
+#define __BRDGCORE_H
+
+#ifdef _KERNEL
+#include <sys/types.h>
+#include <sys/ksynch.h>
+#include <sys/kmem.h>
+#include <sys/atomic.h>
+#include <sys/ethernet.h>
+#include <sys/systm.h>
+#include <sys/prefetch.h>
+#include <sys/cpuvar.h>
+#else
+#include <sys/types.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <pthread.h>
+#ifdef __linux__
+#include <net/ethernet.h>
+#else
+#include <sys/ethernet.h>
+#endif
+#endif
+
+#ifndef ETHERADDRL
+#define ETHERADDRL 6
+#endif
+
+/*
+ * Platform dependent primitives used by the core.
+ */
+#ifdef _KERNEL
+typedef kmutex_t brdg_lock_t;
+#define BRDG_LOCK_INIT(l)        mutex_init((l), NULL, MUTEX_DRIVER, NULL)
+#define BRDG_LOCK_DESTROY(l)     mutex_destroy(l)
+#define BRDG_LOCK(l)             mutex_enter(l)
+#define BRDG_UNLOCK(l)           mutex_exit(l)
+typedef kcondvar_t brdg_cv_t;
+#define BRDG_CV_INIT(c)          cv_init((c), NULL, CV_DRIVER, NULL)
+#define BRDG_CV_DESTROY(c)       cv_destroy(c)
+#define BRDG_CV_WAIT(c, l)       cv_wait((c), (l))
+#define BRDG_CV_BROADCAST(c)     cv_broadcast(c)
+#define BRDG_ALLOC(size)         kmem_zalloc((size), KM_SLEEP)
+#define BRDG_FREE(ptr, size)     kmem_free((ptr), (size))
+#define BRDG_MEMBAR_PRODUCER()   membar_producer()
+#define BRDG_MEMBAR_CONSUMER()   membar_consumer()
+#define BRDG_PREFETCH(p)         prefetch_read_many((void *)(p))
+#define BRDG_NCPU()              max_ncpus
+#define BRDG_CPUID()             (CPU->cpu_seqid)
+#define BRDG_PAUSE()             SMT_PAUSE()
+#else
+typedef pthread_mutex_t brdg_lock_t;
+#define BRDG_LOCK_INIT(l)        pthread_mutex_init((l), NULL)
+#define BRDG_LOCK_DESTROY(l)     pthread_mutex_destroy(l)
+#define BRDG_LOCK(l)             pthread_mutex_lock(l)
+#define BRDG_UNLOCK(l)           pthread_mutex_unlock(l)
+typedef pthread_cond_t brdg_cv_t;
+#define BRDG_CV_INIT(c)          pthread_cond_init((c), NULL)
+#define BRDG_CV_DESTROY(c)       pthread_cond_destroy(c)
+#define BRDG_CV_WAIT(c, l)       pthread_cond_wait((c), (l))
+#define BRDG_CV_BROADCAST(c)     pthread_cond_broadcast(c)
+#define BRDG_ALLOC(size)         calloc(1, (size))
+#define BRDG_FREE(ptr, size)     free(ptr)
+#ifdef __GNUC__
+#define BRDG_MEMBAR_PRODUCER()   __atomic_thread_fence(__ATOMIC_RELEASE)
+#define BRDG_MEMBAR_CONSUMER()   __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define BRDG_PREFETCH(p)         __builtin_prefetch(p)
+#if defined(__i386__) || defined(__x86_64__)
+#define BRDG_PAUSE()             __builtin_ia32_pause()
+#else
+#define BRDG_PAUSE()
+#endif
+#else
+#include <atomic.h>
+#define BRDG_MEMBAR_PRODUCER()   membar_producer()
+#define BRDG_MEMBAR_CONSUMER()   membar_consumer()
+#define BRDG_PREFETCH(p)
+#define BRDG_PAUSE()
+#endif
+/* The data path of userspace programs runs in one thread */
+#define BRDG_NCPU()              1
+#define BRDG_CPUID()             0
+#endif
+
+#define BRDG_FDB_WAYS  4    /* Number of node entries in one hash bucket */
+#define BRDG_LEARN_MAX 256  /* Max number of queued learning requests */
+#define BRDG_BATCH     16   /* Number of frames looked up at once */
+#define BRDG_CACHELINE 64   /* Size of a cache line */
+#define BRDG_SNOOP_MAX 64   /* Max number of queued IGMP/MLD snooping requests */
+#define BRDG_MCAST_PORTS 64 /* Ports of which membership of groups is tracked */
+#define BRDG_BPDU_MAX  16   /* Max number of queued BPDUs */
+#define BRDG_XMIT_MAX  256  /* Max number of queued frames of the bridge itself */
+
+/*
+ * 802.1Q VLAN
+ */
+#define BRDG_VLAN_MAX      4096     /* Number of VLAN IDs */
+#define BRDG_VLAN_DEFAULT  1        /* Default PVID of ports */
+#define BRDG_VLAN_TPID     0x8100   /* TPID of 802.1Q tag */
+#define BRDG_VLAN_VID(tci) ((tci) & 0x0fff)
+
+/*
+ * Tag of a frame given to bo_retag(). 0 if untagged, otherwise
+ * BRDG_TAG_PRESENT with TCI in lower 16 bits.
+ */
+#define BRDG_TAG_PRESENT   0x10000
+
+typedef struct brdg_s      brdg_t;
+typedef struct brdg_port_s brdg_port_t;
+
+/*
+ * Operations provided by the caller.
+ * 'cookie' is the value given to brdg_port_add(), 'frame' is the value
+ * given to brdg_input().
+ */
+typedef struct brdg_ops_s
+{
+    /*
+     * Return non-zero if the port can accept a frame now. Otherwise
+     * frames to the port are dropped and counted.
+     */
+    int    (*bo_canput)(void *cookie);
+    /* Transmit the frame to the port. The frame is consumed */
+    void   (*bo_xmit)(void *cookie, void *frame);
+    /* Duplicate the frame. Return NULL on failure */
+    void  *(*bo_dup)(void *frame);
+    /* Free the frame */
+    void   (*bo_free)(void *frame);
+    /*
+     * Arrange brdg_learn_run() to be called soon from a context which
+     * can take locks. Return non-zero on failure.
+     */
+    int    (*bo_schedule)(brdg_t *br);
+    /*
+     * Transmit frames to the port at once, in the order. Frames are
+     * consumed. Optional; bo_xmit() is used for each frame if NULL.
+     */
+    void   (*bo_xmit_chain)(void *cookie, void **frames, uint32_t count);
+    /*
+     * Change the 802.1Q tag of the frame from 'from' to 'to' (BRDG_TAG_XXX),
+     * i.e. insert, remove or rewrite the tag. The frame is consumed.
+     * Return the new frame, or NULL on failure. Optional; frames which need
+     * a different tag on the egress port are dropped if NULL.
+     */
+    void  *(*bo_retag)(void *frame, uint32_t from, uint32_t to);
+    /*
+     * Allocate a frame which has a copy of the data, to be sent by the
+     * bridge itself. Return NULL on failure. Optional; probes of loop
+     * detection are not sent, and RSTP is disabled if NULL.
+     */
+    void  *(*bo_alloc)(const uint8_t *data, size_t len);
+} brdg_ops_t;
+
+/*
+ * Frame given to brdg_input_batch().
+ */
+typedef struct brdg_frame_s
+{
+    void           *bf_frame;   /* Frame handle */
+    const uint8_t  *bf_hdr;     /* Ethernet header of the frame */
+    size_t         bf_len;      /* Length of contiguous data at bf_hdr */
+    size_t         bf_size;     /* Length of the whole frame */
+} brdg_frame_t;
+
+/*
+ * Statistics of a port.
+ * Counted for the ingress port unless noted.
+ */
+typedef enum brdg_stat_e
+{
+    BRDG_STAT_RX,           /* Frames received */
+    BRDG_STAT_FORWARD,      /* Frames forwarded to the port of the destination */
+    BRDG_STAT_FLOOD,        /* Frames flooded */
+    BRDG_STAT_MCAST,        /* Multicast frames sent to members of the group only */
+    BRDG_STAT_SNOOP,        /* IGMP/MLD messages snooped */
+    BRDG_STAT_BPDU,         /* BPDUs received by RSTP. Not forwarded */
+    BRDG_STAT_FILTER,       /* Frames not forwarded. Destination is on this port */
+    BRDG_STAT_DROP_SRC,     /* Frames dropped. Source is static or held down on another port */
+    BRDG_STAT_DROP_RUNT,    /* Frames dropped. Too short */
+    BRDG_STAT_DROP_VLAN,    /* Frames dropped. VLAN is not allowed on this port */
+    BRDG_STAT_DROP_BCAST,   /* Frames dropped. Over the broadcast storm limit */
+    BRDG_STAT_DROP_MCAST,   /* Frames dropped. Over the multicast storm limit */
+    BRDG_STAT_DROP_UNKNOWN, /* Frames dropped. Over the unknown unicast storm limit */
+    BRDG_STAT_DROP_BLOCKED, /* Frames dropped. Port is blocked by loop detection,
+                               is not forwarding by RSTP, its link is down, or it
+                               is shut down by the MAC limit */
+    BRDG_STAT_TX,           /* Egress. Frames sent to this port */
+    BRDG_STAT_DROP_FULL,    /* Egress. Frames dropped. Port could not accept */
+    BRDG_STAT_DROP_NOMEM,   /* Egress. Frames dropped. Duplicate or retag failed */
+    BRDG_STAT_LEARN,        /* Addresses registered on this port */
+    BRDG_STAT_MOVE,         /* Addresses moved to this port from another port */
+    BRDG_STAT_EVICT,        /* Addresses of this port replaced by another address */
+    BRDG_STAT_AGED,         /* Addresses of this port aged out */
+    BRDG_STAT_LINK_DOWN,    /* Link of this port went down */
+    BRDG_STAT_LIMIT,        /* Frames whose source was not learned. Over the MAC limit
+                               or the learn rate. Dropped unless BRDG_LIMIT_STOP */
+    BRDG_STAT_MAX
+} brdg_stat_t;
+
+extern const char *brdg_stat_name[BRDG_STAT_MAX];
+
+/*
+ * Configuration of the bridge.
+ */
+typedef struct brdg_conf_s
+{
+    uint32_t  bc_fdb_size;      /* Number of FDB entries */
+    uint32_t  bc_fdb_aging;     /* Aging time in seconds. 0 disables aging */
+    uint32_t  bc_sweep_buckets; /* Max buckets checked by one brdg_tick() */
+    uint64_t  bc_hash_key[2];   /* Key of the hash function. Should be random */
+    struct ether_addr bc_addr;  /* Address of the bridge. Should be random, and
+                                   must not be made of bc_hash_key */
+    uint32_t  bc_mcast_size;    /* Number of multicast groups. 0 disables snooping */
+    uint32_t  bc_mcast_timeout; /* Membership timeout in seconds */
+    uint32_t  bc_mcast_leave;   /* Membership timeout after a leave in seconds */
+    uint32_t  bc_mrouter_timeout; /* Router port timeout in seconds */
+    uint32_t  bc_storm_burst;   /* Burst of storm control in milliseconds */
+    uint32_t  bc_move_holddown; /* Seconds an address is not moved again after a move.
+                                   Less than 65536 */
+    uint32_t  bc_loop_flaps;    /* Flaps per second which block the port. 0 disables */
+    uint32_t  bc_loop_block;    /* Seconds the port is blocked for the first detection */
+    uint32_t  bc_loop_probe;    /* Interval of probes in seconds. 0 disables */
+    uint32_t  bc_stp;           /* Non-zero enables RSTP. Needs bo_alloc() */
+    uint32_t  bc_stp_priority;  /* Bridge priority of RSTP. Multiple of 4096 */
+} brdg_conf_t;
+
+/*
+ * Entry of the forwarding database read by brdg_fdb_read().
+ */
+typedef struct brdg_fdb_entry_s
+{
+    struct ether_addr be_addr;  /* Ethernet address */
+    uint16_t  be_vid;           /* VLAN ID */
+    uint16_t  be_flags;         /* BRDG_FDB_XXX */
+    void      *be_cookie;       /* Cookie of the port */
+    uint32_t  be_age;           /* Seconds since the address was seen */
+} brdg_fdb_entry_t;
+
+#define BRDG_FDB_STATIC 0x0001     /* Static entry. (See brdg_fdb_add_static()) */
+
+#define BRDG_FDB_END   0xffffffff  /* Cursor of brdg_fdb_read() after the last bucket */
+#define BRDG_FDB_SCAN  256         /* Max buckets read by one brdg_fdb_read() */
+
+/*
+ * Occupancy of the forwarding database. (See brdg_fdb_info())
+ */
+typedef struct brdg_fdb_info_s
+{
+    uint32_t  bi_nbucket;       /* Number of buckets */
+    uint32_t  bi_entries;       /* Entries in use */
+    uint32_t  bi_load[BRDG_FDB_WAYS + 1]; /* Number of buckets which have n entries */
+    uint64_t  bi_evict;         /* Sum of BRDG_STAT_EVICT of the ports */
+} brdg_fdb_info_t;
+
+/*
+ * Membership of a multicast group read by brdg_mcast_read().
+ */
+typedef struct brdg_mcast_entry_s
+{
+    struct ether_addr bm_addr;  /* Group address. Zero for a router port */
+    uint16_t  bm_vid;           /* VLAN ID. Zero for a router port */
+    uint16_t  bm_flags;         /* BRDG_MCAST_XXX */
+    void      *bm_cookie;       /* Cookie of the port */
+    uint32_t  bm_expire;        /* Seconds until the membership expires */
+} brdg_mcast_entry_t;
+
+#define BRDG_MCAST_ROUTER 0x0001   /* Router port. Queries were received */
+
+/*
+ * VLAN configuration of a port. (See brdg_port_vlan())
+ */
+#define BRDG_VLAN_TRUNK   0  /* Member of bv_member. Frames of PVID are untagged */
+#define BRDG_VLAN_ACCESS  1  /* Member of PVID only. Frames are untagged */
+
+typedef struct brdg_vlan_s
+{
+    uint32_t  bv_mode;          /* BRDG_VLAN_TRUNK or BRDG_VLAN_ACCESS */
+    uint16_t  bv_pvid;          /* VLAN of untagged frames */
+    uint8_t   bv_member[BRDG_VLAN_MAX / 8]; /* Bitmap of VLANs. Trunk only */
+} brdg_vlan_t;
+
+/*
+ * Storm control of a port. (See brdg_port_storm())
+ * Frames received on the port are limited for each class of frames.
+ */
+#define BRDG_STORM_BCAST    0   /* Broadcast */
+#define BRDG_STORM_MCAST    1   /* Multicast */
+#define BRDG_STORM_UNKNOWN  2   /* Unicast to unknown destinations. (flooded) */
+#define BRDG_STORM_MAX      3
+
+typedef struct brdg_storm_s
+{
+    uint32_t  bs_pps;           /* Frames per second. 0 for no limit */
+    uint32_t  bs_bps;           /* Bytes per second. 0 for no limit */
+} brdg_storm_t;
+
+/*
+ * MAC limit of a port. (See brdg_port_limit())
+ * Action when a frame from a new source address is over the limit.
+ */
+#define BRDG_LIMIT_STOP      0  /* The address is not learned. The frame is forwarded */
+#define BRDG_LIMIT_DROP      1  /* The address is not learned. The frame is dropped */
+#define BRDG_LIMIT_SHUTDOWN  2  /* Same as BRDG_LIMIT_DROP, and the port is shut down */
+
+typedef struct brdg_limit_s
+{
+    uint32_t  bm_max;           /* Max dynamic addresses on the port. 0 for no limit */
+    uint32_t  bm_rate;          /* New addresses learned per second. 0 for no limit */
+    uint32_t  bm_action;        /* BRDG_LIMIT_XXX */
+    /* Below are set by brdg_port_limit_get() */
+    uint32_t  bm_learned;       /* Dynamic addresses on the port */
+    uint32_t  bm_shutdown;      /* Non-zero if the port is shut down */
+} brdg_limit_t;
+
+/*
+ * Loop detected on a port, read by brdg_loop_read().
+ */
+#define BRDG_LOOP_FLAP    1   /* Source addresses flapped between ports */
+#define BRDG_LOOP_PROBE   2   /* A probe sent by the bridge came back */
+#define BRDG_LOOP_EVENTS  16  /* Number of detections kept */
+
+typedef struct brdg_loop_event_s
+{
+    void      *bl_cookie;       /* Cookie of the blocked port */
+    void      *bl_peer;         /* Cookie of the other port of the loop. NULL if unknown */
+    struct ether_addr bl_addr;  /* Address which flapped. Zero for BRDG_LOOP_PROBE */
+    uint16_t  bl_reason;        /* BRDG_LOOP_XXX */
+    uint32_t  bl_flaps;         /* Flaps in the second of the detection */
+    uint32_t  bl_age;           /* Seconds since the detection */
+    uint32_t  bl_block;         /* Seconds the port was blocked for */
+    uint32_t  bl_remain;        /* Seconds until the port is unblocked. 0 if not blocked */
+} brdg_loop_event_t;
+
+/*
+ * Rapid Spanning Tree Protocol. (See brdgstp.c)
+ * Ports which are not forwarding do not receive nor send frames other than
+ * BPDUs, and learning ports learn source addresses of received frames.
+ */
+#define BRDG_STP_DISCARDING     0
+#define BRDG_STP_LEARNING       1
+#define BRDG_STP_FORWARDING     2
+
+#define BRDG_STP_ROLE_DISABLED  0
+#define BRDG_STP_ROLE_ROOT      1   /* Toward the root bridge */
+#define BRDG_STP_ROLE_DESIGNATED 2  /* Away from the root bridge */
+#define BRDG_STP_ROLE_ALTERNATE 3   /* Other path to the root bridge */
+#define BRDG_STP_ROLE_BACKUP    4   /* Other port to a segment of this bridge */
+
+/*
+ * Bridge read by brdg_stp_info(). Bridge IDs have the priority in upper
+ * 16 bits and the address in lower 48 bits.
+ */
+typedef struct brdg_stp_info_s
+{
+    uint64_t  bs_bridge;        /* Bridge ID of this bridge */
+    uint64_t  bs_root;          /* Bridge ID of the root bridge */
+    uint32_t  bs_cost;          /* Root path cost */
+    void      *bs_root_port;    /* Cookie of the root port. NULL if this is the root */
+    uint32_t  bs_tc_count;      /* Topology changes detected or received */
+    uint32_t  bs_tc_age;        /* Seconds since the last topology change */
+} brdg_stp_info_t;
+
+/*
+ * RSTP of a port. (See brdg_port_stp())
+ */
+typedef struct brdg_stp_port_s
+{
+    uint32_t  bp_cost;          /* Path cost. 0 for the default */
+    uint16_t  bp_priority;      /* Port priority. Multiple of 16, less than 256 */
+    uint16_t  bp_edge;          /* Non-zero if the port is an edge port */
+    /* Below are set by brdg_port_stp_get() */
+    uint16_t  bp_id;            /* Port ID */
+    uint16_t  bp_role;          /* BRDG_STP_ROLE_XXX */
+    uint16_t  bp_state;         /* BRDG_STP_XXX */
+    uint16_t  bp_oper_edge;     /* Operating as an edge port */
+    uint64_t  bp_dbridge;       /* Designated bridge ID */
+    uint16_t  bp_dport;         /* Designated port ID */
+} brdg_stp_port_t;
+
+extern brdg_t      *brdg_create(const brdg_conf_t *, const brdg_ops_t *, void *);
+extern void         brdg_destroy(brdg_t *);
+extern void        *brdg_arg(brdg_t *);
+extern brdg_port_t *brdg_port_add(brdg_t *, void *);
+extern void         brdg_port_remove(brdg_t *, brdg_port_t *);
+extern void         brdg_port_link(brdg_t *, brdg_port_t *, int);
+extern void         brdg_input(brdg_t *, brdg_port_t *, void *, const uint8_t *, size_t);
+extern void         brdg_input_batch(brdg_t *, brdg_port_t *, brdg_frame_t *, uint32_t);
+extern void         brdg_learn_run(brdg_t *);
+extern void         brdg_tick(brdg_t *, uint64_t);
+extern void         brdg_port_stats(brdg_port_t *, uint64_t *);
+extern uint32_t     brdg_fdb_read(brdg_t *, uint32_t, brdg_fdb_entry_t *, uint32_t, uint32_t *);
+extern void         brdg_fdb_info(brdg_t *, brdg_fdb_info_t *);
+extern int          brdg_fdb_add_static(brdg_t *, const struct ether_addr *, uint16_t, brdg_port_t *);
+extern int          brdg_fdb_delete(brdg_t *, const struct ether_addr *, uint16_t);
+extern int          brdg_port_vlan(brdg_t *, brdg_port_t *, const brdg_vlan_t *);
+extern void         brdg_port_vlan_get(brdg_port_t *, brdg_vlan_t *);
+extern int          brdg_port_storm(brdg_t *, brdg_port_t *, uint32_t, const brdg_storm_t *);
+extern int          brdg_port_limit(brdg_t *, brdg_port_t *, const brdg_limit_t *);
+extern void         brdg_port_limit_get(brdg_t *, brdg_port_t *, brdg_limit_t *);
+extern uint32_t     brdg_mcast_read(brdg_t *, uint32_t, brdg_mcast_entry_t *, uint32_t, uint32_t *);
+extern uint32_t     brdg_loop_read(brdg_t *, brdg_loop_event_t *, uint32_t);
+extern int          brdg_stp_info(brdg_t *, brdg_stp_info_t *);
+extern int          brdg_port_stp(brdg_t *, brdg_port_t *, const brdg_stp_port_t *);
+extern int          brdg_port_stp_get(brdg_t *, brdg_port_t *, brdg_stp_port_t *);
+
+#endif /* __BRDGCORE_H */
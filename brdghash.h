@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2010 Kazuyoshi Aizawa. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/****************************************************************
+ * brdghash.h
+ *
+ * Hash function for ethernet addresses.
+ *
+ * The hash is SipHash-1-3 specialized for an 8 byte message of the
+ * ethernet address and the VLAN ID, keyed by a 128 bit random key
+ * chosen when the module is loaded. Without the
+ * key, a host can not predict which bucket its source address falls
+ * into, so it can not flood crafted addresses to evict chosen entries.
+ ***************************************************************/
+
+#ifndef __BRDGHASH_H
+#define __BRDGHASH_H
+
+#ifdef _KERNEL
+#include <sys/types.h>
+#else
+#include <stdint.h>
+#endif
+
+#define BRDG_HASH_ROTL(x, b)  (((x) << (b)) | ((x) >> (64 - (b))))
+
+#define BRDG_HASH_SIPROUND(v0, v1, v2, v3)      \
+    do {                                         \
+        v0 += v1; v1 = BRDG_HASH_ROTL(v1, 13);   \
+        v1 ^= v0; v0 = BRDG_HASH_ROTL(v0, 32);   \
+        v2 += v3; v3 = BRDG_HASH_ROTL(v3, 16);   \
+        v3 ^= v2;                                \
+        v0 += v3; v3 = BRDG_HASH_ROTL(v3, 21);   \
+        v3 ^= v0;                                \
+        v2 += v1; v1 = BRDG_HASH_ROTL(v1, 17);   \
+        v1 ^= v2; v2 = BRDG_HASH_ROTL(v2, 32);   \
+    } while (0)
+
+/*****************************************************************************
+ * brdg_mac_hash()
+ *
+ * Calculate a 32 bit hash value from ethernet address and VLAN ID.
+ *
+ *  Arguments:
+ *           mac :  6 octets of ethernet address
+ *           vid :  VLAN ID
+ *           key :  128 bit hash key
+ *  Return:
+ *           hash value
+ *****************************************************************************/
+static __inline uint32_t
+brdg_mac_hash(const uint8_t *mac, uint16_t vid, const uint64_t *key)
+{
+    uint64_t v0 = key[0] ^ 0x736f6d6570736575ULL;
+    uint64_t v1 = key[1] ^ 0x646f72616e646f6dULL;
+    uint64_t v2 = key[0] ^ 0x6c7967656e657261ULL;
+    uint64_t v3 = key[1] ^ 0x7465646279746573ULL;
+    uint64_t b;
+
+    /* One block of the message */
+    b = ((uint64_t)vid << 48) |
+        ((uint64_t)mac[5] << 40) | ((uint64_t)mac[4] << 32) |
+        ((uint64_t)mac[3] << 24) | ((uint64_t)mac[2] << 16) |
+        ((uint64_t)mac[1] << 8)  |  (uint64_t)mac[0];
+
+    v3 ^= b;
+    BRDG_HASH_SIPROUND(v0, v1, v2, v3);
+    v0 ^= b;
+
+    /* Final block: message length in the top byte */
+    b = (uint64_t)8 << 56;
+    v3 ^= b;
+    BRDG_HASH_SIPROUND(v0, v1, v2, v3);
+    v0 ^= b;
+
+    v2 ^= 0xff;
+    BRDG_HASH_SIPROUND(v0, v1, v2, v3);
+    BRDG_HASH_SIPROUND(v0, v1, v2, v3);
+    BRDG_HASH_SIPROUND(v0, v1, v2, v3);
+
+    b = v0 ^ v1 ^ v2 ^ v3;
+    return((uint32_t)(b ^ (b >> 32)));
+}
+
+#endif /* __BRDGHASH_H */
@@ -0,0 +1,346 @@
+/*
+ * Copyright (C) 2010 Kazuyoshi Aizawa. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/****************************************************************
+ * brdgio.h
+ *
+ * ioctl interface of brdg module, shared by the module and brdgadm.
+ *
+ * ioctls are sent by I_STR to a brdg module pushed on /dev/ip, which
+ * is a control stream and not a port of the bridge. They can be sent to
+ * the stream of a port as well, before it is linked under IP.
+ *
+ * BRDG_IOC_FDB_ADD and BRDG_IOC_FDB_DEL take brdg_ioc_fdb_entry_t, of
+ * which fe_addr, fe_vid and fe_port (for BRDG_IOC_FDB_ADD) are used.
+ * fe_vid 0 of BRDG_IOC_FDB_ADD means the PVID of the port.
+ * BRDG_IOC_PORT_ID takes uint32_t, which is set to the port number of
+ * the stream the ioctl is sent to.
+ * BRDG_IOC_PORT_SET takes brdg_ioc_port_entry_t. Sent to the stream of a
+ * port, pe_port is ignored and set to the port number of the stream.
+ ***************************************************************/
+
+#ifndef __BRDGIO_H
+#define __BRDGIO_H
+
+#include <sys/types.h>
+
+#define BRDG_IOC             ('B' << 8)
+#define BRDG_IOC_FDB_READ    (BRDG_IOC | 1)  /* Read a page of the FDB */
+#define BRDG_IOC_FDB_INFO    (BRDG_IOC | 2)  /* Occupancy of the FDB */
+#define BRDG_IOC_FDB_ADD     (BRDG_IOC | 3)  /* Add a static entry */
+#define BRDG_IOC_FDB_DEL     (BRDG_IOC | 4)  /* Delete an entry */
+#define BRDG_IOC_PORT_ID     (BRDG_IOC | 5)  /* Port number of the stream */
+#define BRDG_IOC_VLAN_SET    (BRDG_IOC | 6)  /* Set VLAN configuration of a port */
+#define BRDG_IOC_VLAN_GET    (BRDG_IOC | 7)  /* Get VLAN configuration of a port */
+#define BRDG_IOC_MCAST_READ  (BRDG_IOC | 8)  /* Read a page of multicast groups */
+#define BRDG_IOC_STORM_SET   (BRDG_IOC | 9)  /* Set storm control of a port */
+#define BRDG_IOC_PORT_SET    (BRDG_IOC | 10) /* Set interface name and mux ID of a port */
+#define BRDG_IOC_PORT_LIST   (BRDG_IOC | 11) /* Read a page of ports */
+#define BRDG_IOC_LOOP_READ   (BRDG_IOC | 12) /* Read recent detections of loops */
+#define BRDG_IOC_STP_SET     (BRDG_IOC | 13) /* Set RSTP of a port */
+#define BRDG_IOC_STP_READ    (BRDG_IOC | 14) /* Read RSTP of the bridge and a page of ports */
+#define BRDG_IOC_LIMIT_SET   (BRDG_IOC | 15) /* Set MAC limit of a port */
+#define BRDG_IOC_LIMIT_READ  (BRDG_IOC | 16) /* Read MAC limits of a page of ports */
+
+#define BRDG_IOC_FDB_PAGE    64         /* Max entries in one page */
+#define BRDG_IOC_FDB_END     0xffffffff /* Cursor after the last page */
+#define BRDG_IOC_MAXWAYS     8          /* Max ways of a bucket in fi_load[] */
+
+/*
+ * Entry of the forwarding database
+ */
+typedef struct brdg_ioc_fdb_entry_s
+{
+    uint8_t   fe_addr[6];   /* Ethernet address */
+    uint16_t  fe_flags;     /* BRDG_IOC_FDB_STATIC */
+    uint32_t  fe_port;      /* Port number. Instance of the kstat */
+    uint32_t  fe_age;       /* Seconds since the address was seen */
+    uint16_t  fe_vid;       /* VLAN ID */
+    uint16_t  fe_pad;
+} brdg_ioc_fdb_entry_t;
+
+#define BRDG_IOC_FDB_STATIC  0x0001 /* Static entry. Never aged or replaced */
+
+/*
+ * Filters of BRDG_IOC_FDB_READ
+ */
+#define BRDG_IOC_FDB_PORT    0x01   /* Entries of fr_port only */
+#define BRDG_IOC_FDB_PREFIX  0x02   /* Entries which begin with fr_prefix only */
+#define BRDG_IOC_FDB_VLAN    0x04   /* Entries in VLAN fr_vid only */
+
+/*
+ * Argument of BRDG_IOC_FDB_READ.
+ * Set fr_cursor to 0 to read the first page, and issue the ioctl again
+ * with the returned fr_cursor until it becomes BRDG_IOC_FDB_END.
+ * A page may have no entry even if it is not the last page.
+ */
+typedef struct brdg_ioc_fdb_read_s
+{
+    uint32_t  fr_cursor;     /* in/out: position in the forwarding database */
+    uint32_t  fr_filter;     /* in: BRDG_IOC_FDB_XXX */
+    uint32_t  fr_port;       /* in: port number for BRDG_IOC_FDB_PORT */
+    uint8_t   fr_prefix[6];  /* in: address prefix for BRDG_IOC_FDB_PREFIX */
+    uint8_t   fr_prefixlen;  /* in: length of fr_prefix in octets */
+    uint8_t   fr_pad;
+    uint16_t  fr_vid;        /* in: VLAN ID for BRDG_IOC_FDB_VLAN */
+    uint16_t  fr_pad2;
+    uint32_t  fr_count;      /* out: number of entries in fr_entry[] */
+    brdg_ioc_fdb_entry_t fr_entry[BRDG_IOC_FDB_PAGE];
+} brdg_ioc_fdb_read_t;
+
+/*
+ * Argument of BRDG_IOC_FDB_INFO.
+ */
+typedef struct brdg_ioc_fdb_info_s
+{
+    uint32_t  fi_nbucket;    /* Number of buckets */
+    uint32_t  fi_ways;       /* Entries in one bucket */
+    uint32_t  fi_entries;    /* Entries in use */
+    uint32_t  fi_aging;      /* Aging time in seconds */
+    uint32_t  fi_load[BRDG_IOC_MAXWAYS + 1]; /* Number of buckets which have n entries */
+    uint32_t  fi_pad;        /* Same layout for 32bit brdgadm */
+    uint64_t  fi_evict;      /* Entries replaced because the bucket was full */
+} brdg_ioc_fdb_info_t;
+
+/*
+ * Argument of BRDG_IOC_VLAN_SET and BRDG_IOC_VLAN_GET.
+ * An access port is a member of iv_pvid only, and frames are untagged.
+ * A trunk port is a member of VLANs in iv_member, and frames are tagged
+ * except frames of iv_pvid (native VLAN).
+ * Ports are trunk ports of all VLANs with PVID 1 when they are added.
+ */
+#define BRDG_IOC_VLAN_TRUNK  0
+#define BRDG_IOC_VLAN_ACCESS 1
+#define BRDG_IOC_VLAN_MAX    4096
+
+typedef struct brdg_ioc_vlan_s
+{
+    uint32_t  iv_port;       /* in: port number */
+    uint32_t  iv_mode;       /* BRDG_IOC_VLAN_XXX */
+    uint16_t  iv_pvid;       /* VLAN of untagged frames */
+    uint16_t  iv_pad;
+    uint8_t   iv_member[BRDG_IOC_VLAN_MAX / 8]; /* Bitmap of VLANs. Trunk only */
+} brdg_ioc_vlan_t;
+
+/*
+ * Membership of a multicast group learned by IGMP/MLD snooping.
+ * Router ports (ports where queries are received) have me_flags
+ * BRDG_IOC_MCAST_ROUTER and zero me_addr.
+ */
+typedef struct brdg_ioc_mcast_entry_s
+{
+    uint8_t   me_addr[6];   /* Group address */
+    uint16_t  me_flags;     /* BRDG_IOC_MCAST_ROUTER */
+    uint32_t  me_port;      /* Port number */
+    uint32_t  me_expire;    /* Seconds until the membership expires */
+    uint16_t  me_vid;       /* VLAN ID */
+    uint16_t  me_pad;
+} brdg_ioc_mcast_entry_t;
+
+#define BRDG_IOC_MCAST_ROUTER 0x0001
+
+/*
+ * Argument of BRDG_IOC_MCAST_READ. Used in the same way as
+ * BRDG_IOC_FDB_READ, with BRDG_IOC_FDB_END.
+ */
+#define BRDG_IOC_MCAST_PAGE  64         /* Max entries in one page */
+
+typedef struct brdg_ioc_mcast_read_s
+{
+    uint32_t  mr_cursor;     /* in/out: position in the group table */
+    uint32_t  mr_count;      /* out: number of entries in mr_entry[] */
+    brdg_ioc_mcast_entry_t mr_entry[BRDG_IOC_MCAST_PAGE];
+} brdg_ioc_mcast_read_t;
+
+/*
+ * Argument of BRDG_IOC_STORM_SET.
+ * Frames of the class received on the port are dropped while they are
+ * over is_pps frames per second or is_bps bytes per second.
+ */
+#define BRDG_IOC_STORM_BCAST   0    /* Broadcast */
+#define BRDG_IOC_STORM_MCAST   1    /* Multicast */
+#define BRDG_IOC_STORM_UNKNOWN 2    /* Unicast to unknown destinations */
+
+typedef struct brdg_ioc_storm_s
+{
+    uint32_t  is_port;       /* Port number */
+    uint32_t  is_class;      /* BRDG_IOC_STORM_XXX */
+    uint32_t  is_pps;        /* Frames per second. 0 for no limit */
+    uint32_t  is_bps;        /* Bytes per second. 0 for no limit */
+} brdg_ioc_storm_t;
+
+/*
+ * Port registered in brdg module. brdg module is the source of truth of
+ * the interfaces added by brdgadm. A port disappears when its stream is
+ * unlinked from IP.
+ * The name must be unique among ports. BRDG_IOC_PORT_SET fails with
+ * EEXIST if another port has the name.
+ * Link state is known if the driver sends DL_NOTIFY_IND, which brdgadm
+ * requests by DL_NOTIFY_REQ after brdg is pushed.
+ */
+#define BRDG_IOC_IFNAMSIZ    32     /* Same as LIFNAMSIZ */
+
+#define BRDG_IOC_LINK_UNKNOWN  0    /* No notification from the driver */
+#define BRDG_IOC_LINK_UP       1
+#define BRDG_IOC_LINK_DOWN     2
+
+typedef struct brdg_ioc_port_entry_s
+{
+    uint32_t  pe_port;       /* Port number */
+    uint32_t  pe_muxid;      /* Mux ID of I_PLINK. 0 before the port is linked */
+    uint32_t  pe_link;       /* out: BRDG_IOC_LINK_XXX */
+    char      pe_ifname[BRDG_IOC_IFNAMSIZ]; /* Interface name. Empty if not set */
+} brdg_ioc_port_entry_t;
+
+/*
+ * Argument of BRDG_IOC_PORT_LIST. Used in the same way as
+ * BRDG_IOC_FDB_READ, with BRDG_IOC_FDB_END. Ports are returned in
+ * order of the port number.
+ */
+#define BRDG_IOC_PORT_PAGE   64         /* Max entries in one page */
+
+typedef struct brdg_ioc_port_list_s
+{
+    uint32_t  pl_cursor;     /* in/out: port number to start from */
+    uint32_t  pl_count;      /* out: number of entries in pl_entry[] */
+    brdg_ioc_port_entry_t pl_entry[BRDG_IOC_PORT_PAGE];
+} brdg_ioc_port_list_t;
+
+/*
+ * Loop detected on a port. The port does not receive nor send frames
+ * for le_block seconds since the detection.
+ */
+#define BRDG_IOC_LOOP_FLAP   1      /* Addresses flapped between ports */
+#define BRDG_IOC_LOOP_PROBE  2      /* A probe sent by brdg module came back */
+#define BRDG_IOC_LOOP_EVENTS 16     /* Max detections kept */
+#define BRDG_IOC_PORT_NONE   0xffffffff /* Port is not known */
+
+typedef struct brdg_ioc_loop_entry_s
+{
+    uint32_t  le_port;       /* Port number of the blocked port */
+    uint32_t  le_peer;       /* Port number of the other port of the loop, or
+                                BRDG_IOC_PORT_NONE */
+    uint8_t   le_addr[6];    /* Address which flapped. Zero for BRDG_IOC_LOOP_PROBE */
+    uint16_t  le_reason;     /* BRDG_IOC_LOOP_XXX */
+    uint32_t  le_flaps;      /* Flaps in the second of the detection */
+    uint32_t  le_age;        /* Seconds since the detection */
+    uint32_t  le_block;      /* Seconds the port was blocked for */
+    uint32_t  le_remain;     /* Seconds until the port is unblocked. 0 if not blocked */
+} brdg_ioc_loop_entry_t;
+
+/*
+ * Argument of BRDG_IOC_LOOP_READ. Detections are returned from the newest.
+ */
+typedef struct brdg_ioc_loop_read_s
+{
+    uint32_t  lr_count;      /* out: number of entries in lr_entry[] */
+    brdg_ioc_loop_entry_t lr_entry[BRDG_IOC_LOOP_EVENTS];
+} brdg_ioc_loop_read_t;
+
+/*
+ * RSTP of a port. BRDG_IOC_STP_SET uses sp_port, sp_cost, sp_priority and
+ * sp_edge. Both fail with ENOTSUP if RSTP is disabled.
+ * Bridge IDs are the priority and the address in network byte order.
+ */
+#define BRDG_IOC_STP_DISCARDING   0
+#define BRDG_IOC_STP_LEARNING     1
+#define BRDG_IOC_STP_FORWARDING   2
+
+#define BRDG_IOC_STP_DISABLED     0
+#define BRDG_IOC_STP_ROOT         1
+#define BRDG_IOC_STP_DESIGNATED   2
+#define BRDG_IOC_STP_ALTERNATE    3
+#define BRDG_IOC_STP_BACKUP       4
+
+typedef struct brdg_ioc_stp_port_s
+{
+    uint32_t  sp_port;       /* Port number */
+    uint32_t  sp_cost;       /* Path cost. 0 for the default (20000) */
+    uint16_t  sp_priority;   /* Port priority. Multiple of 16, less than 256 */
+    uint16_t  sp_edge;       /* Non-zero for an edge port */
+    uint16_t  sp_id;         /* out: port ID */
+    uint16_t  sp_role;       /* out: BRDG_IOC_STP_XXX of the role */
+    uint16_t  sp_state;      /* out: BRDG_IOC_STP_XXX of the state */
+    uint16_t  sp_oper_edge;  /* out: operating as an edge port */
+    uint8_t   sp_dbridge[8]; /* out: designated bridge ID */
+    uint16_t  sp_dport;      /* out: designated port ID */
+    uint16_t  sp_pad;
+} brdg_ioc_stp_port_t;
+
+/*
+ * Argument of BRDG_IOC_STP_READ. Ports are read in the same way as
+ * BRDG_IOC_PORT_LIST.
+ */
+#define BRDG_IOC_STP_PAGE    64         /* Max entries in one page */
+
+typedef struct brdg_ioc_stp_read_s
+{
+    uint32_t  sr_cursor;     /* in/out: port number to start from */
+    uint32_t  sr_count;      /* out: number of entries in sr_entry[] */
+    uint8_t   sr_bridge[8];  /* out: bridge ID of this bridge */
+    uint8_t   sr_root[8];    /* out: bridge ID of the root bridge */
+    uint32_t  sr_cost;       /* out: root path cost */
+    uint32_t  sr_root_port;  /* out: port number of the root port, or
+                                BRDG_IOC_PORT_NONE if this is the root */
+    uint32_t  sr_tc_count;   /* out: topology changes */
+    uint32_t  sr_tc_age;     /* out: seconds since the last topology change */
+    brdg_ioc_stp_port_t sr_entry[BRDG_IOC_STP_PAGE];
+} brdg_ioc_stp_read_t;
+
+/*
+ * MAC limit of a port. Frames from a new source address are over the
+ * limit if lm_max dynamic addresses are on the port, or lm_rate addresses
+ * were learned in the last second. BRDG_IOC_LIMIT_SET uses lm_port, lm_max,
+ * lm_rate and lm_action, and brings back the port if it was shut down.
+ */
+#define BRDG_IOC_LIMIT_STOP      0  /* The address is not learned. The frame is forwarded */
+#define BRDG_IOC_LIMIT_DROP      1  /* The address is not learned. The frame is dropped */
+#define BRDG_IOC_LIMIT_SHUTDOWN  2  /* Same as DROP, and the port is shut down */
+
+typedef struct brdg_ioc_limit_s
+{
+    uint32_t  lm_port;       /* Port number */
+    uint32_t  lm_max;        /* Max dynamic addresses. 0 for no limit */
+    uint32_t  lm_rate;       /* New addresses per second. 0 for no limit */
+    uint32_t  lm_action;     /* BRDG_IOC_LIMIT_XXX */
+    uint32_t  lm_learned;    /* out: dynamic addresses on the port */
+    uint32_t  lm_shutdown;   /* out: non-zero if the port is shut down */
+    uint64_t  lm_over;       /* out: frames over the limit. "limit" of the kstat */
+} brdg_ioc_limit_t;
+
+/*
+ * Argument of BRDG_IOC_LIMIT_READ. Ports are read in the same way as
+ * BRDG_IOC_PORT_LIST.
+ */
+#define BRDG_IOC_LIMIT_PAGE  64         /* Max entries in one page */
+
+typedef struct brdg_ioc_limit_read_s
+{
+    uint32_t  ll_cursor;     /* in/out: port number to start from */
+    uint32_t  ll_count;      /* out: number of entries in ll_entry[] */
+    brdg_ioc_limit_t ll_entry[BRDG_IOC_LIMIT_PAGE];
+} brdg_ioc_limit_read_t;
+
+#endif /* __BRDGIO_H */
@@ -0,0 +1,669 @@
+/*
+ * Copyright (C) 2010 Kazuyoshi Aizawa. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/********************************************************************
+ * brdgpkt
+ *
+ * Userspace bridge for Linux.
+ *
+ * Bridges network interfaces with the forwarding core (brdgcore.c),
+ * using AF_PACKET sockets with memory mapped TPACKET_V3 RX and TX rings.
+ * Received frames are read in place in the RX ring and copied once into
+ * the TX ring of the egress port, without recvfrom(2)/sendto(2) copies.
+ * Prints frames/sec of each port and latency from reception (kernel
+ * timestamp) to queueing in the TX ring every interval.
+ *
+ * Usage:
+ *   brdgpkt [-i interval] [-b blocksize] [-n blocks] [-s fdbsize] [-r] if1 if2 ...
+ *
+ * Example with veth pairs in network namespaces:
+ *   ip netns add h1; ip netns add h2
+ *   ip link add v1 type veth peer name v1p netns h1
+ *   ip link add v2 type veth peer name v2p netns h2
+ *   ip -n h1 addr add 10.0.0.1/24 dev v1p; ip -n h1 link set v1p up
+ *   ip -n h2 addr add 10.0.0.2/24 dev v2p; ip -n h2 link set v2p up
+ *   ip link set v1 up; ip link set v2 up
+ *   ip netns exec h1 ethtool -K v1p tso off gso off
+ *   ip netns exec h2 ethtool -K v2p tso off gso off
+ *   brdgpkt v1 v2 &
+ *   ip netns exec h1 ping 10.0.0.2
+ *
+ * TCP segmentation offload must be disabled on the hosts as above, as
+ * frames larger than a TX ring frame (2048 bytes) are dropped.
+ *
+ *********************************************************************/
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include "brdgcore.h"
+
+#define TX_FRAME_SIZE   2048     /* Size of a frame in the TX ring */
+#define TX_DATA_OFFSET  (TPACKET3_HDRLEN - sizeof(struct sockaddr_ll))
+#define MAXIFS          64       /* Max number of interfaces */
+
+/*
+ * Port structure.
+ * One port structure corresponds to one interface.
+ */
+typedef struct pkt_port_s
+{
+    char         ifname[IFNAMSIZ];
+    int          fd;             /* AF_PACKET socket */
+    uint8_t      *map;           /* Mapped RX ring and TX ring */
+    size_t       maplen;
+    uint8_t      *rxring;
+    uint32_t     rxblock;        /* Next block of the RX ring */
+    uint8_t      *txring;
+    uint32_t     txframe;        /* Next frame of the TX ring */
+    uint32_t     txframes;       /* Number of frames in the TX ring */
+    int          txpending;      /* Frames are queued in the TX ring */
+    brdg_port_t  *bport;
+    uint64_t     rx;             /* Frames received */
+    uint64_t     rxdrop;         /* Frames dropped. Truncated */
+    uint64_t     tx;             /* Frames queued in the TX ring */
+    uint64_t     txdrop;         /* Frames dropped. TX ring full, too long */
+    int          link;           /* Link is up. (IFF_RUNNING) */
+} pkt_port_t;
+
+/*
+ * Frame handle given to the forwarding core.
+ * Data is in the RX ring, and is valid until the block is released.
+ * Frames sent by the core itself (pkt_alloc()) have data right after the
+ * handle, and are freed when the last reference is released.
+ */
+typedef struct pkt_frame_s
+{
+    uint8_t      *data;
+    uint32_t     len;
+    uint32_t     ref;
+    struct timespec ts;          /* Time of reception */
+} pkt_frame_t;
+
+/*
+ * Latency from reception to queueing in the TX ring
+ */
+typedef struct pkt_latency_s
+{
+    uint64_t     count;
+    uint64_t     sum;            /* nsec */
+    uint64_t     max;            /* nsec */
+} pkt_latency_t;
+
+int print_usage(char *);
+
+static uint32_t      block_size = 1 << 20;   /* Size of a block of the RX ring */
+static uint32_t      block_nr = 8;           /* Number of blocks in the RX ring */
+static pkt_port_t    ports[MAXIFS];
+static int           nport;
+static int           learn_pending;
+static pkt_latency_t latency;
+static volatile int  stop;
+
+static struct tpacket3_hdr *
+tx_frame(pkt_port_t *port, uint32_t index)
+{
+    return((struct tpacket3_hdr *)(port->txring + (size_t)index * TX_FRAME_SIZE));
+}
+
+/*
+ * Operations for the forwarding core
+ */
+static int
+pkt_canput(void *cookie)
+{
+    pkt_port_t *port = cookie;
+
+    return(tx_frame(port, port->txframe)->tp_status == TP_STATUS_AVAILABLE);
+}
+
+static void
+pkt_free(void *frame)
+{
+    pkt_frame_t *f = frame;
+
+    if (--f->ref == 0 && f->data == (uint8_t *)(f + 1))
+        free(f);
+}
+
+static void
+pkt_xmit(void *cookie, void *frame)
+{
+    pkt_port_t          *port = cookie;
+    pkt_frame_t         *f = frame;
+    struct tpacket3_hdr *hdr;
+    struct timespec     now;
+    uint64_t            nsec;
+
+    hdr = tx_frame(port, port->txframe);
+    if (hdr->tp_status == TP_STATUS_WRONG_FORMAT)
+        hdr->tp_status = TP_STATUS_AVAILABLE;
+    if (hdr->tp_status != TP_STATUS_AVAILABLE ||
+        f->len > TX_FRAME_SIZE - TX_DATA_OFFSET) {
+        port->txdrop++;
+        pkt_free(frame);
+        return;
+    }
+    memcpy((uint8_t *)hdr + TX_DATA_OFFSET, f->data, f->len);
+    hdr->tp_len = f->len;
+    __atomic_store_n(&hdr->tp_status, TP_STATUS_SEND_REQUEST, __ATOMIC_RELEASE);
+    port->txframe = (port->txframe + 1) % port->txframes;
+    port->txpending = 1;
+    port->tx++;
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    nsec = (now.tv_sec - f->ts.tv_sec) * 1000000000ULL +
+        now.tv_nsec - f->ts.tv_nsec;
+    latency.count++;
+    latency.sum += nsec;
+    if (nsec > latency.max)
+        latency.max = nsec;
+    pkt_free(frame);
+}
+
+static void *
+pkt_dup(void *frame)
+{
+    ((pkt_frame_t *)frame)->ref++;
+    return(frame);
+}
+
+static int
+pkt_schedule(brdg_t *br)
+{
+    (void) br;
+    learn_pending = 1;
+    return(0);
+}
+
+static void *
+pkt_alloc(const uint8_t *data, size_t len)
+{
+    pkt_frame_t *f;
+
+    if ((f = malloc(sizeof(pkt_frame_t) + len)) == NULL)
+        return(NULL);
+    f->data = (uint8_t *)(f + 1);
+    f->len = len;
+    f->ref = 1;
+    clock_gettime(CLOCK_REALTIME, &f->ts);
+    memcpy(f->data, data, len);
+    return(f);
+}
+
+static brdg_ops_t pkt_ops = {
+    pkt_canput,
+    pkt_xmit,
+    pkt_dup,
+    pkt_free,
+    pkt_schedule,
+    NULL,
+    NULL,
+    pkt_alloc
+};
+
+/*****************************************************************************
+ * port_open()
+ *
+ * Open AF_PACKET socket on the interface, and map RX and TX rings.
+ *****************************************************************************/
+static int
+port_open(pkt_port_t *port, char *ifname)
+{
+    struct tpacket_req3  rxreq, txreq;
+    struct sockaddr_ll   sll;
+    struct packet_mreq   mreq;
+    int                  ver = TPACKET_V3;
+    int                  ifindex;
+
+    strncpy(port->ifname, ifname, IFNAMSIZ - 1);
+    if ((ifindex = if_nametoindex(ifname)) == 0) {
+        perror(ifname);
+        return(-1);
+    }
+    if ((port->fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL))) < 0) {
+        perror("socket");
+        return(-1);
+    }
+    if (setsockopt(port->fd, SOL_PACKET, PACKET_VERSION, &ver, sizeof(ver)) < 0) {
+        perror("PACKET_VERSION");
+        return(-1);
+    }
+
+    memset(&rxreq, 0, sizeof(rxreq));
+    rxreq.tp_block_size = block_size;
+    rxreq.tp_block_nr = block_nr;
+    rxreq.tp_frame_size = TX_FRAME_SIZE;
+    rxreq.tp_frame_nr = (block_size / TX_FRAME_SIZE) * block_nr;
+    rxreq.tp_retire_blk_tov = 1;   /* msec. Hand over a block quickly */
+    if (setsockopt(port->fd, SOL_PACKET, PACKET_RX_RING, &rxreq, sizeof(rxreq)) < 0) {
+        perror("PACKET_RX_RING");
+        return(-1);
+    }
+
+    memset(&txreq, 0, sizeof(txreq));
+    txreq.tp_block_size = block_size;
+    txreq.tp_block_nr = block_nr;
+    txreq.tp_frame_size = TX_FRAME_SIZE;
+    txreq.tp_frame_nr = (block_size / TX_FRAME_SIZE) * block_nr;
+    if (setsockopt(port->fd, SOL_PACKET, PACKET_TX_RING, &txreq, sizeof(txreq)) < 0) {
+        perror("PACKET_TX_RING");
+        return(-1);
+    }
+
+    port->maplen = (size_t)block_size * block_nr * 2;
+    port->map = mmap(NULL, port->maplen, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_LOCKED, port->fd, 0);
+    if (port->map == MAP_FAILED) {
+        /* MAP_LOCKED may fail by RLIMIT_MEMLOCK */
+        port->map = mmap(NULL, port->maplen, PROT_READ | PROT_WRITE,
+            MAP_SHARED, port->fd, 0);
+        if (port->map == MAP_FAILED) {
+            perror("mmap");
+            return(-1);
+        }
+    }
+    port->rxring = port->map;
+    port->txring = port->map + (size_t)block_size * block_nr;
+    port->txframes = txreq.tp_frame_nr;
+
+    memset(&sll, 0, sizeof(sll));
+    sll.sll_family = AF_PACKET;
+    sll.sll_protocol = htons(ETH_P_ALL);
+    sll.sll_ifindex = ifindex;
+    if (bind(port->fd, (struct sockaddr *)&sll, sizeof(sll)) < 0) {
+        perror("bind");
+        return(-1);
+    }
+
+    memset(&mreq, 0, sizeof(mreq));
+    mreq.mr_ifindex = ifindex;
+    mreq.mr_type = PACKET_MR_PROMISC;
+    if (setsockopt(port->fd, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+        perror("PACKET_ADD_MEMBERSHIP");
+        return(-1);
+    }
+    return(0);
+}
+
+/*****************************************************************************
+ * port_link()
+ *
+ * Tell the forwarding core when the link of the interface went down or up,
+ * so that addresses on the port are flushed at once. Polled with the clock
+ * of the core.
+ *****************************************************************************/
+static void
+port_link(brdg_t *br, pkt_port_t *port)
+{
+    struct ifreq ifr;
+    int          up;
+
+    memset(&ifr, 0, sizeof(ifr));
+    snprintf(ifr.ifr_name, IFNAMSIZ, "%s", port->ifname);
+    if (ioctl(port->fd, SIOCGIFFLAGS, &ifr) < 0)
+        return;
+    up = (ifr.ifr_flags & IFF_RUNNING) != 0;
+    if (up == port->link)
+        return;
+    port->link = up;
+    brdg_port_link(br, port->bport, up);
+    fprintf(stderr, "%s: link %s\n", port->ifname, up ? "up" : "down");
+}
+
+/*****************************************************************************
+ * csum_fixup()
+ *
+ * Complete TCP/UDP checksum of the frame received with
+ * TP_STATUS_CSUMNOTREADY. Such frame is sent from a local stack with
+ * checksum offload (e.g. over veth), and the checksum field only has
+ * the sum of the pseudo header. It must be completed before the frame
+ * is forwarded to another interface.
+ *****************************************************************************/
+static void
+csum_fixup(uint8_t *frame, uint32_t len)
+{
+    uint8_t  *l4;
+    uint32_t  off, l4len, sum = 0, i;
+    uint16_t  type, csum;
+    uint8_t   proto;
+
+    if (len < ETHER_HDR_LEN)
+        return;
+    type = (frame[12] << 8) | frame[13];
+    off = ETHER_HDR_LEN;
+    if (type == ETHERTYPE_IP && len >= off + 20) {
+        proto = frame[off + 9];
+        off += (frame[off] & 0x0f) * 4;
+    } else if (type == ETHERTYPE_IPV6 && len >= off + 40) {
+        /* Extension headers are not expected with checksum offload */
+        proto = frame[off + 6];
+        off += 40;
+    } else {
+        return;
+    }
+    if (proto == IPPROTO_TCP)
+        csum = 16;
+    else if (proto == IPPROTO_UDP)
+        csum = 6;
+    else
+        return;
+    if (off + csum + 2 > len)
+        return;
+
+    l4 = frame + off;
+    l4len = len - off;
+    for (i = 0; i + 1 < l4len; i += 2)
+        sum += (l4[i] << 8) | l4[i + 1];
+    if (l4len & 1)
+        sum += l4[l4len - 1] << 8;
+    while (sum >> 16)
+        sum = (sum & 0xffff) + (sum >> 16);
+    sum = ~sum & 0xffff;
+    if (sum == 0 && proto == IPPROTO_UDP)
+        sum = 0xffff;
+    l4[csum] = sum >> 8;
+    l4[csum + 1] = sum;
+}
+
+/*****************************************************************************
+ * port_rx()
+ *
+ * Forward all frames in the ready blocks of the RX ring of the port.
+ *****************************************************************************/
+static void
+port_rx(brdg_t *br, pkt_port_t *port)
+{
+    struct tpacket_block_desc *bd;
+    struct tpacket3_hdr       *hdr, *next;
+    struct sockaddr_ll        *sll;
+    pkt_frame_t               frame[BRDG_BATCH];
+    brdg_frame_t              bf[BRDG_BATCH];
+    uint32_t                  i, n;
+
+    for (;;) {
+        bd = (struct tpacket_block_desc *)
+            (port->rxring + (size_t)port->rxblock * block_size);
+        if ((__atomic_load_n(&bd->hdr.bh1.block_status, __ATOMIC_ACQUIRE) &
+                TP_STATUS_USER) == 0)
+            break;
+
+        n = 0;
+        hdr = (struct tpacket3_hdr *)((uint8_t *)bd + bd->hdr.bh1.offset_to_first_pkt);
+        for (i = 0; i < bd->hdr.bh1.num_pkts; i++, hdr = next) {
+            next = (struct tpacket3_hdr *)((uint8_t *)hdr + hdr->tp_next_offset);
+            sll = (struct sockaddr_ll *)((uint8_t *)hdr +
+                TPACKET_ALIGN(sizeof(struct tpacket3_hdr)));
+            /* Frames sent by this host (or by us) are not forwarded */
+            if (sll->sll_pkttype == PACKET_OUTGOING)
+                continue;
+            /* Truncated by the ring. GSO frame larger than TX_FRAME_SIZE */
+            if (hdr->tp_snaplen != hdr->tp_len) {
+                port->rxdrop++;
+                continue;
+            }
+            frame[n].data = (uint8_t *)hdr + hdr->tp_mac;
+            frame[n].len = hdr->tp_snaplen;
+            frame[n].ref = 1;
+            frame[n].ts.tv_sec = hdr->tp_sec;
+            frame[n].ts.tv_nsec = hdr->tp_nsec;
+            if (hdr->tp_status & TP_STATUS_CSUMNOTREADY)
+                csum_fixup(frame[n].data, frame[n].len);
+            bf[n].bf_frame = &frame[n];
+            bf[n].bf_hdr = frame[n].data;
+            bf[n].bf_len = frame[n].len;
+            bf[n].bf_size = frame[n].len;
+            port->rx++;
+            if (++n == BRDG_BATCH) {
+                brdg_input_batch(br, port->bport, bf, n);
+                n = 0;
+            }
+        }
+        /* Frames must be forwarded before the block is released */
+        if (n > 0)
+            brdg_input_batch(br, port->bport, bf, n);
+
+        __atomic_store_n(&bd->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+        port->rxblock = (port->rxblock + 1) % block_nr;
+    }
+}
+
+/*****************************************************************************
+ * report()
+ *
+ * Print frames/sec of each port and latency since the last report.
+ *****************************************************************************/
+static void
+report(double elapsed)
+{
+    static uint64_t last_rx[MAXIFS], last_tx[MAXIFS];
+    static uint64_t last_rxdrop[MAXIFS], last_txdrop[MAXIFS];
+    uint64_t        rx = 0, tx = 0;
+    int             i;
+
+    for (i = 0; i < nport; i++) {
+        printf("%-10s rx %10.0f/s tx %10.0f/s rxdrop %llu txdrop %llu\n",
+            ports[i].ifname,
+            (ports[i].rx - last_rx[i]) / elapsed,
+            (ports[i].tx - last_tx[i]) / elapsed,
+            (unsigned long long)(ports[i].rxdrop - last_rxdrop[i]),
+            (unsigned long long)(ports[i].txdrop - last_txdrop[i]));
+        rx += ports[i].rx - last_rx[i];
+        tx += ports[i].tx - last_tx[i];
+        last_rx[i] = ports[i].rx;
+        last_tx[i] = ports[i].tx;
+        last_rxdrop[i] = ports[i].rxdrop;
+        last_txdrop[i] = ports[i].txdrop;
+    }
+    printf("total      rx %10.0f/s tx %10.0f/s latency avg %.1f usec max %.1f usec\n",
+        rx / elapsed, tx / elapsed,
+        latency.count ? latency.sum / 1000.0 / latency.count : 0.0,
+        latency.max / 1000.0);
+    fflush(stdout);
+    memset(&latency, 0, sizeof(latency));
+}
+
+static double
+now_sec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return(ts.tv_sec + ts.tv_nsec / 1000000000.0);
+}
+
+static void
+handle_signal(int sig)
+{
+    (void) sig;
+    stop = 1;
+}
+
+int
+main(int argc, char *argv[])
+{
+    int           c, i;
+    uint32_t      interval = 1;
+    brdg_conf_t   conf;
+    brdg_t        *br;
+    struct pollfd pfd[MAXIFS];
+    double        start, last, tick, now;
+    FILE          *fp;
+
+    memset(&conf, 0, sizeof(conf));
+    conf.bc_fdb_size = 4096;
+    conf.bc_fdb_aging = 300;
+    conf.bc_sweep_buckets = 256;
+    conf.bc_mcast_size = 512;
+    conf.bc_mcast_timeout = 260;
+    conf.bc_mcast_leave = 2;
+    conf.bc_mrouter_timeout = 255;
+    conf.bc_storm_burst = 200;
+    conf.bc_move_holddown = 1;
+    conf.bc_loop_flaps = 10;
+    conf.bc_loop_block = 10;
+    conf.bc_loop_probe = 2;
+    conf.bc_stp_priority = 32768;
+
+    while ((c = getopt(argc, argv, "i:b:n:s:r")) != EOF) {
+        switch (c) {
+            case 'i':
+                interval = atoi(optarg);
+                break;
+            case 'b':
+                block_size = atoi(optarg);
+                break;
+            case 'n':
+                block_nr = atoi(optarg);
+                break;
+            case 's':
+                conf.bc_fdb_size = atoi(optarg);
+                break;
+            case 'r':
+                conf.bc_stp = 1;
+                break;
+            default:
+                print_usage(argv[0]);
+                break;
+        }
+    }
+    if (argc - optind < 2 || argc - optind > MAXIFS || interval == 0 ||
+        block_size < TX_FRAME_SIZE || (block_size & (getpagesize() - 1)) ||
+        block_nr == 0)
+        print_usage(argv[0]);
+
+    if ((fp = fopen("/dev/urandom", "r")) == NULL ||
+        fread(conf.bc_hash_key, sizeof(conf.bc_hash_key), 1, fp) != 1 ||
+        fread(&conf.bc_addr, sizeof(conf.bc_addr), 1, fp) != 1) {
+        perror("/dev/urandom");
+        exit(1);
+    }
+    fclose(fp);
+
+    if ((br = brdg_create(&conf, &pkt_ops, NULL)) == NULL) {
+        fprintf(stderr, "brdg_create failed\n");
+        exit(1);
+    }
+    brdg_tick(br, (uint64_t)(now_sec() * 1000));
+
+    for (i = optind; i < argc; i++, nport++) {
+        if (port_open(&ports[nport], argv[i]) < 0)
+            exit(1);
+        if ((ports[nport].bport = brdg_port_add(br, &ports[nport])) == NULL) {
+            fprintf(stderr, "Too many ports\n");
+            exit(1);
+        }
+        ports[nport].link = 1;
+        port_link(br, &ports[nport]);
+        pfd[nport].fd = ports[nport].fd;
+        pfd[nport].events = POLLIN | POLLERR;
+    }
+
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+
+    start = last = tick = now_sec();
+    while (!stop) {
+        if (poll(pfd, nport, 100) < 0 && errno != EINTR) {
+            perror("poll");
+            break;
+        }
+        for (i = 0; i < nport; i++)
+            port_rx(br, &ports[i]);
+
+        if (learn_pending) {
+            learn_pending = 0;
+            brdg_learn_run(br);
+        }
+        /*
+         * Kick transmission of the frames queued in TX rings.
+         */
+        for (i = 0; i < nport; i++) {
+            if (ports[i].txpending) {
+                ports[i].txpending = 0;
+                if (sendto(ports[i].fd, NULL, 0, MSG_DONTWAIT, NULL, 0) < 0 &&
+                    errno != EAGAIN && errno != ENOBUFS)
+                    perror("sendto");
+            }
+        }
+
+        /*
+         * The clock of the core is advanced every 100ms, which is the
+         * resolution of storm control. Links are checked as well.
+         */
+        now = now_sec();
+        if (now - tick >= 0.1) {
+            brdg_tick(br, (uint64_t)(now * 1000));
+            for (i = 0; i < nport; i++)
+                port_link(br, &ports[i]);
+            tick = now;
+        }
+        if (now - last >= interval) {
+            report(now - last);
+            last = now;
+        }
+    }
+
+    printf("\n");
+    for (i = 0; i < nport; i++) {
+        printf("%-10s rx %llu tx %llu rxdrop %llu txdrop %llu\n",
+            ports[i].ifname,
+            (unsigned long long)ports[i].rx, (unsigned long long)ports[i].tx,
+            (unsigned long long)ports[i].rxdrop,
+            (unsigned long long)ports[i].txdrop);
+        brdg_port_remove(br, ports[i].bport);
+        munmap(ports[i].map, ports[i].maplen);
+        close(ports[i].fd);
+    }
+    printf("elapsed %.1f sec\n", now_sec() - start);
+    brdg_destroy(br);
+    exit(0);
+}
+
+int
+print_usage(char *argv)
+{
+    printf("Usage: %s [-i interval] [-b blocksize] [-n blocks] [-s fdbsize] [-r] if1 if2 ...\n", argv);
+    printf("Options:\n");
+    printf(" -i interval\t: Report interval in seconds (default 1)\n");
+    printf(" -b blocksize\t: Size of a block of the rings (default 1048576)\n");
+    printf(" -n blocks\t: Number of blocks of the rings (default 8)\n");
+    printf(" -s fdbsize\t: Number of FDB entries (default 4096)\n");
+    printf(" -r\t\t: Run RSTP\n");
+    exit(1);
+}
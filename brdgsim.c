@@ -0,0 +1,688 @@
+/*
+ * Copyright (C) 2010 Kazuyoshi Aizawa. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/********************************************************************
+ * brdgsim
+ *
+ * Synthetic traffic driver of the forwarding core.
+ *
+ * Runs the forwarding core (brdgcore.c) in userspace with virtual ports
+ * and virtual hosts. Every host first sends a broadcast so that it is
+ * learned, then random unicast and broadcast frames are sent between
+ * hosts. Prints forwarding rate, and counts frames which were delivered
+ * to unexpected ports. With -B, the frames are given to brdg_input_batch()
+ * at once instead of brdg_input() one by one. With -l, addresses learned
+ * on each port are limited, and frames from the other hosts are flooded.
+ * Forwarded frames are sent by bo_xmit_chain(), grouped by the egress
+ * port. The number of addresses the core counts for each port must match
+ * the entries read. Then the first port is removed, and the time it took
+ * and that its entries are gone are checked. At last, on another bridge,
+ * a host which migrated to another port must not be taken as a loop,
+ * while hosts which move back and forth must block a port, and a burst
+ * from one new host must not go over the learn rate of the port.
+ *
+ * Usage:
+ *   brdgsim [-p ports] [-n hosts] [-f frames] [-b broadcast%] [-s fdbsize] [-l max] [-B]
+ *
+ *********************************************************************/
+#include <sys/types.h>
+#include <sys/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "brdgcore.h"
+
+#define FRAME_LEN   64
+
+/*
+ * Frame of the simulation.
+ * Duplicates share the same frame with reference count, like dupmsg(9F).
+ * What is expected for the frame is checked when the last reference
+ * is freed.
+ */
+typedef struct sim_frame_s
+{
+    struct sim_frame_s *next;     /* Free list */
+    uint32_t   ref;
+    int        bcast;             /* Frame is broadcast */
+    uint32_t   sport;             /* Ingress port */
+    uint32_t   dport;             /* Port of the destination host */
+    uint32_t   delivered;         /* Number of ports the frame was sent to */
+    uint32_t   wrong;             /* Sent to other than destination port */
+    int        check;             /* Delivery is checked by frame_check() */
+    uint8_t    data[FRAME_LEN];
+} sim_frame_t;
+
+/*
+ * Virtual port
+ */
+typedef struct sim_port_s
+{
+    uint32_t     index;
+    brdg_port_t  *bport;
+    uint64_t     tx;              /* Frames transmitted to this port */
+} sim_port_t;
+
+int print_usage(char *);
+
+static sim_frame_t  *free_frames;
+static int          learn_pending;
+static uint32_t     nport = 4;
+static uint64_t     flooded;      /* Unicast frames which were flooded */
+static uint64_t     errors;       /* Frames delivered to unexpected ports */
+static uint64_t     chains;       /* Calls of bo_xmit_chain() */
+static uint64_t     chained;      /* Frames sent by bo_xmit_chain() */
+
+static sim_frame_t *
+frame_alloc(void)
+{
+    sim_frame_t *f;
+
+    if ((f = free_frames) != NULL)
+        free_frames = f->next;
+    else if ((f = malloc(sizeof(sim_frame_t))) == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    f->ref = 1;
+    f->delivered = 0;
+    f->wrong = 0;
+    f->check = 1;
+    return(f);
+}
+
+/*
+ * Broadcast must be sent to all other ports. Unicast must be sent only to
+ * the port of the destination, or flooded if the destination is not
+ * registered. (e.g. evicted from a full bucket)
+ */
+static void
+frame_check(sim_frame_t *f)
+{
+    if (!f->check)
+        return;
+    if (f->bcast) {
+        if (f->delivered != nport - 1)
+            errors++;
+    } else if (f->delivered == nport - 1 &&
+        (f->wrong != 0 || f->sport == f->dport)) {
+        flooded++;
+    } else if (f->wrong != 0 || f->delivered != (f->sport != f->dport)) {
+        errors++;
+    }
+}
+
+/*
+ * Operations for the forwarding core
+ */
+static int
+sim_canput(void *cookie)
+{
+    (void) cookie;
+    return(1);
+}
+
+static void
+sim_free(void *frame)
+{
+    sim_frame_t *f = frame;
+
+    if (--f->ref == 0) {
+        frame_check(f);
+        f->next = free_frames;
+        free_frames = f;
+    }
+}
+
+static void
+sim_xmit(void *cookie, void *frame)
+{
+    sim_port_t  *port = cookie;
+    sim_frame_t *f = frame;
+
+    port->tx++;
+    f->delivered++;
+    if (port->index == f->sport)
+        errors++;
+    else if (port->index != f->dport)
+        f->wrong++;
+    sim_free(frame);
+}
+
+static void *
+sim_dup(void *frame)
+{
+    ((sim_frame_t *)frame)->ref++;
+    return(frame);
+}
+
+static int
+sim_schedule(brdg_t *br)
+{
+    (void) br;
+    learn_pending = 1;
+    return(0);
+}
+
+static void
+sim_xmit_chain(void *cookie, void **frames, uint32_t count)
+{
+    uint32_t    i;
+
+    if (count == 0 || count > BRDG_BATCH)
+        errors++;
+    chains++;
+    chained += count;
+    for (i = 0; i < count; i++)
+        sim_xmit(cookie, frames[i]);
+}
+
+static brdg_ops_t sim_ops = {
+    sim_canput,
+    sim_xmit,
+    sim_dup,
+    sim_free,
+    sim_schedule,
+    sim_xmit_chain,
+    NULL,
+    NULL
+};
+
+static void
+host_mac(uint8_t *mac, uint32_t host)
+{
+    mac[0] = 0x02; mac[1] = 0;
+    mac[2] = host >> 24; mac[3] = host >> 16;
+    mac[4] = host >> 8;  mac[5] = host;
+}
+
+/*****************************************************************************
+ * make_frame()
+ *
+ * Make a frame from the host to the host (or broadcast if dst < 0)
+ *****************************************************************************/
+static sim_frame_t *
+make_frame(uint32_t src, int64_t dst)
+{
+    sim_frame_t *f = frame_alloc();
+
+    if (dst < 0)
+        memset(f->data, 0xff, ETHERADDRL);
+    else
+        host_mac(f->data, (uint32_t)dst);
+    host_mac(f->data + ETHERADDRL, src);
+
+    f->bcast = (dst < 0);
+    f->sport = src % nport;
+    f->dport = (dst < 0) ? 0 : (uint32_t)dst % nport;
+    return(f);
+}
+
+static void
+run_learn(brdg_t *br)
+{
+    if (learn_pending) {
+        learn_pending = 0;
+        brdg_learn_run(br);
+    }
+}
+
+/*****************************************************************************
+ * send_frame()
+ *
+ * Send a frame from the host to the host (or broadcast if dst < 0)
+ *****************************************************************************/
+static void
+send_frame(brdg_t *br, sim_port_t *ports, uint32_t src, int64_t dst)
+{
+    sim_frame_t *f = make_frame(src, dst);
+
+    brdg_input(br, ports[f->sport].bport, f, f->data, FRAME_LEN);
+    run_learn(br);
+}
+
+/*****************************************************************************
+ * send_batch()
+ *
+ * Send BRDG_BATCH random frames from hosts on a random port, one by one
+ * by brdg_input(), or at once by brdg_input_batch().
+ *****************************************************************************/
+static void
+send_batch(brdg_t *br, sim_port_t *ports, uint32_t nhost, uint32_t bcast,
+    int batch)
+{
+    brdg_frame_t bf[BRDG_BATCH];
+    sim_frame_t  *f;
+    uint32_t     port = random() % nport;
+    uint32_t     nsrc = (nhost - 1 - port) / nport + 1; /* Hosts on the port */
+    uint32_t     i;
+
+    for (i = 0; i < BRDG_BATCH; i++) {
+        if ((uint32_t)random() % 100 < bcast)
+            f = make_frame((random() % nsrc) * nport + port, -1);
+        else
+            f = make_frame((random() % nsrc) * nport + port, random() % nhost);
+        bf[i].bf_frame = f;
+        bf[i].bf_hdr = f->data;
+        bf[i].bf_len = FRAME_LEN;
+        bf[i].bf_size = FRAME_LEN;
+    }
+    if (batch) {
+        brdg_input_batch(br, ports[port].bport, bf, BRDG_BATCH);
+        run_learn(br);
+        return;
+    }
+    for (i = 0; i < BRDG_BATCH; i++) {
+        brdg_input(br, ports[port].bport, bf[i].bf_frame, bf[i].bf_hdr,
+            bf[i].bf_len);
+        run_learn(br);
+    }
+}
+
+/*****************************************************************************
+ * send_on()
+ *
+ * Send a broadcast from the host on the port, which may not be the port of
+ * the host. The address is not learned until run_learn() is called.
+ *****************************************************************************/
+static void
+send_on(brdg_t *br, sim_port_t *ports, uint32_t src, uint32_t port, int check)
+{
+    sim_frame_t *f = make_frame(src, -1);
+
+    f->sport = port;
+    f->check = check;
+    brdg_input(br, ports[port].bport, f, f->data, FRAME_LEN);
+}
+
+/*****************************************************************************
+ * new_bridge()
+ *
+ * Create a bridge with nport ports for the checks of a scenario.
+ *****************************************************************************/
+static brdg_t *
+new_bridge(const brdg_conf_t *conf, sim_port_t **portsp)
+{
+    brdg_t       *br;
+    sim_port_t   *ports;
+    uint32_t     i;
+
+    if ((br = brdg_create(conf, &sim_ops, NULL)) == NULL) {
+        fprintf(stderr, "brdg_create failed\n");
+        exit(1);
+    }
+    if ((ports = calloc(nport, sizeof(sim_port_t))) == NULL) {
+        perror("calloc");
+        exit(1);
+    }
+    for (i = 0; i < nport; i++) {
+        ports[i].index = i;
+        if ((ports[i].bport = brdg_port_add(br, &ports[i])) == NULL) {
+            fprintf(stderr, "brdg_port_add failed for port %u\n", i);
+            exit(1);
+        }
+    }
+    *portsp = ports;
+    return(br);
+}
+
+static void
+free_bridge(brdg_t *br, sim_port_t *ports)
+{
+    uint32_t     i;
+
+    for (i = 0; i < nport; i++)
+        brdg_port_remove(br, ports[i].bport);
+    brdg_destroy(br);
+    free(ports);
+}
+
+/*****************************************************************************
+ * check_moves()
+ *
+ * A host which moved to another port, e.g. a migrated virtual machine,
+ * must be moved once and must not be taken as a loop, however many frames
+ * it sent before the move was learned. Hosts which are seen on two ports
+ * by turns every second, as in a loop, must block a port.
+ *****************************************************************************/
+static void
+check_moves(const brdg_conf_t *conf)
+{
+    brdg_loop_event_t ev[BRDG_LOOP_EVENTS];
+    brdg_limit_t limit;
+    sim_port_t   *ports;
+    brdg_t       *br;
+    uint64_t     msec = 1000;
+    uint32_t     nev;
+    uint32_t     i, sec;
+
+    br = new_bridge(conf, &ports);
+    brdg_tick(br, msec);
+
+    send_on(br, ports, 0, 0, 1);
+    run_learn(br);
+    brdg_tick(br, msec += 1000);
+    for (i = 0; i < 150; i++)
+        send_on(br, ports, 0, 1, 1);
+    run_learn(br);
+    for (sec = 0; sec < 3; sec++)
+        brdg_tick(br, msec += 1000);
+    nev = brdg_loop_read(br, ev, BRDG_LOOP_EVENTS);
+    brdg_port_limit_get(br, ports[1].bport, &limit);
+    printf("migration: %u loop detections, %u addresses on the new port\n", nev,
+        limit.bm_learned);
+    if (nev != 0 || limit.bm_learned != 1)
+        errors++;
+
+    /* Frames are not delivered to the port once it is blocked */
+    for (sec = 0; sec < 4; sec++) {
+        for (i = 1; i <= 4 * conf->bc_loop_flaps; i++)
+            send_on(br, ports, i, sec % 2, 0);
+        run_learn(br);
+        brdg_tick(br, msec += 1000);
+    }
+    nev = brdg_loop_read(br, ev, BRDG_LOOP_EVENTS);
+    printf("loop: %u loop detections, %u flaps\n", nev, (nev != 0) ? ev[0].bl_flaps : 0);
+    if (nev == 0 || ev[0].bl_reason != BRDG_LOOP_FLAP)
+        errors++;
+
+    free_bridge(br, ports);
+}
+
+/*****************************************************************************
+ * check_limit()
+ *
+ * A burst of frames from one new host takes one token of the learn rate,
+ * and must not shut down the port. New hosts over the rate must shut down
+ * the port.
+ *****************************************************************************/
+static void
+check_limit(const brdg_conf_t *conf)
+{
+    brdg_limit_t limit;
+    sim_port_t   *ports;
+    brdg_t       *br;
+    uint64_t     stats[BRDG_STAT_MAX];
+    uint32_t     i;
+
+    br = new_bridge(conf, &ports);
+    brdg_tick(br, 1000);
+    memset(&limit, 0, sizeof(limit));
+    limit.bm_rate = 10;
+    limit.bm_action = BRDG_LIMIT_SHUTDOWN;
+    (void) brdg_port_limit(br, ports[0].bport, &limit);
+
+    for (i = 0; i < 2 * limit.bm_rate; i++)
+        send_on(br, ports, 0, 0, 1);
+    run_learn(br);
+    brdg_tick(br, 1000);
+    brdg_port_limit_get(br, ports[0].bport, &limit);
+    brdg_port_stats(ports[0].bport, stats);
+    printf("limit: burst of one host, %u learned, %llu over, shutdown %u\n",
+        limit.bm_learned, (unsigned long long)stats[BRDG_STAT_LIMIT],
+        limit.bm_shutdown);
+    if (limit.bm_learned != 1 || stats[BRDG_STAT_LIMIT] != 0 || limit.bm_shutdown)
+        errors++;
+
+    /* Frames over the limit are dropped */
+    for (i = 1; i <= 2 * limit.bm_rate; i++)
+        send_on(br, ports, i, 0, 0);
+    run_learn(br);
+    brdg_tick(br, 1000);
+    brdg_port_limit_get(br, ports[0].bport, &limit);
+    brdg_port_stats(ports[0].bport, stats);
+    printf("limit: %u new hosts, %llu over, shutdown %u\n", 2 * limit.bm_rate,
+        (unsigned long long)stats[BRDG_STAT_LIMIT], limit.bm_shutdown);
+    if (stats[BRDG_STAT_LIMIT] != limit.bm_rate + 1 || !limit.bm_shutdown)
+        errors++;
+
+    free_bridge(br, ports);
+}
+
+static double
+now_usec(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return((double)tv.tv_sec * 1000000.0 + tv.tv_usec);
+}
+
+/*
+ * Read all entries of the forwarding database. Returns the number of
+ * entries, and sets the number of entries of the port to nportp.
+ */
+static uint32_t
+fdb_count(brdg_t *br, sim_port_t *port, uint32_t *nportp)
+{
+    brdg_fdb_entry_t ent[BRDG_FDB_WAYS * 4];
+    uint32_t     cursor = 0, nent = 0, count, i;
+
+    *nportp = 0;
+    do {
+        cursor = brdg_fdb_read(br, cursor, ent, sizeof(ent) / sizeof(ent[0]), &count);
+        for (i = 0; i < count; i++) {
+            if (ent[i].be_cookie == port)
+                (*nportp)++;
+        }
+        nent += count;
+    } while (cursor != BRDG_FDB_END);
+    return(nent);
+}
+
+int
+main(int argc, char *argv[])
+{
+    int          c;
+    int          batch = 0;
+    uint32_t     nhost = 1024, bcast = 5, i;
+    uint64_t     nframe = 1000000, n;
+    brdg_conf_t  conf;
+    brdg_t       *br;
+    sim_port_t   *ports;
+    double       start, elapsed;
+    uint64_t     stats[BRDG_STAT_MAX];
+    uint64_t     forwarded = 0;
+    brdg_fdb_info_t  info;
+    brdg_limit_t limit;
+    uint32_t     nent, nremoved, nleft, nlearned;
+
+    memset(&conf, 0, sizeof(conf));
+    conf.bc_fdb_size = 4096;
+    conf.bc_fdb_aging = 300;
+    conf.bc_sweep_buckets = 256;
+    conf.bc_mcast_size = 512;
+    conf.bc_mcast_timeout = 260;
+    conf.bc_mcast_leave = 2;
+    conf.bc_mrouter_timeout = 255;
+    conf.bc_storm_burst = 200;
+    conf.bc_move_holddown = 1;
+    conf.bc_loop_flaps = 10;
+    conf.bc_loop_block = 10;
+
+    memset(&limit, 0, sizeof(limit));
+    limit.bm_action = BRDG_LIMIT_STOP;
+
+    while ((c = getopt(argc, argv, "p:n:f:b:s:l:B")) != EOF) {
+        switch (c) {
+            case 'p':
+                nport = atoi(optarg);
+                break;
+            case 'n':
+                nhost = atoi(optarg);
+                break;
+            case 'f':
+                nframe = strtoull(optarg, NULL, 10);
+                break;
+            case 'b':
+                bcast = atoi(optarg);
+                break;
+            case 's':
+                conf.bc_fdb_size = atoi(optarg);
+                break;
+            case 'l':
+                limit.bm_max = atoi(optarg);
+                break;
+            case 'B':
+                batch = 1;
+                break;
+            default:
+                print_usage(argv[0]);
+                break;
+        }
+    }
+    if (nport < 2 || nhost < nport || bcast > 100)
+        print_usage(argv[0]);
+
+    srandom(getpid() ^ (uint32_t)now_usec());
+    conf.bc_hash_key[0] = ((uint64_t)random() << 32) ^ random();
+    conf.bc_hash_key[1] = ((uint64_t)random() << 32) ^ random();
+    for (i = 0; i < ETHERADDRL; i++)
+        conf.bc_addr.ether_addr_octet[i] = (uint8_t)random();
+
+    if ((br = brdg_create(&conf, &sim_ops, NULL)) == NULL) {
+        fprintf(stderr, "brdg_create failed\n");
+        exit(1);
+    }
+    brdg_tick(br, 1000);
+
+    if ((ports = calloc(nport, sizeof(sim_port_t))) == NULL) {
+        perror("calloc");
+        exit(1);
+    }
+    for (i = 0; i < nport; i++) {
+        ports[i].index = i;
+        if ((ports[i].bport = brdg_port_add(br, &ports[i])) == NULL) {
+            fprintf(stderr, "brdg_port_add failed for port %u\n", i);
+            exit(1);
+        }
+        (void) brdg_port_limit(br, ports[i].bport, &limit);
+    }
+
+    /*
+     * Let every host be learned.
+     */
+    for (i = 0; i < nhost; i++)
+        send_frame(br, ports, i, -1);
+    errors = 0;
+    flooded = 0;
+    chains = 0;
+    chained = 0;
+
+    /*
+     * Random traffic
+     */
+    start = now_usec();
+    for (n = 0; n < nframe; n += BRDG_BATCH)
+        send_batch(br, ports, nhost, bcast, batch);
+    elapsed = now_usec() - start;
+
+    printf("ports %u, hosts %u, frames %llu, broadcast %u%%%s\n",
+        nport, nhost, (unsigned long long)n, bcast, batch ? ", batch" : "");
+    printf("elapsed %.3f sec, %.3f Mframes/sec, %.1f ns/frame\n",
+        elapsed / 1000000.0, n / elapsed, elapsed * 1000.0 / n);
+    for (i = 0; i < nport; i++) {
+        /* Statistics of the core must match what was seen here */
+        brdg_port_stats(ports[i].bport, stats);
+        printf("port %u: rx %llu tx %llu forward %llu flood %llu filter %llu\n", i,
+            (unsigned long long)stats[BRDG_STAT_RX],
+            (unsigned long long)ports[i].tx,
+            (unsigned long long)stats[BRDG_STAT_FORWARD],
+            (unsigned long long)stats[BRDG_STAT_FLOOD],
+            (unsigned long long)stats[BRDG_STAT_FILTER]);
+        if (stats[BRDG_STAT_TX] != ports[i].tx)
+            errors++;
+        forwarded += stats[BRDG_STAT_FORWARD];
+    }
+    printf("flooded unicast frames: %llu\n", (unsigned long long)flooded);
+    printf("chained frames: %llu in %llu chains\n", (unsigned long long)chained,
+        (unsigned long long)chains);
+    if (chained != forwarded)
+        errors++;
+    printf("misdelivered frames: %llu\n", (unsigned long long)errors);
+
+    /*
+     * Entries read in pages must match the occupancy of the table.
+     */
+    brdg_fdb_info(br, &info);
+    nent = fdb_count(br, &ports[0], &nremoved);
+    for (i = 0; i < nport; i++) {
+        (void) fdb_count(br, &ports[i], &nlearned);
+        brdg_port_limit_get(br, ports[i].bport, &limit);
+        if (limit.bm_learned != nlearned ||
+            (limit.bm_max != 0 && limit.bm_learned > limit.bm_max)) {
+            printf("port %u: %u addresses counted, %u read\n", i,
+                limit.bm_learned, nlearned);
+            errors++;
+        }
+    }
+    printf("fdb: %u entries in %u buckets, %u full buckets, %llu evicted\n",
+        info.bi_entries, info.bi_nbucket, info.bi_load[BRDG_FDB_WAYS],
+        (unsigned long long)info.bi_evict);
+    if (nent != info.bi_entries) {
+        printf("fdb: %u entries read\n", nent);
+        errors++;
+    }
+
+    /*
+     * Entries of the removed port must be gone at once, without scanning
+     * the forwarding database.
+     */
+    start = now_usec();
+    brdg_port_remove(br, ports[0].bport);
+    elapsed = now_usec() - start;
+    printf("remove: port with %u of %u entries in %.1f usec\n", nremoved, nent,
+        elapsed);
+    if (fdb_count(br, &ports[0], &nleft) != nent - nremoved || nleft != 0) {
+        printf("remove: %u entries of the port left\n", nleft);
+        errors++;
+    }
+
+    for (i = 1; i < nport; i++)
+        brdg_port_remove(br, ports[i].bport);
+    brdg_destroy(br);
+    free(ports);
+
+    check_moves(&conf);
+    check_limit(&conf);
+    printf("errors: %llu\n", (unsigned long long)errors);
+    exit(errors == 0 ? 0 : 1);
+}
+
+int
+print_usage(char *argv)
+{
+    printf("Usage: %s [-p ports] [-n hosts] [-f frames] [-b broadcast%%] [-s fdbsize] [-l max] [-B]\n", argv);
+    printf("Options:\n");
+    printf(" -p ports\t: Number of ports (default 4)\n");
+    printf(" -n hosts\t: Number of hosts (default 1024)\n");
+    printf(" -f frames\t: Number of frames (default 1000000)\n");
+    printf(" -b broadcast%%\t: Percentage of broadcast frames (default 5)\n");
+    printf(" -s fdbsize\t: Number of FDB entries (default 4096)\n");
+    printf(" -l max\t\t: Max addresses learned on each port (default no limit)\n");
+    printf(" -B\t\t: Use brdg_input_batch()\n");
+    exit(1);
+}
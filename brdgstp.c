@@ -0,0 +1,667 @@
+/*
+ * Copyright (C) 2010 Kazuyoshi Aizawa. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/*******************************************************
+ * brdgstp.c
+ *
+ * Rapid Spanning Tree Protocol (IEEE 802.1w) of the bridge.
+ *
+ * Roles of ports are selected from the best BPDU received on each port,
+ * and states of ports follow their roles. The root port forwards at once
+ * after the old root port discards. A designated port proposes to the
+ * bridge on the other side of the link, and forwards at once when the
+ * bridge agrees. The root port agrees to a proposal after the designated
+ * ports of this bridge are synced, i.e. discarding or agreed, so the
+ * agreement travels down the tree without waiting for timers. Designated
+ * ports which get no agreement forward after twice the forward delay, or
+ * become edge ports if no BPDU is received for STP_EDGE_DELAY seconds.
+ *
+ * When a port which is not an edge port starts forwarding, or a topology
+ * change is received on the root port or a designated port, addresses on
+ * the other ports except edge ports are flushed, and the change is sent
+ * to the other ports for a hello time.
+ *
+ * Lightweight implementation:
+ *   All links are regarded as point-to-point.
+ *   BPDUs of STP are accepted, but only RST BPDUs are sent. Ports toward
+ *   STP bridges forward by the timer.
+ *   Times of the bridge are fixed. (STP_HELLO, STP_MAX_AGE, STP_FWD_DELAY)
+ *   Disputed and TC acknowledge are not supported.
+ *
+ *******************************************************/
+
+#include "brdgstp.h"
+
+#define INFO_AGED        0      /* No information. The port is designated */
+#define INFO_MINE        1      /* Designated information of this bridge */
+#define INFO_RECEIVED    2      /* Information from the designated bridge */
+
+#define BPDU_CONFIG      0x00   /* Configuration BPDU of STP */
+#define BPDU_RST         0x02   /* RST BPDU */
+#define BPDU_TCN         0x80   /* Topology change notification of STP */
+#define BPDU_CONFIG_LEN  35
+#define BPDU_TCN_LEN     4
+
+/*
+ * Flags of BPDU
+ */
+#define FLAG_TC          0x01
+#define FLAG_PROPOSAL    0x02
+#define FLAG_ROLE        0x0c
+#define FLAG_ROLE_ALT    0x04   /* Alternate or backup port */
+#define FLAG_ROLE_ROOT   0x08
+#define FLAG_ROLE_DESIG  0x0c
+#define FLAG_LEARNING    0x10
+#define FLAG_FORWARDING  0x20
+#define FLAG_AGREEMENT   0x40
+
+#define GET16(p)         (((uint32_t)(p)[0] << 8) | (p)[1])
+#define GET32(p)         ((GET16(p) << 16) | GET16((p) + 2))
+#define GET64(p)         (((uint64_t)GET32(p) << 32) | GET32((p) + 4))
+
+/* Address part of a bridge ID */
+#define BRIDGE_ADDR(id)  ((id) & 0xffffffffffffULL)
+/* Port number part of a port ID */
+#define PORT_NUMBER(id)  ((id) & 0x0fff)
+
+static int  brdg_stp_cmp(const stp_vector_t *, const stp_vector_t *);
+static void brdg_stp_update(stp_t *);
+static void brdg_stp_state(stp_t *, stp_port_t *, uint32_t, int);
+static void brdg_stp_tc(stp_t *, stp_port_t *, int);
+static void brdg_stp_tx(stp_t *, stp_port_t *);
+static void brdg_stp_put(uint8_t *, uint64_t, int);
+
+/*****************************************************************************
+ * brdg_stp_init()
+ *
+ * Initialize the engine. This bridge is the root until a better bridge
+ * is known.
+ *
+ *  Arguments:
+ *           stp    :  engine
+ *           bridge :  bridge ID
+ *           ops    :  operations of the forwarding core
+ *           arg    :  bridge of the forwarding core
+ *****************************************************************************/
+void
+brdg_stp_init(stp_t *stp, uint64_t bridge, const stp_ops_t *ops, void *arg)
+{
+    bzero(stp, sizeof(stp_t));
+    stp->bridge = bridge;
+    stp->ops = *ops;
+    stp->arg = arg;
+    stp->root.root = bridge;
+    stp->root.bridge = bridge;
+    stp->times.max_age = STP_MAX_AGE;
+    stp->times.hello = STP_HELLO;
+    stp->times.fwd_delay = STP_FWD_DELAY;
+}
+
+/*****************************************************************************
+ * brdg_stp_port_add()
+ *
+ * Add the port, with the lowest port number which is not used. The port
+ * discards until the next brdg_stp_tick() selects its role.
+ *
+ *  Arguments:
+ *           stp  :  engine
+ *           sp   :  port to be initialized
+ *           arg  :  port of the forwarding core
+ *****************************************************************************/
+void
+brdg_stp_port_add(stp_t *stp, stp_port_t *sp, void *arg)
+{
+    stp_port_t *p;
+    uint16_t   number;
+
+    for (number = 1; number < 0x0fff; number++) {
+        for (p = stp->ports; p != NULL; p = p->next) {
+            if (PORT_NUMBER(p->id) == number)
+                break;
+        }
+        if (p == NULL)
+            break;
+    }
+    bzero(sp, sizeof(stp_port_t));
+    sp->arg = arg;
+    sp->id = (STP_PORT_PRIORITY << 8) | number;
+    sp->cost = STP_PORT_COST;
+    sp->enabled = 1;
+    sp->role = BRDG_STP_ROLE_DISABLED;
+    sp->state = BRDG_STP_DISCARDING;
+    sp->edge_while = STP_EDGE_DELAY;
+    sp->next = stp->ports;
+    stp->ports = sp;
+}
+
+/*****************************************************************************
+ * brdg_stp_port_remove()
+ *
+ * Remove the port. Roles of the other ports are selected again by the
+ * next brdg_stp_tick().
+ *****************************************************************************/
+void
+brdg_stp_port_remove(stp_t *stp, stp_port_t *sp)
+{
+    stp_port_t **pp;
+
+    for (pp = &stp->ports; *pp != NULL; pp = &(*pp)->next) {
+        if (*pp == sp) {
+            *pp = sp->next;
+            break;
+        }
+    }
+    if (stp->root_port == sp)
+        stp->root_port = NULL;
+}
+
+/*****************************************************************************
+ * brdg_stp_port_config()
+ *
+ * Set the path cost, the priority and the edge port of the port.
+ *
+ *  Arguments:
+ *           stp      :  engine
+ *           sp       :  port
+ *           cost     :  path cost. 0 for STP_PORT_COST
+ *           priority :  port priority. Multiple of 16, less than 256
+ *           edge     :  non-zero if the port is an edge port
+ *****************************************************************************/
+void
+brdg_stp_port_config(stp_t *stp, stp_port_t *sp, uint32_t cost,
+    uint32_t priority, int edge)
+{
+    sp->cost = (cost != 0) ? cost : STP_PORT_COST;
+    sp->id = ((priority & 0xf0) << 8) | PORT_NUMBER(sp->id);
+    sp->admin_edge = (edge != 0);
+    if (sp->admin_edge)
+        sp->oper_edge = 1;
+    brdg_stp_update(stp);
+}
+
+/*****************************************************************************
+ * brdg_stp_port_enable()
+ *
+ * Enable or disable the port when its link goes up or down. A disabled
+ * port discards, and roles of the other ports are selected at once
+ * without waiting for the information of the port to age out. An enabled
+ * port starts again as a new port.
+ *
+ *  Arguments:
+ *           stp     :  engine
+ *           sp      :  port
+ *           enabled :  non-zero if the link is up
+ *****************************************************************************/
+void
+brdg_stp_port_enable(stp_t *stp, stp_port_t *sp, int enabled)
+{
+    sp->enabled = (enabled != 0);
+    sp->info = INFO_AGED;
+    sp->proposing = 0;
+    sp->proposed = 0;
+    sp->agree = 0;
+    sp->agreed = 0;
+    sp->rcvd_while = 0;
+    sp->tc_while = 0;
+    sp->oper_edge = sp->admin_edge;
+    sp->edge_while = STP_EDGE_DELAY;
+    /* Addresses of the port are deleted by the caller */
+    if (!sp->enabled)
+        brdg_stp_state(stp, sp, BRDG_STP_DISCARDING, 0);
+    brdg_stp_update(stp);
+}
+
+/*****************************************************************************
+ * brdg_stp_input()
+ *
+ * Process the BPDU received on the port.
+ *
+ * Information of a designated port is stored if it is better than the
+ * information of the port, or is sent by the same designated port. A
+ * BPDU of a root port or an alternate port is an agreement to the
+ * proposal of the designated port of this bridge.
+ *
+ *  Arguments:
+ *           stp  :  engine
+ *           sp   :  port where the BPDU was received
+ *           bpdu :  BPDU, after the LLC header
+ *           len  :  length of bpdu
+ *****************************************************************************/
+void
+brdg_stp_input(stp_t *stp, stp_port_t *sp, const uint8_t *bpdu, size_t len)
+{
+    stp_vector_t msg;
+    stp_times_t  times;
+    uint32_t     flags;
+    int          c;
+
+    if (!sp->enabled || len < BPDU_TCN_LEN || GET16(bpdu) != 0)
+        return;
+    switch (bpdu[3]) {
+        case BPDU_TCN:
+            flags = FLAG_TC;
+            break;
+        case BPDU_CONFIG:
+            if (len < BPDU_CONFIG_LEN)
+                return;
+            flags = (bpdu[4] & FLAG_TC) | FLAG_ROLE_DESIG;
+            break;
+        case BPDU_RST:
+            if (len < STP_BPDU_LEN)
+                return;
+            flags = bpdu[4];
+            break;
+        default:
+            return;
+    }
+    /* The link has a bridge on the other side */
+    sp->edge_while = STP_EDGE_DELAY;
+    sp->oper_edge = 0;
+
+    if (bpdu[3] != BPDU_TCN) {
+        msg.root = GET64(&bpdu[5]);
+        msg.cost = GET32(&bpdu[13]);
+        msg.bridge = GET64(&bpdu[17]);
+        msg.port = GET16(&bpdu[25]);
+        times.age = GET16(&bpdu[27]) >> 8;
+        times.max_age = GET16(&bpdu[29]) >> 8;
+        times.hello = GET16(&bpdu[31]) >> 8;
+        times.fwd_delay = GET16(&bpdu[33]) >> 8;
+        if (times.age >= times.max_age)
+            return;
+        if (times.hello == 0)
+            times.hello = 1;
+
+        switch (flags & FLAG_ROLE) {
+            case FLAG_ROLE_DESIG:
+                c = brdg_stp_cmp(&msg, &sp->vec);
+                if (sp->info == INFO_AGED || c < 0 || (sp->info == INFO_RECEIVED &&
+                        msg.bridge == sp->vec.bridge &&
+                        PORT_NUMBER(msg.port) == PORT_NUMBER(sp->vec.port))) {
+                    if (sp->info != INFO_RECEIVED || c != 0) {
+                        sp->agreed = 0;
+                        sp->agree = 0;
+                    }
+                    sp->vec = msg;
+                    sp->times = times;
+                    sp->info = INFO_RECEIVED;
+                    sp->rcvd_while = 3 * times.hello;
+                    sp->proposed = (flags & FLAG_PROPOSAL) != 0;
+                } else if (sp->info == INFO_MINE) {
+                    /* Inferior. Tell ours to the bridge */
+                    sp->newinfo = 1;
+                }
+                break;
+            case FLAG_ROLE_ROOT:
+            case FLAG_ROLE_ALT:
+                if ((flags & FLAG_AGREEMENT) && sp->role == BRDG_STP_ROLE_DESIGNATED &&
+                    msg.root == stp->root.root) {
+                    sp->agreed = 1;
+                    sp->proposing = 0;
+                }
+                break;
+        }
+    }
+    if ((flags & FLAG_TC) && (sp->role == BRDG_STP_ROLE_ROOT ||
+            sp->role == BRDG_STP_ROLE_DESIGNATED))
+        brdg_stp_tc(stp, sp, 0);
+    brdg_stp_update(stp);
+}
+
+/*****************************************************************************
+ * brdg_stp_tick()
+ *
+ * Advance timers of ports. Called once a second.
+ *****************************************************************************/
+void
+brdg_stp_tick(stp_t *stp)
+{
+    stp_port_t *p;
+
+    stp->clock++;
+    for (p = stp->ports; p != NULL; p = p->next) {
+        p->tx_count = 0;
+        if (!p->enabled)
+            continue;
+        if (p->info == INFO_RECEIVED && p->rcvd_while != 0 && --p->rcvd_while == 0) {
+            p->info = INFO_AGED;
+            p->proposed = 0;
+        }
+        if (p->tc_while != 0)
+            p->tc_while--;
+        if (p->edge_while != 0)
+            p->edge_while--;
+        else if (p->role == BRDG_STP_ROLE_DESIGNATED && p->proposing && !p->oper_edge)
+            p->oper_edge = 1;
+        if (p->role == BRDG_STP_ROLE_DESIGNATED && !p->oper_edge && !p->agreed &&
+            p->state != BRDG_STP_FORWARDING && p->fd_while != 0 && --p->fd_while == 0) {
+            brdg_stp_state(stp, p, (p->state == BRDG_STP_DISCARDING) ?
+                BRDG_STP_LEARNING : BRDG_STP_FORWARDING, 0);
+            p->fd_while = stp->times.fwd_delay;
+        }
+        if (p->hello_when != 0)
+            p->hello_when--;
+        if (p->hello_when == 0 && (p->role == BRDG_STP_ROLE_DESIGNATED ||
+                (p->role == BRDG_STP_ROLE_ROOT && p->tc_while != 0))) {
+            p->newinfo = 1;
+            p->hello_when = stp->times.hello;
+        }
+    }
+    brdg_stp_update(stp);
+}
+
+/*****************************************************************************
+ * brdg_stp_cmp()
+ *
+ * Compare priority vectors.
+ *
+ *  Return:
+ *           negative if a is better, 0 if same, positive if b is better
+ *****************************************************************************/
+static int
+brdg_stp_cmp(const stp_vector_t *a, const stp_vector_t *b)
+{
+    if (a->root != b->root)
+        return(a->root < b->root ? -1 : 1);
+    if (a->cost != b->cost)
+        return(a->cost < b->cost ? -1 : 1);
+    if (a->bridge != b->bridge)
+        return(a->bridge < b->bridge ? -1 : 1);
+    if (a->port != b->port)
+        return(a->port < b->port ? -1 : 1);
+    return(0);
+}
+
+/*****************************************************************************
+ * brdg_stp_update()
+ *
+ * Select roles of ports, change states of ports by their roles, and send
+ * BPDUs which have new information.
+ *
+ * The root port is the port of the best vector received plus the path
+ * cost. A port is designated if the vector this bridge would send is
+ * better than the received one, a backup port if the received one is
+ * from this bridge, and an alternate port otherwise. When the root
+ * changes, designated ports which are not agreed stop forwarding until
+ * they agree to the new root (sync).
+ *****************************************************************************/
+static void
+brdg_stp_update(stp_t *stp)
+{
+    stp_port_t   *p;
+    stp_port_t   *root = NULL;
+    stp_vector_t best;
+    stp_vector_t vec;
+    uint32_t     role;
+    int          sync;
+    int          c;
+
+    best.root = stp->bridge;
+    best.cost = 0;
+    best.bridge = stp->bridge;
+    best.port = 0;
+    for (p = stp->ports; p != NULL; p = p->next) {
+        if (!p->enabled || p->info != INFO_RECEIVED ||
+            BRIDGE_ADDR(p->vec.bridge) == BRIDGE_ADDR(stp->bridge))
+            continue;
+        vec = p->vec;
+        vec.cost += p->cost;
+        if ((c = brdg_stp_cmp(&vec, &best)) < 0 ||
+            (c == 0 && root != NULL && p->id < root->id)) {
+            best = vec;
+            root = p;
+        }
+    }
+    sync = (root != stp->root_port || brdg_stp_cmp(&best, &stp->root) != 0);
+    stp->root = best;
+    stp->root_port = root;
+    if (root != NULL) {
+        stp->times = root->times;
+        stp->times.age++;
+    } else {
+        stp->times.age = 0;
+        stp->times.max_age = STP_MAX_AGE;
+        stp->times.hello = STP_HELLO;
+        stp->times.fwd_delay = STP_FWD_DELAY;
+    }
+
+    for (p = stp->ports; p != NULL; p = p->next) {
+        if (!p->enabled) {
+            role = BRDG_STP_ROLE_DISABLED;
+        } else if (p == root) {
+            role = BRDG_STP_ROLE_ROOT;
+        } else {
+            vec.root = best.root;
+            vec.cost = best.cost;
+            vec.bridge = stp->bridge;
+            vec.port = p->id;
+            if (p->info != INFO_RECEIVED || brdg_stp_cmp(&vec, &p->vec) <= 0) {
+                role = BRDG_STP_ROLE_DESIGNATED;
+                if (p->info != INFO_MINE || brdg_stp_cmp(&vec, &p->vec) != 0) {
+                    /* Agreement was for the old information */
+                    p->vec = vec;
+                    p->info = INFO_MINE;
+                    p->agreed = 0;
+                    p->newinfo = 1;
+                }
+            } else if (BRIDGE_ADDR(p->vec.bridge) == BRIDGE_ADDR(stp->bridge)) {
+                role = BRDG_STP_ROLE_BACKUP;
+            } else {
+                role = BRDG_STP_ROLE_ALTERNATE;
+            }
+        }
+        if (role != p->role) {
+            p->role = role;
+            p->agreed = 0;
+            p->proposing = 0;
+            if (role == BRDG_STP_ROLE_DESIGNATED) {
+                p->fd_while = stp->times.fwd_delay;
+                p->newinfo = 1;
+            }
+        }
+    }
+
+    /*
+     * Ports which are not root nor designated discard first, so that the
+     * new root port can forward at once. They agree to proposals at once,
+     * since they never forward.
+     */
+    for (p = stp->ports; p != NULL; p = p->next) {
+        if (p->role == BRDG_STP_ROLE_ROOT || p->role == BRDG_STP_ROLE_DESIGNATED)
+            continue;
+        brdg_stp_state(stp, p, BRDG_STP_DISCARDING, 1);
+        if (p->proposed && p->role != BRDG_STP_ROLE_DISABLED) {
+            p->agree = 1;
+            p->newinfo = 1;
+        }
+        p->proposed = 0;
+    }
+    if (root != NULL && root->proposed)
+        sync = 1;
+    for (p = stp->ports; p != NULL; p = p->next) {
+        if (p->role != BRDG_STP_ROLE_DESIGNATED)
+            continue;
+        p->proposed = 0;
+        if (p->oper_edge || p->agreed) {
+            p->proposing = 0;
+            brdg_stp_state(stp, p, BRDG_STP_FORWARDING, 0);
+            continue;
+        }
+        if (sync && p->state != BRDG_STP_DISCARDING) {
+            brdg_stp_state(stp, p, BRDG_STP_DISCARDING, 0);
+            p->fd_while = stp->times.fwd_delay;
+        }
+        if (p->state != BRDG_STP_FORWARDING && !p->proposing) {
+            p->proposing = 1;
+            p->newinfo = 1;
+        }
+    }
+    if (root != NULL) {
+        if (root->proposed) {
+            /* Designated ports are synced */
+            root->agree = 1;
+            root->newinfo = 1;
+            root->proposed = 0;
+        }
+        brdg_stp_state(stp, root, BRDG_STP_FORWARDING, 0);
+    }
+
+    for (p = stp->ports; p != NULL; p = p->next) {
+        if (!p->newinfo)
+            continue;
+        if (p->role == BRDG_STP_ROLE_DESIGNATED || p->agree ||
+            (p->role == BRDG_STP_ROLE_ROOT && p->tc_while != 0))
+            brdg_stp_tx(stp, p);
+        else
+            p->newinfo = 0;
+    }
+}
+
+/*****************************************************************************
+ * brdg_stp_state()
+ *
+ * Change the state of the port. A port which is not an edge port starting
+ * to forward is a topology change.
+ *
+ *  Arguments:
+ *           stp   :  engine
+ *           sp    :  port
+ *           state :  BRDG_STP_XXX
+ *           flush :  delete addresses of the port if it stops learning
+ *****************************************************************************/
+static void
+brdg_stp_state(stp_t *stp, stp_port_t *sp, uint32_t state, int flush)
+{
+    uint32_t old = sp->state;
+
+    if (old == state)
+        return;
+    sp->state = state;
+    stp->ops.so_state(stp, sp, state);
+    if (state == BRDG_STP_DISCARDING && flush && !sp->oper_edge)
+        stp->ops.so_flush(stp, sp, 0);
+    if (state == BRDG_STP_FORWARDING && !sp->oper_edge)
+        brdg_stp_tc(stp, sp, 1);
+}
+
+/*****************************************************************************
+ * brdg_stp_tc()
+ *
+ * Topology change was detected on the port, or received on the port.
+ * Addresses on the other ports which are not edge ports are deleted, and
+ * the change is sent to the root port and designated ports but the port
+ * where it was received.
+ *
+ *  Arguments:
+ *           stp      :  engine
+ *           sp       :  port
+ *           detected :  non-zero if detected on the port
+ *****************************************************************************/
+static void
+brdg_stp_tc(stp_t *stp, stp_port_t *sp, int detected)
+{
+    stp_port_t *p;
+
+    stp->tc_count++;
+    stp->tc_time = stp->clock;
+    stp->ops.so_flush(stp, sp, 1);
+    for (p = stp->ports; p != NULL; p = p->next) {
+        if (!p->enabled || p->oper_edge || (p == sp && !detected))
+            continue;
+        if (p->role != BRDG_STP_ROLE_ROOT && p->role != BRDG_STP_ROLE_DESIGNATED)
+            continue;
+        p->tc_while = stp->times.hello + 1;
+        p->newinfo = 1;
+    }
+}
+
+/*****************************************************************************
+ * brdg_stp_tx()
+ *
+ * Send RST BPDU to the port, unless STP_TX_HOLD BPDUs have been sent in
+ * this second. Then it is sent by the next brdg_stp_tick().
+ *****************************************************************************/
+static void
+brdg_stp_tx(stp_t *stp, stp_port_t *sp)
+{
+    uint8_t   bpdu[STP_BPDU_LEN];
+    uint8_t   flags = 0;
+
+    if (sp->tx_count >= STP_TX_HOLD)
+        return;
+    if (sp->tc_while != 0)
+        flags |= FLAG_TC;
+    switch (sp->role) {
+        case BRDG_STP_ROLE_ROOT:
+            flags |= FLAG_ROLE_ROOT;
+            break;
+        case BRDG_STP_ROLE_DESIGNATED:
+            flags |= FLAG_ROLE_DESIG;
+            if (sp->proposing)
+                flags |= FLAG_PROPOSAL;
+            break;
+        default:
+            flags |= FLAG_ROLE_ALT;
+            break;
+    }
+    if (sp->agree)
+        flags |= FLAG_AGREEMENT;
+    if (sp->state != BRDG_STP_DISCARDING)
+        flags |= FLAG_LEARNING;
+    if (sp->state == BRDG_STP_FORWARDING)
+        flags |= FLAG_FORWARDING;
+
+    bzero(bpdu, sizeof(bpdu));
+    bpdu[2] = 2;            /* Version */
+    bpdu[3] = BPDU_RST;
+    bpdu[4] = flags;
+    brdg_stp_put(&bpdu[5], stp->root.root, 8);
+    brdg_stp_put(&bpdu[13], stp->root.cost, 4);
+    brdg_stp_put(&bpdu[17], stp->bridge, 8);
+    brdg_stp_put(&bpdu[25], sp->id, 2);
+    brdg_stp_put(&bpdu[27], stp->times.age << 8, 2);
+    brdg_stp_put(&bpdu[29], stp->times.max_age << 8, 2);
+    brdg_stp_put(&bpdu[31], stp->times.hello << 8, 2);
+    brdg_stp_put(&bpdu[33], stp->times.fwd_delay << 8, 2);
+
+    sp->tx_count++;
+    sp->newinfo = 0;
+    sp->agree = 0;
+    stp->ops.so_xmit(stp, sp, bpdu, sizeof(bpdu));
+}
+
+/*****************************************************************************
+ * brdg_stp_put()
+ *
+ * Store the value in network byte order.
+ *****************************************************************************/
+static void
+brdg_stp_put(uint8_t *p, uint64_t val, int len)
+{
+    while (len-- > 0) {
+        p[len] = (uint8_t)val;
+        val >>= 8;
+    }
+}
@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2010 Kazuyoshi Aizawa. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/****************************************************************
+ * brdgstp.h
+ *
+ * Rapid Spanning Tree Protocol engine, used by the forwarding core.
+ *
+ * The engine does not know the forwarding core. It is called with
+ * fdb_lock of the bridge held, and changes states of ports, flushes
+ * addresses and sends BPDUs through stp_ops_t.
+ ***************************************************************/
+
+#ifndef __BRDGSTP_H
+#define __BRDGSTP_H
+
+#include "brdgcore.h"
+
+#define STP_BPDU_LEN       36      /* Length of RST BPDU */
+#define STP_HELLO          2       /* Hello time in seconds */
+#define STP_MAX_AGE        20      /* Max age in seconds */
+#define STP_FWD_DELAY      15      /* Forward delay in seconds */
+#define STP_EDGE_DELAY     3       /* Seconds without BPDU until a port is an edge port */
+#define STP_TX_HOLD        6       /* Max BPDUs sent to a port in a second */
+#define STP_PORT_COST      20000   /* Default path cost. 1Gb/s */
+#define STP_PORT_PRIORITY  128     /* Default port priority */
+
+typedef struct stp_s      stp_t;
+typedef struct stp_port_s stp_port_t;
+
+/*
+ * Operations provided by the forwarding core.
+ */
+typedef struct stp_ops_s
+{
+    /* Change the state of the port to BRDG_STP_XXX */
+    void   (*so_state)(stp_t *stp, stp_port_t *port, uint32_t state);
+    /*
+     * Delete dynamic addresses of the port. If 'others', delete them of
+     * all ports but the port and edge ports instead.
+     */
+    void   (*so_flush)(stp_t *stp, stp_port_t *port, int others);
+    /* Send the BPDU to the port */
+    void   (*so_xmit)(stp_t *stp, stp_port_t *port, const uint8_t *bpdu, size_t len);
+} stp_ops_t;
+
+/*
+ * Priority vector. Smaller is better.
+ */
+typedef struct stp_vector_s
+{
+    uint64_t  root;             /* Root bridge ID */
+    uint32_t  cost;             /* Root path cost */
+    uint64_t  bridge;           /* Designated bridge ID */
+    uint16_t  port;             /* Designated port ID */
+} stp_vector_t;
+
+/*
+ * Times in seconds
+ */
+typedef struct stp_times_s
+{
+    uint16_t  age;              /* Message age */
+    uint16_t  max_age;
+    uint16_t  hello;
+    uint16_t  fwd_delay;
+} stp_times_t;
+
+/*
+ * Port of the engine. Timers are in seconds, and count down to 0.
+ */
+struct stp_port_s
+{
+    stp_port_t *next;
+    void      *arg;             /* Port of the forwarding core */
+    uint16_t  id;               /* Port ID. Priority and port number */
+    uint32_t  cost;             /* Path cost */
+    uint8_t   enabled;          /* Port can be used */
+    uint8_t   admin_edge;       /* Edge port set by the administrator */
+    uint8_t   oper_edge;        /* Operating as an edge port */
+    uint8_t   role;             /* BRDG_STP_ROLE_XXX */
+    uint8_t   state;            /* BRDG_STP_XXX */
+    uint8_t   info;             /* INFO_XXX. Origin of vec */
+    uint8_t   proposing;        /* Designated port is proposing to forward */
+    uint8_t   proposed;         /* Proposal was received */
+    uint8_t   agree;            /* Agreement is to be sent */
+    uint8_t   agreed;           /* Agreement was received */
+    uint8_t   newinfo;          /* BPDU is to be sent */
+    stp_vector_t vec;           /* Port priority vector */
+    stp_times_t  times;         /* Times received with vec */
+    uint16_t  rcvd_while;       /* Until received information ages out */
+    uint16_t  fd_while;         /* Until the next state by forward delay */
+    uint16_t  tc_while;         /* Until topology change is no longer sent */
+    uint16_t  hello_when;       /* Until the next periodic BPDU */
+    uint16_t  edge_while;       /* Until the port becomes an edge port */
+    uint16_t  tx_count;         /* BPDUs sent in this second */
+};
+
+/*
+ * Bridge of the engine
+ */
+struct stp_s
+{
+    uint64_t  bridge;           /* Bridge ID. Priority and address */
+    stp_vector_t root;          /* Root priority vector */
+    stp_times_t  times;         /* Times of the root */
+    stp_port_t *root_port;      /* Root port. NULL if this bridge is the root */
+    stp_port_t *ports;          /* All ports */
+    stp_ops_t ops;
+    void      *arg;             /* Bridge of the forwarding core */
+    uint32_t  clock;            /* Seconds. Advanced by brdg_stp_tick() */
+    uint32_t  tc_count;         /* Topology changes detected or received */
+    uint32_t  tc_time;          /* clock of the last topology change */
+};
+
+extern void  brdg_stp_init(stp_t *, uint64_t, const stp_ops_t *, void *);
+extern void  brdg_stp_port_add(stp_t *, stp_port_t *, void *);
+extern void  brdg_stp_port_remove(stp_t *, stp_port_t *);
+extern void  brdg_stp_port_config(stp_t *, stp_port_t *, uint32_t, uint32_t, int);
+extern void  brdg_stp_port_enable(stp_t *, stp_port_t *, int);
+extern void  brdg_stp_input(stp_t *, stp_port_t *, const uint8_t *, size_t);
+extern void  brdg_stp_tick(stp_t *);
+
+#endif /* __BRDGSTP_H */
@@ -0,0 +1,525 @@
+/*
+ * Copyright (C) 2010 Kazuyoshi Aizawa. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/********************************************************************
+ * brdgstpsim
+ *
+ * Convergence test of RSTP of the forwarding core.
+ *
+ * Runs bridges of the forwarding core (brdgcore.c) in userspace, which
+ * are connected in a ring with chords across the ring. Every bridge has
+ * an edge port with a host. Frames on links are delivered in the next
+ * step of 10 milliseconds of the virtual clock.
+ *
+ * The time until ports which forward on both ends of links form a
+ * spanning tree is measured from the start, after a link of the root
+ * bridge is cut, and after the link is restored. Then a broadcast of
+ * each host must reach every other host exactly once. Bridges are told
+ * that the link went down (brdg_port_link()), or with -s, the link is
+ * cut silently and the bridges notice it when the information ages out.
+ *
+ * Usage:
+ *   brdgstpsim [-n bridges] [-c chords] [-t timeout] [-s]
+ *
+ *********************************************************************/
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "brdgcore.h"
+
+#define MAXBRIDGE   64
+#define MAXLINK     (MAXBRIDGE * 2)
+#define QUEUE_LEN   256          /* Frames on a link in a direction */
+#define FRAME_MAX   128
+#define STEP_MSEC   10
+#define TEST_ETHERTYPE 0x88b5    /* Broadcast of hosts. (Local experimental) */
+
+/*
+ * Frame of the simulation.
+ * Duplicates share the same frame with reference count, like dupmsg(9F).
+ */
+typedef struct sim_frame_s
+{
+    uint32_t   ref;
+    uint32_t   len;
+    uint8_t    data[FRAME_MAX];
+} sim_frame_t;
+
+typedef struct sim_bridge_s sim_bridge_t;
+
+/*
+ * Virtual port. A port of a link queues frames to the peer, and a host
+ * port counts broadcasts received by the host.
+ */
+typedef struct sim_port_s
+{
+    sim_bridge_t       *bridge;
+    brdg_port_t        *bport;
+    struct sim_port_s  *peer;     /* Other end of the link. NULL for a host */
+    int                up;        /* Link is up */
+    uint32_t           received;  /* Host: broadcasts of hosts received */
+    sim_frame_t        *queue[QUEUE_LEN]; /* Frames to be received */
+    uint32_t           head;
+    uint32_t           count;
+} sim_port_t;
+
+struct sim_bridge_s
+{
+    uint32_t    index;
+    brdg_t      *br;
+    int         pending;          /* brdg_learn_run() is scheduled */
+    sim_port_t  host;
+};
+
+/*
+ * Link between two bridges
+ */
+typedef struct sim_link_s
+{
+    sim_port_t  end[2];
+} sim_link_t;
+
+int print_usage(char *);
+
+static sim_bridge_t bridges[MAXBRIDGE];
+static sim_link_t   links[MAXLINK];
+static uint32_t     nbridge = 4;
+static uint32_t     nlink;
+static uint64_t     msclock = 1000;
+static uint64_t     overflow;     /* Frames dropped by full queues */
+static int          silent;       /* Links are cut without notice */
+
+/*
+ * Operations for the forwarding core
+ */
+static int
+sim_canput(void *cookie)
+{
+    sim_port_t *port = cookie;
+
+    return(port->peer == NULL || port->up);
+}
+
+static void
+sim_free(void *frame)
+{
+    sim_frame_t *f = frame;
+
+    if (--f->ref == 0)
+        free(f);
+}
+
+static void
+sim_xmit(void *cookie, void *frame)
+{
+    sim_port_t  *port = cookie;
+    sim_port_t  *peer = port->peer;
+    sim_frame_t *f = frame;
+
+    if (peer == NULL) {
+        /* Edge ports get BPDUs too */
+        if (f->data[12] == (TEST_ETHERTYPE >> 8) && f->data[13] == (TEST_ETHERTYPE & 0xff))
+            port->received++;
+        sim_free(frame);
+    } else if (!port->up) {
+        sim_free(frame);
+    } else if (peer->count == QUEUE_LEN) {
+        overflow++;
+        sim_free(frame);
+    } else {
+        peer->queue[(peer->head + peer->count++) % QUEUE_LEN] = frame;
+    }
+}
+
+static void *
+sim_dup(void *frame)
+{
+    ((sim_frame_t *)frame)->ref++;
+    return(frame);
+}
+
+static int
+sim_schedule(brdg_t *br)
+{
+    ((sim_bridge_t *)brdg_arg(br))->pending = 1;
+    return(0);
+}
+
+static void *
+sim_alloc(const uint8_t *data, size_t len)
+{
+    sim_frame_t *f;
+
+    if (len > FRAME_MAX || (f = malloc(sizeof(sim_frame_t))) == NULL)
+        return(NULL);
+    f->ref = 1;
+    f->len = len;
+    memcpy(f->data, data, len);
+    return(f);
+}
+
+static brdg_ops_t sim_ops = {
+    sim_canput,
+    sim_xmit,
+    sim_dup,
+    sim_free,
+    sim_schedule,
+    NULL,
+    NULL,
+    sim_alloc
+};
+
+static void
+run_learn(sim_bridge_t *b)
+{
+    if (b->pending) {
+        b->pending = 0;
+        brdg_learn_run(b->br);
+    }
+}
+
+/*****************************************************************************
+ * receive()
+ *
+ * Give the frames queued on the port to the bridge. Frames queued while
+ * they are received are left to the next step.
+ *****************************************************************************/
+static void
+receive(sim_port_t *port)
+{
+    sim_frame_t *f;
+    uint32_t    n = port->count;
+
+    while (n-- > 0) {
+        f = port->queue[port->head];
+        port->head = (port->head + 1) % QUEUE_LEN;
+        port->count--;
+        brdg_input(port->bridge->br, port->bport, f, f->data, f->len);
+        run_learn(port->bridge);
+    }
+}
+
+/*****************************************************************************
+ * step()
+ *
+ * Advance the virtual clock by STEP_MSEC.
+ *****************************************************************************/
+static void
+step(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < nlink; i++) {
+        receive(&links[i].end[0]);
+        receive(&links[i].end[1]);
+    }
+    msclock += STEP_MSEC;
+    for (i = 0; i < nbridge; i++) {
+        brdg_tick(bridges[i].br, msclock);
+        run_learn(&bridges[i]);
+    }
+}
+
+static int
+forwarding(sim_port_t *port)
+{
+    brdg_stp_port_t bp;
+
+    return(brdg_port_stp_get(port->bridge->br, port->bport, &bp) == 0 &&
+        bp.bp_state == BRDG_STP_FORWARDING);
+}
+
+static uint32_t
+find_root(uint32_t *parent, uint32_t i)
+{
+    while (parent[i] != i)
+        i = parent[i];
+    return(i);
+}
+
+/*****************************************************************************
+ * is_tree()
+ *
+ * Return non-zero if links which forward on both ends connect all bridges
+ * without a loop.
+ *****************************************************************************/
+static int
+is_tree(void)
+{
+    uint32_t parent[MAXBRIDGE];
+    uint32_t a, b, i;
+    uint32_t n = 0;
+
+    for (i = 0; i < nbridge; i++)
+        parent[i] = i;
+    for (i = 0; i < nlink; i++) {
+        if (!links[i].end[0].up || !forwarding(&links[i].end[0]) ||
+            !forwarding(&links[i].end[1]))
+            continue;
+        a = find_root(parent, links[i].end[0].bridge->index);
+        b = find_root(parent, links[i].end[1].bridge->index);
+        if (a == b)
+            return(0);
+        parent[a] = b;
+        n++;
+    }
+    return(n == nbridge - 1);
+}
+
+/*****************************************************************************
+ * converge()
+ *
+ * Run until the spanning tree is formed and stays for a forward delay.
+ *
+ *  Return:
+ *           milliseconds until the tree was formed, or -1 on timeout
+ *****************************************************************************/
+static int64_t
+converge(uint32_t timeout)
+{
+    uint64_t start = msclock;
+    uint64_t formed = 0;
+    int      tree = 0;
+
+    while (msclock - start < (uint64_t)timeout * 1000) {
+        step();
+        if (is_tree()) {
+            if (!tree)
+                formed = msclock;
+            tree = 1;
+            if (msclock - formed >= 15 * 1000)
+                return((int64_t)(formed - start));
+        } else {
+            tree = 0;
+        }
+    }
+    return(-1);
+}
+
+/*****************************************************************************
+ * flood_test()
+ *
+ * Send a broadcast from the host of every bridge, and check it reaches
+ * every other host exactly once.
+ *
+ *  Return:
+ *           number of hosts which received a broadcast not exactly once
+ *****************************************************************************/
+static uint32_t
+flood_test(void)
+{
+    uint8_t     frame[64];
+    sim_frame_t *f;
+    uint32_t    errors = 0;
+    uint32_t    i, j;
+
+    for (i = 0; i < nbridge; i++) {
+        for (j = 0; j < nbridge; j++)
+            bridges[j].host.received = 0;
+        memset(frame, 0, sizeof(frame));
+        memset(frame, 0xff, ETHERADDRL);
+        frame[6] = 0x02;
+        frame[10] = 0x01;
+        frame[11] = (uint8_t)i;
+        frame[12] = TEST_ETHERTYPE >> 8;
+        frame[13] = TEST_ETHERTYPE & 0xff;
+        f = sim_alloc(frame, sizeof(frame));
+        brdg_input(bridges[i].br, bridges[i].host.bport, f, f->data, f->len);
+        run_learn(&bridges[i]);
+        for (j = 0; j < 100; j++)
+            step();
+        for (j = 0; j < nbridge; j++) {
+            if (bridges[j].host.received != (i != j)) {
+                printf("broadcast of host %u: received %u by host %u\n",
+                    i, bridges[j].host.received, j);
+                errors++;
+            }
+        }
+    }
+    return(errors);
+}
+
+static void
+link_add(uint32_t a, uint32_t b)
+{
+    sim_link_t *l = &links[nlink++];
+
+    l->end[0].bridge = &bridges[a];
+    l->end[1].bridge = &bridges[b];
+    l->end[0].peer = &l->end[1];
+    l->end[1].peer = &l->end[0];
+    l->end[0].up = l->end[1].up = 1;
+    if ((l->end[0].bport = brdg_port_add(bridges[a].br, &l->end[0])) == NULL ||
+        (l->end[1].bport = brdg_port_add(bridges[b].br, &l->end[1])) == NULL) {
+        fprintf(stderr, "brdg_port_add failed\n");
+        exit(1);
+    }
+}
+
+static void
+link_set(sim_link_t *l, int up)
+{
+    l->end[0].up = l->end[1].up = up;
+    if (!silent) {
+        brdg_port_link(l->end[0].bridge->br, l->end[0].bport, up);
+        brdg_port_link(l->end[1].bridge->br, l->end[1].bport, up);
+    }
+}
+
+static void
+report(char *event, int64_t msec, uint32_t *errors)
+{
+    if (msec < 0) {
+        printf("%-8s: no spanning tree\n", event);
+        (*errors)++;
+    } else {
+        printf("%-8s: spanning tree in %lld ms\n", event, (long long)msec);
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    int              c;
+    uint32_t         nchord = 1, timeout = 60, i;
+    uint32_t         errors = 0;
+    brdg_conf_t      conf;
+    brdg_stp_port_t  bp;
+    brdg_stp_info_t  info;
+    sim_link_t       *cut = NULL;
+
+    while ((c = getopt(argc, argv, "n:c:t:s")) != EOF) {
+        switch (c) {
+            case 'n':
+                nbridge = atoi(optarg);
+                break;
+            case 'c':
+                nchord = atoi(optarg);
+                break;
+            case 't':
+                timeout = atoi(optarg);
+                break;
+            case 's':
+                silent = 1;
+                break;
+            default:
+                print_usage(argv[0]);
+                break;
+        }
+    }
+    if (nbridge < 3 || nbridge > MAXBRIDGE || nchord > nbridge / 2)
+        print_usage(argv[0]);
+
+    memset(&conf, 0, sizeof(conf));
+    conf.bc_fdb_size = 1024;
+    conf.bc_fdb_aging = 300;
+    conf.bc_sweep_buckets = 256;
+    conf.bc_storm_burst = 200;
+    conf.bc_stp = 1;
+    conf.bc_stp_priority = 32768;
+
+    for (i = 0; i < nbridge; i++) {
+        conf.bc_hash_key[0] = (uint64_t)(i + 1) << 8;
+        conf.bc_hash_key[1] = i;
+        conf.bc_addr.ether_addr_octet[1] = (uint8_t)(i + 1);
+        conf.bc_addr.ether_addr_octet[2] = (uint8_t)((i + 1) >> 8);
+        bridges[i].index = i;
+        if ((bridges[i].br = brdg_create(&conf, &sim_ops, &bridges[i])) == NULL) {
+            fprintf(stderr, "brdg_create failed\n");
+            exit(1);
+        }
+        brdg_tick(bridges[i].br, msclock);
+        bridges[i].host.bridge = &bridges[i];
+        bridges[i].host.up = 1;
+        if ((bridges[i].host.bport = brdg_port_add(bridges[i].br,
+                 &bridges[i].host)) == NULL) {
+            fprintf(stderr, "brdg_port_add failed\n");
+            exit(1);
+        }
+        memset(&bp, 0, sizeof(bp));
+        bp.bp_priority = 128;
+        bp.bp_edge = 1;
+        brdg_port_stp(bridges[i].br, bridges[i].host.bport, &bp);
+    }
+    for (i = 0; i < nbridge; i++)
+        link_add(i, (i + 1) % nbridge);
+    for (i = 0; i < nchord; i++)
+        link_add(i * 2, (i * 2 + nbridge / 2) % nbridge);
+    printf("bridges %u, links %u\n", nbridge, nlink);
+
+    report("start", converge(timeout), &errors);
+    errors += flood_test();
+
+    /*
+     * Cut a forwarding link of the root bridge
+     */
+    for (i = 0; i < nlink && cut == NULL; i++) {
+        if (links[i].end[0].bridge->index == 0 && forwarding(&links[i].end[0]) &&
+            forwarding(&links[i].end[1]))
+            cut = &links[i];
+    }
+    if (cut != NULL) {
+        link_set(cut, 0);
+        report("cut", converge(timeout), &errors);
+        errors += flood_test();
+        link_set(cut, 1);
+        report("restore", converge(timeout), &errors);
+        errors += flood_test();
+    } else {
+        printf("no forwarding link of bridge 0\n");
+        errors++;
+    }
+
+    brdg_stp_info(bridges[nbridge - 1].br, &info);
+    printf("root %016llx, topology changes %u on bridge %u\n",
+        (unsigned long long)info.bs_root, info.bs_tc_count, nbridge - 1);
+    printf("frames dropped by full queues: %llu\n", (unsigned long long)overflow);
+    printf("errors: %u\n", errors);
+
+    for (i = 0; i < nlink; i++) {
+        brdg_port_remove(links[i].end[0].bridge->br, links[i].end[0].bport);
+        brdg_port_remove(links[i].end[1].bridge->br, links[i].end[1].bport);
+    }
+    for (i = 0; i < nbridge; i++) {
+        brdg_port_remove(bridges[i].br, bridges[i].host.bport);
+        brdg_destroy(bridges[i].br);
+    }
+    exit(errors == 0 ? 0 : 1);
+}
+
+int
+print_usage(char *argv)
+{
+    printf("Usage: %s [-n bridges] [-c chords] [-t timeout] [-s]\n", argv);
+    printf("Options:\n");
+    printf(" -n bridges\t: Number of bridges in the ring (default 4, max %d)\n",
+        MAXBRIDGE);
+    printf(" -c chords\t: Number of links across the ring (default 1)\n");
+    printf(" -t timeout\t: Seconds to wait for convergence (default 60)\n");
+    printf(" -s\t\t: Cut the link without telling the bridges\n");
+    exit(1);
+}
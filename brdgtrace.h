@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2010 Kazuyoshi Aizawa. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/****************************************************************
+ * brdgtrace.h
+ *
+ * Static trace probes of the bridge.
+ *
+ * In the kernel module, probes are SDT probes of DTrace, which are
+ * no-operations until enabled, e.g.
+ *
+ *    dtrace -n 'sdt:::brdg-drop { @[arg2] = count(); }'
+ *
+ * In userspace programs on Linux, probes are USDT probes of provider
+ * "brdg" if <sys/sdt.h> of SystemTap is available, and can be traced by
+ * bpftrace, perf or stap without rebuilding, e.g.
+ *
+ *    bpftrace -e 'usdt:./brdgpkt:brdg:drop { @[arg2] = count(); }'
+ *
+ * Otherwise probes are compiled out.
+ *
+ * Probes:
+ *   learn   (brdg_port_t *port, struct ether_addr *addr)
+ *           An address was registered on the port.
+ *   move    (brdg_port_t *port, struct ether_addr *addr, brdg_port_t *oldport)
+ *           An address was moved to the port from oldport. (station move)
+ *   evict   (brdg_port_t *port, struct ether_addr *addr, struct ether_addr *new)
+ *           An address of the port was replaced by a new address, because
+ *           the bucket was full. (hash collision)
+ *   age     (brdg_port_t *port, struct ether_addr *addr)
+ *           An address of the port was aged out.
+ *   forward (brdg_port_t *inport, brdg_port_t *outport, void *frame)
+ *           A frame was forwarded to the port of the destination.
+ *   flood   (brdg_port_t *inport, void *frame)
+ *           A frame was flooded.
+ *   join    (brdg_port_t *port, struct ether_addr *group)
+ *           The port became a member of the multicast group by a report.
+ *   leave   (brdg_port_t *port, struct ether_addr *group)
+ *           Membership of the port in the multicast group expired.
+ *   loop    (brdg_port_t *port, brdg_port_t *peer, int reason)
+ *           A loop was detected and the port was blocked. peer is the other
+ *           port of the loop or NULL, and reason is BRDG_LOOP_XXX.
+ *   unblock (brdg_port_t *port, int reason)
+ *           The block of the port expired.
+ *   link    (brdg_port_t *port, int up)
+ *           Link of the port went up or down.
+ *   limit   (brdg_port_t *port, int shut)
+ *           The port was shut down by the MAC limit, or brought back by
+ *           brdg_port_limit() if shut is 0.
+ *   stp     (brdg_port_t *port, int state)
+ *           RSTP changed the state of the port to BRDG_STP_XXX.
+ *   flush   (brdg_port_t *port, int others)
+ *           Dynamic addresses of the port were deleted, or of all ports but
+ *           the port and edge ports if others is non-zero.
+ *   drop    (brdg_port_t *port, void *frame, int reason)
+ *           A frame was dropped. reason is brdg_stat_t counted for it.
+ *           BRDG_STAT_BPDU if the frame was a BPDU consumed by RSTP.
+ *   flowctl (queue_t *q, mblk_t *mp)
+ *           Kernel only. The NIC driver could not accept the message,
+ *           and it was queued on the backlog of the port.
+ ***************************************************************/
+
+#ifndef __BRDGTRACE_H
+#define __BRDGTRACE_H
+
+#ifdef _KERNEL
+#include <sys/sdt.h>
+
+#define BRDG_TRACE2(name, t1, a1, t2, a2) \
+    DTRACE_PROBE2(brdg__##name, t1, a1, t2, a2)
+#define BRDG_TRACE3(name, t1, a1, t2, a2, t3, a3) \
+    DTRACE_PROBE3(brdg__##name, t1, a1, t2, a2, t3, a3)
+
+#else /* _KERNEL */
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define BRDG_USDT
+#endif
+#endif
+
+#ifdef BRDG_USDT
+#include <sys/sdt.h>
+
+#define BRDG_TRACE2(name, t1, a1, t2, a2) \
+    DTRACE_PROBE2(brdg, name, a1, a2)
+#define BRDG_TRACE3(name, t1, a1, t2, a2, t3, a3) \
+    DTRACE_PROBE3(brdg, name, a1, a2, a3)
+#else
+#define BRDG_TRACE2(name, t1, a1, t2, a2)
+#define BRDG_TRACE3(name, t1, a1, t2, a2, t3, a3)
+#endif
+
+#endif /* _KERNEL */
+
+#endif /* __BRDGTRACE_H */
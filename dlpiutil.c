@@ -48,6 +48,9 @@
 #include <errno.h>
 #include <unistd.h>
 #include <stropts.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <sys/time.h>
 #include "dlpiutil.h"
 #ifdef SOL11
 #include <sys/vfs_opreg.h>
@@ -60,12 +63,39 @@ int    dlbindreq(int, t_uscalar_t, t_uscalar_t, uint16_t, uint16_t, t_uscalar_t,
 void   dlprint_err(int , char *, ...);
 int    dldetachreq(int , caddr_t);
 int    dlpromiscoffreq(int, t_uscalar_t, caddr_t);
+int    dlnotifyreq(int, t_uscalar_t, caddr_t);
 int    strioctl(int , int , int , int , char *);
+int    dlrequest(int, void *, size_t, t_uscalar_t, caddr_t, char *);
+int    dlbringup(dlbringup_t *, int);
+char  *dlstepname(int);
+static int dlput(int, void *, size_t, char *);
+static int dlget(int, t_uscalar_t, caddr_t, char *, t_uscalar_t *);
+static int dlstep_send(dlbringup_t *);
+static int dlstep_run(dlbringup_t *);
 
 #ifndef ERR_MSG_MAX
 #define ERR_MSG_MAX 300
 #endif
 
+int    dl_timeout = DLTIMEOUT; /* Timeout of a DLPI request in milliseconds */
+
+/*
+ * Steps of dlbringup(), in order. A step with primitive 0 is an ioctl
+ * of cmd, which completes synchronously.
+ */
+static struct {
+    char         *name;
+    t_uscalar_t  primitive;  /* DLPI request, or 0 for ioctl */
+    t_uscalar_t  arg;        /* dl_level of DL_PROMISCON_REQ, or ioctl command */
+    t_uscalar_t  ack;        /* Positive acknowledgement */
+} dlsteps[DL_STEP_MAX] = {
+    { "attach",       DL_ATTACH_REQ,    0,               DL_OK_ACK },
+    { "bind",         DL_BIND_REQ,      0,               DL_BIND_ACK },
+    { "promisc_sap",  DL_PROMISCON_REQ, DL_PROMISC_SAP,  DL_OK_ACK },
+    { "promisc_phys", DL_PROMISCON_REQ, DL_PROMISC_PHYS, DL_OK_ACK },
+    { "raw",          0,                DLIOCRAW,        0 }
+};
+
 /*****************************************************************************
  * dlattachreq()
  *
@@ -75,40 +105,12 @@ int    strioctl(int , int , int , int , char *);
 int
 dlattachreq(int fd, t_uscalar_t ppa ,caddr_t buf)
 {
-    union DL_primitives	 *primitive;    
     dl_attach_req_t       attachreq;
-    struct strbuf         ctlbuf;
-    int	                  flags = 0;
-    int                   ret;
-    
+
     attachreq.dl_primitive = DL_ATTACH_REQ;
     attachreq.dl_ppa = ppa;
 
-    ctlbuf.maxlen = 0;
-    ctlbuf.len    = sizeof(attachreq);
-    ctlbuf.buf    = (caddr_t)&attachreq;
-
-    if (putmsg(fd, &ctlbuf, (struct strbuf*) NULL, flags) < 0){
-        dlprint_err(LOG_ERR, "dlattachreq: putmsg: %s", strerror(errno));
-        return(-1);
-    }
-
-    ctlbuf.maxlen = MAXDLBUFSIZE;
-    ctlbuf.len = 0;
-    ctlbuf.buf = (caddr_t)buf;
-
-    if ((ret = getmsg(fd, &ctlbuf, (struct strbuf *)NULL, &flags)) < 0) {
-        dlprint_err(LOG_ERR, "dlattachreq: getmsg: %s\n", strerror(errno));
-        return(-1);
-    }
-
-    primitive = (union DL_primitives *) ctlbuf.buf;
-    if ( primitive->dl_primitive != DL_OK_ACK){
-        dlprint_err(LOG_ERR, "dlattachreq: not DL_OK_ACK\n");
-        return(-1);
-    }
-    
-    return(0);
+    return(dlrequest(fd, &attachreq, sizeof(attachreq), DL_OK_ACK, buf, "dlattachreq"));
 }
 
 /*****************************************************************************
@@ -120,40 +122,13 @@ dlattachreq(int fd, t_uscalar_t ppa ,caddr_t buf)
 int
 dlpromisconreq(int fd, t_uscalar_t level, caddr_t buf)
 {
-    union DL_primitives	 *primitive;        
     dl_promiscon_req_t    promisconreq;
-    struct strbuf         ctlbuf;
-    int	                  flags = 0;
-    int                   ret;
 
     promisconreq.dl_primitive = DL_PROMISCON_REQ;
     promisconreq.dl_level = level;
 
-    ctlbuf.maxlen = 0;
-    ctlbuf.len    = sizeof (promisconreq);
-    ctlbuf.buf    = (caddr_t)&promisconreq;
-
-    if (putmsg(fd, &ctlbuf, (struct strbuf*) NULL, flags) < 0){
-        dlprint_err(LOG_ERR, "dlpromisconreq: putmsg: %s", strerror(errno));
-        return(-1);
-    }
-
-    ctlbuf.maxlen = MAXDLBUFSIZE;
-    ctlbuf.len = 0;
-    ctlbuf.buf = (caddr_t)buf;
-
-    if ((ret = getmsg(fd, &ctlbuf, (struct strbuf *)NULL, &flags)) < 0) {
-        dlprint_err(LOG_ERR, "dlpromisconreq: getmsg: %s\n", strerror(errno));
-        return(-1);
-    }
-
-    primitive = (union DL_primitives *) ctlbuf.buf;
-    if ( primitive->dl_primitive != DL_OK_ACK){
-        dlprint_err(LOG_ERR, "dlpromisconreq: not DL_OK_ACK\n");
-        return(-1);
-    }
-    
-    return(0); 
+    return(dlrequest(fd, &promisconreq, sizeof(promisconreq), DL_OK_ACK, buf,
+               "dlpromisconreq"));
 }
 
 /*****************************************************************************
@@ -173,11 +148,7 @@ dlbindreq(
     caddr_t     buf
     )
 {
-    union DL_primitives	 *primitive;        
     dl_bind_req_t         bindreq;
-    struct strbuf	  ctlbuf;
-    int	                  flags = 0;
-    int                   ret;    
 
     bindreq.dl_primitive    = DL_BIND_REQ;
     bindreq.dl_sap          = sap;
@@ -186,31 +157,7 @@ dlbindreq(
     bindreq.dl_conn_mgmt    = conn_mgmt;
     bindreq.dl_xidtest_flg  = xidtest_flg;
 
-    ctlbuf.maxlen = 0;
-    ctlbuf.len    = sizeof(bindreq);
-    ctlbuf.buf    = (caddr_t)&bindreq;
-
-    if (putmsg(fd, &ctlbuf, (struct strbuf*) NULL, flags) < 0){
-        dlprint_err(LOG_ERR, "dlbindreq: putmsg: %s", strerror(errno));
-        return(-1);
-    }
-
-    ctlbuf.maxlen = MAXDLBUFSIZE;
-    ctlbuf.len    = 0;
-    ctlbuf.buf    = (caddr_t)buf;
-
-    if ((ret = getmsg(fd, &ctlbuf, (struct strbuf *)NULL, &flags)) < 0) {
-        dlprint_err(LOG_ERR, "dlbindreq: getmsg: %s\n", strerror(errno));
-        return(-1);
-    }
-
-    primitive = (union DL_primitives *) ctlbuf.buf;
-    if ( primitive->dl_primitive != DL_BIND_ACK){
-        dlprint_err(LOG_ERR, "dlbindreq: not DL_BIND_ACK\n");
-        return(-1);
-    }
-    
-    return(0);
+    return(dlrequest(fd, &bindreq, sizeof(bindreq), DL_BIND_ACK, buf, "dlbindreq"));
 }
 
 /***********************************************************
@@ -224,13 +171,15 @@ dlprint_err(int level, char *format, ...)
 {
     va_list ap;
     char buf[ERR_MSG_MAX];
+    int  saved_errno = errno; /* Callers return errno after the message */
 
     va_start(ap, format);
     vsnprintf(buf, ERR_MSG_MAX, format, ap);
     va_end(ap);
 
     if(isatty(2))
-        fprintf(stderr, buf);
+        fprintf(stderr, "%s", buf);
+    errno = saved_errno;
 }
 
 /*****************************************************************************
@@ -242,39 +191,11 @@ dlprint_err(int level, char *format, ...)
 int
 dldetachreq(int fd, caddr_t buf)
 {
-    union DL_primitives	 *primitive;    
     dl_detach_req_t       detachreq = {0}; 
-    struct strbuf         ctlbuf;
-    int	                  flags = 0;
-    int                   ret;
-    
-    detachreq.dl_primitive = DL_DETACH_REQ;
 
-    ctlbuf.maxlen = 0;
-    ctlbuf.len    = sizeof(detachreq);
-    ctlbuf.buf    = (caddr_t)&detachreq;
-
-    if (putmsg(fd, &ctlbuf, (struct strbuf*) NULL, flags) < 0){
-        dlprint_err(LOG_ERR, "dldetachreq: putmsg: %s", strerror(errno));
-        return(-1);
-    }
-
-    ctlbuf.maxlen = MAXDLBUFSIZE;
-    ctlbuf.len = 0;
-    ctlbuf.buf = (caddr_t)buf;
-
-    if ((ret = getmsg(fd, &ctlbuf, (struct strbuf *)NULL, &flags)) < 0) {
-        dlprint_err(LOG_ERR, "dldetacheq: getmsg: %s\n", strerror(errno));
-        return(-1);
-    }
+    detachreq.dl_primitive = DL_DETACH_REQ;
 
-    primitive = (union DL_primitives *) ctlbuf.buf;
-    if ( primitive->dl_primitive != DL_OK_ACK){
-        dlprint_err(LOG_ERR, "dldetachreq: not DL_OK_ACK\n");
-        return(-1);
-    }
-    
-    return(0);
+    return(dlrequest(fd, &detachreq, sizeof(detachreq), DL_OK_ACK, buf, "dldetachreq"));
 }
 
 /*****************************************************************************
@@ -286,40 +207,39 @@ dldetachreq(int fd, caddr_t buf)
 int
 dlpromiscoffreq(int fd, t_uscalar_t level, caddr_t buf)
 {
-    union DL_primitives	 *primitive;        
     dl_promiscoff_req_t    promiscoffreq;
-    struct strbuf         ctlbuf;
-    int	                  flags = 0;
-    int                   ret;
 
     promiscoffreq.dl_primitive = DL_PROMISCOFF_REQ;
     promiscoffreq.dl_level = level;
 
-    ctlbuf.maxlen = 0;
-    ctlbuf.len    = sizeof (promiscoffreq);
-    ctlbuf.buf    = (caddr_t)&promiscoffreq;
-
-    if (putmsg(fd, &ctlbuf, (struct strbuf*) NULL, flags) < 0){
-        dlprint_err(LOG_ERR, "dlpromiscoffreq: putmsg: %s", strerror(errno));
-        return(-1);
-    }
+    return(dlrequest(fd, &promiscoffreq, sizeof(promiscoffreq), DL_OK_ACK, buf,
+               "dlpromiscoffreq"));
+}
 
-    ctlbuf.maxlen = MAXDLBUFSIZE;
-    ctlbuf.len = 0;
-    ctlbuf.buf = (caddr_t)buf;
+/*****************************************************************************
+ * dlnotifyreq()
+ *
+ * Send DL_NOTIFY_REQ to the driver, so that it sends DL_NOTIFY_IND of
+ * the notifications (DL_NOTE_XXX) to the stream.
+ *
+ *  Arguments:
+ *           fd            : stream of the interface
+ *           notifications : bitmap of DL_NOTE_XXX
+ *           buf           : buffer for the acknowledgement. MAXDLBUFSIZE bytes
+ *  Return:
+ *           0 on success, -1 on failure with errno
+ *****************************************************************************/
+int
+dlnotifyreq(int fd, t_uscalar_t notifications, caddr_t buf)
+{
+    dl_notify_req_t       notifyreq;
 
-    if ((ret = getmsg(fd, &ctlbuf, (struct strbuf *)NULL, &flags)) < 0) {
-        dlprint_err(LOG_ERR, "dlpromiscoffreq: getmsg: %s\n", strerror(errno));
-        return(-1);
-    }
+    bzero(&notifyreq, sizeof(notifyreq));
+    notifyreq.dl_primitive = DL_NOTIFY_REQ;
+    notifyreq.dl_notifications = notifications;
 
-    primitive = (union DL_primitives *) ctlbuf.buf;
-    if ( primitive->dl_primitive != DL_OK_ACK){
-        dlprint_err(LOG_ERR, "dlpromiscoffreq: not DL_OK_ACK\n");
-        return(-1);
-    }
-    
-    return(0); 
+    return(dlrequest(fd, &notifyreq, sizeof(notifyreq), DL_NOTIFY_ACK, buf,
+               "dlnotifyreq"));
 }
 
 /*****************************************************************************
@@ -349,3 +269,341 @@ strioctl(int fd, int cmd, int timout, int len, char *dp)
         return (strioc.ic_len);
     }
 }
+
+/*****************************************************************************
+ * dlput()
+ *
+ * Send a DLPI request to the stream by putmsg(2).
+ *
+ *  Arguments:
+ *           fd   : stream of the interface
+ *           req  : DLPI request
+ *           len  : length of req
+ *           name : name of the request for messages
+ *  Return:
+ *           0 on success, -1 on failure with errno
+ *****************************************************************************/
+static int
+dlput(int fd, void *req, size_t len, char *name)
+{
+    struct strbuf         ctlbuf;
+
+    ctlbuf.maxlen = 0;
+    ctlbuf.len    = len;
+    ctlbuf.buf    = (caddr_t)req;
+
+    if (putmsg(fd, &ctlbuf, (struct strbuf*) NULL, 0) < 0){
+        dlprint_err(LOG_ERR, "%s: putmsg: %s\n", name, strerror(errno));
+        return(-1);
+    }
+    return(0);
+}
+
+/*****************************************************************************
+ * dlget()
+ *
+ * Receive the acknowledgement of a DLPI request by getmsg(2).
+ * Acknowledgements are high priority messages, so frames received on
+ * the stream in the meantime are left in the queue.
+ * DL_ERROR_ACK is converted to errno. dl_unix_errno is used for
+ * DL_SYSERR, and EPROTO for other errors.
+ *
+ *  Arguments:
+ *           fd       : stream of the interface
+ *           ack      : primitive of the positive acknowledgement
+ *           buf      : buffer for the acknowledgement. MAXDLBUFSIZE bytes
+ *           name     : name of the request for messages
+ *           dlerrnop : set to dl_errno of DL_ERROR_ACK. May be NULL
+ *  Return:
+ *           0 on success, -1 on failure with errno
+ *****************************************************************************/
+static int
+dlget(int fd, t_uscalar_t ack, caddr_t buf, char *name, t_uscalar_t *dlerrnop)
+{
+    union DL_primitives	 *primitive;
+    struct strbuf         ctlbuf;
+    int	                  flags = RS_HIPRI;
+
+    ctlbuf.maxlen = MAXDLBUFSIZE;
+    ctlbuf.len    = 0;
+    ctlbuf.buf    = (caddr_t)buf;
+
+    if (getmsg(fd, &ctlbuf, (struct strbuf *)NULL, &flags) < 0) {
+        dlprint_err(LOG_ERR, "%s: getmsg: %s\n", name, strerror(errno));
+        return(-1);
+    }
+
+    primitive = (union DL_primitives *) ctlbuf.buf;
+    if (ctlbuf.len < (int)sizeof(t_uscalar_t)) {
+        dlprint_err(LOG_ERR, "%s: short acknowledgement\n", name);
+        errno = EPROTO;
+        return(-1);
+    }
+    if (primitive->dl_primitive == DL_ERROR_ACK &&
+        ctlbuf.len >= (int)sizeof(dl_error_ack_t)) {
+        if (dlerrnop != NULL)
+            *dlerrnop = primitive->error_ack.dl_errno;
+        if (primitive->error_ack.dl_errno == DL_SYSERR)
+            errno = primitive->error_ack.dl_unix_errno;
+        else
+            errno = EPROTO;
+        dlprint_err(LOG_ERR, "%s: DL_ERROR_ACK (dl_errno = 0x%x): %s\n", name,
+            (unsigned int)primitive->error_ack.dl_errno, strerror(errno));
+        return(-1);
+    }
+    if (primitive->dl_primitive != ack) {
+        dlprint_err(LOG_ERR, "%s: unexpected primitive 0x%x\n", name,
+            (unsigned int)primitive->dl_primitive);
+        errno = EPROTO;
+        return(-1);
+    }
+    return(0);
+}
+
+/*****************************************************************************
+ * dlrequest()
+ *
+ * Send a DLPI request, and wait for the acknowledgement for dl_timeout
+ * milliseconds at most.
+ *
+ *  Arguments:
+ *           fd   : stream of the interface
+ *           req  : DLPI request
+ *           len  : length of req
+ *           ack  : primitive of the positive acknowledgement
+ *           buf  : buffer for the acknowledgement. MAXDLBUFSIZE bytes
+ *           name : name of the request for messages
+ *  Return:
+ *           0 on success, -1 on failure with errno
+ *****************************************************************************/
+int
+dlrequest(int fd, void *req, size_t len, t_uscalar_t ack, caddr_t buf, char *name)
+{
+    struct pollfd  pfd;
+    int            ret;
+
+    if (dlput(fd, req, len, name) < 0)
+        return(-1);
+
+    pfd.fd = fd;
+    pfd.events = POLLPRI;
+    while ((ret = poll(&pfd, 1, dl_timeout)) < 0 && errno == EINTR)
+        ;
+    if (ret < 0) {
+        dlprint_err(LOG_ERR, "%s: poll: %s\n", name, strerror(errno));
+        return(-1);
+    }
+    if (ret == 0) {
+        dlprint_err(LOG_ERR, "%s: no acknowledgement in %d ms\n", name, dl_timeout);
+        errno = ETIMEDOUT;
+        return(-1);
+    }
+    return(dlget(fd, ack, buf, name, NULL));
+}
+
+/*****************************************************************************
+ * dlstep_send()
+ *
+ * Send the DLPI request of the current step of the stream.
+ *
+ *  Arguments:
+ *           db : the stream
+ *  Return:
+ *           0 on success, -1 on failure with errno
+ *****************************************************************************/
+static int
+dlstep_send(dlbringup_t *db)
+{
+    dl_attach_req_t       attachreq;
+    dl_bind_req_t         bindreq;
+    dl_promiscon_req_t    promisconreq;
+    char                  *name = dlsteps[db->db_step].name;
+
+    switch (dlsteps[db->db_step].primitive) {
+        case DL_ATTACH_REQ:
+            attachreq.dl_primitive = DL_ATTACH_REQ;
+            attachreq.dl_ppa = db->db_ppa;
+            return(dlput(db->db_fd, &attachreq, sizeof(attachreq), name));
+        case DL_BIND_REQ:
+            bzero(&bindreq, sizeof(bindreq));
+            bindreq.dl_primitive    = DL_BIND_REQ;
+            bindreq.dl_service_mode = DL_CLDLS;
+            return(dlput(db->db_fd, &bindreq, sizeof(bindreq), name));
+        case DL_PROMISCON_REQ:
+            promisconreq.dl_primitive = DL_PROMISCON_REQ;
+            promisconreq.dl_level = dlsteps[db->db_step].arg;
+            return(dlput(db->db_fd, &promisconreq, sizeof(promisconreq), name));
+        default:
+            errno = EINVAL;
+            return(-1);
+    }
+}
+
+/*****************************************************************************
+ * dlstep_run()
+ *
+ * Start the current step of the stream. ioctl steps are completed here,
+ * and the next step is started.
+ *
+ *  Arguments:
+ *           db : the stream
+ *  Return:
+ *           1 if waiting for an acknowledgement, 0 if all steps are done,
+ *           -1 on failure with db_errno
+ *****************************************************************************/
+static int
+dlstep_run(dlbringup_t *db)
+{
+    for (;;) {
+        if (db->db_step == DL_STEP_MAX)
+            return(0);
+        db->db_start = gethrtime();
+        if (dlsteps[db->db_step].primitive != 0) {
+            if (dlstep_send(db) < 0) {
+                db->db_errno = errno;
+                return(-1);
+            }
+            return(1);
+        }
+        /*
+         * An ioctl can't be polled. It is bounded by ic_timout in seconds.
+         */
+        if (strioctl(db->db_fd, dlsteps[db->db_step].arg,
+                (dl_timeout + MILLISEC - 1) / MILLISEC, 0, NULL) < 0) {
+            db->db_errno = errno;
+            return(-1);
+        }
+        db->db_time[db->db_step] = gethrtime() - db->db_start;
+        db->db_step++;
+    }
+}
+
+/*****************************************************************************
+ * dlbringup()
+ *
+ * Attach, bind, set promiscuous mode, and set DLIOCRAW on the streams
+ * concurrently. Requests of all streams are outstanding at the same time,
+ * and acknowledgements are waited by poll(2). So the time taken is that
+ * of the slowest interface, not the sum of all of them.
+ * Each step of each stream times out in dl_timeout milliseconds.
+ * Streams whose db_fd is negative are skipped.
+ *
+ *  Arguments:
+ *           db : streams. db_fd and db_ppa are set by the caller, and the
+ *                result of each stream is set in the others
+ *           n  : number of streams
+ *  Return:
+ *           number of streams which failed
+ *****************************************************************************/
+int
+dlbringup(dlbringup_t *db, int n)
+{
+    struct pollfd  *pfd;
+    int            *map;
+    int            npfd;
+    int            wait;
+    int            failed = 0;
+    int            i, j;
+    hrtime_t       now, deadline;
+    dlbringup_t    *d;
+    char           buf[MAXDLBUFSIZE];
+
+    pfd = malloc(n * sizeof(struct pollfd));
+    map = malloc(n * sizeof(int));
+    for (i = 0; i < n; i++) {
+        d = &db[i];
+        d->db_step = 0;
+        d->db_errno = 0;
+        d->db_dlerrno = 0;
+        bzero(d->db_time, sizeof(d->db_time));
+        if (d->db_fd < 0)
+            continue;
+        if (pfd == NULL || map == NULL)
+            d->db_errno = ENOMEM;
+        else
+            (void) dlstep_run(d);
+    }
+
+    while (pfd != NULL && map != NULL) {
+        /*
+         * Poll streams which wait for an acknowledgement until the
+         * earliest deadline.
+         */
+        now = gethrtime();
+        npfd = 0;
+        wait = dl_timeout;
+        for (i = 0; i < n; i++) {
+            d = &db[i];
+            if (d->db_fd < 0 || d->db_errno != 0 || d->db_step == DL_STEP_MAX)
+                continue;
+            deadline = d->db_start + (hrtime_t)dl_timeout * (NANOSEC / MILLISEC);
+            if (now >= deadline) {
+                dlprint_err(LOG_ERR, "%s: no acknowledgement in %d ms\n",
+                    dlsteps[d->db_step].name, dl_timeout);
+                d->db_errno = ETIMEDOUT;
+                continue;
+            }
+            if ((deadline - now) / (NANOSEC / MILLISEC) + 1 < wait)
+                wait = (deadline - now) / (NANOSEC / MILLISEC) + 1;
+            pfd[npfd].fd = d->db_fd;
+            pfd[npfd].events = POLLPRI;
+            pfd[npfd].revents = 0;
+            map[npfd++] = i;
+        }
+        if (npfd == 0)
+            break;
+
+        if (poll(pfd, npfd, wait) < 0) {
+            if (errno == EINTR)
+                continue;
+            for (j = 0; j < npfd; j++)
+                db[map[j]].db_errno = errno;
+            break;
+        }
+
+        for (j = 0; j < npfd; j++) {
+            d = &db[map[j]];
+            if (pfd[j].revents == 0)
+                continue;
+            if ((pfd[j].revents & POLLPRI) == 0) {
+                /* POLLERR, POLLHUP or POLLNVAL */
+                d->db_errno = EIO;
+                continue;
+            }
+            if (dlget(d->db_fd, dlsteps[d->db_step].ack, buf,
+                    dlsteps[d->db_step].name, &d->db_dlerrno) < 0) {
+                d->db_errno = errno;
+                continue;
+            }
+            d->db_time[d->db_step] = gethrtime() - d->db_start;
+            d->db_step++;
+            (void) dlstep_run(d);
+        }
+    }
+
+    for (i = 0; i < n; i++) {
+        if (db[i].db_fd >= 0 && db[i].db_errno != 0)
+            failed++;
+    }
+    free(pfd);
+    free(map);
+    return(failed);
+}
+
+/*****************************************************************************
+ * dlstepname()
+ *
+ * Name of the step of dlbringup().
+ *
+ *  Arguments:
+ *           step : DL_STEP_XXX
+ *  Return:
+ *           name of the step
+ *****************************************************************************/
+char *
+dlstepname(int step)
+{
+    if (step < 0 || step >= DL_STEP_MAX)
+        return("done");
+    return(dlsteps[step].name);
+}
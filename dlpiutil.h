@@ -35,6 +35,33 @@
 
 #define MAXDLBUFSIZE  8192
 #define DLBUFSIZE     8192
+#define DLTIMEOUT     5000  /* Default of dl_timeout in milliseconds */
+
+/*
+ * Steps of dlbringup(), in order
+ */
+#define DL_STEP_ATTACH       0  /* DL_ATTACH_REQ */
+#define DL_STEP_BIND         1  /* DL_BIND_REQ */
+#define DL_STEP_PROMISC_SAP  2  /* DL_PROMISCON_REQ of DL_PROMISC_SAP */
+#define DL_STEP_PROMISC_PHYS 3  /* DL_PROMISCON_REQ of DL_PROMISC_PHYS */
+#define DL_STEP_RAW          4  /* DLIOCRAW ioctl */
+#define DL_STEP_MAX          5
+
+/*
+ * A stream brought up by dlbringup()
+ */
+typedef struct dlbringup_s
+{
+    int          db_fd;       /* in: stream of the interface. Skipped if negative */
+    t_uscalar_t  db_ppa;      /* in: PPA to attach */
+    int          db_step;     /* out: step which failed, or DL_STEP_MAX */
+    int          db_errno;    /* out: 0 on success */
+    t_uscalar_t  db_dlerrno;  /* out: dl_errno of DL_ERROR_ACK, or 0 */
+    hrtime_t     db_start;    /* Start time of the current step */
+    hrtime_t     db_time[DL_STEP_MAX]; /* out: nanoseconds taken by each step */
+} dlbringup_t;
+
+extern int    dl_timeout;
 
 extern int    dlattachreq(int, t_uscalar_t, caddr_t );
 extern int    dlpromisconreq(int, t_uscalar_t, caddr_t);
@@ -42,6 +69,10 @@ extern int    dlbindreq(int, t_uscalar_t, t_uscalar_t, uint16_t, uint16_t, t_usc
 extern void   dlprint_err(int , char *, ...);
 extern int    dldetachreq(int , caddr_t);
 extern int    dlpromiscoffreq(int, t_uscalar_t, caddr_t);
+extern int    dlnotifyreq(int, t_uscalar_t, caddr_t);
 extern int    strioctl(int , int , int , int , char *);
+extern int    dlrequest(int, void *, size_t, t_uscalar_t, caddr_t, char *);
+extern int    dlbringup(dlbringup_t *, int);
+extern char  *dlstepname(int);
 
 #endif /* __DLPIUTIL_H */